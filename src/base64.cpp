@@ -13,13 +13,18 @@
 
 #include "base64.h"
 
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+# define GLOOX_BASE64_SIMD 1
+# include <immintrin.h>
+#endif
+
 namespace gloox
 {
 
   namespace Base64
   {
 
-    static const std::string alphabet64( "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" );
+    static const char alphabet64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
     static const char pad = '=';
     static const char np  = static_cast<char>( std::string::npos );
     static char table64vals[] =
@@ -35,89 +40,410 @@ namespace gloox
       return ( c < 43 || c > 122 ) ? np : table64vals[c-43];
     }
 
-    const std::string encode64( const std::string& input )
+    static inline void encodeGroup( const unsigned char* in, char* out )
     {
-      std::string encoded;
-      char c;
-      const std::string::size_type length = input.length();
+      const unsigned v = ( static_cast<unsigned>( in[0] ) << 16 )
+                         | ( static_cast<unsigned>( in[1] ) << 8 ) | in[2];
+      out[0] = alphabet64[v >> 18];
+      out[1] = alphabet64[( v >> 12 ) & 0x3f];
+      out[2] = alphabet64[( v >> 6 ) & 0x3f];
+      out[3] = alphabet64[v & 0x3f];
+    }
+
+    typedef std::string::size_type ( *EncodeBlocksFunc )( const unsigned char*, std::string::size_type, char* );
+    typedef std::string::size_type ( *DecodeBlocksFunc )( const char*, std::string::size_type, char* );
 
-      encoded.reserve( length * 2 );
+    // The block functions below process as many complete blocks as they safely can and return
+    // the number of input octets consumed. They stop at the first block containing anything but
+    // the alphabet. They may read up to 4 octets past the last consumed block (encoding), or
+    // write up to 8 octets past the last decoded block (decoding), but never past the given
+    // length resp. decodedLength( length ).
 
-      for( std::string::size_type i = 0; i < length; ++i )
+    static std::string::size_type encodeBlocksNone( const unsigned char*, std::string::size_type, char* )
+    {
+      return 0;
+    }
+
+    static std::string::size_type decodeBlocksScalar( const char* in, std::string::size_type length, char* out )
+    {
+      std::string::size_type i = 0;
+      for( ; i + 4 <= length; i += 4, out += 3 )
       {
-        c = static_cast<char>( ( input[i] >> 2 ) & 0x3f );
-        encoded += alphabet64[c];
+        const char a = table64( static_cast<unsigned char>( in[i] ) );
+        const char b = table64( static_cast<unsigned char>( in[i + 1] ) );
+        const char c = table64( static_cast<unsigned char>( in[i + 2] ) );
+        const char d = table64( static_cast<unsigned char>( in[i + 3] ) );
+        if( ( a | b | c | d ) & 0xc0 )
+          break;
 
-        c = static_cast<char>( ( input[i] << 4 ) & 0x3f );
-        if( ++i < length )
-          c = static_cast<char>( c | static_cast<char>( ( input[i] >> 4 ) & 0x0f ) );
-        encoded += alphabet64[c];
+        const unsigned v = ( static_cast<unsigned>( a ) << 18 ) | ( static_cast<unsigned>( b ) << 12 )
+                           | ( static_cast<unsigned>( c ) << 6 ) | static_cast<unsigned>( d );
+        out[0] = static_cast<char>( v >> 16 );
+        out[1] = static_cast<char>( ( v >> 8 ) & 0xff );
+        out[2] = static_cast<char>( v & 0xff );
+      }
+      return i;
+    }
 
-        if( i < length )
-        {
-          c = static_cast<char>( ( input[i] << 2 ) & 0x3c );
-          if( ++i < length )
-            c = static_cast<char>( c | static_cast<char>( ( input[i] >> 6 ) & 0x03 ) );
-          encoded += alphabet64[c];
-        }
-        else
+#if defined( GLOOX_BASE64_SIMD )
+    // Encoding and decoding follow W. Muła and D. Lemire, "Faster Base64 Encoding and
+    // Decoding Using AVX2 Instructions", ACM TWEB 2018.
+
+    __attribute__(( target( "ssse3" ) ))
+    static inline __m128i encodeBlock128( __m128i in )
+    {
+      in = _mm_shuffle_epi8( in, _mm_set_epi8( 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1 ) );
+
+      // split the 4 sextets of each 3 octet group into separate bytes
+      const __m128i t0 = _mm_and_si128( in, _mm_set1_epi32( 0x0fc0fc00 ) );
+      const __m128i t1 = _mm_mulhi_epu16( t0, _mm_set1_epi32( 0x04000040 ) );
+      const __m128i t2 = _mm_and_si128( in, _mm_set1_epi32( 0x003f03f0 ) );
+      const __m128i t3 = _mm_mullo_epi16( t2, _mm_set1_epi32( 0x01000010 ) );
+      const __m128i indices = _mm_or_si128( t1, t3 );
+
+      // map the sextets to the alphabet by adding a per-range offset
+      __m128i result = _mm_subs_epu8( indices, _mm_set1_epi8( 51 ) );
+      const __m128i less = _mm_cmpgt_epi8( _mm_set1_epi8( 26 ), indices );
+      result = _mm_or_si128( result, _mm_and_si128( less, _mm_set1_epi8( 13 ) ) );
+      const __m128i shift = _mm_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                           '/' - 63, 'A', 0, 0 );
+      result = _mm_shuffle_epi8( shift, result );
+      return _mm_add_epi8( result, indices );
+    }
+
+    __attribute__(( target( "ssse3" ) ))
+    static std::string::size_type encodeBlocksSSSE3( const unsigned char* in, std::string::size_type length,
+                                                     char* out )
+    {
+      std::string::size_type i = 0;
+      for( ; i + 16 <= length; i += 12, out += 16 )
+      {
+        const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( out ), encodeBlock128( block ) );
+      }
+      return i;
+    }
+
+    __attribute__(( target( "avx2" ) ))
+    static std::string::size_type encodeBlocksAVX2( const unsigned char* in, std::string::size_type length,
+                                                    char* out )
+    {
+      std::string::size_type i = 0;
+      for( ; i + 28 <= length; i += 24, out += 32 )
+      {
+        __m256i block = _mm256_inserti128_si256(
+            _mm256_castsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ) ) ),
+            _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i + 12 ) ), 1 );
+
+        block = _mm256_shuffle_epi8( block, _mm256_set_epi8( 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                             10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1 ) );
+
+        const __m256i t0 = _mm256_and_si256( block, _mm256_set1_epi32( 0x0fc0fc00 ) );
+        const __m256i t1 = _mm256_mulhi_epu16( t0, _mm256_set1_epi32( 0x04000040 ) );
+        const __m256i t2 = _mm256_and_si256( block, _mm256_set1_epi32( 0x003f03f0 ) );
+        const __m256i t3 = _mm256_mullo_epi16( t2, _mm256_set1_epi32( 0x01000010 ) );
+        const __m256i indices = _mm256_or_si256( t1, t3 );
+
+        __m256i result = _mm256_subs_epu8( indices, _mm256_set1_epi8( 51 ) );
+        const __m256i less = _mm256_cmpgt_epi8( _mm256_set1_epi8( 26 ), indices );
+        result = _mm256_or_si256( result, _mm256_and_si256( less, _mm256_set1_epi8( 13 ) ) );
+        const __m256i shift = _mm256_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                '/' - 63, 'A', 0, 0,
+                                                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                '/' - 63, 'A', 0, 0 );
+        result = _mm256_shuffle_epi8( shift, result );
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( out ), _mm256_add_epi8( result, indices ) );
+      }
+
+      return i + encodeBlocksSSSE3( in + i, length - i, out );
+    }
+
+    __attribute__(( target( "ssse3" ) ))
+    static std::string::size_type decodeBlocksSSSE3( const char* in, std::string::size_type length, char* out )
+    {
+      const __m128i lutLo = _mm_setr_epi8( 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                           0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a );
+      const __m128i lutHi = _mm_setr_epi8( 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                           0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 );
+      const __m128i lutRoll = _mm_setr_epi8( 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 );
+      const __m128i nibbles = _mm_set1_epi8( 0x0f );
+
+      std::string::size_type i = 0;
+      // 16 octets are stored per 12 decoded ones, hence the 8 characters of headroom
+      for( ; i + 24 <= length; i += 16, out += 12 )
+      {
+        const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i ) );
+        const __m128i hi = _mm_and_si128( _mm_srli_epi32( block, 4 ), nibbles );
+        const __m128i lo = _mm_and_si128( block, nibbles );
+
+        // any character outside the alphabet (incl. padding and whitespace) ends the fast path
+        const __m128i invalid = _mm_and_si128( _mm_shuffle_epi8( lutLo, lo ), _mm_shuffle_epi8( lutHi, hi ) );
+        if( _mm_movemask_epi8( _mm_cmpgt_epi8( invalid, _mm_setzero_si128() ) ) )
+          break;
+
+        const __m128i eq2f = _mm_cmpeq_epi8( block, _mm_set1_epi8( 0x2f ) );
+        const __m128i roll = _mm_shuffle_epi8( lutRoll, _mm_add_epi8( eq2f, hi ) );
+        const __m128i values = _mm_add_epi8( block, roll );
+
+        // pack 4 sextets into 3 octets
+        const __m128i merged = _mm_maddubs_epi16( values, _mm_set1_epi32( 0x01400140 ) );
+        __m128i result = _mm_madd_epi16( merged, _mm_set1_epi32( 0x00011000 ) );
+        result = _mm_shuffle_epi8( result, _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                                          -1, -1, -1, -1 ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( out ), result );
+      }
+
+      return i + decodeBlocksScalar( in + i, length - i, out );
+    }
+
+    __attribute__(( target( "avx2" ) ))
+    static std::string::size_type decodeBlocksAVX2( const char* in, std::string::size_type length, char* out )
+    {
+      const __m256i lutLo = _mm256_setr_epi8( 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                              0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                                              0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                              0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a );
+      const __m256i lutHi = _mm256_setr_epi8( 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                              0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                              0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                              0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 );
+      const __m256i lutRoll = _mm256_setr_epi8( 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 );
+      const __m256i nibbles = _mm256_set1_epi8( 0x0f );
+
+      std::string::size_type i = 0;
+      // 32 octets are stored per 24 decoded ones, hence the 16 characters of headroom
+      for( ; i + 48 <= length; i += 32, out += 24 )
+      {
+        const __m256i block = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( in + i ) );
+        const __m256i hi = _mm256_and_si256( _mm256_srli_epi32( block, 4 ), nibbles );
+        const __m256i lo = _mm256_and_si256( block, nibbles );
+
+        const __m256i invalid = _mm256_and_si256( _mm256_shuffle_epi8( lutLo, lo ),
+                                                  _mm256_shuffle_epi8( lutHi, hi ) );
+        if( _mm256_movemask_epi8( _mm256_cmpgt_epi8( invalid, _mm256_setzero_si256() ) ) )
+          break;
+
+        const __m256i eq2f = _mm256_cmpeq_epi8( block, _mm256_set1_epi8( 0x2f ) );
+        const __m256i roll = _mm256_shuffle_epi8( lutRoll, _mm256_add_epi8( eq2f, hi ) );
+        const __m256i values = _mm256_add_epi8( block, roll );
+
+        const __m256i merged = _mm256_maddubs_epi16( values, _mm256_set1_epi32( 0x01400140 ) );
+        __m256i result = _mm256_madd_epi16( merged, _mm256_set1_epi32( 0x00011000 ) );
+        result = _mm256_shuffle_epi8( result, _mm256_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                                                -1, -1, -1, -1,
+                                                                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                                                -1, -1, -1, -1 ) );
+        result = _mm256_permutevar8x32_epi32( result, _mm256_setr_epi32( 0, 1, 2, 4, 5, 6, 3, 7 ) );
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( out ), result );
+      }
+
+      return i + decodeBlocksSSSE3( in + i, length - i, out );
+    }
+#endif
+
+    static EncodeBlocksFunc resolveEncodeBlocks()
+    {
+#if defined( GLOOX_BASE64_SIMD )
+      __builtin_cpu_init();
+      if( __builtin_cpu_supports( "avx2" ) )
+        return encodeBlocksAVX2;
+      if( __builtin_cpu_supports( "ssse3" ) )
+        return encodeBlocksSSSE3;
+#endif
+      return encodeBlocksNone;
+    }
+
+    static DecodeBlocksFunc resolveDecodeBlocks()
+    {
+#if defined( GLOOX_BASE64_SIMD )
+      __builtin_cpu_init();
+      if( __builtin_cpu_supports( "avx2" ) )
+        return decodeBlocksAVX2;
+      if( __builtin_cpu_supports( "ssse3" ) )
+        return decodeBlocksSSSE3;
+#endif
+      return decodeBlocksScalar;
+    }
+
+    std::string::size_type Encoder::update( const char* data, std::string::size_type length, char* out )
+    {
+      static const EncodeBlocksFunc encodeBlocks = resolveEncodeBlocks();
+
+      const unsigned char* in = reinterpret_cast<const unsigned char*>( data );
+      std::string::size_type i = 0;
+      std::string::size_type written = 0;
+
+      if( m_count )
+      {
+        for( ; m_count < 2 && i < length; ++i )
+          m_carry[m_count++] = in[i];
+        if( i == length )
+          return 0;
+
+        const unsigned char group[3] = { m_carry[0], m_carry[1], in[i++] };
+        encodeGroup( group, out );
+        written = 4;
+        m_count = 0;
+      }
+
+      const std::string::size_type blocks = encodeBlocks( in + i, length - i, out + written );
+      i += blocks;
+      written += blocks / 3 * 4;
+
+      for( ; i + 3 <= length; i += 3, written += 4 )
+        encodeGroup( in + i, out + written );
+
+      for( ; i < length; ++i )
+        m_carry[m_count++] = in[i];
+
+      return written;
+    }
+
+    std::string::size_type Encoder::finish( char* out )
+    {
+      if( !m_count )
+        return 0;
+
+      out[0] = alphabet64[m_carry[0] >> 2];
+      if( m_count == 1 )
+      {
+        out[1] = alphabet64[( m_carry[0] << 4 ) & 0x3f];
+        out[2] = pad;
+      }
+      else
+      {
+        out[1] = alphabet64[( ( m_carry[0] << 4 ) | ( m_carry[1] >> 4 ) ) & 0x3f];
+        out[2] = alphabet64[( m_carry[1] << 2 ) & 0x3f];
+      }
+      out[3] = pad;
+
+      m_count = 0;
+      return 4;
+    }
+
+    std::string::size_type Decoder::flush( char* out )
+    {
+      std::string::size_type written = 0;
+      switch( m_count )
+      {
+        case 1:
+          m_error = true;
+          break;
+        case 2:
+          out[written++] = static_cast<char>( ( m_bits >> 4 ) & 0xff );
+          break;
+        case 3:
+          out[written++] = static_cast<char>( ( m_bits >> 10 ) & 0xff );
+          out[written++] = static_cast<char>( ( m_bits >> 2 ) & 0xff );
+          break;
+        default:
+          break;
+      }
+      m_bits = 0;
+      m_count = 0;
+      return written;
+    }
+
+    std::string::size_type Decoder::update( const char* data, std::string::size_type length, char* out )
+    {
+      static const DecodeBlocksFunc decodeBlocks = resolveDecodeBlocks();
+
+      if( m_error )
+        return std::string::npos;
+
+      std::string::size_type i = 0;
+      std::string::size_type written = 0;
+
+      while( i < length )
+      {
+        if( !m_count && !m_padded )
         {
-          ++i;
-          encoded += pad;
+          const std::string::size_type blocks = decodeBlocks( data + i, length - i, out + written );
+          i += blocks;
+          written += blocks / 4 * 3;
+          if( i == length )
+            break;
         }
 
-        if( i < length )
+        const unsigned char c = static_cast<unsigned char>( data[i++] );
+        if( c == ' ' || c == '\t' || c == '\r' || c == '\n' )
+          continue;
+
+        if( c == pad )
         {
-          c = static_cast<char>( input[i] & 0x3f );
-          encoded += alphabet64[c];
+          if( !m_padded )
+          {
+            written += flush( out + written );
+            m_padded = true;
+          }
         }
         else
         {
-          encoded += pad;
+          const char v = table64( c );
+          if( v == np || m_padded )
+            m_error = true;
+
+          m_bits = ( m_bits << 6 ) | static_cast<unsigned>( v & 0x3f );
+          if( ++m_count == 4 )
+          {
+            out[written++] = static_cast<char>( ( m_bits >> 16 ) & 0xff );
+            out[written++] = static_cast<char>( ( m_bits >> 8 ) & 0xff );
+            out[written++] = static_cast<char>( m_bits & 0xff );
+            m_bits = 0;
+            m_count = 0;
+          }
         }
+
+        if( m_error )
+          return std::string::npos;
       }
 
-      return encoded;
+      return written;
     }
 
-    const std::string decode64( const std::string& input )
+    std::string::size_type Decoder::finish( char* out )
     {
-      char c, d;
-      const std::string::size_type length = input.length();
-      std::string decoded;
-
-      decoded.reserve( length );
+      const std::string::size_type written = flush( out );
+      const bool error = m_error;
+      m_padded = false;
+      m_error = false;
+      return error ? std::string::npos : written;
+    }
 
-      for( std::string::size_type i = 0; i < length; ++i )
-      {
-        c = table64(input[i]);
-        ++i;
-        d = table64(input[i]);
-        c = static_cast<char>( ( c << 2 ) | ( ( d >> 4 ) & 0x3 ) );
-        decoded += c;
-        if( ++i < length )
-        {
-          c = input[i];
-          if( pad == c )
-            break;
+    const std::string encode64( const std::string& input )
+    {
+      std::string encoded( encodedLength( input.length() ), '\0' );
+      if( encoded.empty() )
+        return encoded;
 
-          c = table64(input[i]);
-          d = static_cast<char>( ( ( d << 4 ) & 0xf0 ) | ( ( c >> 2 ) & 0xf ) );
-          decoded += d;
-        }
+      Encoder e;
+      const std::string::size_type written = e.update( input.data(), input.length(), &encoded[0] );
+      e.finish( &encoded[written] );
+      return encoded;
+    }
 
-        if( ++i < length )
-        {
-          d = input[i];
-          if( pad == d )
-            break;
+    const std::string decode64( const std::string& input )
+    {
+      std::string decoded( decodedLength( input.length() ), '\0' );
+      if( decoded.empty() )
+        return decoded;
 
-          d = table64(input[i]);
-          c = static_cast<char>( ( ( c << 6 ) & 0xc0 ) | d );
-          decoded += c;
-        }
+      Decoder d;
+      std::string::size_type written = d.update( input.data(), input.length(), &decoded[0] );
+      if( written != std::string::npos )
+      {
+        const std::string::size_type rest = d.finish( &decoded[written] );
+        written = rest != std::string::npos ? written + rest : rest;
       }
 
+      if( written == std::string::npos )
+        return std::string();
+
+      decoded.resize( written );
       return decoded;
     }
 
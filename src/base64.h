@@ -38,12 +38,117 @@ namespace gloox
       GLOOX_API const std::string encode64( const std::string& input );
 
       /**
-       * Base64-decodes the input according to RFC 3548.
+       * Base64-decodes the input according to RFC 3548. Whitespace is skipped.
        * @param input The encoded data.
-       * @return The decoded data.
+       * @return The decoded data, or an empty string if the input is not valid Base64.
        */
       GLOOX_API const std::string decode64( const std::string& input );
 
+      /**
+       * Returns the length of the Base64 encoding of @c length octets. This is also the
+       * minimum size of the output buffer passed to Encoder::update().
+       * @param length The number of octets to encode.
+       * @return The length of the encoded data, including padding.
+       * @since 1.1
+       */
+      inline std::string::size_type encodedLength( std::string::size_type length )
+        { return ( length + 2 ) / 3 * 4; }
+
+      /**
+       * Returns the maximum number of octets @c length characters of Base64 decode to. This is
+       * also the minimum size of the output buffer passed to Decoder::update().
+       * @param length The number of characters to decode.
+       * @return The maximum length of the decoded data.
+       * @since 1.1
+       */
+      inline std::string::size_type decodedLength( std::string::size_type length )
+        { return ( length + 3 ) / 4 * 3; }
+
+      /**
+       * @brief An incremental Base64 encoder writing into caller-provided buffers.
+       *
+       * Feed the data in chunks of arbitrary size to update(), then call finish() to
+       * write the final, padded group. Where available, SSSE3 or AVX2 are used
+       * (detected at runtime).
+       *
+       * @author Jakob Schröter <js@camaya.net>
+       * @since 1.1
+       */
+      class GLOOX_API Encoder
+      {
+        public:
+          /**
+           * Creates a new Encoder.
+           */
+          Encoder() : m_count( 0 ) {}
+
+          /**
+           * Encodes the given data. Up to 2 octets are kept back until more data arrives
+           * or finish() is called.
+           * @param data The data to encode.
+           * @param length The length of @c data.
+           * @param out The output buffer. Must be able to hold encodedLength( @c length ) characters.
+           * @return The number of characters written to @c out.
+           */
+          std::string::size_type update( const char* data, std::string::size_type length, char* out );
+
+          /**
+           * Writes the remaining, padded group and resets the Encoder.
+           * @param out The output buffer. Must be able to hold 4 characters.
+           * @return The number of characters written to @c out.
+           */
+          std::string::size_type finish( char* out );
+
+        private:
+          unsigned char m_carry[2];
+          int m_count;
+      };
+
+      /**
+       * @brief An incremental Base64 decoder writing into caller-provided buffers.
+       *
+       * Feed the encoded data in chunks of arbitrary size to update(), then call finish()
+       * to flush an unpadded final group. Whitespace (e.g. line breaks in vCard photos)
+       * is skipped. Where available, SSSE3 or AVX2 are used (detected at runtime).
+       *
+       * @author Jakob Schröter <js@camaya.net>
+       * @since 1.1
+       */
+      class GLOOX_API Decoder
+      {
+        public:
+          /**
+           * Creates a new Decoder.
+           */
+          Decoder() : m_bits( 0 ), m_count( 0 ), m_padded( false ), m_error( false ) {}
+
+          /**
+           * Decodes the given data.
+           * @param data The encoded data.
+           * @param length The length of @c data.
+           * @param out The output buffer. Must be able to hold decodedLength( @c length ) octets.
+           * @return The number of octets written to @c out, or @c std::string::npos if the
+           * input is not valid Base64. The Decoder stays in the error state until finish().
+           */
+          std::string::size_type update( const char* data, std::string::size_type length, char* out );
+
+          /**
+           * Writes the octets of an unpadded final group and resets the Decoder.
+           * @param out The output buffer. Must be able to hold 2 octets.
+           * @return The number of octets written to @c out, or @c std::string::npos if the
+           * input was not valid Base64.
+           */
+          std::string::size_type finish( char* out );
+
+        private:
+          std::string::size_type flush( char* out );
+
+          unsigned m_bits;
+          int m_count;
+          bool m_padded;
+          bool m_error;
+      };
+
   }
 
 }
@@ -92,7 +92,8 @@ namespace gloox
 
   // ---- ClientBase ----
   ClientBase::ClientBase( const std::string& ns, const std::string& server, int port )
-    : m_connection( 0 ), m_encryption( 0 ), m_compression( 0 ), m_disco( 0 ), m_namespace( ns ),
+    : m_connection( 0 ), m_encryption( 0 ), m_tlsContext( 0 ), m_compression( 0 ), m_disco( 0 ),
+      m_namespace( ns ),
       m_xmllang( "en" ), m_server( server ), m_compressionActive( false ), m_encryptionActive( false ),
       m_compress( true ), m_authed( false ), m_resourceBound( false ), m_block( false ), m_sasl( true ),
       m_tls( TLSOptional ), m_port( port ),
@@ -103,14 +104,16 @@ namespace gloox
       m_parser( this ), m_seFactory( 0 ), m_authError( AuthErrorUndefined ),
       m_streamError( StreamErrorUndefined ), m_streamErrorAppCondition( 0 ),
       m_selectedSaslMech( SaslMechNone ), m_customConnection( false ),
-      m_smSent( 0 )
+      m_iqTimeout( 0 ), m_smSent( 0 ), m_messageSessionCount( 0 ), m_routing( 0 ),
+      m_indexStale( false )
   {
     init();
   }
 
   ClientBase::ClientBase( const std::string& ns, const std::string& password,
                           const std::string& server, int port )
-    : m_connection( 0 ), m_encryption( 0 ), m_compression( 0 ), m_disco( 0 ), m_namespace( ns ),
+    : m_connection( 0 ), m_encryption( 0 ), m_tlsContext( 0 ), m_compression( 0 ), m_disco( 0 ),
+      m_namespace( ns ),
       m_password( password ),
       m_xmllang( "en" ), m_server( server ), m_compressionActive( false ), m_encryptionActive( false ),
       m_compress( true ), m_authed( false ), m_resourceBound( false ), m_block( false ), m_sasl( true ),
@@ -122,7 +125,8 @@ namespace gloox
       m_parser( this ), m_seFactory( 0 ), m_authError( AuthErrorUndefined ),
       m_streamError( StreamErrorUndefined ), m_streamErrorAppCondition( 0 ),
       m_selectedSaslMech( SaslMechNone ), m_customConnection( false ),
-      m_smSent( 0 )
+      m_iqTimeout( 0 ), m_smSent( 0 ), m_messageSessionCount( 0 ), m_routing( 0 ),
+      m_indexStale( false )
   {
     init();
   }
@@ -134,6 +138,7 @@ namespace gloox
     sha.feed( util::long2string( time( 0 ) ) );
     sha.feed( util::int2string( rand() ) );
     m_uniqueBaseId = sha.hex();
+    m_iqTracker.setIDPrefix( m_uniqueBaseId );
 
     if( !m_disco )
     {
@@ -155,7 +160,7 @@ namespace gloox
   ClientBase::~ClientBase()
   {
     m_iqHandlerMapMutex.lock();
-    m_iqIDHandlers.clear();
+    m_iqTracker.clear();
     m_iqHandlerMapMutex.unlock();
 
     m_iqExtHandlerMapMutex.lock();
@@ -167,6 +172,7 @@ namespace gloox
 
     setConnectionImpl( 0 );
     setEncryptionImpl( 0 );
+    setTLSContext( 0 );
     setCompressionImpl( 0 );
     delete m_seFactory;
     m_seFactory = 0; // to avoid usage when Disco gets deleted below
@@ -174,10 +180,6 @@ namespace gloox
     m_disco = 0;
 
     util::clearList( m_messageSessions );
-
-    PresenceJidHandlerList::const_iterator it1 = m_presenceJidHandlers.begin();
-    for( ; it1 != m_presenceJidHandlers.end(); ++it1 )
-      delete (*it1).jid;
   }
 
   ConnectionError ClientBase::recv( int timeout )
@@ -185,7 +187,9 @@ namespace gloox
     if( !m_connection || m_connection->state() == StateDisconnected )
       return ConnNotConnected;
 
-    return m_connection->recv( timeout );
+    const ConnectionError e = m_connection->recv( timeout );
+    checkIqTimeouts();
+    return e;
   }
 
   bool ClientBase::connect( bool block )
@@ -227,7 +231,8 @@ namespace gloox
       return;
     }
 
-    logInstance().dbg( LogAreaXmlIncoming, tag->xml() );
+    if( logInstance().enabled( LogLevelDebug, LogAreaXmlIncoming ) )
+      logInstance().dbg( LogAreaXmlIncoming, tag->xml() );
     ++m_stats.totalStanzasReceived;
 
     if( tag->name() == "stream" && tag->xmlns() == XMLNS_STREAM )
@@ -328,7 +333,12 @@ namespace gloox
 
   void ClientBase::handleDecompressedData( const std::string& data )
   {
-    parse( data );
+    parse( data.data(), data.length() );
+  }
+
+  void ClientBase::handleDecompressedData( const char* data, std::string::size_type length )
+  {
+    parse( data, length );
   }
 
   void ClientBase::handleEncryptedData( const TLSBase* /*base*/, const std::string& data )
@@ -339,12 +349,18 @@ namespace gloox
       m_logInstance.err( LogAreaClassClientbase, "Encryption finished, but chain broken" );
   }
 
-  void ClientBase::handleDecryptedData( const TLSBase* /*base*/, const std::string& data )
+  void ClientBase::handleDecryptedData( const TLSBase* base, const std::string& data )
+  {
+    handleDecryptedData( base, data.data(), data.length() );
+  }
+
+  void ClientBase::handleDecryptedData( const TLSBase* /*base*/, const char* data,
+                                        std::string::size_type length )
   {
     if( m_compression && m_compressionActive )
-      m_compression->decompress( data );
+      m_compression->decompress( data, length );
     else
-      parse( data );
+      parse( data, length );
   }
 
   void ClientBase::handleHandshakeResult( const TLSBase* /*base*/, bool success, CertInfo &certinfo )
@@ -369,14 +385,24 @@ namespace gloox
     }
   }
 
-  void ClientBase::handleReceivedData( const ConnectionBase* /*connection*/, const std::string& data )
+  void ClientBase::handleReceivedData( const ConnectionBase* connection, const std::string& data )
+  {
+    handleReceivedData( connection, data.data(), data.length() );
+  }
+
+  void ClientBase::handleReceivedData( const ConnectionBase* /*connection*/, const char* data,
+                                       std::string::size_type length )
   {
     if( m_encryption && m_encryptionActive )
-      m_encryption->decrypt( data );
+      m_encryption->decrypt( data, length );
     else if( m_compression && m_compressionActive )
-      m_compression->decompress( data );
+      m_compression->decompress( data, length );
     else
-      parse( data );
+      parse( data, length );
+
+    // in blocking mode the connection's receive() loop does not go through recv()
+    if( m_block )
+      checkIqTimeouts();
   }
 
   void ClientBase::handleConnect( const ConnectionBase* /*connection*/ )
@@ -429,16 +455,16 @@ namespace gloox
 #endif
   }
 
-  void ClientBase::parse( const std::string& data )
+  void ClientBase::parse( const char* data, std::string::size_type length )
   {
-    std::string copy = data;
     int i = 0;
-    if( ( i = m_parser.feed( copy ) ) >= 0 )
+    if( ( i = m_parser.feed( data, length ) ) >= 0 )
     {
       std::string error = "parse error (at pos ";
       error += util::int2string( i );
       error += "): ";
-      m_logInstance.err( LogAreaClassClientbase, error + copy );
+      error.append( data, length );
+      m_logInstance.err( LogAreaClassClientbase, error );
       Tag* e = new Tag( "stream:error" );
       new Tag( e, "restricted-xml", "xmlns", XMLNS_XMPP_STREAM );
       send( e );
@@ -482,6 +508,15 @@ namespace gloox
     m_clientCerts = clientCerts;
   }
 
+  void ClientBase::setTLSContext( TLSContext* context )
+  {
+    if( context )
+      context->acquire();
+    if( m_tlsContext )
+      m_tlsContext->release();
+    m_tlsContext = context;
+  }
+
   void ClientBase::startSASL( SaslMechanism type )
   {
     m_selectedSaslMech = type;
@@ -655,56 +690,6 @@ namespace gloox
     send( a );
   }
 
-  std::string ClientBase::hmac( const std::string& key, const std::string& str )
-  {
-    SHA sha;
-    std::string key_ = key;
-    if( key_.length() > 64 )
-    {
-      sha.feed( key_ );
-      key_ = sha.binary();
-      sha.reset();
-    }
-    unsigned char ipad[65];
-    unsigned char opad[65];
-    memset( ipad, '\0', sizeof( ipad ) );
-    memset( opad, '\0', sizeof( opad ) );
-    memcpy( ipad, key_.c_str(), key_.length() );
-    memcpy( opad, key_.c_str(), key_.length() );
-    for( int i = 0; i < 64; i++ )
-    {
-      ipad[i] ^= 0x36;
-      opad[i] ^= 0x5c;
-    }
-    sha.feed( ipad, 64 );
-    sha.feed( str );
-    key_ = sha.binary();
-    sha.reset();
-    sha.feed( opad, 64 );
-    sha.feed( key_ );
-
-    return sha.binary(); // hex() for testing
-  }
-
-  std::string ClientBase::hi( const std::string& str, const std::string& salt, int iter )
-  {
-    int xored[20];
-    memset( xored, '\0', sizeof( xored ) );
-    std::string tmp = salt;
-    tmp.append( "\0\0\0\1", 4 );
-    for( int i = 0; i < iter; ++i )
-    {
-      tmp = hmac( str, tmp );
-      for( int j = 0; j < 20; ++j )
-        xored[j] ^= tmp.c_str()[j];
-    }
-    std::string n;
-    for( int i=0; i < 20 ;++i )
-      n.push_back( static_cast<char>( xored[i] ) );
-
-    return n;
-  }
-
   void ClientBase::processSASLChallenge( const std::string& challenge )
   {
     Tag* t = new Tag( "response", XMLNS, XMLNS_STREAM_SASL );
@@ -729,11 +714,20 @@ namespace gloox
         tmp = decoded.substr( posi + 2, decoded.length() - posi - 2 );
         iter = atoi( tmp.c_str() );
 
-        if( !prep::saslprep( m_password, tmp ) )
-          break;
+        if( m_scramKeys.iterations != iter || m_scramKeys.salt != salt
+            || m_scramKeys.clientKey.length() != 20 || m_scramKeys.serverKey.length() != 20 )
+        {
+          if( !prep::saslprep( m_password, tmp ) )
+            break;
+
+          const std::string saltedPwd = SHA::pbkdf2( tmp, salt, iter );
+          m_scramKeys.salt = salt;
+          m_scramKeys.iterations = iter;
+          m_scramKeys.clientKey = SHA::hmac( saltedPwd, "Client Key" );
+          m_scramKeys.serverKey = SHA::hmac( saltedPwd, "Server Key" );
+        }
 
-        std::string saltedPwd = hi( tmp, salt, iter );
-        std::string ck = hmac( saltedPwd, "Client Key" );
+        const std::string& ck = m_scramKeys.clientKey;
         SHA sha;
         sha.feed( ck );
         std::string storedKey = sha.binary();
@@ -745,13 +739,12 @@ namespace gloox
         tmp += ",r=" + snonce;
 
         std::string authMessage = m_clientFirstMessageBare + "," + decoded + "," + tmp; // client-final-message-without-proof
-        std::string clientSignature = hmac( storedKey, authMessage );
+        std::string clientSignature = SHA::hmac( storedKey, authMessage );
         unsigned char clientProof[20]; // ck XOR clientSignature
         memcpy( clientProof, ck.c_str(), 20 );
         for( int i = 0; i < 20; ++i )
           clientProof[i] ^= clientSignature.c_str()[i];
-        std::string serverKey = hmac( saltedPwd, "Server Key" );
-        m_serverSignature = hmac( serverKey, authMessage );
+        m_serverSignature = SHA::hmac( m_scramKeys.serverKey, authMessage );
 
         tmp += ",p=";
         tmp.append( Base64::encode64( std::string( reinterpret_cast<const char*>( clientProof ), 20 ) ) );
@@ -916,6 +909,10 @@ namespace gloox
     else if( tag->hasChild( "temporary-auth-failure" ) )
       m_authError = SaslTemporaryAuthFailure;
 
+    // the cached keys may be stale, e.g. if the password was changed on the server
+    if( m_authError == SaslNotAuthorized )
+      m_scramKeys = ScramKeys();
+
 #if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
     if( m_selectedSaslMech == SaslMechNTLM )
     {
@@ -938,25 +935,27 @@ namespace gloox
     {
       const std::string decoded = Base64::decode64( payload );
       if( decoded.length() < 3 || Base64::decode64( decoded.substr( 2 ) ) != m_serverSignature  )
+      {
+        m_scramKeys = ScramKeys();
         return false;
+      }
     }
 
     return true;
   }
 
-  void ClientBase::send( IQ& iq, IqHandler* ih, int context, bool del )
+  void ClientBase::send( IQ& iq, IqHandler* ih, int context, bool del, int timeout )
   {
     if( ih && ( iq.subtype() == IQ::Set || iq.subtype() == IQ::Get ) )
     {
       if( iq.id().empty() )
         iq.setID( getID() );
 
-      TrackStruct track;
-      track.ih = ih;
-      track.context = context;
-      track.del = del;
+      if( timeout < 0 )
+        timeout = m_iqTimeout;
+      const long long deadline = timeout > 0 ? util::monotonicTime() + timeout * 1000LL : 0;
       m_iqHandlerMapMutex.lock();
-      m_iqIDHandlers[iq.id()] = track;
+      m_iqTracker.add( iq.id(), ih, context, del, iq.to().full(), deadline );
       m_iqHandlerMapMutex.unlock();
     }
 
@@ -1015,7 +1014,23 @@ namespace gloox
     if( !tag )
     return;
 
-    send( tag->xml() );
+    // serialize into the scratch buffer so that its capacity is reused; don't call out with the
+    // lock held. The buffer goes back afterwards, unless another thread is sending right now
+    std::string xml;
+    m_sendBufferMutex.lock();
+    xml.swap( m_sendBuffer );
+    m_sendBufferMutex.unlock();
+    xml.clear();
+    tag->appendXml( xml );
+
+    send( xml );
+
+    if( m_sendBufferMutex.trylock() )
+    {
+      if( m_sendBuffer.capacity() < xml.capacity() )
+        m_sendBuffer.swap( xml );
+      m_sendBufferMutex.unlock();
+    }
 
     ++m_stats.totalStanzasSent;
 
@@ -1043,7 +1058,8 @@ namespace gloox
       else
         m_connection->send( xml );
 
-      logInstance().dbg( LogAreaXmlOutgoing, xml );
+      if( logInstance().enabled( LogLevelDebug, LogAreaXmlOutgoing ) )
+        logInstance().dbg( LogAreaXmlOutgoing, xml );
     }
   }
 
@@ -1134,6 +1150,28 @@ namespace gloox
     send( " " );
   }
 
+  void ClientBase::checkIqTimeouts()
+  {
+    const long long now = util::monotonicTime();
+    IqTracker::Track track;
+    for( ;; )
+    {
+      m_iqHandlerMapMutex.lock();
+      const bool expired = m_iqTracker.expire( now, track );
+      m_iqHandlerMapMutex.unlock();
+      if( !expired )
+        break;
+
+      m_logInstance.dbg( LogAreaClassClientbase, "IQ '" + track.id + "' timed out" );
+      IQ iq( IQ::Error, m_jid, track.id );
+      iq.setFrom( JID( track.to ) );
+      iq.addExtension( new Error( StanzaErrorTypeWait, StanzaErrorRemoteServerTimeout ) );
+      track.ih->handleIqID( iq, track.context );
+      if( track.del )
+        delete track.ih;
+    }
+  }
+
   void ClientBase::xmppPing( const JID& to, EventHandler* eh )
   {
     const std::string& id = getID();
@@ -1333,42 +1371,38 @@ namespace gloox
   void ClientBase::registerPresenceHandler( const JID& jid, PresenceHandler* ph )
   {
     if( ph && jid )
-    {
-      JidPresHandlerStruct jph;
-      jph.jid = new JID( jid.bare() );
-      jph.ph = ph;
-      m_presenceJidHandlers.push_back( jph );
-    }
+      m_presenceJidHandlers[jid.bareHash()].push_back( std::make_pair( jid.bareJID(), ph ) );
   }
 
   void ClientBase::removePresenceHandler( const JID& jid, PresenceHandler* ph )
   {
-    PresenceJidHandlerList::iterator t;
-    PresenceJidHandlerList::iterator it = m_presenceJidHandlers.begin();
-    while( it != m_presenceJidHandlers.end() )
+    PresenceJidHandlerMap::iterator it = m_presenceJidHandlers.find( jid.bareHash() );
+    if( it == m_presenceJidHandlers.end() )
+      return;
+
+    JidPresenceHandlerList::iterator t;
+    JidPresenceHandlerList::iterator it2 = (*it).second.begin();
+    while( it2 != (*it).second.end() )
     {
-      t = it;
-      ++it;
-      if( ( !ph || (*t).ph == ph ) && (*t).jid->bare() == jid.bare() )
-      {
-        delete (*t).jid;
-        m_presenceJidHandlers.erase( t );
-      }
+      t = it2++;
+      if( ( !ph || (*t).second == ph ) && (*t).first.equalBare( jid ) )
+        (*it).second.erase( t );
+    }
+
+    // while a stanza is being delivered, the list may still be in use
+    if( (*it).second.empty() )
+    {
+      if( m_routing )
+        m_indexStale = true;
+      else
+        m_presenceJidHandlers.erase( it );
     }
   }
 
   void ClientBase::removeIDHandler( IqHandler* ih )
   {
-    IqTrackMap::iterator t;
     m_iqHandlerMapMutex.lock();
-    IqTrackMap::iterator it = m_iqIDHandlers.begin();
-    while( it != m_iqIDHandlers.end() )
-    {
-      t = it;
-      ++it;
-      if( ih == (*t).second.ih )
-        m_iqIDHandlers.erase( t );
-    }
+    m_iqTracker.remove( ih );
     m_iqHandlerMapMutex.unlock();
   }
 
@@ -1409,8 +1443,13 @@ namespace gloox
 
   void ClientBase::registerMessageSession( MessageSession* session )
   {
-    if( session )
-      m_messageSessions.push_back( session );
+    if( !session )
+      return;
+
+    m_messageSessions.push_back( session );
+    const IndexedSession is( ++m_messageSessionCount, session );
+    m_messageSessionsFull[session->target().hash()].push_back( is );
+    m_messageSessionsBare[session->target().bareHash()].push_back( is );
   }
 
   void ClientBase::disposeMessageSession( MessageSession* session )
@@ -1423,11 +1462,129 @@ namespace gloox
                                                  session );
     if( it != m_messageSessions.end() )
     {
+      unindexMessageSession( m_messageSessionsFull, session->target().hash(), session );
+      unindexMessageSession( m_messageSessionsBare, session->target().bareHash(), session );
       delete (*it);
       m_messageSessions.erase( it );
     }
   }
 
+  ClientBase::IndexedSession ClientBase::unindexMessageSession( MessageSessionIndex& index,
+                                                                std::size_t hash,
+                                                                MessageSession* session )
+  {
+    IndexedSession is( 0, 0 );
+    MessageSessionIndex::iterator it = index.find( hash );
+    if( it == index.end() )
+      return is;
+
+    IndexedSessionList::iterator it2 = (*it).second.begin();
+    for( ; it2 != (*it).second.end(); ++it2 )
+    {
+      if( (*it2).second == session )
+      {
+        is = (*it2);
+        (*it).second.erase( it2 );
+        break;
+      }
+    }
+
+    // while a stanza is being delivered, the list may still be in use
+    if( (*it).second.empty() )
+    {
+      if( m_routing )
+        m_indexStale = true;
+      else
+        index.erase( it );
+    }
+
+    return is;
+  }
+
+  void ClientBase::retargetMessageSession( MessageSession* session, const JID& oldTarget )
+  {
+    const JID& target = session->target();
+    if( target == oldTarget )
+      return;
+
+    const IndexedSession is = unindexMessageSession( m_messageSessionsFull, oldTarget.hash(), session );
+    if( !is.second )
+      return;
+
+    // keep the sessions in registration order, the order they are offered messages in
+    IndexedSessionList& l = m_messageSessionsFull[target.hash()];
+    IndexedSessionList::iterator it = l.end();
+    while( it != l.begin() )
+    {
+      IndexedSessionList::iterator p = it;
+      if( (*--p).first < is.first )
+        break;
+      it = p;
+    }
+    l.insert( it, is );
+  }
+
+  void ClientBase::routeMessage( MessageSessionIndex& index, bool full, Message& msg )
+  {
+    const JID& from = msg.from();
+    MessageSessionIndex::iterator it = index.find( full ? from.hash() : from.bareHash() );
+    if( it == index.end() )
+      return;
+
+    ++m_routing;
+    IndexedSessionList& l = (*it).second;
+    IndexedSessionList::const_iterator t;
+    IndexedSessionList::const_iterator it2 = l.begin();
+    while( it2 != l.end() )
+    {
+      t = it2++;
+      MessageSession* session = (*t).second;
+      if( ( full ? session->target() == from : session->target().equalBare( from ) ) &&
+          ( msg.thread().empty()
+            || session->threadID() == msg.thread()
+            || !session->honorThreadID() ) &&
+// FIXME don't use '== 0' here
+          ( session->types() & msg.subtype() || session->types() == 0 ) )
+      {
+        session->handleMessage( msg );
+//        return;
+      }
+    }
+    --m_routing;
+
+    pruneIndexes();
+  }
+
+  void ClientBase::pruneIndexes()
+  {
+    if( m_routing || !m_indexStale )
+      return;
+
+    m_indexStale = false;
+
+    PresenceJidHandlerMap::iterator itp = m_presenceJidHandlers.begin();
+    while( itp != m_presenceJidHandlers.end() )
+    {
+      if( (*itp).second.empty() )
+        itp = m_presenceJidHandlers.erase( itp );
+      else
+        ++itp;
+    }
+
+    MessageSessionIndex* indexes[] = { &m_messageSessionsFull, &m_messageSessionsBare };
+    for( int i = 0; i < 2; ++i )
+    {
+      MessageSessionIndex::iterator it = indexes[i]->begin();
+      while( it != indexes[i]->end() )
+      {
+        if( (*it).second.empty() )
+          it = indexes[i]->erase( it );
+        else
+          ++it;
+      }
+    }
+  }
+
   void ClientBase::registerMessageHandler( MessageHandler* mh )
   {
     if( mh )
@@ -1567,16 +1724,25 @@ namespace gloox
   void ClientBase::notifyPresenceHandlers( Presence& pres )
   {
     bool match = false;
-    PresenceJidHandlerList::const_iterator t;
-    PresenceJidHandlerList::const_iterator itj = m_presenceJidHandlers.begin();
-    while( itj != m_presenceJidHandlers.end() )
+    PresenceJidHandlerMap::iterator itj = m_presenceJidHandlers.find( pres.from().bareHash() );
+    if( itj != m_presenceJidHandlers.end() )
     {
-      t = itj++;
-      if( (*t).jid->bare() == pres.from().bare() && (*t).ph )
+      ++m_routing;
+      JidPresenceHandlerList& l = (*itj).second;
+      JidPresenceHandlerList::const_iterator t;
+      JidPresenceHandlerList::const_iterator itp = l.begin();
+      while( itp != l.end() )
       {
-        (*t).ph->handlePresence( pres );
-        match = true;
+        t = itp++;
+        if( (*t).first.equalBare( pres.from() ) )
+        {
+          (*t).second->handlePresence( pres );
+          match = true;
+        }
       }
+      --m_routing;
+
+      pruneIndexes();
     }
     if( match )
       return;
@@ -1605,19 +1771,19 @@ namespace gloox
 
   void ClientBase::notifyIqHandlers( IQ& iq )
   {
-    m_iqHandlerMapMutex.lock();
-    IqTrackMap::iterator it_id = m_iqIDHandlers.find( iq.id() );
-    bool haveIdHandler = ( it_id != m_iqIDHandlers.end() );
-    m_iqHandlerMapMutex.unlock();
-    if( haveIdHandler && ( iq.subtype() == IQ::Result || iq.subtype() == IQ::Error ) )
+    if( iq.subtype() == IQ::Result || iq.subtype() == IQ::Error )
     {
-      (*it_id).second.ih->handleIqID( iq, (*it_id).second.context );
-      if( (*it_id).second.del )
-        delete (*it_id).second.ih;
+      IqTracker::Track track;
       m_iqHandlerMapMutex.lock();
-      m_iqIDHandlers.erase( it_id );
+      const bool haveIdHandler = m_iqTracker.take( iq.id(), track );
       m_iqHandlerMapMutex.unlock();
-      return;
+      if( haveIdHandler )
+      {
+        track.ih->handleIqID( iq, track.context );
+        if( track.del )
+          delete track.ih;
+        return;
+      }
     }
 
     if( iq.extensions().empty() )
@@ -1686,35 +1852,8 @@ namespace gloox
       }
     }
 
-    MessageSessionList::const_iterator it1 = m_messageSessions.begin();
-    for( ; it1 != m_messageSessions.end(); ++it1 )
-    {
-      if( (*it1)->target().full() == msg.from().full() &&
-            ( msg.thread().empty()
-              || (*it1)->threadID() == msg.thread()
-              || !(*it1)->honorThreadID() ) &&
-// FIXME don't use '== 0' here
-            ( (*it1)->types() & msg.subtype() || (*it1)->types() == 0 ) )
-      {
-        (*it1)->handleMessage( msg );
-//        return;
-      }
-    }
-
-    it1 = m_messageSessions.begin();
-    for( ; it1 != m_messageSessions.end(); ++it1 )
-    {
-      if( (*it1)->target().bare() == msg.from().bare() &&
-            ( msg.thread().empty()
-              || (*it1)->threadID() == msg.thread()
-              || !(*it1)->honorThreadID() ) &&
-// FIXME don't use '== 0' here
-            ( (*it1)->types() & msg.subtype() || (*it1)->types() == 0 ) )
-      {
-        (*it1)->handleMessage( msg );
-//        return;
-      }
-    }
+    routeMessage( m_messageSessionsFull, true, msg );
+    routeMessage( m_messageSessionsBare, false, msg );
 
     MessageSessionHandler* msHandler = 0;
 
@@ -1816,6 +1955,7 @@ namespace gloox
       return 0;
 
     TLSDefault* tls = new TLSDefault( this, m_server );
+    tls->setContext( m_tlsContext );
     if( tls->init( m_clientKey, m_clientCerts, m_cacerts ) )
       return tls;
     else
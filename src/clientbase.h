@@ -19,6 +19,7 @@
 #include "gloox.h"
 #include "eventdispatcher.h"
 #include "iqhandler.h"
+#include "iqtracker.h"
 #include "jid.h"
 #include "logsink.h"
 #include "mutex.h"
@@ -33,6 +34,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <unordered_map>
 
 #if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
 #include <windows.h>
@@ -60,6 +62,7 @@ namespace gloox
   class MUCInvitationHandler;
   class TagHandler;
   class TLSBase;
+  class TLSContext;
   class ConnectionBase;
   class CompressionBase;
   class StanzaExtensionFactory;
@@ -79,6 +82,7 @@ namespace gloox
   {
 
     friend class RosterManager;
+    friend class MessageSession;
 
     public:
       /**
@@ -113,7 +117,8 @@ namespace gloox
        * established.
        * You can have the connection block 'til the end of the connection, or you can have it return
        * immediately. If you choose the latter, its your responsibility to call @ref recv() every now
-       * and then to actually receive data from the socket and to feed the parser.
+       * and then to actually receive data from the socket and to feed the parser. To drive many
+       * non-blocking clients from a single thread, add them to a ConnectionEventLoop.
        * @param block @b True for blocking, @b false for non-blocking connect. Defaults to @b true.
        * @return @b False if prerequisits are not met (server not set) or if the connection was refused,
        * @b true otherwise.
@@ -167,6 +172,15 @@ namespace gloox
        */
       void setCompression( bool compression ) { m_compress = compression; }
 
+      /**
+       * Switches allocation of incoming stanzas from a TagArena on/off. This saves most of
+       * the heap allocations per incoming stanza. Handlers that keep a Tag beyond the
+       * handler call must Tag::clone() it. Default: off.
+       * @param enable Whether to parse incoming stanzas into a TagArena.
+       * @since 1.1
+       */
+      void setTagArena( bool enable ) { m_parser.setTagArena( enable ); }
+
       /**
        * Sets the port to connect to. This is not necessary if either the default port (5222) is used
        * or SRV records exist which will be resolved.
@@ -185,9 +199,48 @@ namespace gloox
 
       /**
        * Sets the password to use to connect to the XMPP server.
+       * This also discards cached SCRAM keys (see scramKeys()).
        * @param password The password to use for authentication.
        */
-      void setPassword( const std::string &password ) { m_password = password; }
+      void setPassword( const std::string &password ) { m_password = password; m_scramKeys = ScramKeys(); }
+
+      /**
+       * @brief The keys SCRAM-SHA-1 derives from the password, salt and iteration count
+       * (RFC 5802, Section 3).
+       *
+       * Deriving them takes one PBKDF2 run with the server's iteration count, i.e. thousands
+       * of HMAC computations.
+       * @since 1.1
+       */
+      struct ScramKeys
+      {
+        ScramKeys() : iterations( 0 ) {}
+
+        std::string salt;               /**< The salt the keys were derived with. */
+        int iterations;                 /**< The iteration count the keys were derived with. */
+        std::string clientKey;          /**< The ClientKey (raw binary). */
+        std::string serverKey;          /**< The ServerKey (raw binary). */
+      };
+
+      /**
+       * Returns the SCRAM-SHA-1 keys derived during the last SCRAM authentication. They are
+       * reused for as long as the server sends the same salt and iteration count, so that
+       * re-authenticating (e.g. after a reconnect) does not repeat the key derivation.
+       * An application may store them (RFC 5802 allows that), and pass them to setScramKeys()
+       * of a new ClientBase to skip the derivation there, too. The password is still needed
+       * in case the server's parameters change.
+       * @return The cached SCRAM-SHA-1 keys. Empty if none have been derived yet.
+       * @since 1.1
+       */
+      const ScramKeys& scramKeys() const { return m_scramKeys; }
+
+      /**
+       * Sets the SCRAM-SHA-1 keys to use if the server's salt and iteration count match.
+       * Otherwise they are derived from the password, as usual.
+       * @param keys The keys, e.g. as returned by scramKeys() earlier.
+       * @since 1.1
+       */
+      void setScramKeys( const ScramKeys& keys ) { m_scramKeys = keys; }
 
       /**
        * Returns the current prepped server.
@@ -256,8 +309,11 @@ namespace gloox
        * @param context A value that allows for restoring context.
        * @param del Whether or not delete the IqHandler object after its being called.
        * Default: @b false.
+       * @param timeout The time in seconds after which the request is considered lost if no
+       * response arrived (see setIqTimeout()). 0 means never, -1 (the default) uses the value
+       * set with setIqTimeout(). This parameter is available since 1.1.
        */
-      void send( IQ& iq, IqHandler* ih, int context, bool del = false );
+      void send( IQ& iq, IqHandler* ih, int context, bool del = false, int timeout = -1 );
 
       /**
        * A convenience function that sends the given IQ stanza.
@@ -363,6 +419,26 @@ namespace gloox
        */
       void whitespacePing();
 
+      /**
+       * Sets the default time after which IQ requests sent using
+       * send( IQ&, IqHandler*, int, bool, int ) are considered lost if no response arrived.
+       * Their IqHandler then receives an IQ of type IQ::Error with a @c remote-server-timeout
+       * condition, and the request is forgotten.
+       * Timeouts are checked once per call to recv(), by ConnectionEventLoop for clients added
+       * to it, whenever data arrives if connect() is blocking, and in checkIqTimeouts().
+       * Default: 0 (requests never time out).
+       * @param timeout The timeout in seconds. 0 disables timeouts for IQs sent afterwards.
+       * @since 1.1
+       */
+      void setIqTimeout( int timeout ) { m_iqTimeout = timeout; }
+
+      /**
+       * Notifies the IqHandlers of all pending IQ requests that have timed out.
+       * See setIqTimeout().
+       * @since 1.1
+       */
+      void checkIqTimeouts();
+
       /**
        * Sends a XMPP Ping (@xep{0199}) to the given JID.
        * @param to Then entity to ping.
@@ -580,6 +656,17 @@ namespace gloox
        */
       void setClientCert( const std::string& clientKey, const std::string& clientCerts );
 
+      /**
+       * Use this function to share TLS configuration, TLS library state and cached TLS sessions
+       * with other clients. The context's CA and client certificates are used instead of the
+       * ones set with setCACerts() and setClientCert(). It takes effect with the next
+       * connection attempt (or the next call to setEncryptionImpl()).
+       * @param context The context to use, or 0 to stop using one. A reference is held until the
+       * client is destroyed or another context is set.
+       * @since 1.1
+       */
+      void setTLSContext( TLSContext* context );
+
       /**
        * Use this function to register a MessageSessionHandler with the Client.
        * Optionally the MessageSessionHandler can receive only MessageSessions with a given
@@ -697,9 +784,16 @@ namespace gloox
       // reimplemented from CompressionDataHandler
       virtual void handleDecompressedData( const std::string& data );
 
+      // reimplemented from CompressionDataHandler
+      virtual void handleDecompressedData( const char* data, std::string::size_type length );
+
       // reimplemented from ConnectionDataHandler
       virtual void handleReceivedData( const ConnectionBase* connection, const std::string& data );
 
+      // reimplemented from ConnectionDataHandler
+      virtual void handleReceivedData( const ConnectionBase* connection, const char* data,
+                                       std::string::size_type length );
+
       // reimplemented from ConnectionDataHandler
       virtual void handleConnect( const ConnectionBase* connection );
 
@@ -712,6 +806,10 @@ namespace gloox
       // reimplemented from TLSHandler
       virtual void handleDecryptedData( const TLSBase* base, const std::string& data );
 
+      // reimplemented from TLSHandler
+      virtual void handleDecryptedData( const TLSBase* base, const char* data,
+                                        std::string::size_type length );
+
       // reimplemented from TLSHandler
       virtual void handleHandshakeResult( const TLSBase* base, bool success, CertInfo &certinfo );
 
@@ -868,6 +966,7 @@ namespace gloox
       std::string m_authcid;             /**< An alternative authentication ID. See setAuthcid(). */
       ConnectionBase* m_connection;      /**< The transport connection. */
       TLSBase* m_encryption;             /**< Used for connection encryption. */
+      TLSContext* m_tlsContext;          /**< Shared TLS state, if any. */
       CompressionBase* m_compression;    /**< Used for connection compression. */
       Disco* m_disco;                    /**< The local Service Discovery client. */
 
@@ -988,10 +1087,8 @@ namespace gloox
       virtual void cleanup() {}
       virtual void handleIqIDForward( const IQ& iq, int context ) { (void) iq; (void) context; }
       void send( Tag* tag, bool queue, bool del );
-      std::string hmac( const std::string& str, const std::string& key );
-      std::string hi( const std::string& str, const std::string& key, int iter );
 
-      void parse( const std::string& data );
+      void parse( const char* data, std::string::size_type length );
       void init();
       void handleStreamError( Tag* tag );
       TLSBase* getDefaultEncryption();
@@ -1000,6 +1097,7 @@ namespace gloox
       void notifyIqHandlers( IQ& iq );
       void notifyMessageHandlers( Message& msg );
       void notifyPresenceHandlers( Presence& presence );
+      void retargetMessageSession( MessageSession* session, const JID& oldTarget );
       void notifySubscriptionHandlers( Subscription& s10n );
       void notifyTagHandlers( Tag* tag );
       void notifyOnDisconnect( ConnectionError e );
@@ -1012,13 +1110,6 @@ namespace gloox
       // reimplemented from IqHandler
       virtual void handleIqID( const IQ& iq, int context );
 
-      struct TrackStruct
-      {
-        IqHandler* ih;
-        int context;
-        bool del;
-      };
-
       struct TagHandlerStruct
       {
         TagHandler* th;
@@ -1026,12 +1117,6 @@ namespace gloox
         std::string tag;
       };
 
-      struct JidPresHandlerStruct
-      {
-        JID* jid;
-        PresenceHandler* ph;
-      };
-
       enum TrackContext
       {
         XMPPPing
@@ -1040,25 +1125,40 @@ namespace gloox
       typedef std::list<ConnectionListener*>               ConnectionListenerList;
       typedef std::multimap<const std::string, IqHandler*> IqHandlerMapXmlns;
       typedef std::multimap<const int, IqHandler*>         IqHandlerMap;
-      typedef std::map<const std::string, TrackStruct>     IqTrackMap;
       typedef std::map<const std::string, MessageHandler*> MessageHandlerMap;
       typedef std::map<int, Tag*>                          SMQueueMap;
       typedef std::list<MessageSession*>                   MessageSessionList;
       typedef std::list<MessageHandler*>                   MessageHandlerList;
       typedef std::list<PresenceHandler*>                  PresenceHandlerList;
-      typedef std::list<JidPresHandlerStruct>              PresenceJidHandlerList;
+      typedef std::list< std::pair<JID, PresenceHandler*> > JidPresenceHandlerList;
+      typedef std::unordered_map<std::size_t, JidPresenceHandlerList> PresenceJidHandlerMap;
+      // sessions with their registration number, to keep them in registration order
+      typedef std::pair<unsigned long, MessageSession*> IndexedSession;
+      typedef std::list<IndexedSession> IndexedSessionList;
+      typedef std::unordered_map<std::size_t, IndexedSessionList> MessageSessionIndex;
       typedef std::list<SubscriptionHandler*>              SubscriptionHandlerList;
       typedef std::list<TagHandlerStruct>                  TagHandlerList;
 
+      IndexedSession unindexMessageSession( MessageSessionIndex& index, std::size_t hash,
+                                            MessageSession* session );
+      void routeMessage( MessageSessionIndex& index, bool full, Message& msg );
+      void pruneIndexes();
+
       ConnectionListenerList   m_connectionListeners;
       IqHandlerMapXmlns        m_iqNSHandlers;
       IqHandlerMap             m_iqExtHandlers;
-      IqTrackMap               m_iqIDHandlers;
+      IqTracker                m_iqTracker;
       SMQueueMap               m_smQueue;
+      std::string              m_sendBuffer;            // reused to serialize outgoing stanzas
       MessageSessionList       m_messageSessions;
+      MessageSessionIndex      m_messageSessionsFull;   // by the hash of the full target JID
+      MessageSessionIndex      m_messageSessionsBare;   // by the hash of the bare target JID
+      unsigned long            m_messageSessionCount;
       MessageHandlerList       m_messageHandlers;
       PresenceHandlerList      m_presenceHandlers;
-      PresenceJidHandlerList   m_presenceJidHandlers;
+      PresenceJidHandlerMap    m_presenceJidHandlers;   // by the hash of the bare JID
+      int                      m_routing;               // nesting depth of stanza delivery
+      bool                     m_indexStale;            // index entries emptied during delivery
       SubscriptionHandlerList  m_subscriptionHandlers;
       TagHandlerList           m_tagHandlers;
       StringList               m_cacerts;
@@ -1072,6 +1172,7 @@ namespace gloox
       util::Mutex m_iqHandlerMapMutex;
       util::Mutex m_iqExtHandlerMapMutex;
       util::Mutex m_queueMutex;
+      util::Mutex m_sendBufferMutex;
 
       Parser m_parser;
       LogSink m_logInstance;
@@ -1090,12 +1191,14 @@ namespace gloox
 
       std::string m_clientFirstMessageBare;
       std::string m_serverSignature;
+      ScramKeys m_scramKeys;
       std::string m_gs2Header;
       std::string m_ntlmDomain;
       bool m_customConnection;
 
       std::string m_uniqueBaseId;
       util::AtomicRefCount m_nextId;
+      int m_iqTimeout;
 
       int m_smSent;
 
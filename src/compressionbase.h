@@ -65,6 +65,16 @@ namespace gloox
        */
       virtual void decompress( const std::string& data ) = 0;
 
+      /**
+       * Decompresses the given chunk of data without an intermediate copy. The default
+       * implementation copies the data into a string and calls the function above.
+       * @param data The compressed data.
+       * @param length The number of bytes in @c data.
+       * @since 1.1
+       */
+      virtual void decompress( const char* data, std::string::size_type length )
+        { decompress( std::string( data, length ) ); }
+
       /**
        * Performs internal cleanup.
        * @since 1.0
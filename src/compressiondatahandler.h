@@ -50,6 +50,16 @@ namespace gloox
        */
       virtual void handleDecompressedData( const std::string& data ) = 0;
 
+      /**
+       * This function is called when decompression is finished. The default implementation
+       * copies the data into a string and calls the function above.
+       * @param data The decompressed data. Only valid for the duration of the call.
+       * @param length The number of bytes in @c data.
+       * @since 1.1
+       */
+      virtual void handleDecompressedData( const char* data, std::string::size_type length )
+        { handleDecompressedData( std::string( data, length ) ); }
+
   };
 
 }
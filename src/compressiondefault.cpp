@@ -84,6 +84,12 @@ namespace gloox
       m_impl->decompress( data );
   }
 
+  void CompressionDefault::decompress( const char* data, std::string::size_type length )
+  {
+    if( m_impl )
+      m_impl->decompress( data, length );
+  }
+
   void CompressionDefault::cleanup()
   {
     if( m_impl )
@@ -67,6 +67,9 @@ namespace gloox
       // reimplemented from CompressionBase
       virtual void decompress( const std::string& data );
 
+      // reimplemented from CompressionBase
+      virtual void decompress( const char* data, std::string::size_type length );
+
       // reimplemented from CompressionBase
       virtual void cleanup();
 
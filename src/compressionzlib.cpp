@@ -18,13 +18,19 @@
 namespace gloox
 {
 
-  CompressionZlib::CompressionZlib( CompressionDataHandler* cdh )
-    : CompressionBase( cdh )
+  // inflated data is handed to the CompressionDataHandler in chunks of at most this size
+  static const uInt inflateChunk = 16384;
+
+  CompressionZlib::CompressionZlib( CompressionDataHandler* cdh, int level, int strategy )
+    : CompressionBase( cdh ), m_inflateBuffer( 0 ), m_level( level ), m_strategy( strategy )
   {
   }
 
   bool CompressionZlib::init()
   {
+    if( m_valid )
+      return true;
+
     int ret = Z_OK;
     m_zinflate.zalloc = Z_NULL;
     m_zinflate.zfree = Z_NULL;
@@ -38,11 +44,17 @@ namespace gloox
     m_zdeflate.zalloc = Z_NULL;
     m_zdeflate.zfree = Z_NULL;
     m_zdeflate.opaque = Z_NULL;
-    m_zinflate.avail_in = 0;
-    m_zinflate.next_in = Z_NULL;
-    ret = deflateInit( &m_zdeflate, Z_BEST_COMPRESSION/*Z_DEFAULT_COMPRESSION*/ );
+    m_zdeflate.avail_in = 0;
+    m_zdeflate.next_in = Z_NULL;
+    ret = deflateInit2( &m_zdeflate, m_level, Z_DEFLATED, MAX_WBITS, 8, m_strategy );
     if( ret != Z_OK )
+    {
+      inflateEnd( &m_zinflate );
       return false;
+    }
+
+    if( !m_inflateBuffer )
+      m_inflateBuffer = new char[inflateChunk];
 
     m_valid = true;
     return true;
@@ -51,6 +63,37 @@ namespace gloox
   CompressionZlib::~CompressionZlib()
   {
     cleanup();
+    delete[] m_inflateBuffer;
+  }
+
+  bool CompressionZlib::setParameters( int level, int strategy )
+  {
+    if( level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION
+        || strategy < Z_DEFAULT_STRATEGY || strategy > Z_FIXED )
+      return false;
+
+    m_compressMutex.lock();
+    m_level = level;
+    m_strategy = strategy;
+    bool ok = true;
+    std::string flushed;
+    if( m_valid )
+    {
+      // every compress() ends with a sync flush, so there is no pending input, but zlib
+      // may still close the current block
+      Bytef out[64];
+      m_zdeflate.avail_in = 0;
+      m_zdeflate.avail_out = sizeof( out );
+      m_zdeflate.next_out = out;
+      ok = deflateParams( &m_zdeflate, m_level, m_strategy ) == Z_OK;
+      flushed.assign( reinterpret_cast<char*>( out ), sizeof( out ) - m_zdeflate.avail_out );
+    }
+    m_compressMutex.unlock();
+
+    if( !flushed.empty() && m_handler )
+      m_handler->handleCompressedData( flushed );
+
+    return ok;
   }
 
   void CompressionZlib::compress( const std::string& data )
@@ -61,59 +104,74 @@ namespace gloox
     if( !m_valid || !m_handler || data.empty() )
       return;
 
-    long unsigned int CHUNK = data.length() + ( data.length() / 100 ) + 13;
-    Bytef* out = new Bytef[CHUNK];
-    char* in = const_cast<char*>( data.c_str() );
-
     m_compressMutex.lock();
 
     m_zdeflate.avail_in = static_cast<uInt>( data.length() );
-    m_zdeflate.next_in = reinterpret_cast<Bytef*>( in );
+    m_zdeflate.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( data.data() ) );
 
-    std::string result;
-    do {
-      m_zdeflate.avail_out = static_cast<uInt>( CHUNK );
-      m_zdeflate.next_out = reinterpret_cast<Bytef*>( out );
+    // deflateBound() does not account for the sync flush marker, which takes up to 6 octets
+    // (plus a few more for a pending bit buffer)
+    std::string::size_type done = 0;
+    std::string::size_type size = deflateBound( &m_zdeflate, static_cast<uLong>( data.length() ) ) + 16;
+    do
+    {
+      m_compressed.resize( size );
+      m_zdeflate.avail_out = static_cast<uInt>( size - done );
+      m_zdeflate.next_out = reinterpret_cast<Bytef*>( &m_compressed[done] );
 
       deflate( &m_zdeflate, Z_SYNC_FLUSH );
-      result.append( reinterpret_cast<char*>( out ), CHUNK - m_zdeflate.avail_out );
+      done = size - m_zdeflate.avail_out;
+      size *= 2;
     } while( m_zdeflate.avail_out == 0 );
 
+    m_compressed.resize( done );
+
+    // don't call out with the lock held; the buffer goes back afterwards so that its capacity
+    // is reused, unless another thread is compressing right now
+    std::string out;
+    out.swap( m_compressed );
     m_compressMutex.unlock();
 
-    delete[] out;
+    m_handler->handleCompressedData( out );
 
-    m_handler->handleCompressedData( result );
+    if( m_compressMutex.trylock() )
+    {
+      if( m_compressed.capacity() < out.capacity() )
+        m_compressed.swap( out );
+      m_compressMutex.unlock();
+    }
   }
 
   void CompressionZlib::decompress( const std::string& data )
+  {
+    decompress( data.data(), data.length() );
+  }
+
+  void CompressionZlib::decompress( const char* data, std::string::size_type length )
   {
     if( !m_valid )
       init();
 
-    if( !m_valid || !m_handler || data.empty() )
+    if( !m_valid || !m_handler || !length )
       return;
 
-    int CHUNK = 50;
-    char* out = new char[CHUNK];
-    char* in = const_cast<char*>( data.c_str() );
-
-    m_zinflate.avail_in = static_cast<uInt>( data.length() );
-    m_zinflate.next_in = reinterpret_cast<Bytef*>( in );
+    m_zinflate.avail_in = static_cast<uInt>( length );
+    m_zinflate.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( data ) );
 
-    std::string result;
+    int ret;
     do
     {
-      m_zinflate.avail_out = CHUNK;
-      m_zinflate.next_out = reinterpret_cast<Bytef*>( out );
+      m_zinflate.avail_out = inflateChunk;
+      m_zinflate.next_out = reinterpret_cast<Bytef*>( m_inflateBuffer );
 
-      inflate( &m_zinflate, Z_SYNC_FLUSH );
-      result.append( out, CHUNK - m_zinflate.avail_out );
-    } while( m_zinflate.avail_out == 0 );
+      ret = inflate( &m_zinflate, Z_SYNC_FLUSH );
+      if( ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR )
+        break;
 
-    delete[] out;
-
-    m_handler->handleDecompressedData( result );
+      const uInt have = inflateChunk - m_zinflate.avail_out;
+      if( have )
+        m_handler->handleDecompressedData( m_inflateBuffer, have );
+    } while( m_zinflate.avail_out == 0 && ret == Z_OK );
   }
 
   void CompressionZlib::cleanup()
@@ -128,6 +186,8 @@ namespace gloox
        m_valid = false;
     }
 
+    m_compressed = std::string();
+
     m_compressMutex.unlock();
   }
 
@@ -30,6 +30,13 @@ namespace gloox
   /**
    * An implementation of CompressionBase using zlib.
    *
+   * The compression level and strategy can be chosen to trade bandwidth for CPU time.
+   * To use a non-default setting with a Client, set it as the compression implementation
+   * before connecting:
+   * @code
+   * client->setCompressionImpl( new CompressionZlib( client, Z_BEST_SPEED ) );
+   * @endcode
+   *
    * @author Jakob Schröter <js@camaya.net>
    * @since 0.9
    */
@@ -39,14 +46,31 @@ namespace gloox
       /**
        * Contructor.
        * @param cdh The CompressionDataHandler to receive de/compressed data.
+       * @param level The zlib compression level, from 0 (@c Z_NO_COMPRESSION) to
+       * 9 (@c Z_BEST_COMPRESSION). The default, @c Z_DEFAULT_COMPRESSION, currently means 6.
+       * Levels 1 to 3 cost considerably less CPU time and compress typical XMPP traffic
+       * only slightly worse. (Since 1.1.)
+       * @param strategy The zlib compression strategy, e.g. @c Z_DEFAULT_STRATEGY or
+       * @c Z_FILTERED. (Since 1.1.)
        */
-      CompressionZlib( CompressionDataHandler* cdh );
+      CompressionZlib( CompressionDataHandler* cdh, int level = Z_DEFAULT_COMPRESSION,
+                       int strategy = Z_DEFAULT_STRATEGY );
 
       /**
        * Virtual Destructor.
        */
       virtual ~CompressionZlib();
 
+      /**
+       * Changes the compression level and strategy. Can be used at any time, data compressed
+       * afterwards uses the new parameters.
+       * @param level The zlib compression level (see the constructor).
+       * @param strategy The zlib compression strategy (see the constructor).
+       * @return @b False if the parameters are invalid, @b true otherwise.
+       * @since 1.1
+       */
+      bool setParameters( int level, int strategy = Z_DEFAULT_STRATEGY );
+
       // reimplemented from CompressionBase
       virtual bool init();
 
@@ -56,6 +80,9 @@ namespace gloox
       // reimplemented from CompressionBase
       virtual void decompress( const std::string& data );
 
+      // reimplemented from CompressionBase
+      virtual void decompress( const char* data, std::string::size_type length );
+
       // reimplemented from CompressionBase
       virtual void cleanup();
 
@@ -63,6 +90,12 @@ namespace gloox
       z_stream m_zinflate;
       z_stream m_zdeflate;
 
+      std::string m_compressed;
+      char* m_inflateBuffer;
+
+      int m_level;
+      int m_strategy;
+
       util::Mutex m_compressMutex;
 
   };
@@ -23,6 +23,8 @@
 namespace gloox
 {
 
+  class SendQueueHandler;
+
   /**
    * @brief An abstract base class for a connection.
    *
@@ -132,6 +134,53 @@ namespace gloox
        */
       virtual const std::string localInterface() const { return EmptyString; }
 
+      /**
+       * Returns the file descriptor of the socket this connection reads from, if any.
+       * Wrapping connections (TLS, proxies) return their transport's socket.
+       * This is used by ConnectionEventLoop to wait for incoming data.
+       * @return The socket, or -1 if there is no (single) socket.
+       * @since 1.1
+       */
+      virtual int socket() const { return -1; }
+
+      /**
+       * Writes out as much of the data queued in asynchronous send mode as possible without
+       * blocking. See ConnectionTCPBase::setAsyncSend().
+       * @return ConnNoError, or an error if writing failed.
+       * @since 1.1
+       */
+      virtual ConnectionError flush() { return ConnNoError; }
+
+      /**
+       * Returns the number of octets queued in asynchronous send mode.
+       * @return The number of octets waiting to be written.
+       * @since 1.1
+       */
+      virtual int pendingOutput() const { return 0; }
+
+      /**
+       * Returns the point in time (in terms of util::monotonicTime()) by which the data queued
+       * in asynchronous send mode should be written.
+       * @return The time queued data is due, or 0 if there is none.
+       * @since 1.1
+       */
+      virtual long long nextFlush() const { return 0; }
+
+      /**
+       * Registers a SendQueueHandler to be notified of changes of the output queue in
+       * asynchronous send mode. Multiple handlers can be registered.
+       * @param sqh The handler to register.
+       * @since 1.1
+       */
+      virtual void registerSendQueueHandler( SendQueueHandler* sqh ) { (void)sqh; }
+
+      /**
+       * Removes a SendQueueHandler.
+       * @param sqh The handler to remove.
+       * @since 1.1
+       */
+      virtual void removeSendQueueHandler( SendQueueHandler* sqh ) { (void)sqh; }
+
       /**
        * Returns current connection statistics.
        * @param totalIn The total number of bytes received.
@@ -47,6 +47,19 @@ namespace gloox
        */
       virtual void handleReceivedData( const ConnectionBase* connection, const std::string& data ) = 0;
 
+      /**
+       * This function is called for data received from the underlying transport if the
+       * connection can pass its receive buffer directly. The default implementation copies
+       * the data into a string and calls the function above.
+       * @param connection The connection that received the data.
+       * @param data The data received. Only valid for the duration of the call.
+       * @param length The number of bytes received.
+       * @since 1.1
+       */
+      virtual void handleReceivedData( const ConnectionBase* connection, const char* data,
+                                       std::string::size_type length )
+        { handleReceivedData( connection, std::string( data, length ) ); }
+
       /**
        * This function is called when e.g. the raw TCP connection was established.
        * @param connection The connection.
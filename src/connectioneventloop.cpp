@@ -0,0 +1,438 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "connectioneventloop.h"
+#include "clientbase.h"
+#include "connectionbase.h"
+#include "timerhandler.h"
+#include "util.h"
+
+#if defined( __linux__ )
+# define GLOOX_EVENTLOOP_EPOLL 1
+# include <sys/epoll.h>
+# include <unistd.h>
+#elif ( !defined( _WIN32 ) && !defined( _WIN32_WCE ) ) || defined( __SYMBIAN32__ )
+# include <poll.h>
+#else
+# include <winsock2.h>
+#endif
+
+#if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
+# include <windows.h>
+#else
+# include <errno.h>
+# include <string.h>
+#endif
+
+#include <vector>
+
+namespace gloox
+{
+
+  static const int maxEvents = 256;
+  static const int iqTimeoutInterval = 1000;
+
+  ConnectionEventLoop::ConnectionEventLoop( const LogSink& logInstance )
+    : m_logInstance( logInstance ), m_poll( -1 ), m_nextTimer( 0 ), m_stop( false )
+  {
+#ifdef GLOOX_EVENTLOOP_EPOLL
+    m_poll = epoll_create1( EPOLL_CLOEXEC );
+    if( m_poll < 0 )
+      m_logInstance.err( LogAreaClassConnectionEventLoop, "epoll_create1() failed. errno: "
+                         + util::int2string( errno ) + ": " + strerror( errno ) );
+#endif
+  }
+
+  ConnectionEventLoop::~ConnectionEventLoop()
+  {
+#ifdef GLOOX_EVENTLOOP_EPOLL
+    if( m_poll >= 0 )
+      close( m_poll );
+#endif
+  }
+
+  bool ConnectionEventLoop::add( ConnectionBase* connection )
+  {
+    if( !connection )
+      return false;
+
+    return addSocket( connection->socket(), connection, 0, 0 );
+  }
+
+  bool ConnectionEventLoop::add( ClientBase* client, int pingInterval )
+  {
+    if( !client || !client->connectionImpl() )
+      return false;
+
+    return addSocket( client->connectionImpl()->socket(), client->connectionImpl(), client, pingInterval );
+  }
+
+  bool ConnectionEventLoop::addSocket( int fd, ConnectionBase* connection, ClientBase* client,
+                                       int pingInterval )
+  {
+    if( fd < 0 )
+      return false;
+
+    // the fd may have been closed and reused without the old connection being removed
+    ConnectionMap::iterator it = m_connections.find( fd );
+    if( it != m_connections.end() )
+      removeSocket( it );
+
+#ifdef GLOOX_EVENTLOOP_EPOLL
+    if( m_poll < 0 )
+      return false;
+
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof( ev ) );
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if( epoll_ctl( m_poll, EPOLL_CTL_ADD, fd, &ev ) < 0 )
+    {
+      m_logInstance.err( LogAreaClassConnectionEventLoop, "epoll_ctl() failed. errno: "
+                         + util::int2string( errno ) + ": " + strerror( errno ) );
+      return false;
+    }
+#endif
+
+    Connection c;
+    c.connection = connection;
+    c.client = client;
+    c.pingTimer = pingInterval > 0 ? addTimer( pingInterval, 0, client, true ) : -1;
+    c.iqTimer = client ? addTimer( iqTimeoutInterval, 0, client, true, true ) : -1;
+    c.pollOut = false;
+    m_connections[fd] = c;
+
+    connection->registerSendQueueHandler( this );
+    if( connection->pendingOutput() )
+      m_flush.insert( fd );
+
+    return true;
+  }
+
+  void ConnectionEventLoop::remove( ConnectionBase* connection )
+  {
+    ConnectionMap::iterator it = m_connections.find( connection->socket() );
+    if( it == m_connections.end() || (*it).second.connection != connection )
+    {
+      // the socket has been closed already
+      for( it = m_connections.begin(); it != m_connections.end(); ++it )
+      {
+        if( (*it).second.connection == connection )
+          break;
+      }
+    }
+
+    if( it != m_connections.end() )
+      removeSocket( it );
+  }
+
+  void ConnectionEventLoop::remove( ClientBase* client )
+  {
+    ConnectionMap::iterator it = m_connections.begin();
+    for( ; it != m_connections.end(); ++it )
+    {
+      if( (*it).second.client == client )
+      {
+        removeSocket( it );
+        return;
+      }
+    }
+  }
+
+  void ConnectionEventLoop::removeSocket( ConnectionMap::iterator it )
+  {
+#ifdef GLOOX_EVENTLOOP_EPOLL
+    // fails harmlessly if the fd has been closed already, closing removes it from the epoll set
+    struct epoll_event ev;
+    epoll_ctl( m_poll, EPOLL_CTL_DEL, (*it).first, &ev );
+#endif
+
+    if( (*it).second.pingTimer != -1 )
+      removeTimer( (*it).second.pingTimer );
+    if( (*it).second.iqTimer != -1 )
+      removeTimer( (*it).second.iqTimer );
+
+    (*it).second.connection->removeSendQueueHandler( this );
+    m_flush.erase( (*it).first );
+    m_connections.erase( it );
+  }
+
+  int ConnectionEventLoop::registerTimer( int interval, TimerHandler* th, bool repeat )
+  {
+    if( !th || interval < 0 )
+      return -1;
+
+    return addTimer( interval, th, 0, repeat );
+  }
+
+  int ConnectionEventLoop::addTimer( int interval, TimerHandler* th, ClientBase* client, bool repeat,
+                                     bool iqTimeouts )
+  {
+    Timer t;
+    t.due = util::monotonicTime() + interval;
+    t.interval = interval;
+    t.handler = th;
+    t.client = client;
+    t.repeat = repeat;
+    t.iqTimeouts = iqTimeouts;
+
+    const int id = ++m_nextTimer;
+    m_timers[id] = t;
+    m_queue.insert( std::make_pair( t.due, id ) );
+    return id;
+  }
+
+  void ConnectionEventLoop::removeTimer( int id )
+  {
+    TimerMap::iterator it = m_timers.find( id );
+    if( it == m_timers.end() )
+      return;
+
+    m_queue.erase( std::make_pair( (*it).second.due, id ) );
+    m_timers.erase( it );
+  }
+
+  int ConnectionEventLoop::dispatchTimers()
+  {
+    int count = 0;
+    const long long t = util::monotonicTime();
+    while( !m_queue.empty() && (*m_queue.begin()).first <= t )
+    {
+      const int id = (*m_queue.begin()).second;
+      m_queue.erase( m_queue.begin() );
+
+      TimerMap::iterator it = m_timers.find( id );
+      if( it == m_timers.end() )
+        continue;
+
+      // re-arm (or remove) before calling out, so the handler may remove the timer
+      const Timer timer = (*it).second;
+      if( timer.repeat )
+      {
+        (*it).second.due = t + ( timer.interval > 0 ? timer.interval : 1 );
+        m_queue.insert( std::make_pair( (*it).second.due, id ) );
+      }
+      else
+        m_timers.erase( it );
+
+      ++count;
+      if( timer.iqTimeouts )
+        timer.client->checkIqTimeouts();
+      else if( timer.client )
+        timer.client->whitespacePing();
+      else
+        timer.handler->handleTimer( id );
+    }
+
+    return count;
+  }
+
+  void ConnectionEventLoop::dispatch( int fd, bool read, bool write )
+  {
+    ConnectionMap::iterator it = m_connections.find( fd );
+    if( it == m_connections.end() )
+      return;
+
+    ConnectionBase* connection = (*it).second.connection;
+    ClientBase* client = (*it).second.client;
+
+    ConnectionError e = ConnNoError;
+    if( write )
+      e = connection->flush();
+    if( e == ConnNoError && read )
+      e = client ? client->recv( 0 ) : connection->recv( 0 );
+    if( e == ConnNoError )
+      return;
+
+    // the connection is gone, but the handlers may have changed the loop in the meantime
+    it = m_connections.find( fd );
+    if( it != m_connections.end() && (*it).second.connection == connection )
+      removeSocket( it );
+  }
+
+  void ConnectionEventLoop::handleSendQueue( const ConnectionBase* connection, SendQueueEvent event,
+                                             int /*bytes*/ )
+  {
+    if( event != SendQueuePending )
+      return;
+
+    const int fd = connection->socket();
+    if( m_connections.find( fd ) != m_connections.end() )
+      m_flush.insert( fd );
+  }
+
+  void ConnectionEventLoop::watchWritable( ConnectionMap::iterator it, bool watch )
+  {
+    if( (*it).second.pollOut == watch )
+      return;
+
+    (*it).second.pollOut = watch;
+
+#ifdef GLOOX_EVENTLOOP_EPOLL
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof( ev ) );
+    ev.events = watch ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.fd = (*it).first;
+    epoll_ctl( m_poll, EPOLL_CTL_MOD, (*it).first, &ev );
+#endif
+  }
+
+  void ConnectionEventLoop::flushPending()
+  {
+    if( m_flush.empty() )
+      return;
+
+    // a failing flush may make the handlers change the loop
+    const std::vector<int> fds( m_flush.begin(), m_flush.end() );
+    const long long now = util::monotonicTime();
+    std::vector<int>::const_iterator fit = fds.begin();
+    for( ; fit != fds.end(); ++fit )
+    {
+      ConnectionMap::iterator it = m_connections.find( *fit );
+      if( it == m_connections.end() )
+      {
+        m_flush.erase( *fit );
+        continue;
+      }
+
+      ConnectionBase* connection = (*it).second.connection;
+      if( !(*it).second.pollOut && connection->pendingOutput() && connection->nextFlush() <= now )
+      {
+        const ConnectionError e = connection->flush();
+        it = m_connections.find( *fit );
+        if( it == m_connections.end() || (*it).second.connection != connection )
+          continue;
+        if( e != ConnNoError )
+        {
+          removeSocket( it );
+          continue;
+        }
+
+        // whatever is left did not fit into the socket's buffer
+        if( connection->pendingOutput() )
+          watchWritable( it, true );
+      }
+
+      if( !connection->pendingOutput() )
+      {
+        watchWritable( it, false );
+        m_flush.erase( *fit );
+      }
+    }
+  }
+
+  int ConnectionEventLoop::poll( int timeout )
+  {
+    if( m_connections.empty() && m_queue.empty() )
+      return 0;
+
+    int wait = timeout == -1 ? -1 : ( timeout + 999 ) / 1000;
+    const long long now = util::monotonicTime();
+    if( !m_queue.empty() )
+    {
+      long long next = (*m_queue.begin()).first - now;
+      if( next < 0 )
+        next = 0;
+      if( wait == -1 || next < wait )
+        wait = static_cast<int>( next );
+    }
+
+    // queued output that is due, unless it waits for the socket to become writable
+    FlushSet::const_iterator fit = m_flush.begin();
+    for( ; fit != m_flush.end() && wait != 0; ++fit )
+    {
+      ConnectionMap::const_iterator cit = m_connections.find( *fit );
+      if( cit == m_connections.end() || (*cit).second.pollOut )
+        continue;
+
+      long long next = (*cit).second.connection->nextFlush() - now;
+      if( next < 0 )
+        next = 0;
+      if( wait == -1 || next < wait )
+        wait = static_cast<int>( next );
+    }
+
+    int count = 0;
+
+#ifdef GLOOX_EVENTLOOP_EPOLL
+    if( m_poll < 0 )
+      return -1;
+
+    struct epoll_event events[maxEvents];
+    const int n = epoll_wait( m_poll, events, maxEvents, wait );
+    if( n < 0 && errno != EINTR )
+    {
+      m_logInstance.err( LogAreaClassConnectionEventLoop, "epoll_wait() failed. errno: "
+                         + util::int2string( errno ) + ": " + strerror( errno ) );
+      return -1;
+    }
+
+    for( int i = 0; i < n; ++i )
+      dispatch( events[i].data.fd, ( events[i].events & ~EPOLLOUT ) != 0,
+                ( events[i].events & EPOLLOUT ) != 0 );
+    count += n > 0 ? n : 0;
+#else
+    std::vector<struct pollfd> fds;
+    fds.reserve( m_connections.size() );
+    ConnectionMap::const_iterator it = m_connections.begin();
+    for( ; it != m_connections.end(); ++it )
+    {
+      struct pollfd pfd;
+      pfd.fd = (*it).first;
+      pfd.events = (*it).second.pollOut ? POLLIN | POLLOUT : POLLIN;
+      pfd.revents = 0;
+      fds.push_back( pfd );
+    }
+
+#if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
+    int n = 0;
+    if( fds.empty() )
+      Sleep( wait );
+    else
+      n = WSAPoll( &fds[0], static_cast<ULONG>( fds.size() ), wait );
+#else
+    const int n = ::poll( fds.empty() ? 0 : &fds[0], static_cast<nfds_t>( fds.size() ), wait );
+#endif
+    if( n < 0 )
+    {
+      m_logInstance.err( LogAreaClassConnectionEventLoop, "poll() failed." );
+      return -1;
+    }
+
+    for( std::vector<struct pollfd>::const_iterator pit = fds.begin(); n > 0 && pit != fds.end(); ++pit )
+    {
+      if( (*pit).revents )
+      {
+        dispatch( (*pit).fd, ( (*pit).revents & ~POLLOUT ) != 0, ( (*pit).revents & POLLOUT ) != 0 );
+        ++count;
+      }
+    }
+#endif
+
+    count += dispatchTimers();
+    flushPending();
+    return count;
+  }
+
+  void ConnectionEventLoop::run()
+  {
+    m_stop = false;
+    while( !m_stop && ( !m_connections.empty() || !m_timers.empty() ) )
+    {
+      if( poll( -1 ) < 0 )
+        break;
+    }
+  }
+
+
+}
@@ -0,0 +1,214 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef CONNECTIONEVENTLOOP_H__
+#define CONNECTIONEVENTLOOP_H__
+
+#include "gloox.h"
+#include "logsink.h"
+#include "sendqueuehandler.h"
+
+#include <map>
+#include <set>
+#include <utility>
+
+namespace gloox
+{
+
+  class ClientBase;
+  class ConnectionBase;
+  class TimerHandler;
+
+  /**
+   * @brief An event loop that drives many connections from a single thread.
+   *
+   * Instead of calling ConnectionBase::recv() (or ClientBase::recv()) on each connection
+   * from its own thread, add the connections to a ConnectionEventLoop and call run() or
+   * poll(). The loop waits for incoming data on all of them at once (using epoll on Linux,
+   * and poll() elsewhere) and calls recv() on those that have data available.
+   *
+   * Usage with ClientBase:
+   * @code
+   * ConnectionEventLoop loop( logInstance );
+   * for( ... )
+   * {
+   *   Client* c = new Client( jid, password );
+   *   if( c->connect( false ) )
+   *     loop.add( c, 60000 ); // send a whitespace ping every 60 seconds
+   * }
+   * loop.run();
+   * @endcode
+   *
+   * Connections that report an error from recv() (e.g. because the peer closed the stream)
+   * are removed from the loop automatically. Any connection that exposes its socket through
+   * ConnectionBase::socket() can be added, including ConnectionTCPServer, whose recv()
+   * accepts incoming connections. ConnectionBOSH is not supported.
+   *
+   * Timers can be used for periodic tasks like XMPP Pings (see registerTimer()).
+   *
+   * Connections in asynchronous send mode (see ConnectionTCPBase::setAsyncSend()) are flushed
+   * at the end of the loop iteration in which their latency budget runs out, so that all
+   * stanzas queued while handling one batch of events go out in a single system call. While a
+   * connection's socket does not accept any more data, the loop waits for it to become
+   * writable.
+   *
+   * @note ConnectionEventLoop is not thread-safe. All functions, including the ones of the added
+   * connections, should be called from the thread running the loop. It is safe to add and remove
+   * connections and timers from within callbacks, but a connection must not be deleted while its
+   * own recv() is running. Remove connections from the loop before destroying it if they
+   * outlive it.
+   *
+   * @author Jakob Schröter <js@camaya.net>
+   * @since 1.1
+   */
+  class GLOOX_API ConnectionEventLoop : public SendQueueHandler
+  {
+    public:
+      /**
+       * Constructs a new ConnectionEventLoop.
+       * @param logInstance The LogSink to use for logging.
+       */
+      ConnectionEventLoop( const LogSink& logInstance );
+
+      /**
+       * Virtual destructor. Does not delete or disconnect the added connections.
+       */
+      virtual ~ConnectionEventLoop();
+
+      /**
+       * Adds a connection to the loop. The connection must be connected already, i.e. its
+       * socket() must be valid.
+       * @param connection The connection to add.
+       * @return @b True if the connection was added, @b false otherwise.
+       */
+      bool add( ConnectionBase* connection );
+
+      /**
+       * Adds a client to the loop. ClientBase::connect( false ) must have been called
+       * before. The loop will call ClientBase::recv() whenever data is available, and
+       * ClientBase::checkIqTimeouts() once per second.
+       * @param client The client to add.
+       * @param pingInterval If greater than 0, the loop will send a whitespace ping on the
+       * client's stream every @c pingInterval milliseconds.
+       * @return @b True if the client was added, @b false otherwise.
+       */
+      bool add( ClientBase* client, int pingInterval = 0 );
+
+      /**
+       * Removes a connection from the loop. The connection is not disconnected.
+       * @param connection The connection to remove.
+       */
+      void remove( ConnectionBase* connection );
+
+      /**
+       * Removes a client from the loop, including its timers. The client is not disconnected.
+       * @param client The client to remove.
+       */
+      void remove( ClientBase* client );
+
+      /**
+       * Registers a timer.
+       * @param interval The interval in milliseconds.
+       * @param th The TimerHandler to notify when the timer expires.
+       * @param repeat Whether the timer should fire every @c interval milliseconds until it is
+       * removed. If @b false, the timer is removed after firing once.
+       * @return The timer's ID, to be used with removeTimer().
+       */
+      int registerTimer( int interval, TimerHandler* th, bool repeat = true );
+
+      /**
+       * Removes a timer.
+       * @param id The ID of the timer to remove.
+       */
+      void removeTimer( int id );
+
+      /**
+       * Waits for incoming data on any of the added connections, or the next timer to expire,
+       * and dispatches what's ready.
+       * @param timeout The maximum time to wait, in microseconds (like ConnectionBase::recv()).
+       * -1 means to wait until something happens.
+       * @return The number of connections and timers that were dispatched, or -1 on error.
+       */
+      int poll( int timeout = -1 );
+
+      /**
+       * Runs the loop until stop() is called, or until there are neither connections nor
+       * timers left.
+       */
+      void run();
+
+      /**
+       * Makes run() return after the current iteration. Call it from a callback.
+       */
+      void stop() { m_stop = true; }
+
+      /**
+       * Returns the number of connections currently in the loop.
+       * @return The number of connections.
+       */
+      int connections() const { return static_cast<int>( m_connections.size() ); }
+
+      // reimplemented from SendQueueHandler
+      virtual void handleSendQueue( const ConnectionBase* connection, SendQueueEvent event, int bytes );
+
+    private:
+      struct Connection
+      {
+        ConnectionBase* connection;
+        ClientBase* client;
+        int pingTimer;
+        int iqTimer;
+        bool pollOut;
+      };
+
+      struct Timer
+      {
+        long long due;
+        int interval;
+        TimerHandler* handler;
+        ClientBase* client;
+        bool repeat;
+        bool iqTimeouts;
+      };
+
+      typedef std::map<int, Connection> ConnectionMap;
+      typedef std::map<int, Timer> TimerMap;
+      typedef std::set< std::pair<long long, int> > TimerQueue;
+      typedef std::set<int> FlushSet;
+
+      ConnectionEventLoop& operator=( const ConnectionEventLoop& );
+      ConnectionEventLoop( const ConnectionEventLoop& );
+
+      bool addSocket( int fd, ConnectionBase* connection, ClientBase* client, int pingInterval );
+      void removeSocket( ConnectionMap::iterator it );
+      int addTimer( int interval, TimerHandler* th, ClientBase* client, bool repeat,
+                    bool iqTimeouts = false );
+      int dispatchTimers();
+      void dispatch( int fd, bool read, bool write );
+      void flushPending();
+      void watchWritable( ConnectionMap::iterator it, bool watch );
+
+      const LogSink& m_logInstance;
+      ConnectionMap m_connections;
+      TimerMap m_timers;
+      TimerQueue m_queue;
+      FlushSet m_flush;
+      int m_poll;
+      int m_nextTimer;
+      bool m_stop;
+
+  };
+
+}
+
+#endif // CONNECTIONEVENTLOOP_H__
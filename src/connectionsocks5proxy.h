@@ -112,6 +112,26 @@ namespace gloox
       // reimplemented from ConnectionBase
       virtual void getStatistics( long int &totalIn, long int &totalOut );
 
+      // reimplemented from ConnectionBase
+      virtual int socket() const { return m_connection ? m_connection->socket() : -1; }
+
+      // reimplemented from ConnectionBase
+      virtual ConnectionError flush() { return m_connection ? m_connection->flush() : ConnNotConnected; }
+
+      // reimplemented from ConnectionBase
+      virtual int pendingOutput() const { return m_connection ? m_connection->pendingOutput() : 0; }
+
+      // reimplemented from ConnectionBase
+      virtual long long nextFlush() const { return m_connection ? m_connection->nextFlush() : 0; }
+
+      // reimplemented from ConnectionBase
+      virtual void registerSendQueueHandler( SendQueueHandler* sqh )
+        { if( m_connection ) m_connection->registerSendQueueHandler( sqh ); }
+
+      // reimplemented from ConnectionBase
+      virtual void removeSendQueueHandler( SendQueueHandler* sqh )
+        { if( m_connection ) m_connection->removeSendQueueHandler( sqh ); }
+
       // reimplemented from ConnectionDataHandler
       virtual void handleReceivedData( const ConnectionBase* connection, const std::string& data );
 
@@ -31,6 +31,8 @@
 # include <sys/types.h>
 # include <sys/socket.h>
 # include <sys/select.h>
+# include <sys/uio.h>
+# include <poll.h>
 # include <netinet/in.h>
 # include <unistd.h>
 # include <string.h>
@@ -44,17 +46,34 @@ typedef int socklen_t;
 
 #include <ctime>
 
+#include <climits>
 #include <cstdlib>
 #include <string>
 
 namespace gloox
 {
 
+  // the number of queued chunks handed to a single writev()
+  static const int maxSegments = 256;
+
+#if ( !defined( _WIN32 ) && !defined( _WIN32_WCE ) ) || defined( __SYMBIAN32__ )
+# ifdef MSG_NOSIGNAL
+  static const int asyncSendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+# else
+  static const int asyncSendFlags = MSG_DONTWAIT;
+# endif
+#endif
+
+  // how long disconnect() and cleanup() wait for queued data to be written, in milliseconds
+  static const int closeFlushTimeout = 1000;
+
   ConnectionTCPBase::ConnectionTCPBase( const LogSink& logInstance,
                                         const std::string& server, int port )
     : ConnectionBase( 0 ),
       m_logInstance( logInstance ), m_buf( 0 ), m_socket( -1 ), m_totalBytesIn( 0 ),
-      m_totalBytesOut( 0 ), m_bufsize( 8192 ), m_cancel( true )
+      m_totalBytesOut( 0 ), m_bufsize( 8192 ), m_cancel( true ), m_sendOffset( 0 ), m_flushDue( 0 ),
+      m_pending( 0 ), m_maxBytes( 16384 ), m_maxDelay( 0 ), m_highWater( 1048576 ),
+      m_lowWater( 262144 ), m_async( false ), m_blocked( false ), m_aboveHigh( false )
   {
     init( server, port );
   }
@@ -63,7 +82,9 @@ namespace gloox
                                         const std::string& server, int port )
     : ConnectionBase( cdh ),
       m_logInstance( logInstance ), m_buf( 0 ), m_socket( -1 ), m_totalBytesIn( 0 ),
-      m_totalBytesOut( 0 ), m_bufsize( 8192 ), m_cancel( true )
+      m_totalBytesOut( 0 ), m_bufsize( 8192 ), m_cancel( true ), m_sendOffset( 0 ), m_flushDue( 0 ),
+      m_pending( 0 ), m_maxBytes( 16384 ), m_maxDelay( 0 ), m_highWater( 1048576 ),
+      m_lowWater( 262144 ), m_async( false ), m_blocked( false ), m_aboveHigh( false )
   {
     init( server, port );
   }
@@ -85,6 +106,8 @@ namespace gloox
 
   void ConnectionTCPBase::disconnect()
   {
+    drainQueue();
+
     util::MutexGuard rm( m_recvMutex );
     m_cancel = true;
   }
@@ -94,19 +117,92 @@ namespace gloox
     if( m_socket < 0 )
       return true; // let recv() catch the closed fd
 
+    // wake up when queued data is due, or when a full socket becomes writable again
+    bool write = false;
+    if( m_async )
+    {
+      m_sendMutex.lock();
+      if( !m_sendQueue.empty() && m_blocked )
+        write = true;
+      else if( !m_sendQueue.empty() )
+      {
+        long long left = ( m_flushDue - util::monotonicTime() ) * 1000;
+        if( left < 0 )
+          left = 0;
+        if( timeout == -1 || left < timeout )
+          timeout = left < INT_MAX ? static_cast<int>( left ) : INT_MAX;
+      }
+      m_sendMutex.unlock();
+    }
+
+#if ( !defined( _WIN32 ) && !defined( _WIN32_WCE ) ) || defined( __SYMBIAN32__ )
+    // poll() has no FD_SETSIZE limit, which matters with many connections per process
+    struct pollfd pfd;
+    pfd.fd = m_socket;
+    pfd.events = write ? POLLIN | POLLOUT : POLLIN;
+    pfd.revents = 0;
+
+    return ::poll( &pfd, 1, timeout == -1 ? -1 : ( timeout + 999 ) / 1000 ) > 0
+           && ( pfd.revents & ~POLLOUT ) != 0;
+#else
     fd_set fds;
+    fd_set wfds;
     struct timeval tv;
 
     FD_ZERO( &fds );
+    FD_ZERO( &wfds );
     // the following causes a C4127 warning in VC++ Express 2008 and possibly other versions.
     // however, the reason for the warning can't be fixed in gloox.
     FD_SET( m_socket, &fds );
+    if( write )
+      FD_SET( m_socket, &wfds );
 
     tv.tv_sec = timeout / 1000000;
     tv.tv_usec = timeout % 1000000;
 
-    return ( ( select( m_socket + 1, &fds, 0, 0, timeout == -1 ? 0 : &tv ) > 0 )
+    return ( ( select( m_socket + 1, &fds, write ? &wfds : 0, 0, timeout == -1 ? 0 : &tv ) > 0 )
              && FD_ISSET( m_socket, &fds ) != 0 );
+#endif
+  }
+
+  bool ConnectionTCPBase::waitWritable( int timeout )
+  {
+#if ( !defined( _WIN32 ) && !defined( _WIN32_WCE ) ) || defined( __SYMBIAN32__ )
+    struct pollfd pfd;
+    pfd.fd = m_socket;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+
+    return ::poll( &pfd, 1, timeout ) > 0 && ( pfd.revents & POLLOUT ) != 0;
+#else
+    fd_set fds;
+    FD_ZERO( &fds );
+    FD_SET( m_socket, &fds );
+
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = ( timeout % 1000 ) * 1000;
+
+    return select( m_socket + 1, 0, &fds, 0, timeout == -1 ? 0 : &tv ) > 0
+           && FD_ISSET( m_socket, &fds ) != 0;
+#endif
+  }
+
+  void ConnectionTCPBase::drainQueue()
+  {
+    util::MutexGuard sm( m_sendMutex );
+
+    // best effort: a peer that does not read must not block closing the connection for long
+    const long long deadline = util::monotonicTime() + closeFlushTimeout;
+    while( !m_sendQueue.empty() && m_socket >= 0 )
+    {
+      if( writeQueue() != ConnNoError || m_sendQueue.empty() )
+        break;
+
+      const long long left = deadline - util::monotonicTime();
+      if( left <= 0 || !waitWritable( static_cast<int>( left ) ) )
+        break;
+    }
   }
 
   ConnectionError ConnectionTCPBase::receive()
@@ -130,6 +226,53 @@ namespace gloox
       return false;
     }
 
+    if( m_async )
+    {
+      const bool wasEmpty = m_sendQueue.empty();
+      if( wasEmpty )
+        m_flushDue = util::monotonicTime() + m_maxDelay;
+
+      // once the budget is exhausted, data is written along with the queue and only what the
+      // socket does not take is copied
+      ConnectionError err = ConnNoError;
+      if( m_pending + static_cast<int>( data.length() ) >= m_maxBytes && !m_blocked )
+        err = writeQueue( &data );
+      else
+      {
+        m_sendQueue.push_back( data );
+        m_pending += static_cast<int>( data.length() );
+      }
+
+      const bool pending = wasEmpty && !m_sendQueue.empty();
+      bool high = false;
+      bool low = false;
+      if( !m_aboveHigh && m_pending > m_highWater )
+        high = m_aboveHigh = true;
+      else if( m_aboveHigh && m_pending <= m_lowWater )
+      {
+        m_aboveHigh = false;
+        low = true;
+      }
+      const int bytes = m_pending;
+
+      m_sendMutex.unlock();
+
+      if( err != ConnNoError )
+      {
+        sendFailed();
+        return false;
+      }
+
+      if( pending )
+        notifySendQueue( SendQueuePending, bytes );
+      if( high )
+        notifySendQueue( SendQueueHigh, bytes );
+      if( low )
+        notifySendQueue( SendQueueLow, bytes );
+
+      return true;
+    }
+
     int sent = 0;
     for( size_t num = 0, len = data.length(); sent != -1 && num < len; num += sent )
     {
@@ -141,21 +284,279 @@ namespace gloox
     m_sendMutex.unlock();
 
     if( sent == -1 )
+      sendFailed();
+
+    return sent != -1;
+  }
+
+  void ConnectionTCPBase::sendFailed()
+  {
+    // send() failed for an unexpected reason
+    std::string message = "send() failed. "
+#if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
+      "WSAGetLastError: " + util::int2string( ::WSAGetLastError() );
+#else
+      "errno: " + util::int2string( errno ) + ": " + strerror( errno );
+#endif
+    m_logInstance.err( LogAreaClassConnectionTCPBase, message );
+
+    if( m_handler )
+      m_handler->handleDisconnect( this, ConnIoError );
+  }
+
+  ConnectionError ConnectionTCPBase::writeQueue( const std::string* data )
+  {
+    m_blocked = false;
+
+    while( !m_sendQueue.empty() || data )
     {
-        // send() failed for an unexpected reason
-        std::string message = "send() failed. "
 #if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
-          "WSAGetLastError: " + util::int2string( ::WSAGetLastError() );
+      WSABUF bufs[maxSegments];
 #else
-          "errno: " + util::int2string( errno ) + ": " + strerror( errno );
+      struct iovec bufs[maxSegments];
 #endif
-      m_logInstance.err( LogAreaClassConnectionTCPBase, message );
+      int count = 0;
+      size_t total = 0;
+      SendQueue::const_iterator it = m_sendQueue.begin();
+      for( ; it != m_sendQueue.end() && count < maxSegments; ++it, ++count )
+      {
+        const std::string::size_type offset = count ? 0 : m_sendOffset;
+#if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
+        bufs[count].buf = const_cast<char*>( (*it).data() + offset );
+        bufs[count].len = static_cast<ULONG>( (*it).length() - offset );
+#else
+        bufs[count].iov_base = const_cast<char*>( (*it).data() + offset );
+        bufs[count].iov_len = (*it).length() - offset;
+#endif
+        total += (*it).length() - offset;
+      }
 
-      if( m_handler )
-        m_handler->handleDisconnect( this, ConnIoError );
+      const bool withData = data && it == m_sendQueue.end() && count < maxSegments;
+      if( withData )
+      {
+#if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
+        bufs[count].buf = const_cast<char*>( data->data() );
+        bufs[count].len = static_cast<ULONG>( data->length() );
+#else
+        bufs[count].iov_base = const_cast<char*>( data->data() );
+        bufs[count].iov_len = data->length();
+#endif
+        ++count;
+      }
+
+#if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
+      // the socket stays blocking for the synchronous paths
+      u_long nonBlocking = 1;
+      ioctlsocket( m_socket, FIONBIO, &nonBlocking );
+      DWORD written = 0;
+      const int ret = WSASend( m_socket, bufs, static_cast<DWORD>( count ), &written, 0, 0, 0 );
+      const int error = ret == SOCKET_ERROR ? ::WSAGetLastError() : 0;
+      nonBlocking = 0;
+      ioctlsocket( m_socket, FIONBIO, &nonBlocking );
+      if( ret == SOCKET_ERROR )
+      {
+        if( error == WSAEWOULDBLOCK )
+        {
+          m_blocked = true;
+          break;
+        }
+        ::WSASetLastError( error );
+        return ConnIoError;
+      }
+      size_t sent = written;
+#else
+      struct msghdr msg;
+      memset( &msg, 0, sizeof( msg ) );
+      msg.msg_iov = bufs;
+      msg.msg_iovlen = count;
+      const ssize_t ret = ::sendmsg( m_socket, &msg, asyncSendFlags );
+      if( ret < 0 )
+      {
+        if( errno == EINTR )
+          continue;
+        if( errno == EAGAIN || errno == EWOULDBLOCK )
+        {
+          m_blocked = true;
+          break;
+        }
+        return ConnIoError;
+      }
+      size_t sent = static_cast<size_t>( ret );
+#endif
+
+      m_totalBytesOut += static_cast<long int>( sent );
+      const bool partial = sent < total + ( withData ? data->length() : 0 );
+
+      const size_t fromQueue = sent < total ? sent : total;
+      m_pending -= static_cast<int>( fromQueue );
+      sent -= fromQueue;
+      size_t consumed = fromQueue;
+      while( consumed )
+      {
+        const std::string::size_type left = m_sendQueue.front().length() - m_sendOffset;
+        if( consumed < left )
+        {
+          m_sendOffset += consumed;
+          break;
+        }
+        consumed -= left;
+        m_sendQueue.pop_front();
+        m_sendOffset = 0;
+      }
+
+      if( withData )
+      {
+        if( sent < data->length() )
+        {
+          m_sendQueue.push_back( data->substr( sent ) );
+          m_pending += static_cast<int>( data->length() - sent );
+        }
+        data = 0;
+      }
+
+      // the socket's buffer is full, no need to try again right now
+      if( partial )
+      {
+        m_blocked = true;
+        break;
+      }
     }
 
-    return sent != -1;
+    if( data )
+    {
+      m_sendQueue.push_back( *data );
+      m_pending += static_cast<int>( data->length() );
+    }
+
+    if( m_sendQueue.empty() )
+      m_flushDue = 0;
+
+    return ConnNoError;
+  }
+
+  ConnectionError ConnectionTCPBase::flush()
+  {
+    m_sendMutex.lock();
+
+    if( m_sendQueue.empty() )
+    {
+      m_sendMutex.unlock();
+      return ConnNoError;
+    }
+
+    if( m_socket < 0 )
+    {
+      m_sendMutex.unlock();
+      return ConnNotConnected;
+    }
+
+    const ConnectionError err = writeQueue();
+    bool low = false;
+    if( m_aboveHigh && m_pending <= m_lowWater )
+    {
+      m_aboveHigh = false;
+      low = true;
+    }
+    const int bytes = m_pending;
+
+    m_sendMutex.unlock();
+
+    if( err != ConnNoError )
+      sendFailed();
+    else if( low )
+      notifySendQueue( SendQueueLow, bytes );
+
+    return err;
+  }
+
+  void ConnectionTCPBase::flushIfDue()
+  {
+    if( !m_async )
+      return;
+
+    m_sendMutex.lock();
+    const bool due = !m_sendQueue.empty() && m_flushDue <= util::monotonicTime();
+    m_sendMutex.unlock();
+
+    if( due )
+      flush();
+  }
+
+  int ConnectionTCPBase::pendingOutput() const
+  {
+    util::MutexGuard sm( m_sendMutex );
+    return m_pending;
+  }
+
+  long long ConnectionTCPBase::nextFlush() const
+  {
+    util::MutexGuard sm( m_sendMutex );
+    return m_pending ? m_flushDue : 0;
+  }
+
+  void ConnectionTCPBase::setAsyncSend( bool async, int maxBytes, int maxDelay )
+  {
+    m_sendMutex.lock();
+
+    m_async = async;
+    m_maxBytes = maxBytes > 0 ? maxBytes : 0;
+    m_maxDelay = maxDelay > 0 ? maxDelay : 0;
+
+    ConnectionError err = ConnNoError;
+    bool low = false;
+    if( !async && !m_sendQueue.empty() && m_socket >= 0 )
+    {
+      while( err == ConnNoError && !m_sendQueue.empty() )
+      {
+        err = writeQueue();
+        if( err == ConnNoError && !m_sendQueue.empty() && !waitWritable() )
+          err = ConnIoError;
+      }
+      low = m_aboveHigh && err == ConnNoError;
+      m_aboveHigh = m_aboveHigh && !low;
+    }
+
+    m_sendMutex.unlock();
+
+    if( err != ConnNoError )
+      sendFailed();
+    else if( low )
+      notifySendQueue( SendQueueLow, 0 );
+  }
+
+  void ConnectionTCPBase::setSendQueueLimits( int highWater, int lowWater )
+  {
+    util::MutexGuard sm( m_sendMutex );
+    m_highWater = highWater;
+    m_lowWater = lowWater;
+  }
+
+  void ConnectionTCPBase::registerSendQueueHandler( SendQueueHandler* sqh )
+  {
+    if( !sqh )
+      return;
+
+    util::MutexGuard sm( m_sendMutex );
+    m_sendQueueHandlers.remove( sqh );
+    m_sendQueueHandlers.push_back( sqh );
+  }
+
+  void ConnectionTCPBase::removeSendQueueHandler( SendQueueHandler* sqh )
+  {
+    util::MutexGuard sm( m_sendMutex );
+    m_sendQueueHandlers.remove( sqh );
+  }
+
+  void ConnectionTCPBase::notifySendQueue( SendQueueEvent event, int bytes )
+  {
+    // handlers may (un)register handlers, and other threads may do so, too
+    m_sendMutex.lock();
+    const SendQueueHandlerList handlers( m_sendQueueHandlers );
+    m_sendMutex.unlock();
+
+    SendQueueHandlerList::const_iterator it = handlers.begin();
+    for( ; it != handlers.end(); ++it )
+      (*it)->handleSendQueue( this, event, bytes );
   }
 
   void ConnectionTCPBase::getStatistics( long int &totalIn, long int &totalOut )
@@ -175,6 +576,8 @@ namespace gloox
       return;
     }
 
+    drainQueue();
+
     if( m_socket >= 0 )
     {
       DNS::closeSocket( m_socket, m_logInstance );
@@ -185,6 +588,12 @@ namespace gloox
     m_cancel = true;
     m_totalBytesIn = 0;
     m_totalBytesOut = 0;
+    m_sendQueue.clear();
+    m_sendOffset = 0;
+    m_pending = 0;
+    m_flushDue = 0;
+    m_blocked = false;
+    m_aboveHigh = false;
 
     m_recvMutex.unlock(),
     m_sendMutex.unlock();
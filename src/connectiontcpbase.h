@@ -18,11 +18,14 @@
 #include "connectionbase.h"
 #include "logsink.h"
 #include "mutex.h"
+#include "sendqueuehandler.h"
 
 #ifdef __MINGW32__
 #include <ws2tcpip.h>
 #endif
 
+#include <deque>
+#include <list>
 #include <string>
 
 namespace gloox
@@ -38,6 +41,11 @@ namespace gloox
    *
    * You should not need to use this class directly.
    *
+   * By default, send() blocks until all data has been handed to the kernel. In asynchronous
+   * send mode (see setAsyncSend()) send() never blocks. Instead, data is queued per connection
+   * and written with a single writev() (a single WSASend() on Windows) per flush, which saves
+   * system calls when many small stanzas go out in a burst, e.g. presence floods or MUC fan-out.
+   *
    * @author Jakob Schröter <js@camaya.net>
    * @since 0.9
    */
@@ -87,12 +95,65 @@ namespace gloox
       // reimplemented from ConnectionBase
       virtual void getStatistics( long int &totalIn, long int &totalOut );
 
+      /**
+       * Switches asynchronous send mode on or off. In asynchronous mode, send() appends the data
+       * to an output queue and returns immediately. Queued data is written, as far as possible
+       * without blocking, when
+       * @li it has grown to at least @c maxBytes octets, or
+       * @li it has been waiting for @c maxDelay milliseconds, or
+       * @li flush() is called.
+       *
+       * The latency budget is enforced by recv() and by ConnectionEventLoop, so either must be
+       * called regularly. With a @c maxDelay of 0, data is held until the current round of
+       * processing ends, i.e. until the next recv() or the end of the current
+       * ConnectionEventLoop iteration. That coalesces e.g. the replies to a batch of incoming
+       * stanzas. Whatever the socket does not accept stays queued until it is writable again.
+       * A connection added to a ConnectionEventLoop is flushed by the loop, which also waits for
+       * writability.
+       *
+       * Switching asynchronous mode off writes out any queued data, blocking if necessary.
+       * disconnect() and cleanup() also try to write out queued data before the socket is
+       * closed, but wait at most one second for the socket to become writable.
+       * @param async Whether to queue outgoing data.
+       * @param maxBytes The byte budget. 0 writes each chunk of data immediately, and queues only
+       * what the socket does not accept.
+       * @param maxDelay The latency budget in milliseconds.
+       * @since 1.1
+       */
+      void setAsyncSend( bool async, int maxBytes = 16384, int maxDelay = 0 );
+
+      /**
+       * Sets the high- and low-water marks of the output queue in asynchronous send mode.
+       * Registered SendQueueHandlers receive a SendQueueHigh event when the queue grows beyond
+       * @c highWater octets, and a SendQueueLow event when it has been drained to @c lowWater
+       * octets afterwards. The queue itself is not limited. The defaults are 1 MB and 256 KB.
+       * @param highWater The high-water mark in octets.
+       * @param lowWater The low-water mark in octets. Should be less than @c highWater.
+       * @since 1.1
+       */
+      void setSendQueueLimits( int highWater, int lowWater );
+
+      // reimplemented from ConnectionBase
+      virtual ConnectionError flush();
+
+      // reimplemented from ConnectionBase
+      virtual int pendingOutput() const;
+
+      // reimplemented from ConnectionBase
+      virtual long long nextFlush() const;
+
+      // reimplemented from ConnectionBase
+      virtual void registerSendQueueHandler( SendQueueHandler* sqh );
+
+      // reimplemented from ConnectionBase
+      virtual void removeSendQueueHandler( SendQueueHandler* sqh );
+
       /**
        * Gives access to the raw socket of this connection. Use it wisely. You can
        * select()/poll() it and use ConnectionTCPBase::recv( -1 ) to fetch the data.
        * @return The socket of the active connection, or -1 if no connection is established.
        */
-      int socket() const { return m_socket; }
+      virtual int socket() const { return m_socket; }
 
       /**
        * This function allows to set an existing socket with an established
@@ -119,9 +180,15 @@ namespace gloox
       void init( const std::string& server, int port );
       bool dataAvailable( int timeout = -1 );
       void cancel();
+      void flushIfDue();
+      ConnectionError writeQueue( const std::string* data = 0 );
+      bool waitWritable( int timeout = -1 );
+      void drainQueue();
+      void notifySendQueue( SendQueueEvent event, int bytes );
+      void sendFailed();
 
       const LogSink& m_logInstance;
-      util::Mutex m_sendMutex;
+      mutable util::Mutex m_sendMutex;
       util::Mutex m_recvMutex;
 
       char* m_buf;
@@ -131,6 +198,22 @@ namespace gloox
       const int m_bufsize;
       bool m_cancel;
 
+      typedef std::deque<std::string> SendQueue;
+      typedef std::list<SendQueueHandler*> SendQueueHandlerList;
+
+      SendQueue m_sendQueue;
+      SendQueueHandlerList m_sendQueueHandlers;
+      std::string::size_type m_sendOffset;
+      long long m_flushDue;
+      int m_pending;
+      int m_maxBytes;
+      int m_maxDelay;
+      int m_highWater;
+      int m_lowWater;
+      bool m_async;
+      bool m_blocked;
+      bool m_aboveHigh;
+
   };
 
 }
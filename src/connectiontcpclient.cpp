@@ -124,6 +124,9 @@ namespace gloox
 
   ConnectionError ConnectionTCPClient::recv( int timeout )
   {
+    // write out what has been queued while processing the previous chunk
+    flushIfDue();
+
     m_recvMutex.lock();
 
     if( m_cancel || m_socket < 0 )
@@ -135,6 +138,7 @@ namespace gloox
     if( !dataAvailable( timeout ) )
     {
       m_recvMutex.unlock();
+      flushIfDue();
       return ConnNoError;
     }
 
@@ -177,7 +181,7 @@ namespace gloox
     m_buf[size] = '\0';
 
     if( m_handler )
-      m_handler->handleReceivedData( this, std::string( m_buf, size ) );
+      m_handler->handleReceivedData( this, m_buf, size );
 
     return ConnNoError;
   }
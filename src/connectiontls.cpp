@@ -144,7 +144,14 @@ namespace gloox
   void ConnectionTLS::handleReceivedData( const ConnectionBase* /*connection*/, const std::string& data )
   {
     if( m_tls )
-      m_tls->decrypt( data );
+      m_tls->decrypt( data.data(), data.length() );
+  }
+
+  void ConnectionTLS::handleReceivedData( const ConnectionBase* /*connection*/, const char* data,
+                                          std::string::size_type length )
+  {
+    if( m_tls )
+      m_tls->decrypt( data, length );
   }
 
   void ConnectionTLS::handleConnect( const ConnectionBase* /*connection*/ )
@@ -167,10 +174,16 @@ namespace gloox
       m_connection->send( data );
   }
 
-  void ConnectionTLS::handleDecryptedData( const TLSBase* /*tls*/, const std::string& data )
+  void ConnectionTLS::handleDecryptedData( const TLSBase* tls, const std::string& data )
+  {
+    handleDecryptedData( tls, data.data(), data.length() );
+  }
+
+  void ConnectionTLS::handleDecryptedData( const TLSBase* /*tls*/, const char* data,
+                                           std::string::size_type length )
   {
     if( m_handler )
-      m_handler->handleReceivedData( this, data );
+      m_handler->handleReceivedData( this, data, length );
     else
     {
       m_log.log( LogLevelDebug, LogAreaClassConnectionTLS, "Data received and decrypted but no handler" );
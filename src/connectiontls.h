@@ -149,9 +149,33 @@ namespace gloox
       // reimplemented from ConnectionBase
       virtual void getStatistics( long int& totalIn, long int& totalOut );
 
+      // reimplemented from ConnectionBase
+      virtual int socket() const { return m_connection ? m_connection->socket() : -1; }
+
+      // reimplemented from ConnectionBase
+      virtual ConnectionError flush() { return m_connection ? m_connection->flush() : ConnNotConnected; }
+
+      // reimplemented from ConnectionBase
+      virtual int pendingOutput() const { return m_connection ? m_connection->pendingOutput() : 0; }
+
+      // reimplemented from ConnectionBase
+      virtual long long nextFlush() const { return m_connection ? m_connection->nextFlush() : 0; }
+
+      // reimplemented from ConnectionBase
+      virtual void registerSendQueueHandler( SendQueueHandler* sqh )
+        { if( m_connection ) m_connection->registerSendQueueHandler( sqh ); }
+
+      // reimplemented from ConnectionBase
+      virtual void removeSendQueueHandler( SendQueueHandler* sqh )
+        { if( m_connection ) m_connection->removeSendQueueHandler( sqh ); }
+
       // reimplemented from ConnectionDataHandler
       virtual void handleReceivedData( const ConnectionBase* connection, const std::string& data );
 
+      // reimplemented from ConnectionDataHandler
+      virtual void handleReceivedData( const ConnectionBase* connection, const char* data,
+                                       std::string::size_type length );
+
       // reimplemented from ConnectionDataHandler
       virtual void handleConnect( const ConnectionBase* connection );
 
@@ -167,6 +191,10 @@ namespace gloox
       // reimplemented from TLSHandler
       virtual void handleDecryptedData( const TLSBase*, const std::string& data );
 
+      // reimplemented from TLSHandler
+      virtual void handleDecryptedData( const TLSBase*, const char* data,
+                                        std::string::size_type length );
+
       // reimplemented from TLSHandler
       virtual void handleHandshakeResult( const TLSBase* base, bool success, CertInfo& certinfo );
 
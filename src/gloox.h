@@ -1199,6 +1199,7 @@ namespace gloox
     LogAreaClassConnectionTLS         = 0x002000, /**< Log messages from ConnectionTLS */
     LogAreaLinkLocalManager           = 0x004000, /**< Log messages from LinkLocalManager */
     LogAreaClassConnectionWebSocket   = 0x008000, /**< Log messages from ConnectionWebSocket */
+    LogAreaClassConnectionEventLoop   = 0x010000, /**< Log messages from ConnectionEventLoop */
     LogAreaAllClasses                 = 0x01FFFF, /**< All log messages from all the classes. */
     LogAreaXmlIncoming                = 0x020000, /**< Incoming XML. */
     LogAreaXmlOutgoing                = 0x040000, /**< Outgoing XML. */
@@ -0,0 +1,315 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "iqtracker.h"
+
+#include <cstdio>
+#include <utility>
+
+namespace gloox
+{
+
+  // number of unused entries kept for reuse
+  static const unsigned maxFree = 1024;
+
+  IqTracker::IqTracker()
+    : m_emptyChains( 0 ), m_count( 0 )
+  {
+  }
+
+  IqTracker::~IqTracker()
+  {
+    clear();
+
+    EntryList::const_iterator it = m_free.begin();
+    for( ; it != m_free.end(); ++it )
+      delete (*it);
+  }
+
+  bool IqTracker::numericKey( const std::string& id, unsigned& key ) const
+  {
+    const std::string::size_type p = m_prefix.length();
+    if( !p || id.length() != p + 8 || id.compare( 0, p, m_prefix ) != 0 )
+      return false;
+
+    key = 0;
+    for( std::string::size_type i = p; i < p + 8; ++i )
+    {
+      const char c = id[i];
+      unsigned d;
+      if( c >= '0' && c <= '9' )
+        d = c - '0';
+      else if( c >= 'a' && c <= 'f' )
+        d = c - 'a' + 10;
+      else
+        return false;
+      key = ( key << 4 ) | d;
+    }
+
+    return true;
+  }
+
+  IqTracker::Entry* IqTracker::find( const std::string& id )
+  {
+    unsigned key;
+    if( numericKey( id, key ) )
+    {
+      NumericMap::const_iterator it = m_numeric.find( key );
+      return it != m_numeric.end() ? (*it).second : 0;
+    }
+
+    StringMap::const_iterator it = m_strings.find( id );
+    return it != m_strings.end() ? (*it).second : 0;
+  }
+
+  void IqTracker::add( const std::string& id, IqHandler* ih, int context, bool del,
+                       const std::string& to, long long deadline )
+  {
+    Entry* e = find( id );
+    if( e )
+      unlink( e );
+
+    if( m_free.empty() )
+      e = new Entry;
+    else
+    {
+      e = m_free.back();
+      m_free.pop_back();
+    }
+
+    e->track.ih = ih;
+    e->track.context = context;
+    e->track.del = del;
+    e->track.to = to;
+    e->numeric = numericKey( id, e->key );
+    if( e->numeric && !m_spare.empty() )
+    {
+      m_spare.key() = e->key;
+      m_spare.mapped() = e;
+      m_numeric.insert( std::move( m_spare ) );
+    }
+    else if( e->numeric )
+      m_numeric[e->key] = e;
+    else
+    {
+      e->track.id = id;
+      m_strings[id] = e;
+    }
+
+    e->deadline = deadline;
+    e->heapIndex = -1;
+    if( deadline )
+    {
+      e->heapIndex = static_cast<int>( m_heap.size() );
+      m_heap.push_back( e );
+      siftUp( e->heapIndex );
+    }
+
+    // prepend to the handler's chain
+    HandlerMap::iterator it = m_handlers.find( ih );
+    if( it == m_handlers.end() )
+      it = m_handlers.insert( std::make_pair( ih, static_cast<Entry*>( 0 ) ) ).first;
+    else if( !(*it).second )
+      --m_emptyChains;
+    e->prev = 0;
+    e->next = (*it).second;
+    if( e->next )
+      e->next->prev = e;
+    (*it).second = e;
+
+    ++m_count;
+  }
+
+  void IqTracker::release( Entry* e )
+  {
+    if( m_free.size() < maxFree )
+      m_free.push_back( e );
+    else
+      delete e;
+
+    --m_count;
+  }
+
+  void IqTracker::dropKey( Entry* e )
+  {
+    // keep a node around, most IQs are answered before the next one is sent
+    if( e->numeric && m_spare.empty() )
+      m_spare = m_numeric.extract( e->key );
+    else if( e->numeric )
+      m_numeric.erase( e->key );
+    else
+      m_strings.erase( e->track.id );
+
+    if( e->heapIndex != -1 )
+      heapRemove( e );
+  }
+
+  void IqTracker::unlink( Entry* e )
+  {
+    dropKey( e );
+
+    if( e->next )
+      e->next->prev = e->prev;
+    if( e->prev )
+      e->prev->next = e->next;
+    else
+    {
+      // empty chains are kept, handlers tend to send more than one IQ
+      HandlerMap::iterator it = m_handlers.find( e->track.ih );
+      (*it).second = e->next;
+      if( !e->next && ++m_emptyChains > 64 && m_emptyChains > m_handlers.size() / 2 )
+        pruneChains();
+    }
+
+    release( e );
+  }
+
+  void IqTracker::pruneChains()
+  {
+    HandlerMap::iterator it = m_handlers.begin();
+    while( it != m_handlers.end() )
+    {
+      if( (*it).second )
+        ++it;
+      else
+        it = m_handlers.erase( it );
+    }
+    m_emptyChains = 0;
+  }
+
+  bool IqTracker::take( const std::string& id, Track& track )
+  {
+    Entry* e = find( id );
+    if( !e )
+      return false;
+
+    track.ih = e->track.ih;
+    track.context = e->track.context;
+    track.del = e->track.del;
+    unlink( e );
+    return true;
+  }
+
+  void IqTracker::remove( IqHandler* ih )
+  {
+    HandlerMap::iterator it = m_handlers.find( ih );
+    if( it == m_handlers.end() )
+      return;
+
+    Entry* e = (*it).second;
+    if( !e )
+      --m_emptyChains;
+    m_handlers.erase( it );
+    while( e )
+    {
+      // the whole chain goes, no need to relink it
+      Entry* next = e->next;
+      dropKey( e );
+      release( e );
+      e = next;
+    }
+  }
+
+  bool IqTracker::expire( long long now, Track& track )
+  {
+    if( m_heap.empty() || m_heap.front()->deadline > now )
+      return false;
+
+    Entry* e = m_heap.front();
+    if( e->numeric )
+    {
+      char hex[9];
+      sprintf( hex, "%08x", e->key );
+      track.id = m_prefix + hex;
+    }
+    else
+      track.id = e->track.id;
+
+    track.ih = e->track.ih;
+    track.context = e->track.context;
+    track.del = e->track.del;
+    track.to = e->track.to;
+    unlink( e );
+    return true;
+  }
+
+  void IqTracker::clear()
+  {
+    NumericMap::const_iterator it = m_numeric.begin();
+    for( ; it != m_numeric.end(); ++it )
+      delete (*it).second;
+    StringMap::const_iterator it2 = m_strings.begin();
+    for( ; it2 != m_strings.end(); ++it2 )
+      delete (*it2).second;
+
+    m_numeric.clear();
+    m_strings.clear();
+    m_handlers.clear();
+    m_heap.clear();
+    m_emptyChains = 0;
+    m_count = 0;
+  }
+
+  void IqTracker::heapRemove( Entry* e )
+  {
+    const int i = e->heapIndex;
+    Entry* last = m_heap.back();
+    m_heap.pop_back();
+    e->heapIndex = -1;
+    if( last == e )
+      return;
+
+    m_heap[i] = last;
+    last->heapIndex = i;
+    siftUp( i );
+    siftDown( last->heapIndex );
+  }
+
+  void IqTracker::siftUp( int i )
+  {
+    Entry* e = m_heap[i];
+    while( i > 0 )
+    {
+      const int parent = ( i - 1 ) / 2;
+      if( m_heap[parent]->deadline <= e->deadline )
+        break;
+      m_heap[i] = m_heap[parent];
+      m_heap[i]->heapIndex = i;
+      i = parent;
+    }
+    m_heap[i] = e;
+    e->heapIndex = i;
+  }
+
+  void IqTracker::siftDown( int i )
+  {
+    const int n = static_cast<int>( m_heap.size() );
+    Entry* e = m_heap[i];
+    for( ;; )
+    {
+      int child = 2 * i + 1;
+      if( child >= n )
+        break;
+      if( child + 1 < n && m_heap[child + 1]->deadline < m_heap[child]->deadline )
+        ++child;
+      if( e->deadline <= m_heap[child]->deadline )
+        break;
+      m_heap[i] = m_heap[child];
+      m_heap[i]->heapIndex = i;
+      i = child;
+    }
+    m_heap[i] = e;
+    e->heapIndex = i;
+  }
+
+}
@@ -0,0 +1,164 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef IQTRACKER_H__
+#define IQTRACKER_H__
+
+#include "gloox.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gloox
+{
+
+  class IqHandler;
+
+  /**
+   * @brief Keeps track of the IQ requests awaiting a response, and of their deadlines.
+   *
+   * IDs created by ClientBase::getID() consist of a per-session prefix and an 8 digit hex counter.
+   * For those, only the counter is hashed (and stored). Other IDs are hashed as a whole. All pending
+   * IQs of an IqHandler are chained, so that removing a handler costs O(number of its pending IQs).
+   * Deadlines are kept in a binary heap.
+   *
+   * @note This class is not thread-safe.
+   *
+   * @author Jakob Schröter <js@camaya.net>
+   * @since 1.1
+   */
+  class GLOOX_API IqTracker
+  {
+    public:
+      /**
+       * A pending IQ request.
+       */
+      struct Track
+      {
+        IqHandler* ih;              /**< The handler to notify of the response. */
+        int context;                /**< The handler's context. */
+        bool del;                   /**< Whether to delete the handler afterwards. */
+        std::string to;             /**< The request's recipient (full JID). */
+        std::string id;             /**< The request's ID. */
+      };
+
+      /**
+       * Constructs a new, empty IqTracker.
+       */
+      IqTracker();
+
+      /**
+       * Destructor. Does not delete any handlers.
+       */
+      ~IqTracker();
+
+      /**
+       * Sets the prefix of the IDs created by ClientBase::getID(). IDs consisting of the prefix
+       * and 8 hex digits are keyed by the numeric value of those digits.
+       * Must be set before any IQs are added.
+       * @param prefix The ID prefix.
+       */
+      void setIDPrefix( const std::string& prefix ) { m_prefix = prefix; }
+
+      /**
+       * Adds a pending IQ. An existing entry with the same ID is replaced.
+       * @param id The IQ's ID. Must not be empty.
+       * @param ih The handler to notify of the response.
+       * @param context The handler's context.
+       * @param del Whether to delete the handler afterwards.
+       * @param to The IQ's recipient (full JID).
+       * @param deadline The point in time (in terms of util::monotonicTime()) after which
+       * the IQ expires, or 0 if it should never expire.
+       */
+      void add( const std::string& id, IqHandler* ih, int context, bool del, const std::string& to,
+                long long deadline );
+
+      /**
+       * Removes a pending IQ and returns it.
+       * @param id The IQ's ID.
+       * @param track Receives the removed entry, except for its ID and recipient.
+       * @return @b True if there was an IQ with the given ID, @b false otherwise.
+       */
+      bool take( const std::string& id, Track& track );
+
+      /**
+       * Removes all pending IQs of the given handler.
+       * @param ih The handler.
+       */
+      void remove( IqHandler* ih );
+
+      /**
+       * Removes the pending IQ with the earliest deadline, if that is not after @c now.
+       * @param now The current time (in terms of util::monotonicTime()).
+       * @param track Receives the removed entry.
+       * @return @b True if an IQ expired, @b false otherwise.
+       */
+      bool expire( long long now, Track& track );
+
+      /**
+       * Removes all pending IQs.
+       */
+      void clear();
+
+      /**
+       * Returns the number of pending IQs.
+       * @return The number of pending IQs.
+       */
+      int size() const { return m_count; }
+
+    private:
+      struct Entry
+      {
+        Track track;
+        Entry* prev;
+        Entry* next;
+        long long deadline;
+        int heapIndex;
+        bool numeric;
+        unsigned key;
+      };
+
+      typedef std::unordered_map<unsigned, Entry*> NumericMap;
+      typedef std::unordered_map<std::string, Entry*> StringMap;
+      typedef std::unordered_map<IqHandler*, Entry*> HandlerMap;
+      typedef std::vector<Entry*> EntryList;
+
+      IqTracker& operator=( const IqTracker& );
+      IqTracker( const IqTracker& );
+
+      bool numericKey( const std::string& id, unsigned& key ) const;
+      Entry* find( const std::string& id );
+      void dropKey( Entry* e );
+      void release( Entry* e );
+      void unlink( Entry* e );
+      void pruneChains();
+      void heapRemove( Entry* e );
+      void siftUp( int i );
+      void siftDown( int i );
+
+      NumericMap m_numeric;
+      NumericMap::node_type m_spare;
+      StringMap m_strings;
+      HandlerMap m_handlers;
+      EntryList m_heap;
+      EntryList m_free;
+      std::string m_prefix;
+      HandlerMap::size_type m_emptyChains;
+      int m_count;
+
+  };
+
+}
+
+#endif // IQTRACKER_H__
@@ -14,74 +14,276 @@
 #include "prep.h"
 #include "gloox.h"
 #include "util.h"
+#include "mutexguard.h"
+
+#include <unordered_map>
 
 namespace gloox
 {
 
-  bool JID::setJID( const std::string& jid )
+  struct JID::Parts
   {
-    if ( jid.empty() )
+    Parts() : valid( false ) {}
+
+    std::string username;
+    std::string server;
+    std::string serverRaw;
+    std::string resource;
+    bool valid;
+  };
+
+  /*
+   * The records of all valid JIDs in use, and of some that have been used recently.
+   *
+   * A record's reference count is only ever raised from 0, or dropped to 0, with the lock
+   * held. So a record found in the pool cannot be freed while it is being acquired, and a
+   * record with more than one reference can be released without the lock.
+   */
+  struct JID::Pool
+  {
+    Pool() : idle( 0 ), idleHead( 0 ), idleTail( 0 ) {}
+
+    // the number of unreferenced records to keep, so that the JIDs of short-lived stanzas
+    // do not need to be prepped again
+    static const int MaxIdle = 4096;
+
+    typedef std::unordered_multimap<std::size_t, Record*> RecordMap;
+
+    util::Mutex mutex;
+    RecordMap records;                 // by the hash of the full JID
+    int idle;
+    Record* idleHead;                  // most recently released first
+    Record* idleTail;
+  };
+
+  // not destroyed on exit, as static JIDs may be destroyed after it
+  JID::Pool& JID::pool()
+  {
+    static Pool* p = new Pool();
+    return *p;
+  }
+
+  static std::size_t hashOf( const std::string& full )
+  {
+    return full.empty() ? 0 : std::hash<std::string>()( full );
+  }
+
+  JID::Record* JID::find( Pool& p, std::size_t hash, const std::string& full, const Parts* parts )
+  {
+    std::pair<Pool::RecordMap::const_iterator, Pool::RecordMap::const_iterator> range
+        = p.records.equal_range( hash );
+    Pool::RecordMap::const_iterator it = range.first;
+    for( ; it != range.second; ++it )
     {
-      m_bare = m_full = m_server = m_username = m_serverRaw = m_resource = EmptyString;
-      m_valid = false;
-      return false;
+      Record* r = (*it).second;
+      if( r->full != full )
+        continue;
+
+      // the same full JID can be built from different (raw) parts
+      if( parts ? r->bare->username != parts->username || r->bare->server != parts->server
+                  || r->bare->serverRaw != parts->serverRaw
+                : !r->canonical )
+        continue;
+
+      if( r->refs.fetch_add( 1, std::memory_order_acq_rel ) == 0 )
+      {
+        ( r->prevIdle ? r->prevIdle->nextIdle : p.idleHead ) = r->nextIdle;
+        ( r->nextIdle ? r->nextIdle->prevIdle : p.idleTail ) = r->prevIdle;
+        r->prevIdle = r->nextIdle = 0;
+        --p.idle;
+      }
+      return r;
     }
+    return 0;
+  }
 
-    const std::string::size_type at = jid.find( '@' );
-    const std::string::size_type slash = jid.find( '/', at == std::string::npos ? 0 : at );
+  JID::Record* JID::create( Pool& p, std::size_t hash, std::string& full, const Parts& parts,
+                            Record* bare )
+  {
+    Record* r = new Record();
+    r->full.swap( full );
+    if( bare )
+    {
+      r->resource = parts.resource;
+      r->bare = bare;
+    }
+    else
+    {
+      r->username = parts.username;
+      r->server = parts.server;
+      r->serverRaw = parts.serverRaw;
+      r->bare = r;
+    }
+    r->hash = hash;
+    r->refs.store( 1, std::memory_order_relaxed );
+    r->valid = parts.valid;
+    r->pooled = parts.valid;
+    r->canonical = false;
+    r->prevIdle = r->nextIdle = 0;
+    if( r->pooled )
+      p.records.insert( std::make_pair( hash, r ) );
+    return r;
+  }
 
-    if( at != std::string::npos && !( m_valid = prep::nodeprep( jid.substr( 0, at ), m_username ) ) )
-      return false;
+  JID::Record* JID::intern( const Parts& parts, const std::string& source )
+  {
+    std::string bare;
+    if( !parts.username.empty() )
+    {
+      bare = parts.username;
+      bare += '@';
+    }
+    bare += parts.server;
+    std::string full;
+    if( !parts.resource.empty() )
+    {
+      full = bare;
+      full += '/';
+      full += parts.resource;
+    }
+    const std::size_t bareHash = hashOf( bare );
+    const std::size_t fullHash = hashOf( full );
+    const bool canonical = parts.valid && parts.server == parts.serverRaw
+                           && ( full.empty() ? bare : full ) == source;
 
-    m_serverRaw = jid.substr( at == std::string::npos ? 0 : at + 1, slash - at - 1 );
-    if( !( m_valid = prep::nameprep( m_serverRaw, m_server ) ) )
-      return false;
+    Pool& p = pool();
+    util::MutexGuard m( p.mutex );
+    Record* r = parts.valid ? find( p, bareHash, bare, &parts ) : 0;
+    if( !r )
+      r = create( p, bareHash, bare, parts, 0 );
 
-    if( slash != std::string::npos
-         && !( m_valid = prep::resourceprep( jid.substr( slash + 1 ), m_resource ) ) )
-      return false;
+    if( !parts.resource.empty() )
+    {
+      Record* f = parts.valid ? find( p, fullHash, full, &parts ) : 0;
+      if( f )
+        unref( r );             // f holds a reference to its bare record already
+      else
+        f = create( p, fullHash, full, parts, r );
+      r = f;
+    }
 
-    setStrings();
+    if( canonical )
+      r->canonical = true;
 
-    return m_valid;
+    return r;
   }
 
-  bool JID::setUsername( const std::string& uname )
+  void JID::unref( Record* record )
   {
-    m_valid = prep::nodeprep( uname, m_username );
-    setStrings();
-    return m_valid;
+    Pool& p = pool();
+    util::MutexGuard m( p.mutex );
+    if( record->refs.fetch_sub( 1, std::memory_order_acq_rel ) != 1 )
+      return;
+
+    if( record->pooled )
+    {
+      record->nextIdle = p.idleHead;
+      ( p.idleHead ? p.idleHead->prevIdle : p.idleTail ) = record;
+      p.idleHead = record;
+      if( ++p.idle <= Pool::MaxIdle )
+        return;
+
+      // evict the record released longest ago
+      record = p.idleTail;
+      p.idleTail = record->prevIdle;
+      ( p.idleTail ? p.idleTail->nextIdle : p.idleHead ) = 0;
+      --p.idle;
+      std::pair<Pool::RecordMap::iterator, Pool::RecordMap::iterator> range
+          = p.records.equal_range( record->hash );
+      Pool::RecordMap::iterator it = range.first;
+      while( (*it).second != record )
+        ++it;
+      p.records.erase( it );
+    }
+
+    if( record->bare != record )
+      unref( record->bare );
+    delete record;
   }
 
-  bool JID::setServer( const std::string& serv )
+  void JID::assign( const Parts& parts, const std::string& source )
   {
-    m_serverRaw = serv;
-    m_valid = prep::nameprep( m_serverRaw, m_server );
-    setStrings();
-    return m_valid;
+    Record* r = intern( parts, source );
+    release( m_record );
+    m_record = r;
   }
 
-  bool JID::setResource( const std::string& res )
+  void JID::parts( Parts& parts ) const
   {
-    m_valid = prep::resourceprep( res, m_resource );
-    setFull();
-    return m_valid;
+    if( !m_record )
+      return;
+
+    parts.username = username();
+    parts.server = server();
+    parts.serverRaw = serverRaw();
+    parts.resource = resource();
+    parts.valid = m_record->valid;
   }
 
-  void JID::setFull()
+  bool JID::setJID( const std::string& jid )
   {
-    m_full = bare();
-    if( !m_resource.empty() )
-      m_full += '/' + m_resource;
+    if ( jid.empty() )
+    {
+      release( m_record );
+      m_record = 0;
+      return false;
+    }
+
+    // a string that has been parsed into a valid JID before does not need to be prepped again
+    Pool& p = pool();
+    p.mutex.lock();
+    Record* r = find( p, hashOf( jid ), jid, 0 );
+    p.mutex.unlock();
+    if( r )
+    {
+      release( m_record );
+      m_record = r;
+      return true;
+    }
+
+    Parts parts;
+    const std::string::size_type at = jid.find( '@' );
+    const std::string::size_type slash = jid.find( '/', at == std::string::npos ? 0 : at );
+
+    parts.valid = at == std::string::npos || prep::nodeprep( jid.substr( 0, at ), parts.username );
+    if( parts.valid )
+    {
+      parts.serverRaw = jid.substr( at == std::string::npos ? 0 : at + 1, slash - at - 1 );
+      parts.valid = prep::nameprep( parts.serverRaw, parts.server );
+    }
+    if( parts.valid && slash != std::string::npos )
+      parts.valid = prep::resourceprep( jid.substr( slash + 1 ), parts.resource );
+
+    assign( parts, jid );
+    return parts.valid;
+  }
+
+  bool JID::setUsername( const std::string& uname )
+  {
+    Parts p;
+    parts( p );
+    p.valid = prep::nodeprep( uname, p.username );
+    assign( p );
+    return p.valid;
   }
 
-  void JID::setBare()
+  bool JID::setServer( const std::string& serv )
   {
-    if( !m_username.empty() )
-      m_bare = m_username + '@';
-    else
-      m_bare = ""/*EmptyString*/;
-    m_bare += m_server;
+    Parts p;
+    parts( p );
+    p.serverRaw = serv;
+    p.valid = prep::nameprep( p.serverRaw, p.server );
+    assign( p );
+    return p.valid;
+  }
+
+  bool JID::setResource( const std::string& res )
+  {
+    Parts p;
+    parts( p );
+    p.valid = prep::resourceprep( res, p.resource );
+    assign( p );
+    return p.valid;
   }
 
   std::string JID::escapeNode( const std::string& node )
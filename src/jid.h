@@ -16,7 +16,11 @@
 #define JID_H__
 
 #include "macros.h"
+#include "gloox.h"
 
+#include <atomic>
+#include <cstddef>
+#include <functional>
 #include <string>
 
 namespace gloox
@@ -24,6 +28,15 @@ namespace gloox
   /**
    * @brief An abstraction of a JID.
    *
+   * JIDs are interned: all JIDs with the same (prepped) value share one immutable record
+   * holding the JID's parts and a hash computed once. Copying a JID copies a pointer,
+   * comparing two JIDs usually compares pointers, and hash() and equalBare() allow to use
+   * JIDs as keys of hash tables. Parsing a string that is already a prepped JID in use
+   * skips stringprep. The setters build (or find) a new record.
+   *
+   * Records are freed some time after the last JID referring to them is gone.
+   * JIDs can be used from multiple threads, but a single JID object is not synchronized.
+   *
    * @author Jakob Schröter <js@camaya.net>
    * @since 0.4
    */
@@ -34,21 +47,39 @@ namespace gloox
       /**
        * Constructs an empty JID.
        */
-      JID() : m_valid( false ) {}
+      JID() : m_record( 0 ) {}
 
       /**
        * Constructs a new JID from a string.
        * @param jid The string containing the JID.
        */
-      JID( const std::string& jid ) : m_valid( true ) { setJID( jid ); }
+      JID( const std::string& jid ) : m_record( 0 ) { setJID( jid ); }
+
+      /**
+       * Copy constructor. The copy shares the JID's record.
+       * @param right The JID to copy.
+       */
+      JID( const JID& right ) : m_record( right.m_record ) { acquire( m_record ); }
+
+      /**
+       * Assignment operator. The JID shares the other JID's record.
+       * @param right The JID to copy.
+       */
+      JID& operator=( const JID& right )
+      {
+        acquire( right.m_record );
+        release( m_record );
+        m_record = right.m_record;
+        return *this;
+      }
 
       /**
        * Destructor.
        */
-      ~JID() {}
+      ~JID() { release( m_record ); }
 
       /**
-       * Sets the JID from a string.
+       * Sets the JID from a string, replacing all of its parts.
        * @param jid The string containing the JID.
        * @return @b True if the given JID was valid, @b false otherwise.
        */
@@ -58,20 +89,20 @@ namespace gloox
        * Returns the full (prepped) JID (user\@host/resource).
        * @return The full JID.
        */
-      const std::string& full() const { return m_full; }
+      const std::string& full() const { return m_record ? m_record->full : EmptyString; }
 
       /**
        * Returns the bare (prepped) JID (user\@host).
        * @return The bare JID.
        */
-      const std::string& bare() const { return m_bare; }
+      const std::string& bare() const { return m_record ? m_record->bare->full : EmptyString; }
 
       /**
        * Creates and returns a JID from this JID's node and server parts.
        * @return The bare JID.
        * @since 0.9
        */
-      JID bareJID() const { return JID( bare() ); }
+      JID bareJID() const { return JID( m_record ? m_record->bare : 0 ); }
 
       /**
        * Sets the username.
@@ -95,25 +126,50 @@ namespace gloox
        * Returns the prepped username.
        * @return The current username.
        */
-      const std::string& username() const { return m_username; }
+      const std::string& username() const { return m_record ? m_record->bare->username : EmptyString; }
 
       /**
        * Returns the prepped server name.
        * @return The current server.
        */
-      const std::string& server() const { return m_server; }
+      const std::string& server() const { return m_record ? m_record->bare->server : EmptyString; }
 
       /**
        * Returns the raw (unprepped) server name.
        * @return The raw server name.
        */
-      const std::string& serverRaw() const { return m_serverRaw; }
+      const std::string& serverRaw() const { return m_record ? m_record->bare->serverRaw : EmptyString; }
 
       /**
        * Returns the prepped resource.
        * @return The current resource.
        */
-      const std::string& resource() const { return m_resource; }
+      const std::string& resource() const { return m_record ? m_record->resource : EmptyString; }
+
+      /**
+       * Returns a hash of the full JID. It is computed once per distinct JID.
+       * @return The hash of the full JID. It is 0 for an empty JID.
+       * @since 1.1
+       */
+      std::size_t hash() const { return m_record ? m_record->hash : 0; }
+
+      /**
+       * Returns a hash of the bare JID. It is computed once per distinct JID.
+       * @return The hash of the bare JID. It is 0 for an empty JID.
+       * @since 1.1
+       */
+      std::size_t bareHash() const { return m_record ? m_record->bare->hash : 0; }
+
+      /**
+       * Compares the bare JIDs of two JIDs. This is cheaper than comparing bare() or bareJID().
+       * @param right The second JID.
+       * @return @b True if both JIDs have the same bare JID, @b false otherwise.
+       * @since 1.1
+       */
+      bool equalBare( const JID& right ) const
+      {
+        return equal( m_record ? m_record->bare : 0, right.m_record ? right.m_record->bare : 0 );
+      }
 
       /**
        * Compares a JID with a string.
@@ -131,13 +187,13 @@ namespace gloox
        * Compares two JIDs.
        * @param right The second JID.
        */
-      bool operator==( const JID& right ) const { return full() == right.full(); }
+      bool operator==( const JID& right ) const { return equal( m_record, right.m_record ); }
 
       /**
        * Compares two JIDs.
        * @param right The second JID.
        */
-      bool operator!=( const JID& right ) const { return full() != right.full(); }
+      bool operator!=( const JID& right ) const { return !equal( m_record, right.m_record ); }
 
       /**
        * Compares two JIDs to see if the left is less than the right.
@@ -171,7 +227,7 @@ namespace gloox
       /**
        * Converts to  @b true if the JID is valid, @b false otherwise.
        */
-      operator bool() const { return m_valid; }
+      operator bool() const { return m_record && m_record->valid; }
 
       /**
        * @xep{0106}: JID Escaping
@@ -188,32 +244,86 @@ namespace gloox
       static std::string unescapeNode( const std::string& node );
 
     private:
-      /**
-       * Utility function to rebuild both the bare and full jid.
-       */
-      void setStrings() { setBare(); setFull(); }
+      struct Parts;
+      struct Pool;
+
+      // An interned JID. Records never change after they have been created.
+      struct Record
+      {
+        std::string full;              // the bare JID, for a bare record
+        std::string username;          // bare records only
+        std::string server;            // bare records only
+        std::string serverRaw;         // bare records only
+        std::string resource;
+        std::size_t hash;
+        Record* bare;                  // the record of the bare JID, may be this
+        std::atomic<int> refs;
+        bool valid;
+        bool pooled;                   // false for invalid JIDs, which are not shared
+        bool canonical;                // parsing full yields this record, see setJID()
+        Record* prevIdle;              // the pool's list of unreferenced records
+        Record* nextIdle;
+      };
+
+      // Shares @c record.
+      explicit JID( Record* record ) : m_record( record ) { acquire( m_record ); }
+
+      static bool equal( const Record* left, const Record* right )
+      {
+        if( left == right )
+          return true;
+        const std::size_t lh = left ? left->hash : 0;
+        const std::size_t rh = right ? right->hash : 0;
+        // equal prepped JIDs share a record unless their raw server names differ
+        return lh == rh && ( left ? left->full : EmptyString ) == ( right ? right->full : EmptyString );
+      }
+
+      static void acquire( Record* record )
+      {
+        if( record )
+          record->refs.fetch_add( 1, std::memory_order_relaxed );
+      }
+
+      static void release( Record* record )
+      {
+        if( !record )
+          return;
+
+        // the last reference is dropped under the pool's lock, see JID::Pool
+        int refs = record->refs.load( std::memory_order_relaxed );
+        while( refs > 1 )
+        {
+          if( record->refs.compare_exchange_weak( refs, refs - 1, std::memory_order_acq_rel ) )
+            return;
+        }
+        unref( record );
+      }
+
+      static Pool& pool();
+      static Record* find( Pool& pool, std::size_t hash, const std::string& full, const Parts* parts );
+      static Record* create( Pool& pool, std::size_t hash, std::string& full, const Parts& parts,
+                             Record* bare );
+      static Record* intern( const Parts& parts, const std::string& source );
+      static void unref( Record* record );
+      void assign( const Parts& parts, const std::string& source = EmptyString );
+      void parts( Parts& parts ) const;
+
+      Record* m_record;
 
-      /**
-       * Utility function rebuilding the bare jid.
-       * @note Do not use this function directly, instead use setStrings.
-       */
-      void setBare();
-
-      /**
-       * Utility function rebuilding the full jid.
-       */
-      void setFull();
+  };
 
-      std::string m_resource;
-      std::string m_username;
-      std::string m_server;
-      std::string m_serverRaw;
-      std::string m_bare;
-      std::string m_full;
-      bool m_valid;
+}
 
+namespace std
+{
+  /**
+   * Allows to use JIDs as keys of std::unordered_map and std::unordered_set.
+   * @since 1.1
+   */
+  template<> struct hash<gloox::JID>
+  {
+    std::size_t operator()( const gloox::JID& jid ) const { return jid.hash(); }
   };
-
 }
 
 #endif // JID_H__
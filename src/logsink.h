@@ -84,6 +84,18 @@ namespace gloox
       void err( LogArea area, const std::string& message ) const
         { log( LogLevelError, area, message ); }
 
+      /**
+       * Use this function to find out whether a message of the given LogLevel and LogArea
+       * would be delivered to any registered LogHandler. This is cheap and allows callers
+       * to skip building expensive log messages (e.g. serializing XML) nobody is listening to.
+       * @param level The severity of the event to be logged.
+       * @param area The part of the program/library the message would come from.
+       * @return @b True if at least one LogHandler would receive the message, @b false otherwise.
+       * @since 1.1
+       */
+      bool enabled( LogLevel level, LogArea area ) const
+        { return ( m_areas[level] & area ) != 0; }
+
       /**
        * Registers @c lh as object that receives all debug messages of the specified type.
        * Suitable for logging to a file, etc.
@@ -108,8 +120,11 @@ namespace gloox
 
       LogSink( const LogSink& /*copy*/ );
 
+      void updateAreas();
+
       typedef std::map<LogHandler*, LogInfo> LogHandlerMap;
       LogHandlerMap m_logHandlers;
+      int m_areas[LogLevelError + 1];
 
   };
 
@@ -39,17 +39,21 @@ namespace gloox
     else
       m_subtype = static_cast<MessageType>( util::lookup2( typestring, msgTypeStringValues ) );
 
-    const TagList& c = tag->children();
-    TagList::const_iterator it = c.begin();
+    const Tag::NodeList& c = tag->nodes();
+    Tag::NodeList::const_iterator it = c.begin();
     for( ; it != c.end(); ++it )
     {
-      if( (*it)->name() == "body" )
-        setLang( &m_bodies, m_body, (*it) );
-      else if( (*it)->name() == "subject" ) {
+      if( (*it)->type != Tag::TypeTag )
+        continue;
+
+      const Tag* t = (*it)->tag;
+      if( t->name() == "body" )
+        setLang( &m_bodies, m_body, t );
+      else if( t->name() == "subject" ) {
           has_subject = true;
-          setLang(&m_subjects, m_subject, (*it));
-      }else if( (*it)->name() == "thread" )
-        m_thread = (*it)->cdata();
+          setLang(&m_subjects, m_subject, t);
+      }else if( t->name() == "thread" )
+        m_thread = t->cdata();
     }
 
 
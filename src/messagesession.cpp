@@ -102,12 +102,15 @@ namespace gloox
 
   void MessageSession::resetResource()
   {
-    m_target.setResource( EmptyString );
+    setResource( EmptyString );
   }
 
   void MessageSession::setResource( const std::string& resource )
   {
+    const JID old = m_target;
     m_target.setResource( resource );
+    if( m_parent )
+      m_parent->retargetMessageSession( this, old );
   }
 
   void MessageSession::disposeMessageFilter( MessageFilter* mf )
@@ -235,8 +235,10 @@ namespace gloox
       {
         m_type = TypeDestroy;
         m_jid = (*it)->findAttribute( "jid" );
-        m_pwd = (*it)->findCData( "/query/destroy/password" );
-        m_reason = (*it)->findCData( "/query/destroy/reason" );
+        static const Tag::XPath password( "/query/destroy/password" );
+        static const Tag::XPath reason( "/query/destroy/reason" );
+        m_pwd = (*it)->findCData( password );
+        m_reason = (*it)->findCData( reason );
         break;
       }
     }
@@ -919,7 +921,7 @@ namespace gloox
 
   void MUCRoom::handlePresence( const Presence& presence )
   {
-    if( ( presence.from().bare() != m_nick.bare() ) || !m_roomHandler )
+    if( !presence.from().equalBare( m_nick ) || !m_roomHandler )
       return;
 
     if( presence.subtype() == Presence::Error  )
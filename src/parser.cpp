@@ -15,33 +15,50 @@
 #include "parser.h"
 
 #include <cstdlib>
+#include <cstring>
 
 namespace gloox
 {
 
   Parser::Parser( TagHandler* ph, bool deleteRoot )
-    : m_tagHandler( ph ), m_current( 0 ), m_root( 0 ), m_xmlnss( 0 ), m_state( Initial ),
-      m_preamble( 0 ), m_quote( false ), m_haveTagPrefix( false ), m_haveAttribPrefix( false ),
-      m_attribIsXmlns( false ), m_deleteRoot( deleteRoot )
+    : m_tagHandler( ph ), m_current( 0 ), m_root( 0 ), m_xmlnss( 0 ), m_arena( 0 ),
+      m_state( Initial ), m_preamble( 0 ), m_quote( false ), m_haveTagPrefix( false ),
+      m_haveAttribPrefix( false ), m_attribIsXmlns( false ), m_deleteRoot( deleteRoot ),
+      m_useArena( false )
   {
   }
 
   Parser::~Parser()
   {
     cleanup( true );
+    delete m_arena;
   }
 
-  Parser::DecodeState Parser::decode( std::string::size_type& pos, const std::string& data )
+  void Parser::setTagArena( bool enable )
   {
-    std::string::size_type p = data.find( ';', pos );
-    std::string::size_type diff = p - pos;
+    if( !m_deleteRoot )
+      return;
+
+    // a partially parsed element may still live in the arena, so keep it around until
+    // the next cleanup()
+    if( enable && !m_arena )
+      m_arena = new TagArena();
 
-    if( p == std::string::npos )
+    m_useArena = enable;
+  }
+
+  Parser::DecodeState Parser::decode( std::string::size_type& pos, const char* data,
+                                     std::string::size_type length )
+  {
+    const char* end = static_cast<const char*>( memchr( data + pos, ';', length - pos ) );
+    if( !end )
     {
-      m_backBuffer = data.substr( pos );
+      m_backBuffer.assign( data + pos, length - pos );
       return DecodeInsufficient;
     }
 
+    std::string::size_type diff = end - data - pos;
+
     if( diff < 3 || diff > 9 )
       return DecodeInvalid;
 
@@ -59,9 +76,9 @@ namespace gloox
             idx = 3;
           }
 
-          char* end;
-          const long int val = std::strtol( data.data() + pos + idx, &end, base );
-          if( *end != ';' || val < 0 )
+          char* num;
+          const long int val = std::strtol( data + pos + idx, &num, base );
+          if( *num != ';' || val < 0 )
             return DecodeInvalid;
 
           if( val == 0x9 || val == 0xA || val == 0xD || ( val >= 0x20 && val <= 0x7F ) )
@@ -103,15 +120,15 @@ namespace gloox
           return DecodeInvalid;
         break;
       case 'a':
-        if( diff == 5 && !data.compare( pos + 1, 5, "apos;" ) )
+        if( diff == 5 && !memcmp( data + pos + 1, "apos;", 5 ) )
           rep += '\'';
-        else if( diff == 4 && !data.compare( pos + 1, 4, "amp;" ) )
+        else if( diff == 4 && !memcmp( data + pos + 1, "amp;", 4 ) )
           rep += '&';
         else
           return DecodeInvalid;
         break;
       case 'q':
-        if( diff == 5 && !data.compare( pos + 1, 5, "quot;" ) )
+        if( diff == 5 && !memcmp( data + pos + 1, "quot;", 5 ) )
           rep += '"';
         else
           return DecodeInvalid;
@@ -136,14 +153,16 @@ namespace gloox
     return DecodeValid;
   }
 
-  Parser::ForwardScanState Parser::forwardScan( std::string::size_type& pos, const std::string& data,
-                                                const std::string& needle )
+  Parser::ForwardScanState Parser::forwardScan( std::string::size_type& pos, const char* data,
+                                                std::string::size_type length,
+                                                const char* needle )
   {
-    if( pos + needle.length() <= data.length() )
+    const std::string::size_type needleLength = strlen( needle );
+    if( pos + needleLength <= length )
     {
-      if( !data.compare( pos, needle.length(), needle ) )
+      if( !memcmp( data + pos, needle, needleLength ) )
       {
-        pos += needle.length() - 1;
+        pos += needleLength - 1;
         return ForwardFound;
       }
       else
@@ -153,21 +172,38 @@ namespace gloox
     }
     else
     {
-      m_backBuffer = data.substr( pos );
+      m_backBuffer.assign( data + pos, length - pos );
       return ForwardInsufficientSize;
     }
   }
 
+  void Parser::appendRun( std::string& target, std::string::size_type& pos, const char* data,
+                          std::string::size_type length, const char* stop )
+  {
+    const std::string::size_type end = util::findFirstOf( data, pos + 1, length, stop );
+    target.append( data + pos, end - pos );
+    pos = end - 1;
+  }
+
   int Parser::feed( std::string& data )
+  {
+    return feed( data.data(), data.length() );
+  }
+
+  int Parser::feed( const char* data, std::string::size_type length )
   {
     if( !m_backBuffer.empty() )
     {
-      data.insert( 0, m_backBuffer );
-      m_backBuffer = EmptyString;
+      // a token was cut off at the end of the previous chunk
+      std::string buf;
+      buf.swap( m_backBuffer );
+      buf.append( data, length );
+      return feed( buf.data(), buf.length() );
     }
 
-    std::string::size_type count = data.length();
-    for( std::string::size_type i = 0; i < count; ++i )
+    TagArena::Scope scope( m_useArena ? m_arena : 0 );
+
+    for( std::string::size_type i = 0; i < length; ++i )
     {
       const unsigned char c = data[i];
 //       printf( "found char:   %c, ", c );
@@ -205,7 +241,7 @@ namespace gloox
           {
             case '&':
 //               printf( "InterTag, calling decode\n" );
-              switch( decode( i, data ) )
+              switch( decode( i, data, length ) )
               {
                 case DecodeValid:
                   m_state = TagInside;
@@ -251,7 +287,7 @@ namespace gloox
               m_preamble = 1;
               break;
             case '!':
-              switch( forwardScan( i, data, "![CDATA[" ) )
+              switch( forwardScan( i, data, length, "![CDATA[" ) )
               {
                 case ForwardFound:
                   m_state = TagCDATASection;
@@ -273,7 +309,7 @@ namespace gloox
           switch( c )
           {
             case ']':
-              switch( forwardScan( i, data, "]]>" ) )
+              switch( forwardScan( i, data, length, "]]>" ) )
               {
                 case ForwardFound:
                   m_state = TagInside;
@@ -286,7 +322,7 @@ namespace gloox
               }
               break;
             default:
-              m_cdata += c;
+              appendRun( m_cdata, i, data, length, "]" );
               break;
           }
           break;
@@ -343,7 +379,7 @@ namespace gloox
               break;
             case '&':
 //               printf( "TagInside, calling decode\n" );
-              switch( decode( i, data ) )
+              switch( decode( i, data, length ) )
               {
                 case DecodeValid:
                   break;
@@ -355,7 +391,7 @@ namespace gloox
               }
               break;
             default:
-              m_cdata += c;
+              appendRun( m_cdata, i, data, length, "<&" );
               break;
           }
           break;
@@ -579,7 +615,7 @@ namespace gloox
               break;
             case '&':
 //               printf( "TagAttributeValue, calling decode\n" );
-              switch( decode( i, data ) )
+              switch( decode( i, data, length ) )
               {
                 case DecodeValid:
                   break;
@@ -592,7 +628,7 @@ namespace gloox
               break;
             case '>':
             default:
-              m_value += c;
+              appendRun( m_value, i, data, length, "<'\"&" );
           }
           break;
         case TagNameAlmostComplete:
@@ -773,6 +809,9 @@ namespace gloox
 
   void Parser::cleanup( bool deleteRoot )
   {
+    // arena memory is recognized by the active arenas only
+    TagArena::Scope scope( m_arena );
+
     if( deleteRoot )
       delete m_root;
     m_root = 0;
@@ -789,9 +828,12 @@ namespace gloox
     m_value = EmptyString;
     m_xmlns = EmptyString;
     util::clearList( m_attribs );
-    m_attribs.clear();
+    m_attribs.shrink_to_fit(); // may have grown inside the arena
     m_state = Initial;
     m_preamble = 0;
+
+    if( deleteRoot && m_arena )
+      m_arena->reset();
   }
 
   bool Parser::isWhitespace( unsigned char c )
@@ -802,7 +844,11 @@ namespace gloox
   void Parser::streamEvent( Tag* tag )
   {
     if( m_tagHandler )
+    {
+      // anything the handler allocates must survive the arena's reset
+      TagArena::Scope scope( 0 );
       m_tagHandler->handleTag( tag );
+    }
   }
 
 }
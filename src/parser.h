@@ -49,12 +49,25 @@ namespace gloox
 
       /**
        * Use this function to feed the parser with more XML.
-       * @param data Raw xml to parse. It may be modified if backbuffering is necessary.
+       * @param data Raw xml to parse.
        * @return Returns @b -1 if parsing was successful. If a parse error occured, the
        * character position where the error has occured is returned.
        */
       int feed( std::string& data );
 
+      /**
+       * Use this function to feed the parser with more XML. The data is scanned in place;
+       * only the bytes of a token that is cut off at the end of the buffer are kept
+       * for the next call.
+       * @param data Raw xml to parse. It is not required to be NUL-terminated.
+       * @param length The number of bytes in @c data.
+       * @return Returns @b -1 if parsing was successful. If a parse error occured, the
+       * character position where the error has occured is returned. The position is
+       * relative to the start of any data kept from the previous call.
+       * @since 1.1
+       */
+      int feed( const char* data, std::string::size_type length );
+
       /**
        * Resets internal state.
        * @param deleteRoot Whether to delete the m_root member. For
@@ -62,6 +75,18 @@ namespace gloox
        */
       void cleanup( bool deleteRoot = true );
 
+      /**
+       * Enables or disables allocation of parsed Tags from a TagArena. If enabled, each
+       * top-level element is built inside an arena that is reset as soon as the TagHandler
+       * returns, instead of performing a number of heap allocations per element.
+       * TagHandlers must use Tag::clone() for any Tag they want to keep.
+       * This has no effect if the Parser was created with @c deleteRoot set to @b false.
+       * Default: disabled.
+       * @param enable Whether to use a TagArena.
+       * @since 1.1
+       */
+      void setTagArena( bool enable );
+
     private:
       enum ParserInternalState
       {
@@ -105,14 +130,18 @@ namespace gloox
       bool closeTag();
       bool isWhitespace( unsigned char c );
       void streamEvent( Tag* tag );
-      ForwardScanState forwardScan( std::string::size_type& pos, const std::string& data,
-                                    const std::string& needle );
-      DecodeState decode( std::string::size_type& pos, const std::string& data );
+      ForwardScanState forwardScan( std::string::size_type& pos, const char* data,
+                                    std::string::size_type length, const char* needle );
+      DecodeState decode( std::string::size_type& pos, const char* data,
+                          std::string::size_type length );
+      void appendRun( std::string& target, std::string::size_type& pos, const char* data,
+                      std::string::size_type length, const char* stop );
 
       TagHandler* m_tagHandler;
       Tag* m_current;
       Tag* m_root;
       StringMap* m_xmlnss;
+      TagArena* m_arena;
 
       ParserInternalState m_state;
       Tag::AttributeList m_attribs;
@@ -130,6 +159,7 @@ namespace gloox
       bool m_haveAttribPrefix;
       bool m_attribIsXmlns;
       bool m_deleteRoot;
+      bool m_useArena;
 
   };
 
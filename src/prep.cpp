@@ -11,6 +11,8 @@
 */
 
 #include "prep.h"
+#include "mutex.h"
+#include "mutexguard.h"
 
 #include "config.h"
 
@@ -19,8 +21,12 @@
 # include <idna.h>
 #endif
 
+#include <atomic>
 #include <cstdlib>
+#include <list>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 #include <string.h>
 
@@ -32,6 +38,190 @@ namespace gloox
   namespace prep
   {
 
+    /**
+     * A bounded, thread-safe memo of the results of one Stringprep profile. Input that the
+     * profile maps to itself unchanged (printable ASCII without uppercase letters, and without
+     * the characters Nodeprep prohibits) is not looked up at all.
+     */
+    class Cache
+    {
+      public:
+        /**
+         * The function doing the actual prepping.
+         */
+        typedef bool (*PrepFn)( const std::string& in, std::string& out );
+
+        /**
+         * Creates a new, empty cache.
+         * @param profile The profile whose results are cached.
+         */
+        Cache( Profile profile )
+          : m_profile( profile ), m_size( 4096 ), m_hits( 0 ), m_misses( 0 ), m_fastPath( 0 )
+        {}
+
+        /**
+         * Preps a string, using the fast path or a cached result if possible.
+         * @param in The string to prep.
+         * @param out The prepped string. In case of an error this string is not touched.
+         * @param fn The function to prep @c in with on a cache miss.
+         * @return The return value of @c fn for @c in.
+         */
+        bool prep( const std::string& in, std::string& out, PrepFn fn )
+        {
+          if( in.empty() || in.length() > JID_PORTION_SIZE )
+            return fn( in, out );
+
+          if( canonical( in ) )
+          {
+            m_fastPath.fetch_add( 1, std::memory_order_relaxed );
+            out = in;
+            return true;
+          }
+
+          {
+            util::MutexGuard m( m_mutex );
+            ResultMap::iterator it = m_index.find( in );
+            if( it != m_index.end() )
+            {
+              ++m_hits;
+              m_results.splice( m_results.begin(), m_results, (*it).second );
+              const Result& r = (*(*it).second).second;
+              if( r.first )
+                out = r.second;
+              return r.first;
+            }
+            ++m_misses;
+          }
+
+          Result r;
+          r.first = fn( in, r.second );
+          if( r.first )
+            out = r.second;
+
+          util::MutexGuard m( m_mutex );
+          if( m_size && m_index.find( in ) == m_index.end() )
+          {
+            if( m_results.size() >= m_size )
+            {
+              m_index.erase( m_results.back().first );
+              m_results.pop_back();
+            }
+            m_results.push_front( std::make_pair( in, r ) );
+            m_index[in] = m_results.begin();
+          }
+          return r.first;
+        }
+
+        /**
+         * Sets the maximum number of cached results, dropping the least recently used ones.
+         * @param size The maximum number of results. 0 disables the cache.
+         */
+        void setSize( int size )
+        {
+          util::MutexGuard m( m_mutex );
+          m_size = size > 0 ? static_cast<ResultList::size_type>( size ) : 0;
+          while( m_results.size() > m_size )
+          {
+            m_index.erase( m_results.back().first );
+            m_results.pop_back();
+          }
+        }
+
+        /**
+         * Empties the cache and resets its counters.
+         */
+        void clear()
+        {
+          util::MutexGuard m( m_mutex );
+          m_index.clear();
+          m_results.clear();
+          m_hits = 0;
+          m_misses = 0;
+          m_fastPath = 0;
+        }
+
+        /**
+         * Returns the cache's usage counters.
+         * @return The usage counters.
+         */
+        CacheStats stats() const
+        {
+          util::MutexGuard m( m_mutex );
+          CacheStats s;
+          s.hits = m_hits;
+          s.misses = m_misses;
+          s.fastPath = m_fastPath.load( std::memory_order_relaxed );
+          s.entries = static_cast<int>( m_results.size() );
+          return s;
+        }
+
+      private:
+        typedef std::pair<bool, std::string> Result;
+        typedef std::list< std::pair<std::string, Result> > ResultList;
+        typedef std::unordered_map<std::string, ResultList::iterator> ResultMap;
+
+        bool canonical( const std::string& s ) const
+        {
+          std::string::const_iterator it = s.begin();
+          for( ; it != s.end(); ++it )
+          {
+            const char c = (*it);
+            if( c < 0x20 || c > 0x7e )
+              return false;
+            if( m_profile == Resourceprep )
+              continue;
+            if( c == ' ' || ( c >= 'A' && c <= 'Z' ) )
+              return false;
+            if( m_profile == Nodeprep && ( c == '"' || c == '&' || c == '\'' || c == '/'
+                                           || c == ':' || c == '<' || c == '>' || c == '@' ) )
+              return false;
+          }
+          return true;
+        }
+
+        const Profile m_profile;
+        mutable util::Mutex m_mutex;
+        ResultList m_results;       // most recently used first
+        ResultMap m_index;
+        ResultList::size_type m_size;
+        unsigned long m_hits;
+        unsigned long m_misses;
+        std::atomic<unsigned long> m_fastPath;
+
+    };
+
+    /**
+     * Returns the cache of a profile. The caches are leaked on purpose, so that JIDs can be
+     * prepped during static destruction.
+     * @param profile The profile.
+     * @return The profile's cache.
+     */
+    static Cache& cache( Profile profile )
+    {
+      static Cache* caches[] = { new Cache( Nodeprep ), new Cache( Nameprep ),
+                                 new Cache( Resourceprep ) };
+      return *caches[profile];
+    }
+
+    void setCacheSize( int size )
+    {
+      cache( Nodeprep ).setSize( size );
+      cache( Nameprep ).setSize( size );
+      cache( Resourceprep ).setSize( size );
+    }
+
+    CacheStats cacheStats( Profile profile )
+    {
+      return cache( profile ).stats();
+    }
+
+    void clearCache()
+    {
+      cache( Nodeprep ).clear();
+      cache( Nameprep ).clear();
+      cache( Resourceprep ).clear();
+    }
+
 #ifdef HAVE_LIBIDN
     /**
      * Applies a Stringprep profile to a string. This function does the actual
@@ -54,12 +244,27 @@ namespace gloox
       free( p );
       return rc == STRINGPREP_OK;
     }
+
+    static bool prepareNode( const std::string& s, std::string& out )
+    {
+      return prepare( s, out, stringprep_xmpp_nodeprep );
+    }
+
+    static bool prepareName( const std::string& s, std::string& out )
+    {
+      return prepare( s, out, stringprep_nameprep );
+    }
+
+    static bool prepareResource( const std::string& s, std::string& out )
+    {
+      return prepare( s, out, stringprep_xmpp_resourceprep );
+    }
 #endif
 
     bool nodeprep( const std::string& node, std::string& out )
     {
 #ifdef HAVE_LIBIDN
-      return prepare( node, out, stringprep_xmpp_nodeprep );
+      return cache( Nodeprep ).prep( node, out, prepareNode );
 #else
       if( node.length() > JID_PORTION_SIZE )
         return false;
@@ -71,7 +276,7 @@ namespace gloox
     bool nameprep( const std::string& domain, std::string& out )
     {
 #ifdef HAVE_LIBIDN
-      return prepare( domain, out, stringprep_nameprep );
+      return cache( Nameprep ).prep( domain, out, prepareName );
 #else
       if( domain.length() > JID_PORTION_SIZE )
         return false;
@@ -83,7 +288,7 @@ namespace gloox
     bool resourceprep( const std::string& resource, std::string& out )
     {
 #ifdef HAVE_LIBIDN
-      return prepare( resource, out, stringprep_xmpp_resourceprep );
+      return cache( Resourceprep ).prep( resource, out, prepareResource );
 #else
       if( resource.length() > JID_PORTION_SIZE )
         return false;
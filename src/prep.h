@@ -32,6 +32,11 @@ namespace gloox
    * LibIDN is not installed these functions return the string they are given
    * without any modification.
    *
+   * The results of nodeprep(), nameprep() and resourceprep() are memoized in a bounded,
+   * thread-safe cache per profile, as the same JID parts are prepped over and over again.
+   * ASCII input the profile maps to itself (e.g. a lowercase ASCII domain) skips both
+   * LibIDN and the cache. See setCacheSize() and cacheStats().
+   *
    * @author Jakob Schröter <js@camaya.net>
    * @since 0.2
    */
@@ -88,6 +93,53 @@ namespace gloox
      */
     bool idna( const std::string& domain, std::string& out );
 
+    /**
+     * The Stringprep profiles whose results are cached.
+     * @since 1.1
+     */
+    enum Profile
+    {
+      Nodeprep,                     /**< The Nodeprep profile, see nodeprep(). */
+      Nameprep,                     /**< The Nameprep profile, see nameprep(). */
+      Resourceprep                  /**< The Resourceprep profile, see resourceprep(). */
+    };
+
+    /**
+     * Usage counters of a profile's cache.
+     * @since 1.1
+     */
+    struct CacheStats
+    {
+      unsigned long hits;           /**< The number of lookups answered from the cache. */
+      unsigned long misses;         /**< The number of lookups that had to call LibIDN. */
+      unsigned long fastPath;       /**< The number of ASCII inputs that needed no prepping. */
+      int entries;                  /**< The number of cached results. */
+    };
+
+    /**
+     * Sets the maximum number of results cached per profile. When a cache is full, the
+     * result that has been used least recently is dropped. The default is 4096. 0 disables
+     * the caches. The ASCII fast path is always used.
+     * @param size The maximum number of results to keep per profile.
+     * @note If LibIDN is not available nothing is cached, as prepping is a plain copy.
+     * @since 1.1
+     */
+    void setCacheSize( int size );
+
+    /**
+     * Returns the usage counters of a profile's cache.
+     * @param profile The profile.
+     * @return The profile's counters. The hit rate is @c hits / ( @c hits + @c misses ).
+     * @since 1.1
+     */
+    CacheStats cacheStats( Profile profile );
+
+    /**
+     * Empties all caches and resets their counters.
+     * @since 1.1
+     */
+    void clearCache();
+
   }
 
 }
@@ -58,14 +58,18 @@ namespace gloox
         m_subtype = static_cast<PresenceType>( util::lookup( t->cdata(), msgShowStringValues ) );
     }
 
-    const TagList& c = tag->children();
-    TagList::const_iterator it = c.begin();
+    const Tag::NodeList& c = tag->nodes();
+    Tag::NodeList::const_iterator it = c.begin();
     for( ; it != c.end(); ++it )
     {
-      if( (*it)->name() == "status" )
-        setLang( &m_stati, m_status, (*it) );
-      else if( (*it)->name() == "priority" )
-        m_priority = atoi( (*it)->cdata().c_str() );
+      if( (*it)->type != Tag::TypeTag )
+        continue;
+
+      const Tag* t = (*it)->tag;
+      if( t->name() == "status" )
+        setLang( &m_stati, m_status, t );
+      else if( t->name() == "priority" )
+        m_priority = atoi( t->cdata().c_str() );
     }
   }
 
@@ -46,12 +46,15 @@ namespace gloox
     if( !tag || tag->name() != "query" || tag->xmlns() != XMLNS_ROSTER )
       return;
 
-    const ConstTagList& l = tag->findTagList( "query/item" );
+    static const Tag::XPath item( "query/item" );
+    static const Tag::XPath group( "item/group" );
+
+    const ConstTagList& l = tag->findTagList( item );
     ConstTagList::const_iterator it = l.begin();
     for( ; it != l.end(); ++it )
     {
       StringList groups;
-      const ConstTagList& g = (*it)->findTagList( "item/group" );
+      const ConstTagList& g = (*it)->findTagList( group );
       ConstTagList::const_iterator it_g = g.begin();
       for( ; it_g != g.end(); ++it_g )
         groups.push_back( (*it_g)->cdata() );
@@ -240,7 +243,7 @@ namespace gloox
 
     bool self = false;
     Roster::iterator it = m_roster.find( presence.from().bare() );
-    if( it != m_roster.end() || ( self = ( presence.from().bareJID() == m_self->jid() ) ) )
+    if( it != m_roster.end() || ( self = presence.from().equalBare( m_self->jid() ) ) )
     {
       RosterItem* ri = self ? m_self : (*it).second;
       const std::string& resource = presence.from().resource();
@@ -0,0 +1,68 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef SENDQUEUEHANDLER_H__
+#define SENDQUEUEHANDLER_H__
+
+#include "macros.h"
+
+namespace gloox
+{
+
+  class ConnectionBase;
+
+  /**
+   * Events concerning the output queue of a connection in asynchronous send mode.
+   */
+  enum SendQueueEvent
+  {
+    SendQueuePending,               /**< Data has been queued while the queue was empty. It will be
+                                     * written when the coalescing budget is exhausted, or when
+                                     * the socket becomes writable again. */
+    SendQueueHigh,                  /**< The queue has grown beyond the high-water mark. Consider
+                                     * to stop sending to this connection for now. */
+    SendQueueLow                    /**< After a SendQueueHigh event, the queue has been drained
+                                     * to the low-water mark. */
+  };
+
+  /**
+   * @brief A virtual interface which can be reimplemented to receive events about the output
+   * queue of a connection in asynchronous send mode.
+   *
+   * See ConnectionTCPBase::setAsyncSend() for details.
+   *
+   * @author Jakob Schröter <js@camaya.net>
+   * @since 1.1
+   */
+  class GLOOX_API SendQueueHandler
+  {
+    public:
+      /**
+       * Virtual Destructor.
+       */
+      virtual ~SendQueueHandler() {}
+
+      /**
+       * This function is called when the state of a connection's output queue changes.
+       * @param connection The connection owning the queue. For wrapping connections (TLS,
+       * proxies) this is the transport connection.
+       * @param event The event.
+       * @param bytes The number of octets currently queued.
+       */
+      virtual void handleSendQueue( const ConnectionBase* connection, SendQueueEvent event, int bytes ) = 0;
+
+  };
+
+}
+
+#endif // SENDQUEUEHANDLER_H__
@@ -15,11 +15,437 @@
 #include "sha.h"
 #include "gloox.h"
 
-#include <cstdio>
+#include <cstring>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+# define GLOOX_SHA_X86 1
+# include <cpuid.h>
+# include <immintrin.h>
+#endif
 
 namespace gloox
 {
 
+  static const unsigned IV[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+  static inline unsigned rol( unsigned word, int bits )
+  {
+    return ( word << bits ) | ( word >> ( 32 - bits ) );
+  }
+
+  static inline unsigned ch( unsigned b, unsigned c, unsigned d )
+  {
+    return ( b & c ) | ( ~b & d );
+  }
+
+  static inline unsigned parity( unsigned b, unsigned c, unsigned d )
+  {
+    return b ^ c ^ d;
+  }
+
+  static inline unsigned maj( unsigned b, unsigned c, unsigned d )
+  {
+    return ( b & c ) | ( b & d ) | ( c & d );
+  }
+
+  // One round. Instead of moving the working variables along, the callers rotate their roles.
+  static inline void step( unsigned a, unsigned& b, unsigned& e, unsigned f, unsigned wk )
+  {
+    e += rol( a, 5 ) + f + wk;
+    b = rol( b, 30 );
+  }
+
+  // the 80 rounds, given the message schedule with the round constants already added
+  static inline void rounds( unsigned* H, const unsigned* WK )
+  {
+    unsigned A = H[0];
+    unsigned B = H[1];
+    unsigned C = H[2];
+    unsigned D = H[3];
+    unsigned E = H[4];
+
+    int t = 0;
+    for( ; t < 20; t += 5 )
+    {
+      step( A, B, E, ch( B, C, D ), WK[t] );
+      step( E, A, D, ch( A, B, C ), WK[t+1] );
+      step( D, E, C, ch( E, A, B ), WK[t+2] );
+      step( C, D, B, ch( D, E, A ), WK[t+3] );
+      step( B, C, A, ch( C, D, E ), WK[t+4] );
+    }
+    for( ; t < 40; t += 5 )
+    {
+      step( A, B, E, parity( B, C, D ), WK[t] );
+      step( E, A, D, parity( A, B, C ), WK[t+1] );
+      step( D, E, C, parity( E, A, B ), WK[t+2] );
+      step( C, D, B, parity( D, E, A ), WK[t+3] );
+      step( B, C, A, parity( C, D, E ), WK[t+4] );
+    }
+    for( ; t < 60; t += 5 )
+    {
+      step( A, B, E, maj( B, C, D ), WK[t] );
+      step( E, A, D, maj( A, B, C ), WK[t+1] );
+      step( D, E, C, maj( E, A, B ), WK[t+2] );
+      step( C, D, B, maj( D, E, A ), WK[t+3] );
+      step( B, C, A, maj( C, D, E ), WK[t+4] );
+    }
+    for( ; t < 80; t += 5 )
+    {
+      step( A, B, E, parity( B, C, D ), WK[t] );
+      step( E, A, D, parity( A, B, C ), WK[t+1] );
+      step( D, E, C, parity( E, A, B ), WK[t+2] );
+      step( C, D, B, parity( D, E, A ), WK[t+3] );
+      step( B, C, A, parity( C, D, E ), WK[t+4] );
+    }
+
+    H[0] += A;
+    H[1] += B;
+    H[2] += C;
+    H[3] += D;
+    H[4] += E;
+  }
+
+  static const unsigned K[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+  typedef void ( *CompressFunc )( unsigned*, const unsigned char*, unsigned );
+
+  // the SHA-1 compression function: adds @c blocks 64 byte blocks to the state
+  static void compressScalar( unsigned* H, const unsigned char* data, unsigned blocks )
+  {
+    unsigned W[80];
+    unsigned WK[80];
+    for( ; blocks; --blocks, data += 64 )
+    {
+      for( int t = 0; t < 16; ++t )
+      {
+        W[t] = static_cast<unsigned>( data[t * 4] ) << 24
+               | static_cast<unsigned>( data[t * 4 + 1] ) << 16
+               | static_cast<unsigned>( data[t * 4 + 2] ) << 8
+               | static_cast<unsigned>( data[t * 4 + 3] );
+      }
+      for( int t = 16; t < 80; ++t )
+        W[t] = rol( W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16], 1 );
+      for( int t = 0; t < 80; ++t )
+        WK[t] = W[t] + K[t / 20];
+
+      rounds( H, WK );
+    }
+  }
+
+#if defined( GLOOX_SHA_X86 )
+  // The compression function using the SHA extensions (SHA-NI). ABCD are kept in one register
+  // (in reverse order), E in the top lane of another. Every sha1rnds4 does four rounds.
+  __attribute__(( target( "sha,sse4.1" ) ))
+  static void compressSHANI( unsigned* H, const unsigned char* data, unsigned blocks )
+  {
+    const __m128i MASK = _mm_set_epi64x( 0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL );
+
+    __m128i ABCD = _mm_shuffle_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( H ) ), 0x1B );
+    __m128i E0 = _mm_set_epi32( static_cast<int>( H[4] ), 0, 0, 0 );
+    __m128i E1;
+    __m128i MSG0, MSG1, MSG2, MSG3;
+
+    for( ; blocks; --blocks, data += 64 )
+    {
+      const __m128i ABCD_SAVE = ABCD;
+      const __m128i E0_SAVE = E0;
+
+      // rounds 0-3
+      MSG0 = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) ), MASK );
+      E0 = _mm_add_epi32( E0, MSG0 );
+      E1 = ABCD;
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 0 );
+
+      // rounds 4-7
+      MSG1 = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + 16 ) ), MASK );
+      E1 = _mm_sha1nexte_epu32( E1, MSG1 );
+      E0 = ABCD;
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 0 );
+      MSG0 = _mm_sha1msg1_epu32( MSG0, MSG1 );
+
+      // rounds 8-11
+      MSG2 = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + 32 ) ), MASK );
+      E0 = _mm_sha1nexte_epu32( E0, MSG2 );
+      E1 = ABCD;
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 0 );
+      MSG1 = _mm_sha1msg1_epu32( MSG1, MSG2 );
+      MSG0 = _mm_xor_si128( MSG0, MSG2 );
+
+      // rounds 12-15
+      MSG3 = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + 48 ) ), MASK );
+      E1 = _mm_sha1nexte_epu32( E1, MSG3 );
+      E0 = ABCD;
+      MSG0 = _mm_sha1msg2_epu32( MSG0, MSG3 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 0 );
+      MSG2 = _mm_sha1msg1_epu32( MSG2, MSG3 );
+      MSG1 = _mm_xor_si128( MSG1, MSG3 );
+
+      // rounds 16-19
+      E0 = _mm_sha1nexte_epu32( E0, MSG0 );
+      E1 = ABCD;
+      MSG1 = _mm_sha1msg2_epu32( MSG1, MSG0 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 0 );
+      MSG3 = _mm_sha1msg1_epu32( MSG3, MSG0 );
+      MSG2 = _mm_xor_si128( MSG2, MSG0 );
+
+      // rounds 20-23
+      E1 = _mm_sha1nexte_epu32( E1, MSG1 );
+      E0 = ABCD;
+      MSG2 = _mm_sha1msg2_epu32( MSG2, MSG1 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 1 );
+      MSG0 = _mm_sha1msg1_epu32( MSG0, MSG1 );
+      MSG3 = _mm_xor_si128( MSG3, MSG1 );
+
+      // rounds 24-27
+      E0 = _mm_sha1nexte_epu32( E0, MSG2 );
+      E1 = ABCD;
+      MSG3 = _mm_sha1msg2_epu32( MSG3, MSG2 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 1 );
+      MSG1 = _mm_sha1msg1_epu32( MSG1, MSG2 );
+      MSG0 = _mm_xor_si128( MSG0, MSG2 );
+
+      // rounds 28-31
+      E1 = _mm_sha1nexte_epu32( E1, MSG3 );
+      E0 = ABCD;
+      MSG0 = _mm_sha1msg2_epu32( MSG0, MSG3 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 1 );
+      MSG2 = _mm_sha1msg1_epu32( MSG2, MSG3 );
+      MSG1 = _mm_xor_si128( MSG1, MSG3 );
+
+      // rounds 32-35
+      E0 = _mm_sha1nexte_epu32( E0, MSG0 );
+      E1 = ABCD;
+      MSG1 = _mm_sha1msg2_epu32( MSG1, MSG0 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 1 );
+      MSG3 = _mm_sha1msg1_epu32( MSG3, MSG0 );
+      MSG2 = _mm_xor_si128( MSG2, MSG0 );
+
+      // rounds 36-39
+      E1 = _mm_sha1nexte_epu32( E1, MSG1 );
+      E0 = ABCD;
+      MSG2 = _mm_sha1msg2_epu32( MSG2, MSG1 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 1 );
+      MSG0 = _mm_sha1msg1_epu32( MSG0, MSG1 );
+      MSG3 = _mm_xor_si128( MSG3, MSG1 );
+
+      // rounds 40-43
+      E0 = _mm_sha1nexte_epu32( E0, MSG2 );
+      E1 = ABCD;
+      MSG3 = _mm_sha1msg2_epu32( MSG3, MSG2 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 2 );
+      MSG1 = _mm_sha1msg1_epu32( MSG1, MSG2 );
+      MSG0 = _mm_xor_si128( MSG0, MSG2 );
+
+      // rounds 44-47
+      E1 = _mm_sha1nexte_epu32( E1, MSG3 );
+      E0 = ABCD;
+      MSG0 = _mm_sha1msg2_epu32( MSG0, MSG3 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 2 );
+      MSG2 = _mm_sha1msg1_epu32( MSG2, MSG3 );
+      MSG1 = _mm_xor_si128( MSG1, MSG3 );
+
+      // rounds 48-51
+      E0 = _mm_sha1nexte_epu32( E0, MSG0 );
+      E1 = ABCD;
+      MSG1 = _mm_sha1msg2_epu32( MSG1, MSG0 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 2 );
+      MSG3 = _mm_sha1msg1_epu32( MSG3, MSG0 );
+      MSG2 = _mm_xor_si128( MSG2, MSG0 );
+
+      // rounds 52-55
+      E1 = _mm_sha1nexte_epu32( E1, MSG1 );
+      E0 = ABCD;
+      MSG2 = _mm_sha1msg2_epu32( MSG2, MSG1 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 2 );
+      MSG0 = _mm_sha1msg1_epu32( MSG0, MSG1 );
+      MSG3 = _mm_xor_si128( MSG3, MSG1 );
+
+      // rounds 56-59
+      E0 = _mm_sha1nexte_epu32( E0, MSG2 );
+      E1 = ABCD;
+      MSG3 = _mm_sha1msg2_epu32( MSG3, MSG2 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 2 );
+      MSG1 = _mm_sha1msg1_epu32( MSG1, MSG2 );
+      MSG0 = _mm_xor_si128( MSG0, MSG2 );
+
+      // rounds 60-63
+      E1 = _mm_sha1nexte_epu32( E1, MSG3 );
+      E0 = ABCD;
+      MSG0 = _mm_sha1msg2_epu32( MSG0, MSG3 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 3 );
+      MSG2 = _mm_sha1msg1_epu32( MSG2, MSG3 );
+      MSG1 = _mm_xor_si128( MSG1, MSG3 );
+
+      // rounds 64-67
+      E0 = _mm_sha1nexte_epu32( E0, MSG0 );
+      E1 = ABCD;
+      MSG1 = _mm_sha1msg2_epu32( MSG1, MSG0 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 3 );
+      MSG3 = _mm_sha1msg1_epu32( MSG3, MSG0 );
+      MSG2 = _mm_xor_si128( MSG2, MSG0 );
+
+      // rounds 68-71
+      E1 = _mm_sha1nexte_epu32( E1, MSG1 );
+      E0 = ABCD;
+      MSG2 = _mm_sha1msg2_epu32( MSG2, MSG1 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 3 );
+      MSG3 = _mm_xor_si128( MSG3, MSG1 );
+
+      // rounds 72-75
+      E0 = _mm_sha1nexte_epu32( E0, MSG2 );
+      E1 = ABCD;
+      MSG3 = _mm_sha1msg2_epu32( MSG3, MSG2 );
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E0, 3 );
+
+      // rounds 76-79
+      E1 = _mm_sha1nexte_epu32( E1, MSG3 );
+      E0 = ABCD;
+      ABCD = _mm_sha1rnds4_epu32( ABCD, E1, 3 );
+
+      E0 = _mm_sha1nexte_epu32( E0, E0_SAVE );
+      ABCD = _mm_add_epi32( ABCD, ABCD_SAVE );
+    }
+
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( H ), _mm_shuffle_epi32( ABCD, 0x1B ) );
+    H[4] = static_cast<unsigned>( _mm_extract_epi32( E0, 3 ) );
+  }
+
+  static inline __attribute__(( target( "ssse3" ) )) __m128i rolv( __m128i x, int bits )
+  {
+    return _mm_or_si128( _mm_slli_epi32( x, bits ), _mm_srli_epi32( x, 32 - bits ) );
+  }
+
+  // The scalar rounds, but with the message schedule computed four words at a time.
+  __attribute__(( target( "ssse3" ) ))
+  static void compressSSSE3( unsigned* H, const unsigned char* data, unsigned blocks )
+  {
+    const __m128i MASK = _mm_set_epi8( 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3 );
+    __m128i W[20];
+    unsigned WK[80];
+    for( ; blocks; --blocks, data += 64 )
+    {
+      const unsigned* w = reinterpret_cast<const unsigned*>( W );
+      for( int i = 0; i < 4; ++i )
+        W[i] = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + i * 16 ) ), MASK );
+
+      // W[t] = rol( W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16], 1 ), where the last lane needs W[t]
+      // from the first one
+      for( int i = 4; i < 8; ++i )
+      {
+        __m128i x = _mm_srli_si128( W[i-1], 4 );
+        x = _mm_xor_si128( x, _mm_loadu_si128( reinterpret_cast<const __m128i*>( w + i * 4 - 8 ) ) );
+        x = _mm_xor_si128( x, _mm_loadu_si128( reinterpret_cast<const __m128i*>( w + i * 4 - 14 ) ) );
+        x = _mm_xor_si128( x, W[i-4] );
+        x = rolv( x, 1 );
+        W[i] = _mm_xor_si128( x, rolv( _mm_slli_si128( x, 12 ), 1 ) );
+      }
+
+      // from t = 32 on: W[t] = rol( W[t-6] ^ W[t-16] ^ W[t-28] ^ W[t-32], 2 )
+      for( int i = 8; i < 20; ++i )
+      {
+        __m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( w + i * 4 - 6 ) );
+        x = _mm_xor_si128( x, W[i-4] );
+        x = _mm_xor_si128( x, W[i-7] );
+        x = _mm_xor_si128( x, W[i-8] );
+        W[i] = rolv( x, 2 );
+      }
+
+      for( int i = 0; i < 20; ++i )
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( WK + i * 4 ),
+                          _mm_add_epi32( W[i], _mm_set1_epi32( static_cast<int>( K[i / 5] ) ) ) );
+
+      rounds( H, WK );
+    }
+  }
+
+  static CompressFunc resolveCompress()
+  {
+    unsigned eax, ebx, ecx, edx;
+    if( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) || !( ecx & bit_SSSE3 ) )
+      return compressScalar;
+
+    const bool sse41 = ( ecx & bit_SSE4_1 ) != 0;
+    if( sse41 && __get_cpuid_max( 0, 0 ) >= 7 )
+    {
+      __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+      if( ebx & ( 1u << 29 ) ) // SHA
+        return compressSHANI;
+    }
+
+    return compressSSSE3;
+  }
+#else
+  static CompressFunc resolveCompress()
+  {
+    return compressScalar;
+  }
+#endif
+
+  static void compress( unsigned* H, const unsigned char* data, unsigned blocks = 1 )
+  {
+    static const CompressFunc compressBlocks = resolveCompress();
+    compressBlocks( H, data, blocks );
+  }
+
+  static inline void store( const unsigned* H, unsigned char* digest )
+  {
+    for( int i = 0; i < 20; ++i )
+      digest[i] = static_cast<unsigned char>( H[i >> 2] >> ( ( 3 - ( i & 3 ) ) << 3 ) );
+  }
+
+  // the HMAC key, padded (or hashed) to the block size
+  static void hmacKey( const std::string& key, unsigned char* k )
+  {
+    memset( k, 0, 64 );
+    if( key.length() > 64 )
+    {
+      SHA sha;
+      sha.feed( key );
+      memcpy( k, sha.binary().data(), 20 );
+    }
+    else
+      memcpy( k, key.data(), key.length() );
+  }
+
+  // the states after hashing the inner and the outer pad of an HMAC key
+  static void hmacPads( const std::string& key, unsigned* inner, unsigned* outer )
+  {
+    unsigned char k[64];
+    hmacKey( key, k );
+
+    unsigned char block[64];
+    for( int i = 0; i < 64; ++i )
+      block[i] = static_cast<unsigned char>( k[i] ^ 0x36 );
+    memcpy( inner, IV, sizeof( IV ) );
+    compress( inner, block );
+
+    for( int i = 0; i < 64; ++i )
+      block[i] = static_cast<unsigned char>( k[i] ^ 0x5c );
+    memcpy( outer, IV, sizeof( IV ) );
+    compress( outer, block );
+  }
+
+  // HMAC of a 20 byte message, given the pad states. The message is a single, padded block
+  // following the key's block, i.e. 84 bytes (672 bits) in total, for both hashes.
+  static void hmacDigest( const unsigned* inner, const unsigned* outer, unsigned char* digest )
+  {
+    unsigned char block[64];
+    memset( block + 20, 0, 44 );
+    block[20] = 0x80;
+    block[62] = 0x02;
+    block[63] = 0xA0;
+
+    unsigned H[5];
+    memcpy( block, digest, 20 );
+    memcpy( H, inner, sizeof( H ) );
+    compress( H, block );
+
+    store( H, block );
+    memcpy( H, outer, sizeof( H ) );
+    compress( H, block );
+    store( H, digest );
+  }
+
   SHA::SHA()
   {
     init();
@@ -35,11 +461,7 @@ namespace gloox
     Length_High = 0;
     Message_Block_Index = 0;
 
-    H[0] = 0x67452301;
-    H[1] = 0xEFCDAB89;
-    H[2] = 0x98BADCFE;
-    H[3] = 0x10325476;
-    H[4] = 0xC3D2E1F0;
+    memcpy( H, IV, sizeof( IV ) );
 
     m_finished = false;
     m_corrupted = false;
@@ -58,9 +480,15 @@ namespace gloox
     if( !m_finished )
       finalize();
 
-    char buf[41];
+    static const char hexDigits[] = "0123456789abcdef";
+    unsigned char digest[20];
+    store( H, digest );
+    char buf[40];
     for( int i = 0; i < 20; ++i )
-      sprintf( buf + i * 2, "%02x", static_cast<unsigned char>( H[i >> 2] >> ( ( 3 - ( i & 3 ) ) << 3 ) ) );
+    {
+      buf[i * 2] = hexDigits[digest[i] >> 4];
+      buf[i * 2 + 1] = hexDigits[digest[i] & 0x0f];
+    }
 
     return std::string( buf, 40 );
   }
@@ -71,8 +499,7 @@ namespace gloox
       finalize();
 
     unsigned char digest[20];
-    for( int i = 0; i < 20; ++i )
-      digest[i] = static_cast<unsigned char>( H[i >> 2] >> ( ( 3 - ( i & 3 ) ) << 3 ) );
+    store( H, digest );
 
     return std::string( reinterpret_cast<char*>( digest ), 20 );
   }
@@ -97,29 +524,39 @@ namespace gloox
       return;
     }
 
-    while( length-- && !m_corrupted )
+    const unsigned long long bits = ( static_cast<unsigned long long>( Length_High ) << 32 | Length_Low )
+                                    + static_cast<unsigned long long>( length ) * 8;
+    if( bits >> 32 < Length_High )
     {
-      Message_Block[Message_Block_Index++] = ( *data & 0xFF );
-
-      Length_Low += 8;
-      Length_Low &= 0xFFFFFFFF;
-      if( Length_Low == 0 )
-      {
-        Length_High++;
-        Length_High &= 0xFFFFFFFF;
-        if( Length_High == 0 )
-        {
-          m_corrupted = true;
-        }
-      }
+      m_corrupted = true;
+      return;
+    }
+    Length_Low = static_cast<unsigned>( bits & 0xFFFFFFFF );
+    Length_High = static_cast<unsigned>( bits >> 32 );
 
-      if( Message_Block_Index == 64 )
-      {
-        process();
-      }
+    if( Message_Block_Index )
+    {
+      unsigned n = 64 - static_cast<unsigned>( Message_Block_Index );
+      if( n > length )
+        n = length;
+      memcpy( Message_Block + Message_Block_Index, data, n );
+      Message_Block_Index += static_cast<int>( n );
+      data += n;
+      length -= n;
+      if( Message_Block_Index < 64 )
+        return;
+      process();
+    }
 
-      ++data;
+    if( length >= 64 )
+    {
+      compress( H, data, length / 64 );
+      data += length & ~63u;
+      length &= 63;
     }
+
+    memcpy( Message_Block, data, length );
+    Message_Block_Index = static_cast<int>( length );
   }
 
   void SHA::feed( const std::string& data )
@@ -129,85 +566,7 @@ namespace gloox
 
   void SHA::process()
   {
-    const unsigned K[] = { 0x5A827999,
-                           0x6ED9EBA1,
-                           0x8F1BBCDC,
-                           0xCA62C1D6
-                          };
-    int t;
-    unsigned temp;
-    unsigned W[80];
-    unsigned A, B, C, D, E;
-
-    for( t = 0; t < 16; t++ )
-    {
-      W[t] =  static_cast<unsigned int>( Message_Block[t * 4] ) << 24;
-      W[t] |= static_cast<unsigned int>( Message_Block[t * 4 + 1] ) << 16;
-      W[t] |= static_cast<unsigned int>( Message_Block[t * 4 + 2] ) << 8;
-      W[t] |= static_cast<unsigned int>( Message_Block[t * 4 + 3] );
-    }
-
-    for( t = 16; t < 80; ++t )
-    {
-      W[t] = shift( 1, W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16] );
-    }
-
-    A = H[0];
-    B = H[1];
-    C = H[2];
-    D = H[3];
-    E = H[4];
-
-    for( t = 0; t < 20; ++t )
-    {
-      temp = shift( 5, A ) + ( ( B & C ) | ( ( ~B ) & D ) ) + E + W[t] + K[0];
-      temp &= 0xFFFFFFFF;
-      E = D;
-      D = C;
-      C = shift( 30, B );
-      B = A;
-      A = temp;
-    }
-
-    for( t = 20; t < 40; ++t )
-    {
-      temp = shift( 5, A ) + ( B ^ C ^ D ) + E + W[t] + K[1];
-      temp &= 0xFFFFFFFF;
-      E = D;
-      D = C;
-      C = shift( 30, B );
-      B = A;
-      A = temp;
-    }
-
-    for( t = 40; t < 60; ++t )
-    {
-      temp = shift( 5, A ) + ( ( B & C ) | ( B & D ) | ( C & D ) ) + E + W[t] + K[2];
-      temp &= 0xFFFFFFFF;
-      E = D;
-      D = C;
-      C = shift( 30, B );
-      B = A;
-      A = temp;
-    }
-
-    for( t = 60; t < 80; ++t )
-    {
-      temp = shift( 5, A ) + ( B ^ C ^ D ) + E + W[t] + K[3];
-      temp &= 0xFFFFFFFF;
-      E = D;
-      D = C;
-      C = shift( 30, B );
-      B = A;
-      A = temp;
-    }
-
-    H[0] = ( H[0] + A ) & 0xFFFFFFFF;
-    H[1] = ( H[1] + B ) & 0xFFFFFFFF;
-    H[2] = ( H[2] + C ) & 0xFFFFFFFF;
-    H[3] = ( H[3] + D ) & 0xFFFFFFFF;
-    H[4] = ( H[4] + E ) & 0xFFFFFFFF;
-
+    compress( H, Message_Block );
     Message_Block_Index = 0;
   }
 
@@ -242,16 +601,60 @@ namespace gloox
     process();
   }
 
-  unsigned SHA::shift( int bits, unsigned word )
+  const std::string SHA::hex( const std::string& data )
   {
-    return ( ( word << bits ) & 0xFFFFFFFF) | ( ( word & 0xFFFFFFFF ) >> ( 32-bits ) );
+    SHA sha;
+    sha.feed( data );
+    return sha.hex();
   }
 
-  const std::string SHA::hex( const std::string& data )
+  const std::string SHA::hmac( const std::string& key, const std::string& data )
   {
+    unsigned char k[64];
+    hmacKey( key, k );
+
+    unsigned char pad[64];
+    for( int i = 0; i < 64; ++i )
+      pad[i] = static_cast<unsigned char>( k[i] ^ 0x36 );
     SHA sha;
+    sha.feed( pad, 64 );
     sha.feed( data );
-    return sha.hex();
+    const std::string inner = sha.binary();
+
+    for( int i = 0; i < 64; ++i )
+      pad[i] = static_cast<unsigned char>( k[i] ^ 0x5c );
+    sha.reset();
+    sha.feed( pad, 64 );
+    sha.feed( inner );
+    return sha.binary();
+  }
+
+  const std::string SHA::pbkdf2( const std::string& password, const std::string& salt, int iterations )
+  {
+    unsigned char result[20];
+    memset( result, 0, sizeof( result ) );
+    if( iterations <= 0 )
+      return std::string( reinterpret_cast<char*>( result ), 20 );
+
+    unsigned inner[5];
+    unsigned outer[5];
+    hmacPads( password, inner, outer );
+
+    // U1 = HMAC( password, salt + INT( 1 ) )
+    std::string s = salt;
+    s.append( "\0\0\0\1", 4 );
+    unsigned char u[20];
+    memcpy( u, hmac( password, s ).data(), 20 );
+    memcpy( result, u, 20 );
+
+    for( int i = 1; i < iterations; ++i )
+    {
+      hmacDigest( inner, outer, u );
+      for( int j = 0; j < 20; ++j )
+        result[j] ^= u[j];
+    }
+
+    return std::string( reinterpret_cast<char*>( result ), 20 );
   }
 
 }
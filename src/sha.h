@@ -23,6 +23,9 @@ namespace gloox
   /**
    * @brief An implementation of SHA1.
    *
+   * On x86 CPUs the compression function uses the SHA extensions (SHA-NI) or, failing that,
+   * computes the message schedule with SSSE3. Support is detected at runtime.
+   *
    * @author Jakob Schröter <js@camaya.net>
    * @since 0.9
    */
@@ -85,10 +88,32 @@ namespace gloox
        */
       static const std::string hex( const std::string& data );
 
+      /**
+       * Computes an HMAC-SHA1 (RFC 2104).
+       * @param key The key.
+       * @param data The data to authenticate.
+       * @return The raw binary MAC (20 bytes).
+       * @since 1.1
+       */
+      static const std::string hmac( const std::string& key, const std::string& data );
+
+      /**
+       * Derives a key using PBKDF2 with HMAC-SHA1 (RFC 2898), with an output length of one
+       * hash. This is the Hi() function of SCRAM-SHA-1 (RFC 5802).
+       * The pads of the key are hashed only once, and the iterations work on fixed-size
+       * buffers.
+       * @param password The password.
+       * @param salt The salt.
+       * @param iterations The iteration count.
+       * @return The raw binary key (20 bytes).
+       * @since 1.1
+       */
+      static const std::string pbkdf2( const std::string& password, const std::string& salt,
+                                       int iterations );
+
     private:
       void process();
       void pad();
-      inline unsigned shift( int bits, unsigned word );
       void init();
 
       unsigned H[5];
@@ -0,0 +1,244 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef SMALLVECTOR_H__
+#define SMALLVECTOR_H__
+
+#include "tagarena.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace gloox
+{
+
+  /**
+   * @brief A contiguous container with inline storage for the first @c N elements.
+   *
+   * SmallVector stores up to @c N elements inside the object itself and only allocates
+   * (using TagArena::allocate(), i.e. from the active TagArena, if any) when it grows
+   * beyond that. It offers the subset of the std::list interface used for Tag's
+   * attribute and node lists, so that code iterating these lists keeps compiling.
+   *
+   * Unlike std::list, insert() and erase() invalidate iterators to the following elements.
+   * Use the iterator returned by erase() to continue an iteration.
+   *
+   * @note @c T must be a trivial type, e.g. a pointer.
+   *
+   * @author Jakob Schröter <js@camaya.net>
+   * @since 1.1
+   */
+  template<typename T, unsigned N>
+  class SmallVector
+  {
+    public:
+      typedef T value_type;
+      typedef T* iterator;
+      typedef const T* const_iterator;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef std::size_t size_type;
+
+      /**
+       * Creates an empty SmallVector.
+       */
+      SmallVector() : m_data( m_inline ), m_size( 0 ), m_capacity( N ) {}
+
+      /**
+       * Copy constructor.
+       * @param right The SmallVector to copy.
+       */
+      SmallVector( const SmallVector& right )
+        : m_data( m_inline ), m_size( 0 ), m_capacity( N )
+      {
+        *this = right;
+      }
+
+      /**
+       * Destructor.
+       */
+      ~SmallVector() { release(); }
+
+      /**
+       * Assignment operator.
+       * @param right The SmallVector to copy.
+       * @return A reference to this SmallVector.
+       */
+      SmallVector& operator=( const SmallVector& right )
+      {
+        if( this == &right )
+          return *this;
+
+        m_size = 0;
+        reserve( right.m_size );
+        std::copy( right.begin(), right.end(), m_data );
+        m_size = right.m_size;
+        return *this;
+      }
+
+      /**
+       * Swaps the contents of two SmallVectors.
+       * @param right The SmallVector to swap contents with.
+       */
+      void swap( SmallVector& right )
+      {
+        if( m_data != m_inline && right.m_data != right.m_inline )
+        {
+          std::swap( m_data, right.m_data );
+          std::swap( m_size, right.m_size );
+          std::swap( m_capacity, right.m_capacity );
+          return;
+        }
+
+        SmallVector tmp( *this );
+        *this = right;
+        right = tmp;
+      }
+
+      iterator begin() { return m_data; }
+      const_iterator begin() const { return m_data; }
+      iterator end() { return m_data + m_size; }
+      const_iterator end() const { return m_data + m_size; }
+
+      size_type size() const { return m_size; }
+      bool empty() const { return m_size == 0; }
+
+      reference front() { return m_data[0]; }
+      const_reference front() const { return m_data[0]; }
+      reference back() { return m_data[m_size - 1]; }
+      const_reference back() const { return m_data[m_size - 1]; }
+
+      reference operator[]( size_type i ) { return m_data[i]; }
+      const_reference operator[]( size_type i ) const { return m_data[i]; }
+
+      /**
+       * Appends an element.
+       * @param value The element to append.
+       */
+      void push_back( const T& value )
+      {
+        if( m_size == m_capacity )
+          grow( m_capacity * 2 );
+        m_data[m_size++] = value;
+      }
+
+      /**
+       * Prepends an element.
+       * @param value The element to prepend.
+       */
+      void push_front( const T& value ) { insert( begin(), value ); }
+
+      /**
+       * Removes the last element.
+       */
+      void pop_back() { --m_size; }
+
+      /**
+       * Removes the first element.
+       */
+      void pop_front() { erase( begin() ); }
+
+      /**
+       * Inserts an element before the given position.
+       * @param pos The position to insert before.
+       * @param value The element to insert.
+       * @return An iterator pointing to the inserted element.
+       */
+      iterator insert( iterator pos, const T& value )
+      {
+        const size_type i = pos - m_data;
+        if( m_size == m_capacity )
+          grow( m_capacity * 2 );
+        std::copy_backward( m_data + i, m_data + m_size, m_data + m_size + 1 );
+        m_data[i] = value;
+        ++m_size;
+        return m_data + i;
+      }
+
+      /**
+       * Removes the element at the given position.
+       * @param pos The element to remove.
+       * @return An iterator pointing to the element following the removed one.
+       */
+      iterator erase( iterator pos )
+      {
+        std::copy( pos + 1, end(), pos );
+        --m_size;
+        return pos;
+      }
+
+      /**
+       * Removes all elements equal to @c value.
+       * @param value The value to remove.
+       */
+      void remove( const T& value )
+      {
+        m_size = std::remove( begin(), end(), value ) - m_data;
+      }
+
+      /**
+       * Removes all elements. Allocated memory is kept.
+       */
+      void clear() { m_size = 0; }
+
+      /**
+       * Makes sure at least @c capacity elements fit without further allocations.
+       * @param capacity The number of elements to reserve memory for.
+       */
+      void reserve( size_type capacity )
+      {
+        if( capacity > m_capacity )
+          grow( capacity );
+      }
+
+      /**
+       * Moves the elements back to the inline storage and frees allocated memory, if the
+       * current elements fit.
+       */
+      void shrink_to_fit()
+      {
+        if( m_data == m_inline || m_size > N )
+          return;
+
+        std::copy( m_data, m_data + m_size, m_inline );
+        release();
+        m_data = m_inline;
+        m_capacity = N;
+      }
+
+    private:
+      void grow( size_type capacity )
+      {
+        T* data = static_cast<T*>( TagArena::allocate( capacity * sizeof( T ) ) );
+        std::copy( m_data, m_data + m_size, data );
+        release();
+        m_data = data;
+        m_capacity = capacity;
+      }
+
+      void release()
+      {
+        if( m_data != m_inline )
+          TagArena::deallocate( m_data );
+      }
+
+      T* m_data;
+      size_type m_size;
+      size_type m_capacity;
+      T m_inline[N];
+
+  };
+
+}
+
+#endif // SMALLVECTOR_H__
@@ -20,6 +20,8 @@
 #include "stanzaextension.h"
 #include "tag.h"
 
+#include <algorithm>
+
 namespace gloox
 {
 
@@ -52,6 +54,7 @@ namespace gloox
       }
     }
     m_extensions.push_back( ext );
+    rebuildIndex();
   }
 
   bool StanzaExtensionFactory::removeExtension( int ext )
@@ -64,33 +67,236 @@ namespace gloox
       {
         delete (*it);
         m_extensions.erase( it );
+        rebuildIndex();
         return true;
       }
     }
     return false;
   }
 
-  void StanzaExtensionFactory::addExtensions( Stanza& stanza, Tag* tag )
+  void StanzaExtensionFactory::rebuildIndex()
   {
-    ConstTagList::const_iterator it;
+    m_filters.clear();
+    m_childIndex.clear();
+    m_unindexed.clear();
 
-    util::MutexGuard m( m_extensionsMutex );
-    SEList::const_iterator ite = m_extensions.begin();
-    for( ; ite != m_extensions.end(); ++ite )
+    SEList::const_iterator it = m_extensions.begin();
+    for( ; it != m_extensions.end(); ++it )
+      compileFilter( (*it) );
+  }
+
+  static bool isNameChar( const char c )
+  {
+    return c != '/' && c != '[' && c != ']' && c != '|' && c != '@' && c != '\''
+           && c != '(' && c != ')' && c != '=' && c != '<' && c != '>' && c != '+'
+           && c != '.' && c != ' ';
+  }
+
+  static std::string::size_type readName( const std::string& expr, std::string::size_type pos,
+                                          std::string& name )
+  {
+    std::string::size_type start = pos;
+    if( pos < expr.length() && expr[pos] == '*' )
+      ++pos;
+    else
+      while( pos < expr.length() && isNameChar( expr[pos] ) && expr[pos] != '*' )
+        ++pos;
+
+    name = expr.substr( start, pos - start );
+    return pos;
+  }
+
+  void StanzaExtensionFactory::compileFilter( const StanzaExtension* ext )
+  {
+    const std::string& filter = ext->filterString();
+
+    // split into top-level alternatives
+    std::string::size_type start = 0;
+    int depth = 0;
+    bool literal = false;
+    for( std::string::size_type i = 0; i <= filter.length(); ++i )
     {
-      const ConstTagList& match = tag->findTagList( (*ite)->filterString() );
-      it = match.begin();
-      for( ; it != match.end(); ++it )
+      if( i < filter.length() )
+      {
+        const char c = filter[i];
+        if( c == '\'' )
+          literal = !literal;
+        else if( !literal && ( c == '[' || c == '(' ) )
+          ++depth;
+        else if( !literal && ( c == ']' || c == ')' ) )
+          --depth;
+
+        if( literal || depth || c != '|' )
+          continue;
+      }
+
+      if( i == start )
       {
-        StanzaExtension* se = (*ite)->newInstance( (*it) );
-        if( se )
+        start = i + 1;
+        continue;
+      }
+
+      Filter f( ext, filter.substr( start, i - start ) );
+      start = i + 1;
+
+      // only alternatives of the form /root/child[@xmlns='...']... can be indexed
+      std::string child;
+      std::string xmlns;
+      const std::string& e = f.xpath.expression();
+      std::string::size_type pos = 0;
+      if( e.length() > 2 && e[0] == '/' && e[1] != '/' )
+      {
+        pos = readName( e, 1, f.root );
+        if( !f.root.empty() && pos < e.length() && e[pos] == '/' )
+        {
+          pos = readName( e, pos + 1, child );
+          f.indexed = !child.empty() && child.find_first_not_of( "0123456789" ) != std::string::npos;
+        }
+      }
+
+      if( f.indexed )
+      {
+        static const std::string xmlnsPredicate = "[@" + XMLNS + "='";
+        if( e.compare( pos, xmlnsPredicate.length(), xmlnsPredicate ) == 0 )
         {
-          stanza.addExtension( se );
-          if( se->embeddedStanza() )
-            stanza.setEmbeddedStanza();
+          std::string::size_type end = e.find( '\'', pos + xmlnsPredicate.length() );
+          if( end != std::string::npos && end + 1 < e.length() && e[end + 1] == ']'
+              && e.find( '\\', pos ) > end )
+          {
+            xmlns = e.substr( pos + xmlnsPredicate.length(), end - pos - xmlnsPredicate.length() );
+            pos = end + 2;
+          }
         }
+        f.simple = ( pos == e.length() );
+      }
+
+      const unsigned idx = static_cast<unsigned>( m_filters.size() );
+      m_filters.push_back( f );
+      if( f.indexed )
+        m_childIndex[child][xmlns].push_back( idx );
+      else
+        m_unindexed.push_back( idx );
+    }
+  }
+
+  void StanzaExtensionFactory::addMatches( const FilterIndexList& fl, const Tag* root,
+                                           const Tag* child,
+                                           std::map<unsigned, ConstTagList>& matches ) const
+  {
+    FilterIndexList::const_iterator it = fl.begin();
+    for( ; it != fl.end(); ++it )
+    {
+      const Filter& f = m_filters[(*it)];
+      if( f.root != root->name() && f.root != "*" )
+        continue;
+
+      ConstTagList& match = matches[(*it)];
+      if( f.simple )
+        match.push_back( child );
+    }
+  }
+
+  void StanzaExtensionFactory::addMatches( const XmlnsIndex& xi, const Tag* root,
+                                           const Tag* child,
+                                           std::map<unsigned, ConstTagList>& matches ) const
+  {
+    const std::string& xmlns = child->findAttribute( XMLNS );
+    XmlnsIndex::const_iterator it = xi.find( xmlns );
+    if( it != xi.end() )
+      addMatches( (*it).second, root, child, matches );
+
+    if( xmlns.empty() )
+      return;
+
+    it = xi.find( EmptyString );
+    if( it != xi.end() )
+      addMatches( (*it).second, root, child, matches );
+  }
+
+  static void addUnique( ConstTagList& one, const ConstTagList& two )
+  {
+    ConstTagList::const_iterator it = two.begin();
+    for( ; it != two.end(); ++it )
+      if( std::find( one.begin(), one.end(), (*it) ) == one.end() )
+        one.push_back( (*it) );
+  }
+
+  void StanzaExtensionFactory::createExtensions( Stanza& stanza, const StanzaExtension* ext,
+                                                 const ConstTagList& match ) const
+  {
+    ConstTagList::const_iterator it = match.begin();
+    for( ; it != match.end(); ++it )
+    {
+      StanzaExtension* se = ext->newInstance( (*it) );
+      if( se )
+      {
+        stanza.addExtension( se );
+        if( se->embeddedStanza() )
+          stanza.setEmbeddedStanza();
       }
     }
   }
 
+  void StanzaExtensionFactory::addExtensions( Stanza& stanza, Tag* tag )
+  {
+    if( !tag )
+      return;
+
+    util::MutexGuard m( m_extensionsMutex );
+
+    if( tag->parent() )
+    {
+      // absolute expressions would be evaluated against the document root
+      SEList::const_iterator ite = m_extensions.begin();
+      for( ; ite != m_extensions.end(); ++ite )
+        createExtensions( stanza, (*ite), tag->findTagList( (*ite)->filterString() ) );
+      return;
+    }
+
+    // filter index -> matched tags, ordered by registration and alternative
+    std::map<unsigned, ConstTagList> matches;
+
+    FilterIndexList::const_iterator itu = m_unindexed.begin();
+    for( ; itu != m_unindexed.end(); ++itu )
+      matches[(*itu)];
+
+    const ChildIndex::const_iterator wildcard = m_childIndex.find( "*" );
+    const Tag::NodeList& nodes = tag->nodes();
+    Tag::NodeList::const_iterator itc = nodes.begin();
+    for( ; itc != nodes.end(); ++itc )
+    {
+      if( (*itc)->type != Tag::TypeTag )
+        continue;
+
+      const Tag* child = (*itc)->tag;
+      ChildIndex::const_iterator it = m_childIndex.find( child->name() );
+      if( it != m_childIndex.end() && it != wildcard )
+        addMatches( (*it).second, tag, child, matches );
+      if( wildcard != m_childIndex.end() )
+        addMatches( (*wildcard).second, tag, child, matches );
+    }
+
+    const StanzaExtension* current = 0;
+    ConstTagList result;
+    std::map<unsigned, ConstTagList>::const_iterator itm = matches.begin();
+    for( ; itm != matches.end(); ++itm )
+    {
+      const Filter& f = m_filters[(*itm).first];
+      if( f.ext != current )
+      {
+        if( current )
+          createExtensions( stanza, current, result );
+        current = f.ext;
+        result.clear();
+      }
+
+      if( f.simple )
+        addUnique( result, (*itm).second );
+      else
+        addUnique( result, tag->findTagList( f.xpath ) );
+    }
+    if( current )
+      createExtensions( stanza, current, result );
+  }
+
 }
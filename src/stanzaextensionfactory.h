@@ -15,13 +15,16 @@
 #define STANZAEXTENSIONFACTORY_H__
 
 #include "mutex.h"
+#include "tag.h"
 
 #include <list>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace gloox
 {
 
-  class Tag;
   class Stanza;
   class StanzaExtension;
 
@@ -82,8 +85,44 @@ namespace gloox
       void addExtensions( Stanza& stanza, Tag* tag );
 
     private:
+      /**
+       * A single, '|'-separated alternative of an extension's filter string, compiled
+       * at registration time.
+       */
+      struct Filter
+      {
+        Filter( const StanzaExtension* _ext, const std::string& expression )
+          : ext( _ext ), xpath( expression ), indexed( false ), simple( false ) {}
+
+        const StanzaExtension* ext;   /**< The extension this alternative belongs to. */
+        Tag::XPath xpath;             /**< The alternative's compiled XPath expression. */
+        std::string root;             /**< The expected stanza element name (or '*'). */
+        bool indexed;                 /**< Whether the alternative is reachable through the
+                                       * child index, i.e. starts with /root/child. */
+        bool simple;                  /**< Whether the alternative is exactly
+                                       * /root/child[\@xmlns='...'] and matches the indexed
+                                       * child itself, without evaluating the expression. */
+      };
+
+      typedef std::vector<Filter> FilterList;
+      typedef std::vector<unsigned> FilterIndexList;
+      typedef std::map<std::string, FilterIndexList> XmlnsIndex;
+      typedef std::map<std::string, XmlnsIndex> ChildIndex;
+
+      void rebuildIndex();
+      void compileFilter( const StanzaExtension* ext );
+      void addMatches( const XmlnsIndex& xi, const Tag* root, const Tag* child,
+                       std::map<unsigned, ConstTagList>& matches ) const;
+      void addMatches( const FilterIndexList& fl, const Tag* root, const Tag* child,
+                       std::map<unsigned, ConstTagList>& matches ) const;
+      void createExtensions( Stanza& stanza, const StanzaExtension* ext,
+                             const ConstTagList& match ) const;
+
       typedef std::list<StanzaExtension*> SEList;
       SEList m_extensions;
+      FilterList m_filters;
+      ChildIndex m_childIndex;
+      FilterIndexList m_unindexed;
       util::Mutex m_extensionsMutex;
 
   };
@@ -34,7 +34,8 @@ namespace gloox
 
     m_subtype = static_cast<S10nType>( util::lookup( tag->findAttribute( TYPE ), msgTypeStringValues ) );
 
-    const ConstTagList& c = tag->findTagList( "/presence/status" );
+    static const Tag::XPath status( "/presence/status" );
+    const ConstTagList& c = tag->findTagList( status );
     ConstTagList::const_iterator it = c.begin();
     for( ; it != c.end(); ++it )
       setLang( &m_stati, m_status, (*it) );
@@ -18,6 +18,8 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <map>
+#include <vector>
 
 namespace gloox
 {
@@ -115,31 +117,33 @@ namespace gloox
   }
 
   const std::string Tag::Attribute::xml() const
+  {
+    std::string xml;
+    appendXml( xml );
+    return xml;
+  }
+
+  void Tag::Attribute::appendXml( std::string& target ) const
   {
     if( m_name.empty() )
-      return EmptyString;
+      return;
 
-    std::string xml;
-    xml += ' ';
+    target += ' ';
     if( !m_prefix.empty() )
     {
-      xml += m_prefix;
-      xml += ':';
+      target += m_prefix;
+      target += ':';
     }
-    xml += m_name;
-    xml += "='";
-    util::appendEscaped( xml, m_value );
-    xml += '\'';
-
-    return xml;
+    target += m_name;
+    target += "='";
+    util::appendEscaped( target, m_value );
+    target += '\'';
   }
   // ---- ~Tag::Attribute ----
 
   // ---- Tag ----
   Tag::Tag( const std::string& name, const std::string& cdata )
-    : m_parent( 0 ), m_children( 0 ), m_cdata( 0 ),
-      m_attribs( 0 ), m_nodes( 0 ),
-      m_xmlnss( 0 )
+    : m_parent( 0 ), m_children( 0 ), m_xmlnss( 0 )
   {
     addCData( cdata ); // implicitly UTF-8 checked
 
@@ -148,9 +152,7 @@ namespace gloox
   }
 
   Tag::Tag( Tag* parent, const std::string& name, const std::string& cdata )
-    : m_parent( parent ), m_children( 0 ), m_cdata( 0 ),
-      m_attribs( 0 ), m_nodes( 0 ),
-      m_xmlnss( 0 )
+    : m_parent( parent ), m_children( 0 ), m_xmlnss( 0 )
   {
     if( m_parent )
       m_parent->addChild( this );
@@ -164,9 +166,7 @@ namespace gloox
   Tag::Tag( const std::string& name,
             const std::string& attrib,
             const std::string& value )
-    : m_parent( 0 ), m_children( 0 ), m_cdata( 0 ),
-      m_attribs( 0 ), m_nodes( 0 ),
-      m_name( name ), m_xmlnss( 0 )
+    : m_parent( 0 ), m_children( 0 ), m_name( name ), m_xmlnss( 0 )
   {
     addAttribute( attrib, value ); // implicitly UTF-8 checked
 
@@ -177,9 +177,7 @@ namespace gloox
   Tag::Tag( Tag* parent, const std::string& name,
                          const std::string& attrib,
                          const std::string& value )
-    : m_parent( parent ), m_children( 0 ), m_cdata( 0 ),
-      m_attribs( 0 ), m_nodes( 0 ),
-      m_name( name ), m_xmlnss( 0 )
+    : m_parent( parent ), m_children( 0 ), m_name( name ), m_xmlnss( 0 )
   {
     if( m_parent )
       m_parent->addChild( this );
@@ -191,56 +189,47 @@ namespace gloox
   }
 
   Tag::Tag( Tag* tag )
-    : m_parent( 0 ), m_children( 0 ), m_cdata( 0 ), m_attribs( 0 ),
-      m_nodes( 0 ), m_xmlnss( 0 )
+    : m_parent( 0 ), m_children( 0 ), m_xmlnss( 0 )
   {
     if( !tag )
       return;
 
-    m_children = tag->m_children;
-    m_cdata = tag->m_cdata;
-    m_attribs = tag->m_attribs;
-    m_nodes = tag->m_nodes;
+    m_children.store( tag->m_children.exchange( 0 ) );
+    m_attribs.swap( tag->m_attribs );
+    m_nodes.swap( tag->m_nodes );
     m_name = tag->m_name;
     m_xmlns = tag->m_xmlns;
     m_xmlnss = tag->m_xmlnss;
 
-    tag->m_nodes = 0;
-    tag->m_cdata = 0;
-    tag->m_attribs = 0;
-    tag->m_children = 0;
     tag->m_xmlnss = 0;
 
-    if( m_attribs )
-    {
-      AttributeList::iterator it = m_attribs->begin();
-      while( it != m_attribs->end() )
-        (*it++)->m_parent = this;
-    }
+    AttributeList::iterator it = m_attribs.begin();
+    for( ; it != m_attribs.end(); ++it )
+      (*it)->m_parent = this;
 
-    if( m_children )
+    NodeList::iterator itn = m_nodes.begin();
+    for( ; itn != m_nodes.end(); ++itn )
     {
-      TagList::iterator it = m_children->begin();
-      while( it != m_children->end() )
-        (*it++)->m_parent = this;
+      if( (*itn)->type == TypeTag )
+        (*itn)->tag->m_parent = this;
     }
   }
 
   Tag::~Tag()
   {
-    if( m_cdata )
-      util::clearList( *m_cdata );
-    if( m_attribs )
-      util::clearList( *m_attribs );
-    if( m_children )
-      util::clearList( *m_children );
-    if( m_nodes )
-      util::clearList( *m_nodes );
-
-    delete m_cdata;
-    delete m_attribs;
-    delete m_children;
-    delete m_nodes;
+    util::clearList( m_attribs );
+
+    NodeList::iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type == TypeTag )
+        delete (*it)->tag;
+      else
+        TagArena::destroy( (*it)->str );
+      delete (*it);
+    }
+
+    delete m_children.load();
     delete m_xmlnss;
 
     m_parent = 0;
@@ -251,104 +240,84 @@ namespace gloox
     if( m_name != right.m_name || m_xmlns != right.m_xmlns )
       return false;
 
-    if( m_cdata && right.m_cdata )
-    {
-      StringPList::const_iterator ct = m_cdata->begin();
-      StringPList::const_iterator ct_r = right.m_cdata->begin();
-      while( ct != m_cdata->end() && ct_r != right.m_cdata->end() && *(*ct) == *(*ct_r) )
-      {
-        ++ct;
-        ++ct_r;
-      }
-      if( ct != m_cdata->end() )
-        return false;
-    }
-    else if( m_cdata || right.m_cdata )
+    if( m_nodes.size() != right.m_nodes.size() || m_attribs.size() != right.m_attribs.size() )
       return false;
 
-    if( m_children && right.m_children )
+    NodeList::const_iterator it = m_nodes.begin();
+    NodeList::const_iterator it_r = right.m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it, ++it_r )
     {
-      TagList::const_iterator it = m_children->begin();
-      TagList::const_iterator it_r = right.m_children->begin();
-      while( it != m_children->end() && it_r != right.m_children->end() && *(*it) == *(*it_r) )
-      {
-        ++it;
-        ++it_r;
-      }
-      if( it != m_children->end() )
+      if( (*it)->type != (*it_r)->type )
+        return false;
+
+      if( (*it)->type == TypeTag ? !( *(*it)->tag == *(*it_r)->tag )
+                                 : *(*it)->str != *(*it_r)->str )
         return false;
     }
-    else if( m_children || right.m_children )
-      return false;
 
-    if( m_attribs && right.m_attribs )
+    AttributeList::const_iterator at = m_attribs.begin();
+    AttributeList::const_iterator at_r = right.m_attribs.begin();
+    for( ; at != m_attribs.end(); ++at, ++at_r )
     {
-      AttributeList::const_iterator at = m_attribs->begin();
-      AttributeList::const_iterator at_r = right.m_attribs->begin();
-      while( at != m_attribs->end() && at_r != right.m_attribs->end() && *(*at) == *(*at_r) )
-      {
-        ++at;
-        ++at_r;
-      }
-      if( at != m_attribs->end() )
+      if( !( *(*at) == *(*at_r) ) )
         return false;
     }
-    else if( m_attribs || right.m_attribs )
-      return false;
 
     return true;
   }
 
   const std::string Tag::xml() const
+  {
+    std::string xml;
+    appendXml( xml );
+    return xml;
+  }
+
+  void Tag::appendXml( std::string& target ) const
   {
     if( m_name.empty() )
-      return EmptyString;
+      return;
 
-    std::string xml = "<";
+    target += '<';
     if( !m_prefix.empty() )
     {
-      xml += m_prefix;
-      xml += ':';
+      target += m_prefix;
+      target += ':';
     }
-    xml += m_name;
-    if( m_attribs && !m_attribs->empty() )
+    target += m_name;
+    AttributeList::const_iterator it_a = m_attribs.begin();
+    for( ; it_a != m_attribs.end(); ++it_a )
     {
-      AttributeList::const_iterator it_a = m_attribs->begin();
-      for( ; it_a != m_attribs->end(); ++it_a )
-      {
-        xml += (*it_a)->xml();
-      }
+      (*it_a)->appendXml( target );
     }
 
-    if( !m_nodes || m_nodes->empty() )
-      xml += "/>";
+    if( m_nodes.empty() )
+      target += "/>";
     else
     {
-      xml += '>';
-      NodeList::const_iterator it_n = m_nodes->begin();
-      for( ; it_n != m_nodes->end(); ++it_n )
+      target += '>';
+      NodeList::const_iterator it_n = m_nodes.begin();
+      for( ; it_n != m_nodes.end(); ++it_n )
       {
         switch( (*it_n)->type )
         {
           case TypeTag:
-            xml += (*it_n)->tag->xml();
+            (*it_n)->tag->appendXml( target );
             break;
           case TypeString:
-            util::appendEscaped( xml, *((*it_n)->str) );
+            util::appendEscaped( target, *((*it_n)->str) );
             break;
         }
       }
-      xml += "</";
+      target += "</";
       if( !m_prefix.empty() )
       {
-        xml += m_prefix;
-        xml += ':';
+        target += m_prefix;
+        target += ':';
       }
-      xml += m_name;
-      xml += '>';
+      target += m_name;
+      target += '>';
     }
-
-    return xml;
   }
 
   bool Tag::addAttribute( Attribute* attr )
@@ -362,11 +331,8 @@ namespace gloox
       return false;
     }
 
-    if( !m_attribs )
-      m_attribs = new AttributeList();
-
-    AttributeList::iterator it = m_attribs->begin();
-    for( ; it != m_attribs->end(); ++it )
+    AttributeList::iterator it = m_attribs.begin();
+    for( ; it != m_attribs.end(); ++it )
     {
       if( (*it)->name() == attr->name()
           && ( (*it)->xmlns() == attr->xmlns() || (*it)->prefix() == attr->prefix() ) )
@@ -377,7 +343,7 @@ namespace gloox
       }
     }
 
-    m_attribs->push_back( attr );
+    m_attribs.push_back( attr );
 
     return true;
   }
@@ -408,16 +374,11 @@ namespace gloox
 
   void Tag::setAttributes( const AttributeList& attributes )
   {
-    if( !m_attribs )
-      m_attribs = new AttributeList( attributes );
-    else
-    {
-      util::clearList( *m_attribs );
-      *m_attribs = attributes;
-    }
+    util::clearList( m_attribs );
+    m_attribs = attributes;
 
-    AttributeList::iterator it = m_attribs->begin();
-    for( ; it != m_attribs->end(); ++it )
+    AttributeList::iterator it = m_attribs.begin();
+    for( ; it != m_attribs.end(); ++it )
       (*it)->m_parent = this;
   }
 
@@ -426,14 +387,11 @@ namespace gloox
     if( !child )
       return;
 
-    if( !m_nodes )
-      m_nodes = new NodeList();
-    if( !m_children )
-      m_children = new TagList();
-
-    m_children->push_back( child );
+    m_nodes.push_back( new Node( child ) );
     child->m_parent = this;
-    m_nodes->push_back( new Node( child ) );
+    TagList* children = m_children.load( std::memory_order_acquire );
+    if( children )
+      children->push_back( child );
   }
 
   void Tag::addChildCopy( const Tag* child )
@@ -444,36 +402,28 @@ namespace gloox
     addChild( child->clone() );
   }
 
-  bool Tag::setCData( const std::string& cdata )
+  void Tag::removeCData()
   {
-    if( cdata.empty() || !util::checkValidXMLChars( cdata ) )
-      return false;
-
-    if( !m_cdata )
-      m_cdata = new StringPList();
-    else
-      util::clearList( *m_cdata );
-
-    if( !m_nodes )
-      m_nodes = new NodeList();
-    else
+    NodeList::iterator it = m_nodes.begin();
+    while( it != m_nodes.end() )
     {
-      NodeList::iterator it = m_nodes->begin();
-      NodeList::iterator t;
-      while( it != m_nodes->end() )
+      if( (*it)->type == TypeString )
       {
-        if( (*it)->type == TypeString )
-        {
-          t = it++;
-          delete (*t);
-          m_nodes->erase( t );
-        }
-        else
-        {
-           it++;
-        }
+        TagArena::destroy( (*it)->str );
+        delete (*it);
+        it = m_nodes.erase( it );
       }
+      else
+        ++it;
     }
+  }
+
+  bool Tag::setCData( const std::string& cdata )
+  {
+    if( cdata.empty() || !util::checkValidXMLChars( cdata ) )
+      return false;
+
+    removeCData();
 
     return addCData( cdata );
   }
@@ -483,40 +433,52 @@ namespace gloox
     if( cdata.empty() || !util::checkValidXMLChars( cdata ) )
       return false;
 
-    if( !m_cdata )
-      m_cdata = new StringPList();
-    if( !m_nodes )
-      m_nodes = new NodeList();
-
-    std::string* str = new std::string( cdata );
-    m_cdata->push_back( str );
-    m_nodes->push_back( new Node( str ) );
+    m_nodes.push_back( new Node( TagArena::create( cdata ) ) );
     return true;
   }
 
   const std::string Tag::cdata() const
   {
-    if( !m_cdata )
-      return EmptyString;
-
     std::string str;
-    StringPList::const_iterator it = m_cdata->begin();
-    for( ; it != m_cdata->end(); ++it )
-      str += *(*it);
+    NodeList::const_iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type == TypeString )
+        str += *(*it)->str;
+    }
 
     return str;
   }
 
   const TagList& Tag::children() const
   {
-    static const TagList empty;
-    return m_children ? *m_children : empty;
+    TagList* children = m_children.load( std::memory_order_acquire );
+    if( children )
+      return *children;
+
+    // several threads may get here for the same const Tag; the first one to publish its
+    // list wins, the others discard theirs
+    children = new TagList();
+    NodeList::const_iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type == TypeTag )
+        children->push_back( (*it)->tag );
+    }
+
+    TagList* expected = 0;
+    if( !m_children.compare_exchange_strong( expected, children, std::memory_order_acq_rel ) )
+    {
+      delete children;
+      children = expected;
+    }
+
+    return *children;
   }
 
   const Tag::AttributeList& Tag::attributes() const
   {
-    static const AttributeList empty;
-    return m_attribs ? *m_attribs : empty;
+    return m_attribs;
   }
 
   bool Tag::setXmlns( const std::string& xmlns, const std::string& prefix )
@@ -588,11 +550,8 @@ namespace gloox
 
   const std::string& Tag::findAttribute( const std::string& name ) const
   {
-    if( !m_attribs )
-      return EmptyString;
-
-    AttributeList::const_iterator it = m_attribs->begin();
-    for( ; it != m_attribs->end(); ++it )
+    AttributeList::const_iterator it = m_attribs.begin();
+    for( ; it != m_attribs.end(); ++it )
       if( (*it)->name() == name )
         return (*it)->value();
 
@@ -601,11 +560,11 @@ namespace gloox
 
   bool Tag::hasAttribute( const std::string& name, const std::string& value ) const
   {
-    if( name.empty() || !m_attribs )
+    if( name.empty() )
       return false;
 
-    AttributeList::const_iterator it = m_attribs->begin();
-    for( ; it != m_attribs->end(); ++it )
+    AttributeList::const_iterator it = m_attribs.begin();
+    for( ; it != m_attribs.end(); ++it )
       if( (*it)->name() == name )
         return value.empty() || (*it)->value() == value;
 
@@ -623,67 +582,76 @@ namespace gloox
 
   Tag* Tag::findChild( const std::string& name ) const
   {
-    if( !m_children )
-      return 0;
-
-    TagList::const_iterator it = m_children->begin();
-    while( it != m_children->end() && (*it)->name() != name )
-      ++it;
-    return it != m_children->end() ? (*it) : 0;
+    NodeList::const_iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type == TypeTag && (*it)->tag->name() == name )
+        return (*it)->tag;
+    }
+    return 0;
   }
 
   Tag* Tag::findChild( const std::string& name, const std::string& attr,
                        const std::string& value ) const
   {
-    if( !m_children || name.empty() )
+    if( name.empty() )
       return 0;
 
-    TagList::const_iterator it = m_children->begin();
-    while( it != m_children->end() && ( (*it)->name() != name || !(*it)->hasAttribute( attr, value ) ) )
-      ++it;
-    return it != m_children->end() ? (*it) : 0;
+    NodeList::const_iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type == TypeTag && (*it)->tag->name() == name
+          && (*it)->tag->hasAttribute( attr, value ) )
+        return (*it)->tag;
+    }
+    return 0;
   }
 
   bool Tag::hasChildWithCData( const std::string& name, const std::string& cdata ) const
   {
-    if( !m_children || name.empty() || cdata.empty() )
-      return 0;
+    if( name.empty() || cdata.empty() )
+      return false;
 
-    TagList::const_iterator it = m_children->begin();
-    while( it != m_children->end() && ( (*it)->name() != name
-            || ( !cdata.empty() && (*it)->cdata() != cdata ) ) )
-      ++it;
-    return it != m_children->end();
+    NodeList::const_iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type == TypeTag && (*it)->tag->name() == name && (*it)->tag->cdata() == cdata )
+        return true;
+    }
+    return false;
   }
 
   Tag* Tag::findChildWithAttrib( const std::string& attr, const std::string& value ) const
   {
-    if( !m_children || attr.empty() )
+    if( attr.empty() )
       return 0;
 
-    TagList::const_iterator it = m_children->begin();
-    while( it != m_children->end() && !(*it)->hasAttribute( attr, value ) )
-      ++it;
-    return it != m_children->end() ? (*it) : 0;
+    NodeList::const_iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type == TypeTag && (*it)->tag->hasAttribute( attr, value ) )
+        return (*it)->tag;
+    }
+    return 0;
   }
 
   Tag* Tag::clone() const
   {
+    // clones are meant to outlive the arena the original may live in
+    TagArena::Scope scope( 0 );
+
     Tag* t = new Tag( m_name );
     t->m_xmlns = m_xmlns;
     t->m_prefix = m_prefix;
 
-    if( m_attribs )
+    t->m_attribs.reserve( m_attribs.size() );
+    Tag::AttributeList::const_iterator at = m_attribs.begin();
+    Attribute* attr;
+    for( ; at != m_attribs.end(); ++at )
     {
-      t->m_attribs = new AttributeList();
-      Tag::AttributeList::const_iterator at = m_attribs->begin();
-      Attribute* attr;
-      for( ; at != m_attribs->end(); ++at )
-      {
-        attr = new Attribute( *(*at) );
-        attr->m_parent = t;
-        t->m_attribs->push_back( attr );
-      }
+      attr = new Attribute( *(*at) );
+      attr->m_parent = t;
+      t->m_attribs.push_back( attr );
     }
 
     if( m_xmlnss )
@@ -691,20 +659,18 @@ namespace gloox
       t->m_xmlnss = new StringMap( *m_xmlnss );
     }
 
-    if( m_nodes )
+    t->m_nodes.reserve( m_nodes.size() );
+    Tag::NodeList::const_iterator nt = m_nodes.begin();
+    for( ; nt != m_nodes.end(); ++nt )
     {
-      Tag::NodeList::const_iterator nt = m_nodes->begin();
-      for( ; nt != m_nodes->end(); ++nt )
+      switch( (*nt)->type )
       {
-        switch( (*nt)->type )
-        {
-          case TypeTag:
-            t->addChild( (*nt)->tag->clone() );
-            break;
-          case TypeString:
-            t->addCData( *((*nt)->str) );
-            break;
-        }
+        case TypeTag:
+          t->addChild( (*nt)->tag->clone() );
+          break;
+        case TypeString:
+          t->addCData( *((*nt)->str) );
+          break;
       }
     }
 
@@ -714,260 +680,325 @@ namespace gloox
   TagList Tag::findChildren( const std::string& name,
                              const std::string& xmlns ) const
   {
-    return m_children ? findChildren( *m_children, name, xmlns ) : TagList();
+    TagList ret;
+    NodeList::const_iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type == TypeTag && (*it)->tag->name() == name
+          && ( xmlns.empty() || (*it)->tag->xmlns() == xmlns ) )
+        ret.push_back( (*it)->tag );
+    }
+    return ret;
   }
 
-  TagList Tag::findChildren( const TagList& list, const std::string& name,
-                             const std::string& xmlns ) const
+  void Tag::removeNode( Tag* tag )
   {
-    TagList ret;
-    TagList::const_iterator it = list.begin();
-    for( ; it != list.end(); ++it )
+    NodeList::iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
     {
-      if( (*it)->name() == name && ( xmlns.empty() || (*it)->xmlns() == xmlns ) )
-        ret.push_back( (*it) );
+      if( (*it)->type == TypeTag && (*it)->tag == tag )
+      {
+        delete (*it);
+        m_nodes.erase( it );
+        break;
+      }
     }
-    return ret;
+
+    TagList* children = m_children.load( std::memory_order_acquire );
+    if( children )
+      children->remove( tag );
   }
 
   void Tag::removeChild( const std::string& name, const std::string& xmlns )
   {
-    if( name.empty() || !m_children || !m_nodes )
+    if( name.empty() )
       return;
 
     TagList l = findChildren( name, xmlns );
     TagList::iterator it = l.begin();
-    TagList::iterator it2;
-    while( it != l.end() )
+    for( ; it != l.end(); ++it )
     {
-      it2 = it++;
-      NodeList::iterator itn = m_nodes->begin();
-      for( ; itn != m_nodes->end(); ++itn )
-      {
-        if( (*itn)->type == TypeTag && (*itn)->tag == (*it2) )
-        {
-          delete (*itn);
-          m_nodes->erase( itn );
-          break;
-        }
-      }
-      m_children->remove( (*it2) );
-      delete (*it2);
+      removeNode( (*it) );
+      delete (*it);
     }
   }
 
   void Tag::removeChild( Tag* tag )
   {
-    if( m_children )
-      m_children->remove( tag );
+    removeNode( tag );
+  }
 
-    if( !m_nodes )
+  void Tag::removeAttribute( const std::string& attr, const std::string& value,
+                             const std::string& xmlns )
+  {
+    if( attr.empty() )
       return;
 
-    NodeList::iterator it = m_nodes->begin();
-    for( ; it != m_nodes->end(); ++it )
+    AttributeList::iterator it = m_attribs.begin();
+    while( it != m_attribs.end() )
     {
-      if( (*it)->type == TypeTag && (*it)->tag == tag )
+      if( (*it)->name() == attr && ( value.empty() || (*it)->value() == value )
+                                && ( xmlns.empty() || (*it)->xmlns() == xmlns ) )
       {
         delete (*it);
-        m_nodes->erase( it );
-        return;
+        it = m_attribs.erase( it );
       }
+      else
+        ++it;
     }
   }
 
-  void Tag::removeAttribute( const std::string& attr, const std::string& value,
-                             const std::string& xmlns )
+  // ---- Tag::XPath ----
+  struct Tag::XPath::Token
   {
-    if( attr.empty() || !m_attribs )
+    void compile( const Tag* tag )
+    {
+      type = atoi( tag->findAttribute( TYPE ).c_str() );
+      name = tag->name();
+      index = atoi( name.c_str() );
+      predicate = tag->hasAttribute( "predicate", "true" );
+      number = tag->hasAttribute( "number", "true" );
+
+      const TagList& l = tag->children();
+      children.resize( l.size() );
+      TagList::const_iterator it = l.begin();
+      for( int i = 0; it != l.end(); ++it, ++i )
+        children[i].compile( (*it) );
+    }
+
+    int type;
+    std::string name;
+    int index;
+    bool predicate;
+    bool number;
+    std::vector<Token> children;
+  };
+
+  Tag::XPath::XPath( const std::string& expression )
+    : m_expression( expression ), m_root( 0 ),
+      m_absolute( expression.length() >= 2 && expression[0] == '/' && expression[1] != '/' )
+  {
+    if( expression == "/" || expression == "//" )
       return;
 
-    AttributeList::iterator it = m_attribs->begin();
-    AttributeList::iterator it2;
-    while( it != m_attribs->end() )
-    {
-      it2 = it++;
-      if( (*it2)->name() == attr && ( value.empty() || (*it2)->value() == value )
-                                 && ( xmlns.empty() || (*it2)->xmlns() == xmlns ) )
+    unsigned len = 0;
+    Tag* p = Tag::parse( expression, len );
+    if( !p )
+      return;
+
+    m_root = new Token();
+    m_root->compile( p );
+    delete p;
+  }
+
+  Tag::XPath::XPath( const XPath& right )
+    : m_expression( right.m_expression ), m_root( right.m_root ? new Token( *right.m_root ) : 0 ),
+      m_absolute( right.m_absolute )
+  {
+  }
+
+  Tag::XPath& Tag::XPath::operator=( const XPath& right )
+  {
+    if( this == &right )
+      return *this;
+
+    delete m_root;
+    m_expression = right.m_expression;
+    m_root = right.m_root ? new Token( *right.m_root ) : 0;
+    m_absolute = right.m_absolute;
+    return *this;
+  }
+
+  Tag::XPath::~XPath()
+  {
+    delete m_root;
+  }
+
+  /**
+   * A per-thread LRU cache of compiled XPath expressions, used by the string-based
+   * XPath functions.
+   */
+  class XPathCache
+  {
+    public:
+      const Tag::XPath& get( const std::string& expression )
       {
-        delete (*it2);
-        m_attribs->erase( it2 );
+        ExpressionMap::iterator it = m_map.find( expression );
+        if( it != m_map.end() )
+        {
+          m_list.splice( m_list.begin(), m_list, (*it).second );
+          return m_list.front();
+        }
+
+        m_list.push_front( Tag::XPath( expression ) );
+        m_map.insert( std::make_pair( expression, m_list.begin() ) );
+        if( m_list.size() > CacheSize )
+        {
+          m_map.erase( m_list.back().expression() );
+          m_list.pop_back();
+        }
+        return m_list.front();
       }
-    }
+
+    private:
+      static const std::list<Tag::XPath>::size_type CacheSize = 256;
+
+      typedef std::list<Tag::XPath> XPathList;
+      typedef std::map<std::string, XPathList::iterator> ExpressionMap;
+
+      XPathList m_list;
+      ExpressionMap m_map;
+  };
+
+  static const Tag::XPath& compiledXPath( const std::string& expression )
+  {
+    static thread_local XPathCache cache;
+    return cache.get( expression );
   }
 
   const std::string Tag::findCData( const std::string& expression ) const
   {
-    const ConstTagList& l = findTagList( expression );
-    return !l.empty() ? l.front()->cdata() : EmptyString;
+    return findCData( compiledXPath( expression ) );
   }
 
   const Tag* Tag::findTag( const std::string& expression ) const
   {
-    const ConstTagList& l = findTagList( expression );
-    return !l.empty() ? l.front() : 0;
+    return findTag( compiledXPath( expression ) );
   }
 
   ConstTagList Tag::findTagList( const std::string& expression ) const
+  {
+    return findTagList( compiledXPath( expression ) );
+  }
+
+  const std::string Tag::findCData( const XPath& xpath ) const
+  {
+    const ConstTagList& l = findTagList( xpath );
+    return !l.empty() ? l.front()->cdata() : EmptyString;
+  }
+
+  const Tag* Tag::findTag( const XPath& xpath ) const
+  {
+    const ConstTagList& l = findTagList( xpath );
+    return !l.empty() ? l.front() : 0;
+  }
+
+  ConstTagList Tag::findTagList( const XPath& xpath ) const
   {
     ConstTagList l;
-    if( expression == "/" || expression == "//" )
+    if( !xpath.m_root )
       return l;
 
-    if( m_parent && expression.length() >= 2 && expression[0] == '/'
-                                             && expression[1] != '/' )
-      return m_parent->findTagList( expression );
+    if( m_parent && xpath.m_absolute )
+      return m_parent->findTagList( xpath );
 
-    unsigned len = 0;
-    Tag* p = parse( expression, len );
-//     if( p )
-//       printf( "parsed tree: %s\n", p->xml().c_str() );
-    l = evaluateTagList( p );
-    delete p;
+    evaluateTagList( *xpath.m_root, l, xpath.m_root->type );
     return l;
   }
 
-  ConstTagList Tag::evaluateTagList( Tag* token ) const
+  void Tag::evaluateTagList( const XPath::Token& token, ConstTagList& result, int type,
+                             bool anyName ) const
   {
-    ConstTagList result;
-    if( !token )
-      return result;
-
-//     printf( "evaluateTagList called in Tag %s and Token %s (type: %s)\n", name().c_str(),
-//             token->name().c_str(), token->findAttribute( TYPE ).c_str() );
-
-    TokenType tokenType = static_cast<TokenType>( atoi( token->findAttribute( TYPE ).c_str() ) );
-    switch( tokenType )
+    switch( type )
     {
       case XTUnion:
-        add( result, evaluateUnion( token ) );
+      {
+        std::vector<XPath::Token>::const_iterator it = token.children.begin();
+        for( ; it != token.children.end(); ++it )
+          evaluateTagList( (*it), result, (*it).type );
         break;
+      }
       case XTElement:
       {
-//         printf( "in XTElement, token: %s\n", token->name().c_str() );
-        if( token->name() == name() || token->name() == "*" )
+        if( !anyName && token.name != m_name && token.name != "*" )
+          break;
+
+        if( token.children.empty() )
         {
-//           printf( "found %s\n", name().c_str() );
-          const TagList& tokenChildren = token->children();
-          if( tokenChildren.size() )
-          {
-            bool predicatesSucceeded = true;
-            TagList::const_iterator cit = tokenChildren.begin();
-            for( ; cit != tokenChildren.end(); ++cit )
-            {
-              if( (*cit)->hasAttribute( "predicate", "true" ) )
-              {
-                predicatesSucceeded = evaluatePredicate( (*cit) );
-                if( !predicatesSucceeded )
-                  return result;
-              }
-            }
+          add( result, this );
+          break;
+        }
+
+        std::vector<XPath::Token>::const_iterator cit = token.children.begin();
+        for( ; cit != token.children.end(); ++cit )
+        {
+          if( (*cit).predicate && !evaluatePredicate( (*cit) ) )
+            return;
+        }
+
+        bool hasElementChildren = false;
+        cit = token.children.begin();
+        for( ; cit != token.children.end(); ++cit )
+        {
+          if( (*cit).predicate || (*cit).number )
+            continue;
+
+          hasElementChildren = true;
 
-            bool hasElementChildren = false;
-            cit = tokenChildren.begin();
-            for( ; cit != tokenChildren.end(); ++cit )
+          bool hasChildren = false;
+          NodeList::const_iterator it = m_nodes.begin();
+          for( ; it != m_nodes.end(); ++it )
+          {
+            if( (*it)->type == TypeTag )
             {
-              if( (*cit)->hasAttribute( "predicate", "true" ) ||
-                  (*cit)->hasAttribute( "number", "true" ) )
-                continue;
-
-              hasElementChildren = true;
-
-//               printf( "checking %d children of token %s\n", tokenChildren.size(), token->name().c_str() );
-              if( m_children && !m_children->empty() )
-              {
-                TagList::const_iterator it = m_children->begin();
-                for( ; it != m_children->end(); ++it )
-                {
-                  add( result, (*it)->evaluateTagList( (*cit) ) );
-                }
-              }
-              else if( atoi( (*cit)->findAttribute( TYPE ).c_str() ) == XTDoubleDot && m_parent )
-              {
-                (*cit)->addAttribute( TYPE, XTDot );
-                add( result, m_parent->evaluateTagList( (*cit) ) );
-              }
+              hasChildren = true;
+              (*it)->tag->evaluateTagList( (*cit), result, (*cit).type );
             }
-
-            if( !hasElementChildren )
-              result.push_back( this );
           }
-          else
+
+          if( !hasChildren && (*cit).type == XTDoubleDot && m_parent )
           {
-//             printf( "adding %s to result set\n", name().c_str() );
-            result.push_back( this );
+            m_parent->evaluateTagList( (*cit), result, XTDot );
           }
         }
-//         else
-//           printf( "found %s != %s\n", token->name().c_str(), name().c_str() );
+
+        if( !hasElementChildren )
+          add( result, this );
 
         break;
       }
       case XTDoubleSlash:
       {
-//         printf( "in XTDoubleSlash\n" );
-        Tag* t = token->clone();
-//         printf( "original token: %s\ncloned token: %s\n", token->xml().c_str(), n->xml().c_str() );
-        t->addAttribute( TYPE, XTElement );
-        add( result, evaluateTagList( t ) );
-        const ConstTagList& res2 = allDescendants();
-        ConstTagList::const_iterator it = res2.begin();
-        for( ; it != res2.end(); ++it )
-        {
-          add( result, (*it)->evaluateTagList( t ) );
-        }
-        delete t;
+        evaluateTagList( token, result, XTElement );
+        evaluateDescendants( token, result );
         break;
       }
       case XTDot:
       {
-        const TagList& tokenChildren = token->children();
-        if( !tokenChildren.empty() )
-        {
-          add( result, evaluateTagList( tokenChildren.front() ) );
-        }
+        if( !token.children.empty() )
+          evaluateTagList( token.children.front(), result, token.children.front().type );
         else
-          result.push_back( this );
+          add( result, this );
         break;
       }
       case XTDoubleDot:
       {
-//         printf( "in XTDoubleDot\n" );
-        if( m_parent )
+        if( !m_parent )
+          break;
+
+        if( token.children.empty() )
         {
-          const TagList& tokenChildren = token->children();
-          if( tokenChildren.size() )
-          {
-            Tag* testtoken = tokenChildren.front();
-            if( testtoken->name() == "*" )
-            {
-              add( result, m_parent->evaluateTagList( testtoken ) );
-            }
-            else
-            {
-              Tag* t = token->clone();
-              t->addAttribute( TYPE, XTElement );
-              t->m_name = m_parent->m_name;
-              add( result, m_parent->evaluateTagList( t ) );
-              delete t;
-            }
-          }
+          add( result, m_parent );
+        }
+        else
+        {
+          const XPath::Token& testtoken = token.children.front();
+          if( testtoken.name == "*" )
+            m_parent->evaluateTagList( testtoken, result, testtoken.type );
           else
-          {
-            result.push_back( m_parent );
-          }
+            m_parent->evaluateTagList( token, result, XTElement, true );
         }
+        break;
       }
       case XTInteger:
       {
-        const TagList& l = token->children();
-        if( !l.size() )
+        if( token.children.empty() )
           break;
 
-        const ConstTagList& res = evaluateTagList( l.front() );
+        ConstTagList res;
+        evaluateTagList( token.children.front(), res, token.children.front().type );
 
-        int pos = atoi( token->name().c_str() );
-//         printf( "checking index %d\n", pos );
+        int pos = token.index;
         if( pos > 0 && pos <= static_cast<int>( res.size() ) )
         {
           ConstTagList::const_iterator it = res.begin();
@@ -975,30 +1006,38 @@ namespace gloox
           {
             ++it;
           }
-          result.push_back( *it );
+          add( result, (*it) );
         }
         break;
       }
       default:
         break;
     }
-    return result;
   }
 
-  bool Tag::evaluateBoolean( Tag* token ) const
+  void Tag::evaluateDescendants( const XPath::Token& token, ConstTagList& result ) const
   {
-    if( !token )
-      return false;
+    NodeList::const_iterator it = m_nodes.begin();
+    for( ; it != m_nodes.end(); ++it )
+    {
+      if( (*it)->type != TypeTag )
+        continue;
 
+      (*it)->tag->evaluateTagList( token, result, XTElement );
+      (*it)->tag->evaluateDescendants( token, result );
+    }
+  }
+
+  bool Tag::evaluateBoolean( const XPath::Token& token ) const
+  {
     bool result = false;
-    TokenType tokenType = static_cast<TokenType>( atoi( token->findAttribute( TYPE ).c_str() ) );
-    switch( tokenType )
+    switch( token.type )
     {
       case XTAttribute:
-        if( token->name() == "*" && m_attribs && m_attribs->size() )
+        if( token.name == "*" && !m_attribs.empty() )
           result = true;
         else
-          result = hasAttribute( token->name() );
+          result = hasAttribute( token.name );
         break;
       case XTOperatorEq:
         result = evaluateEquals( token );
@@ -1014,12 +1053,9 @@ namespace gloox
       case XTUnion:
       case XTElement:
       {
-        Tag* t = new Tag( "." );
-        t->addAttribute( TYPE, XTDot );
-        t->addChild( token );
-        result = !evaluateTagList( t ).empty();
-        t->removeChild( token );
-        delete t;
+        ConstTagList l;
+        evaluateTagList( token, l, token.type );
+        result = !l.empty();
         break;
       }
       default:
@@ -1029,30 +1065,27 @@ namespace gloox
     return result;
   }
 
-  bool Tag::evaluateEquals( Tag* token ) const
+  bool Tag::evaluateEquals( const XPath::Token& token ) const
   {
-    if( !token || token->children().size() != 2 )
+    if( token.children.size() != 2 )
       return false;
 
     bool result = false;
-    TagList::const_iterator it = token->children().begin();
-    Tag* ch1 = (*it);
-    Tag* ch2 = (*++it);
+    const XPath::Token& ch1 = token.children[0];
+    const XPath::Token& ch2 = token.children[1];
 
-    TokenType tt1 = static_cast<TokenType>( atoi( ch1->findAttribute( TYPE ).c_str() ) );
-    TokenType tt2 = static_cast<TokenType>( atoi( ch2->findAttribute( TYPE ).c_str() ) );
-    switch( tt1 )
+    switch( ch1.type )
     {
       case XTAttribute:
-        switch( tt2 )
+        switch( ch2.type )
         {
           case XTInteger:
           case XTLiteral:
-            result = ( findAttribute( ch1->name() ) == ch2->name() );
+            result = ( findAttribute( ch1.name ) == ch2.name );
             break;
           case XTAttribute:
-            result = ( hasAttribute( ch1->name() ) && hasAttribute( ch2->name() ) &&
-                      findAttribute( ch1->name() ) == findAttribute( ch2->name() ) );
+            result = ( hasAttribute( ch1.name ) && hasAttribute( ch2.name ) &&
+                      findAttribute( ch1.name ) == findAttribute( ch2.name ) );
             break;
           default:
             break;
@@ -1060,14 +1093,14 @@ namespace gloox
         break;
       case XTInteger:
       case XTLiteral:
-        switch( tt2 )
+        switch( ch2.type )
         {
           case XTAttribute:
-            result = ( ch1->name() == findAttribute( ch2->name() ) );
+            result = ( ch1.name == findAttribute( ch2.name ) );
             break;
           case XTLiteral:
           case XTInteger:
-            result = ( ch1->name() == ch2->name() );
+            result = ( ch1.name == ch2.name );
             break;
           default:
             break;
@@ -1080,38 +1113,7 @@ namespace gloox
     return result;
   }
 
-  ConstTagList Tag::allDescendants() const
-  {
-    ConstTagList result;
-
-    if( !m_children )
-      return result;
-
-    TagList::const_iterator it = m_children->begin();
-    for( ; it != m_children->end(); ++it )
-    {
-      result.push_back( (*it) );
-      add( result, (*it)->allDescendants() );
-    }
-    return result;
-  }
-
-  ConstTagList Tag::evaluateUnion( Tag* token ) const
-  {
-    ConstTagList result;
-    if( !token )
-      return result;
-
-    const TagList& l = token->children();
-    TagList::const_iterator it = l.begin();
-    for( ; it != l.end(); ++it )
-    {
-      add( result, evaluateTagList( (*it) ) );
-    }
-    return result;
-  }
-
-  void Tag::closePreviousToken( Tag** root, Tag** current, Tag::TokenType& type, std::string& tok ) const
+  void Tag::closePreviousToken( Tag** root, Tag** current, Tag::TokenType& type, std::string& tok )
   {
     if( !tok.empty() )
     {
@@ -1121,7 +1123,7 @@ namespace gloox
     }
   }
 
-  Tag* Tag::parse( const std::string& expression, unsigned& len, Tag::TokenType border ) const
+  Tag* Tag::parse( const std::string& expression, unsigned& len, Tag::TokenType border )
   {
     Tag* root = 0;
     Tag* current = root;
@@ -1263,7 +1265,7 @@ namespace gloox
   }
 
   void Tag::addToken( Tag **root, Tag **current, Tag::TokenType type,
-                      const std::string& token ) const
+                      const std::string& token )
   {
     Tag* t = new Tag( token );
     if( t->isNumber() && !t->children().size() )
@@ -1284,7 +1286,7 @@ namespace gloox
   }
 
   void Tag::addOperator( Tag** root, Tag** current, Tag* arg,
-                           Tag::TokenType type, const std::string& token ) const
+                           Tag::TokenType type, const std::string& token )
   {
     Tag* t = new Tag( token );
     t->addAttribute( TYPE, type );
@@ -1296,7 +1298,7 @@ namespace gloox
     *current = *root = t;
   }
 
-  bool Tag::addPredicate( Tag **root, Tag **current, Tag* token ) const
+  bool Tag::addPredicate( Tag **root, Tag **current, Tag* token )
   {
     if( !*root || !*current )
       return false;
@@ -1366,12 +1368,10 @@ namespace gloox
     return i == l;
   }
 
-  void Tag::add( ConstTagList& one, const ConstTagList& two )
+  void Tag::add( ConstTagList& list, const Tag* tag )
   {
-    ConstTagList::const_iterator it = two.begin();
-    for( ; it != two.end(); ++it )
-      if( std::find( one.begin(), one.end(), (*it) ) == one.end() )
-        one.push_back( (*it) );
+    if( std::find( list.begin(), list.end(), tag ) == list.end() )
+      list.push_back( tag );
   }
 
 }
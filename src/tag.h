@@ -15,7 +15,10 @@
 #define TAG_H__
 
 #include "gloox.h"
+#include "smallvector.h"
+#include "tagarena.h"
 
+#include <atomic>
 #include <string>
 #include <list>
 #include <utility>
@@ -97,6 +100,18 @@ namespace gloox
            */
           virtual ~Attribute() {}
 
+          /**
+           * Allocates an Attribute from the active TagArena, if any.
+           * @param size The number of bytes to allocate.
+           */
+          static void* operator new( std::size_t size ) { return TagArena::allocate( size ); }
+
+          /**
+           * Frees an Attribute allocated using operator new().
+           * @param p The memory to free.
+           */
+          static void operator delete( void* p ) { TagArena::deallocate( p ); }
+
           /**
            * Returns the attribute's name.
            * @return The attribute's name.
@@ -151,6 +166,13 @@ namespace gloox
            */
           const std::string xml() const;
 
+          /**
+           * Appends the string representation of the attribute to a string.
+           * @param target The string to append to.
+           * @since 1.1
+           */
+          void appendXml( std::string& target ) const;
+
           /**
            * Checks two Attributes for equality.
            * @param right The Attribute to check against the current Attribute.
@@ -182,9 +204,11 @@ namespace gloox
       };
 
       /**
-       * A list of XML element attributes.
+       * A list of XML element attributes. The first four attributes are stored inline.
+       * @note Since 1.1 this is a SmallVector instead of a std::list. Erasing an element
+       * invalidates iterators to the following elements.
        */
-      typedef std::list<Attribute*> AttributeList;
+      typedef SmallVector<Attribute*, 4> AttributeList;
 
       /**
        * Creates a new tag with a given name (and XML character data, if given).
@@ -225,6 +249,22 @@ namespace gloox
        */
       virtual ~Tag();
 
+      /**
+       * Allocates a Tag from the active TagArena, if any. Outside a TagArena::Scope
+       * Tags are allocated from the heap as usual.
+       * @param size The number of bytes to allocate.
+       * @since 1.1
+       */
+      static void* operator new( std::size_t size ) { return TagArena::allocate( size ); }
+
+      /**
+       * Frees a Tag allocated using operator new(). Memory owned by a TagArena is
+       * released by TagArena::reset().
+       * @param p The memory to free.
+       * @since 1.1
+       */
+      static void operator delete( void* p ) { TagArena::deallocate( p ); }
+
       /**
        * This function can be used to retrieve the complete XML of a tag as a string.
        * It includes all the attributes, child nodes and character data.
@@ -232,6 +272,15 @@ namespace gloox
        */
       const std::string xml() const;
 
+      /**
+       * Appends the complete XML of the tag to a string, without building temporary strings
+       * for attributes and child tags. If the same string is used over and over again (after
+       * clearing it), serializing does not allocate once its capacity suffices.
+       * @param target The string to append the XML to.
+       * @since 1.1
+       */
+      void appendXml( std::string& target ) const;
+
       /**
        * Sets the Tag's namespace prefix.
        * @param prefix The namespace prefix.
@@ -408,6 +457,9 @@ namespace gloox
       /**
        * Use this function to fetch a const list of child elements.
        * @return A constant reference to the list of child elements.
+       * @note Since 1.1 the TagList is created on first use and kept up to date afterwards.
+       * findChild() and friends do not need it. Concurrent calls on a const Tag are safe. Use
+       * nodes() to iterate over child elements without allocating the list.
        */
       const TagList& children() const;
 
@@ -532,6 +584,69 @@ namespace gloox
        */
       Tag* clone() const;
 
+      /**
+       * @brief A compiled XPath expression.
+       *
+       * Parsing an XPath expression is considerably more expensive than evaluating it. An
+       * XPath object parses its expression once and can then be evaluated against any
+       * number of Tags using findTagList(), findTag() or findCData(). Evaluation does not
+       * allocate memory other than for the result list.
+       *
+       * @code
+       * static const Tag::XPath items( "/query/item" );
+       * const ConstTagList& l = tag->findTagList( items );
+       * @endcode
+       *
+       * The string-based overloads of these functions use an internal, per-thread cache
+       * of recently compiled expressions.
+       *
+       * @author Jakob Schröter <js@camaya.net>
+       * @since 1.1
+       */
+      class GLOOX_API XPath
+      {
+
+        friend class Tag;
+
+        public:
+          /**
+           * Compiles the given XPath expression.
+           * @param expression The XPath expression to compile.
+           */
+          explicit XPath( const std::string& expression );
+
+          /**
+           * Copy constructor.
+           * @param right The XPath to copy.
+           */
+          XPath( const XPath& right );
+
+          /**
+           * Assignment operator.
+           * @param right The XPath to copy.
+           */
+          XPath& operator=( const XPath& right );
+
+          /**
+           * Destructor.
+           */
+          ~XPath();
+
+          /**
+           * Returns the expression this XPath was compiled from.
+           * @return The original expression.
+           */
+          const std::string& expression() const { return m_expression; }
+
+        private:
+          struct Token;
+
+          std::string m_expression;
+          Token* m_root;
+          bool m_absolute;
+
+      };
+
       /**
        * Evaluates the given XPath expression and returns the result Tag's character data, if any.
        * If more than one Tag match, only the first one's character data is returned.
@@ -567,6 +682,32 @@ namespace gloox
        */
       ConstTagList findTagList( const std::string& expression ) const;
 
+      /**
+       * Evaluates the given compiled XPath expression and returns the result Tag's character
+       * data, if any. If more than one Tag match, only the first one's character data is returned.
+       * @param xpath A compiled XPath expression to evaluate.
+       * @return A matched Tag's character data, or the empty string.
+       * @since 1.1
+       */
+      const std::string findCData( const XPath& xpath ) const;
+
+      /**
+       * Evaluates the given compiled XPath expression and returns the result Tag. If more than
+       * one Tag match, only the first one is returned.
+       * @param xpath A compiled XPath expression to evaluate.
+       * @return A matched Tag, or 0.
+       * @since 1.1
+       */
+      const Tag* findTag( const XPath& xpath ) const;
+
+      /**
+       * Evaluates the given compiled XPath expression and returns the matched Tags.
+       * @param xpath A compiled XPath expression to evaluate.
+       * @return A list of matched Tags, or an empty TagList.
+       * @since 1.1
+       */
+      ConstTagList findTagList( const XPath& xpath ) const;
+
       /**
        * Checks two Tags for equality. Order of attributes and child tags does matter.
        * @param right The Tag to check against the current Tag.
@@ -604,21 +745,30 @@ namespace gloox
         XPUnexpectedToken
       };
 
-#ifdef WANT_XHTMLIM
     public:
-#endif
+      /**
+       * The type of a child node.
+       * @since 1.1 (previously only available if WANT_XHTMLIM was defined)
+       */
       enum NodeType
       {
         TypeTag,                    /**< The Node is a Tag. */
         TypeString                  /**< The Node is a std::string. */
       };
 
+      /**
+       * A child node, either a Tag or a piece of character data.
+       * @since 1.1 (previously only available if WANT_XHTMLIM was defined)
+       */
       struct Node
       {
         Node( Tag* _tag ) : type( TypeTag ), tag( _tag ) {}
         Node( std::string* _str ) : type( TypeString ), str( _str ) {}
         ~Node() {}
 
+        static void* operator new( std::size_t size ) { return TagArena::allocate( size ); }
+        static void operator delete( void* p ) { TagArena::deallocate( p ); }
+
         NodeType type;
         union
         {
@@ -627,28 +777,28 @@ namespace gloox
         };
       };
 
-      typedef std::list<Node*> NodeList;
+      /**
+       * A list of child nodes. The first four nodes are stored inline.
+       * @note Since 1.1 this is a SmallVector instead of a std::list.
+       */
+      typedef SmallVector<Node*, 4> NodeList;
 
       /**
        * Use this function to fetch a const list of child elements.
        * The list includes both tags and cdata nodes, all in order. Use this if you want to render
        * XHTML-IM content without passing raw XML to an external parser/renderer.
+       * Unlike children(), this does not allocate and is the preferred way to iterate over
+       * child elements in hot code paths.
        * @return A constant reference to the list of child elements.
+       * @since 1.1 (previously only available if WANT_XHTMLIM was defined)
        */
-      const NodeList& nodes() const
-      {
-        static const NodeList empty;
-        return m_nodes ? *m_nodes : empty;
-      }
+      const NodeList& nodes() const { return m_nodes; }
 
-#ifdef WANT_XHTMLIM
     private:
-#endif
       Tag* m_parent;
-      TagList* m_children;
-      StringPList* m_cdata;
-      AttributeList* m_attribs;
-      NodeList* m_nodes;
+      mutable std::atomic<TagList*> m_children;
+      AttributeList m_attribs;
+      NodeList m_nodes;
       std::string m_name;
       std::string m_xmlns;
       StringMap* m_xmlnss;
@@ -697,30 +847,31 @@ namespace gloox
       void setXmlns( StringMap* xmlns )
         { delete m_xmlnss; m_xmlnss = xmlns; }
 
-      Tag* parse( const std::string& expression, unsigned& len, TokenType border = XTNone ) const;
+      static Tag* parse( const std::string& expression, unsigned& len, TokenType border = XTNone );
 
-      void closePreviousToken( Tag**, Tag**, TokenType&, std::string& ) const;
-      void addToken( Tag **root, Tag **current, TokenType type, const std::string& token ) const;
-      void addOperator( Tag **root, Tag **current, Tag* arg, TokenType type,
-                        const std::string& token ) const;
-      bool addPredicate( Tag **root, Tag **current, Tag* token ) const;
+      static void closePreviousToken( Tag**, Tag**, TokenType&, std::string& );
+      static void addToken( Tag **root, Tag **current, TokenType type, const std::string& token );
+      static void addOperator( Tag **root, Tag **current, Tag* arg, TokenType type,
+                               const std::string& token );
+      static bool addPredicate( Tag **root, Tag **current, Tag* token );
 
-      TagList findChildren( const TagList& list, const std::string& name,
-                            const std::string& xmlns = EmptyString ) const;
-      ConstTagList evaluateTagList( Tag* token ) const;
-      ConstTagList evaluateUnion( Tag* token ) const;
-      ConstTagList allDescendants() const;
+      void evaluateTagList( const XPath::Token& token, ConstTagList& result, int type,
+                            bool anyName = false ) const;
+      void evaluateDescendants( const XPath::Token& token, ConstTagList& result ) const;
 
       static TokenType getType( const std::string& c );
 
       static bool isWhitespace( const char c );
       bool isNumber() const;
 
-      bool evaluateBoolean( Tag* token ) const;
-      bool evaluatePredicate( Tag* token ) const { return evaluateBoolean( token ); }
-      bool evaluateEquals( Tag* token ) const;
+      bool evaluateBoolean( const XPath::Token& token ) const;
+      bool evaluatePredicate( const XPath::Token& token ) const { return evaluateBoolean( token ); }
+      bool evaluateEquals( const XPath::Token& token ) const;
+
+      static void add( ConstTagList& list, const Tag* tag );
 
-      static void add( ConstTagList& one, const ConstTagList& two );
+      void removeCData();
+      void removeNode( Tag* tag );
   };
 
 }
@@ -0,0 +1,143 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "tagarena.h"
+
+#include <cstdlib>
+#include <functional>
+
+namespace gloox
+{
+
+  static const std::size_t Alignment = alignof( std::max_align_t );
+
+  static std::size_t alignedSize( std::size_t size )
+  {
+    return ( size + Alignment - 1 ) / Alignment * Alignment;
+  }
+
+  // the innermost Scope of the current thread
+  static thread_local TagArena::Scope* s_currentScope = 0;
+
+  // ---- TagArena::Scope ----
+  TagArena::Scope::Scope( TagArena* arena )
+    : m_arena( arena ), m_previous( s_currentScope )
+  {
+    s_currentScope = this;
+  }
+
+  TagArena::Scope::~Scope()
+  {
+    s_currentScope = m_previous;
+  }
+  // ---- ~TagArena::Scope ----
+
+  // ---- TagArena ----
+  TagArena::TagArena( std::size_t blockSize )
+    : m_blocks( 0 ), m_first( 0 ), m_blockSize( blockSize ), m_allocations( 0 ), m_bytes( 0 )
+  {
+  }
+
+  TagArena::~TagArena()
+  {
+    while( m_blocks )
+    {
+      Block* b = m_blocks;
+      m_blocks = m_blocks->next;
+      free( b );
+    }
+  }
+
+  void TagArena::reset()
+  {
+    while( m_blocks && m_blocks != m_first )
+    {
+      Block* b = m_blocks;
+      m_blocks = m_blocks->next;
+      free( b );
+    }
+
+    if( m_blocks )
+      m_blocks->used = 0;
+
+    m_allocations = 0;
+    m_bytes = 0;
+  }
+
+  TagArena* TagArena::current()
+  {
+    return s_currentScope ? s_currentScope->m_arena : 0;
+  }
+
+  void* TagArena::allocate( std::size_t size )
+  {
+    TagArena* arena = current();
+    return arena ? arena->alloc( size ) : ::operator new( size );
+  }
+
+  void TagArena::deallocate( void* p )
+  {
+    if( !p )
+      return;
+
+    // usually there is no Scope at all, or a single one
+    for( const Scope* s = s_currentScope; s; s = s->m_previous )
+    {
+      if( s->m_arena && s->m_arena->owns( p ) )
+        return;
+    }
+
+    ::operator delete( p );
+  }
+
+  bool TagArena::owns( const void* p ) const
+  {
+    const std::less<const void*> less;
+    const std::size_t offset = alignedSize( sizeof( Block ) );
+    for( const Block* b = m_blocks; b; b = b->next )
+    {
+      const char* start = reinterpret_cast<const char*>( b ) + offset;
+      if( !less( p, start ) && less( p, start + b->size ) )
+        return true;
+    }
+    return false;
+  }
+
+  void* TagArena::alloc( std::size_t size )
+  {
+    size = alignedSize( size );
+    const std::size_t offset = alignedSize( sizeof( Block ) );
+
+    if( !m_blocks || m_blocks->used + size > m_blocks->size )
+    {
+      const std::size_t blockSize = size > m_blockSize ? size : m_blockSize;
+      Block* b = static_cast<Block*>( malloc( offset + blockSize ) );
+      if( !b )
+        throw std::bad_alloc();
+
+      b->next = m_blocks;
+      b->size = blockSize;
+      b->used = 0;
+      m_blocks = b;
+      if( !m_first )
+        m_first = b;
+    }
+
+    void* p = reinterpret_cast<char*>( m_blocks ) + offset + m_blocks->used;
+    m_blocks->used += size;
+    ++m_allocations;
+    m_bytes += size;
+    return p;
+  }
+
+}
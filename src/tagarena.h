@@ -0,0 +1,190 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef TAGARENA_H__
+#define TAGARENA_H__
+
+#include "macros.h"
+
+#include <cstddef>
+#include <new>
+
+namespace gloox
+{
+
+  /**
+   * @brief A simple bump allocator for the nodes of parsed XML trees.
+   *
+   * While a TagArena is active in the current thread (see TagArena::Scope), Tags, their
+   * Attributes, child and attribute lists, and character data are allocated from the
+   * arena instead of the heap. Deleting such a Tag runs the destructors as usual but does
+   * not free any memory. All memory is released in one step by reset().
+   *
+   * The Parser uses a TagArena per stream if enabled using Parser::setTagArena() (or
+   * ClientBase::setTagArena()). The arena is reset after each top-level element has been
+   * handled. Tags that need to outlive the TagHandler::handleTag() call must be copied using
+   * Tag::clone(), which always allocates from the heap while the handler runs.
+   *
+   * Objects not allocated from an arena are freed normally, so Tags from both sources can
+   * be mixed freely. Heap allocations carry no overhead: whether memory belongs to an arena is
+   * decided by its address, checking the arenas of the enclosing TagArena::Scopes of the
+   * current thread. Hence, objects allocated from an arena must be destroyed while that arena
+   * is active (possibly shadowed by a nested Scope) in the same thread. The Parser takes care
+   * of that for the Tags it creates.
+   *
+   * @author Jakob Schröter <js@camaya.net>
+   * @since 1.1
+   */
+  class GLOOX_API TagArena
+  {
+    public:
+      /**
+       * @brief Activates a TagArena for the current thread for the lifetime of the Scope.
+       *
+       * The previously active arena (if any) is restored when the Scope is destroyed.
+       * Pass @b 0 to temporarily allocate from the heap.
+       */
+      class GLOOX_API Scope
+      {
+        public:
+          /**
+           * Activates the given arena.
+           * @param arena The arena to allocate from. May be 0.
+           */
+          Scope( TagArena* arena );
+
+          /**
+           * Restores the previously active arena.
+           */
+          ~Scope();
+
+        private:
+          Scope( const Scope& );
+          Scope& operator=( const Scope& );
+
+          friend class TagArena;
+
+          TagArena* m_arena;
+          Scope* m_previous;
+      };
+
+      /**
+       * Creates a new, empty TagArena.
+       * @param blockSize The size of the memory blocks the arena allocates from the heap.
+       */
+      TagArena( std::size_t blockSize = 16384 );
+
+      /**
+       * Destructor. Frees all memory. Objects allocated from the arena must be destroyed
+       * before.
+       */
+      ~TagArena();
+
+      /**
+       * Releases all allocations at once. The first block is kept for reuse.
+       */
+      void reset();
+
+      /**
+       * Returns the number of allocations served since the last reset().
+       * @return The number of allocations.
+       */
+      unsigned long allocations() const { return m_allocations; }
+
+      /**
+       * Returns the number of bytes handed out since the last reset().
+       * @return The number of bytes allocated.
+       */
+      std::size_t bytes() const { return m_bytes; }
+
+      /**
+       * Returns the arena that is active in the current thread, if any.
+       * @return The active arena, or 0.
+       */
+      static TagArena* current();
+
+      /**
+       * Allocates memory from the active arena or, if there is none, from the heap.
+       * @param size The number of bytes to allocate.
+       * @return The allocated memory.
+       */
+      static void* allocate( std::size_t size );
+
+      /**
+       * Frees memory returned by allocate(). Memory that came from an arena is released
+       * by the next TagArena::reset() instead. The arena must be active in the current thread
+       * (see above).
+       * @param p The memory to free. May be 0.
+       */
+      static void deallocate( void* p );
+
+      /**
+       * Creates a default-constructed object using allocate().
+       * @return The new object.
+       */
+      template<typename T>
+      static T* create()
+      {
+        return new( allocate( sizeof( T ) ) ) T();
+      }
+
+      /**
+       * Creates a copy-constructed object using allocate().
+       * @param t The object to copy.
+       * @return The new object.
+       */
+      template<typename T>
+      static T* create( const T& t )
+      {
+        return new( allocate( sizeof( T ) ) ) T( t );
+      }
+
+      /**
+       * Destroys an object created with create().
+       * @param t The object to destroy. May be 0.
+       */
+      template<typename T>
+      static void destroy( T* t )
+      {
+        if( !t )
+          return;
+
+        t->~T();
+        deallocate( t );
+      }
+
+    private:
+      TagArena( const TagArena& );
+      TagArena& operator=( const TagArena& );
+
+      struct Block
+      {
+        Block* next;
+        std::size_t size;
+        std::size_t used;
+      };
+
+      void* alloc( std::size_t size );
+      bool owns( const void* p ) const;
+
+      Block* m_blocks;
+      Block* m_first;
+      std::size_t m_blockSize;
+      unsigned long m_allocations;
+      std::size_t m_bytes;
+
+  };
+
+}
+
+#endif // TAGARENA_H__
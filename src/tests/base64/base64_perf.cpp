@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2004-2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#include "../../base64.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <cstdio> // [s]print[f]
+#include <cstdlib>
+
+#include <sys/time.h>
+
+static const double divider = 1000000;
+static double t;
+
+static void printTime( const char* testName, struct timeval tv1, struct timeval tv2,
+                       std::string::size_type bytes )
+{
+  t = static_cast<double>( tv2.tv_sec - tv1.tv_sec );
+  t +=  static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / divider;
+  printf( "%s: %.03f seconds (%.01f MB/s)\n", testName, t, bytes / t / ( 1024 * 1024 ) );
+}
+
+static void run( std::string::size_type size, int num )
+{
+  struct timeval tv1;
+  struct timeval tv2;
+  char name[64];
+
+  std::string data;
+  for( std::string::size_type i = 0; i < size; ++i )
+    data += static_cast<char>( rand() & 0xff );
+  const std::string encoded = Base64::encode64( data );
+  const std::string::size_type total = size * num;
+
+  std::string::size_type sum = 0;
+  sprintf( name, "encode64(), %lu bytes", static_cast<unsigned long>( size ) );
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    sum += Base64::encode64( data ).length();
+  gettimeofday( &tv2, 0 );
+  printTime( name, tv1, tv2, total );
+
+  sprintf( name, "decode64(), %lu bytes", static_cast<unsigned long>( size ) );
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    sum += Base64::decode64( encoded ).length();
+  gettimeofday( &tv2, 0 );
+  printTime( name, tv1, tv2, total );
+
+  char* buf = new char[Base64::encodedLength( size ) + 4];
+
+  sprintf( name, "Encoder, %lu bytes", static_cast<unsigned long>( size ) );
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    Base64::Encoder e;
+    const std::string::size_type n = e.update( data.data(), data.length(), buf );
+    sum += n + e.finish( buf + n );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime( name, tv1, tv2, total );
+
+  sprintf( name, "Decoder, %lu bytes", static_cast<unsigned long>( size ) );
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    Base64::Decoder d;
+    const std::string::size_type n = d.update( encoded.data(), encoded.length(), buf );
+    sum += n + d.finish( buf + n );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime( name, tv1, tv2, total );
+
+  delete[] buf;
+
+  if( sum == 0 )
+    printf( "nothing encoded or decoded\n" );
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  // an IBB chunk and an avatar
+  run( 4096, 20000 );
+  run( 200 * 1024, 400 );
+
+  return 0;
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
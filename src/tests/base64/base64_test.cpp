@@ -17,6 +17,8 @@ using namespace gloox;
 #include <locale.h>
 #include <string>
 #include <cstdio> // [s]print[f]
+#include <cstdlib>
+#include <algorithm>
 
 int main( int /*argc*/, char** /*argv*/ )
 {
@@ -54,6 +56,125 @@ int main( int /*argc*/, char** /*argv*/ )
 
 
 
+  // -------
+  name = "rfc 4648 test vectors";
+  {
+    const char* plain[] = { "f", "fo", "foo", "foob", "fooba", "foobar" };
+    const char* encoded[] = { "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+    for( int i = 0; i < 6; ++i )
+    {
+      if( Base64::encode64( plain[i] ) != encoded[i] || Base64::decode64( encoded[i] ) != plain[i] )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), plain[i] );
+      }
+    }
+  }
+
+  // -------
+  name = "all lengths, round trip";
+  {
+    srand( 42 );
+    std::string all;
+    for( int i = 0; i < 600; ++i )
+      all += static_cast<char>( rand() & 0xff );
+    for( std::string::size_type len = 0; len < all.length(); ++len )
+    {
+      sample = all.substr( 0, len );
+      b = Base64::encode64( sample );
+      if( b.length() != Base64::encodedLength( len ) || sample != Base64::decode64( b )
+          || b.find_first_not_of( "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=" )
+               != std::string::npos )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed at length %lu\n", name.c_str(), static_cast<unsigned long>( len ) );
+        break;
+      }
+    }
+  }
+
+  // -------
+  name = "Encoder/Decoder, chunked";
+  {
+    sample = "";
+    for( int i = 0; i < 5000; ++i )
+      sample += static_cast<char>( rand() & 0xff );
+    const std::string expected = Base64::encode64( sample );
+    for( std::string::size_type chunk = 1; chunk < 200; chunk += 7 )
+    {
+      Base64::Encoder e;
+      std::string out;
+      char buf[300];
+      for( std::string::size_type pos = 0; pos < sample.length(); pos += chunk )
+      {
+        const std::string::size_type len = std::min( chunk, sample.length() - pos );
+        out.append( buf, e.update( sample.data() + pos, len, buf ) );
+      }
+      out.append( buf, e.finish( buf ) );
+
+      Base64::Decoder d;
+      std::string dec;
+      for( std::string::size_type pos = 0; pos < out.length(); pos += chunk )
+      {
+        const std::string::size_type len = std::min( chunk, out.length() - pos );
+        dec.append( buf, d.update( out.data() + pos, len, buf ) );
+      }
+      dec.append( buf, d.finish( buf ) );
+
+      if( out != expected || dec != sample )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed at chunk size %lu\n", name.c_str(), static_cast<unsigned long>( chunk ) );
+        break;
+      }
+    }
+  }
+
+  // -------
+  name = "decode with line breaks";
+  {
+    std::string wrapped;
+    const std::string encoded = Base64::encode64( sample );
+    for( std::string::size_type pos = 0; pos < encoded.length(); pos += 76 )
+      wrapped += encoded.substr( pos, 76 ) + "\r\n";
+    if( Base64::decode64( wrapped ) != sample )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  name = "decode unpadded";
+  if( Base64::decode64( "Zm9vYmE" ) != "fooba" || Base64::decode64( "Zm9vYg" ) != "foob" )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
+
+  // -------
+  name = "decode empty response";
+  if( Base64::decode64( "=" ) != "" )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
+
+  // -------
+  name = "decode invalid";
+  {
+    std::string invalid = Base64::encode64( sample );
+    invalid[100] = '*';
+    if( Base64::decode64( invalid ) != "" || Base64::decode64( "Zg==Zg==" ) != ""
+        || Base64::decode64( "Z" ) != "" )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+  b = "";
+  sample = "";
+
   if( fail == 0 )
   {
     printf( "Base64: OK\n" );
@@ -0,0 +1,288 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#define CLIENTBASE_TEST
+#include "../../clientbase.h"
+#include "../../base64.h"
+#include "../../sha.h"
+#include "../../iq.h"
+#include "../../iqhandler.h"
+#include "../../message.h"
+#include "../../messagehandler.h"
+#include "../../messagesession.h"
+#include "../../presence.h"
+#include "../../presencehandler.h"
+#include "../../tag.h"
+#include "../../gloox.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <vector>
+#include <cstdio> // [s]print[f]
+#include <cstring>
+
+#include <sys/time.h>
+
+class ClientBaseTest : public ClientBase
+{
+  public:
+    ClientBaseTest() : ClientBase( "a", "b", 1 ) {}
+    virtual ~ClientBaseTest() {}
+    virtual void handleStartNode( const Tag* /*tag*/ ) {}
+    virtual bool handleNormalNode( Tag* /*tag*/ ) { return false; }
+    virtual void rosterFilled() {}
+
+    void scram( const std::string& serverFirst )
+    {
+      m_selectedSaslMech = SaslMechScramSha1;
+      m_gs2Header = "n,";
+      m_clientFirstMessageBare = "n=user,r=fyko+d2lbbFgONRv9qkxdawL";
+      processSASLChallenge( serverFirst );
+    }
+};
+
+class Handler : public IqHandler
+{
+  public:
+    Handler() : count( 0 ) {}
+    virtual bool handleIq( const IQ& /*iq*/ ) { return false; }
+    virtual void handleIqID( const IQ& /*iq*/, int /*context*/ ) { ++count; }
+    int count;
+};
+
+class Counter : public PresenceHandler, public MessageHandler
+{
+  public:
+    Counter() : count( 0 ) {}
+    virtual void handlePresence( const Presence& /*presence*/ ) { ++count; }
+    virtual void handleMessage( const Message& /*msg*/, MessageSession* /*session*/ ) { ++count; }
+    int count;
+};
+
+static double divider = 1000000;
+static int num = 200000;
+static double t;
+
+static void printTime ( const char * testName, struct timeval tv1, struct timeval tv2 )
+{
+  t = static_cast<double>( tv2.tv_sec - tv1.tv_sec );
+  t +=  static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / divider;
+  printf( "%s: %.03f seconds (%.00f/s)\n", testName, t, num / t );
+}
+
+// keeps @c window requests in flight, answering the oldest one for every new request
+static void requestResponse( int window )
+{
+  ClientBaseTest c;
+  Handler h;
+  std::vector<Tag*> results( window, static_cast<Tag*>( 0 ) );
+  const JID to( "service.example.net" );
+
+  struct timeval tv1;
+  struct timeval tv2;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num + window; ++i )
+  {
+    Tag*& r = results[i % window];
+    if( r )
+    {
+      c.handleTag( r );
+      delete r;
+      r = 0;
+    }
+    if( i >= num )
+      continue;
+
+    IQ iq( IQ::Get, to );
+    c.send( iq, &h, 0 );
+    r = new Tag( "iq" );
+    r->addAttribute( "type", "result" );
+    r->addAttribute( "id", iq.id() );
+    r->addAttribute( "from", to.full() );
+  }
+  gettimeofday( &tv2, 0 );
+
+  char name[64];
+  sprintf( name, "request/response, %d in flight", window );
+  printTime( name, tv1, tv2 );
+  if( h.count != num )
+    fprintf( stderr, "%d responses handled, expected %d\n", h.count, num );
+}
+
+// the previous Hi() of ClientBase, for comparison
+static std::string hmacString( const std::string& key, const std::string& str )
+{
+  SHA sha;
+  std::string key_ = key;
+  unsigned char ipad[65];
+  unsigned char opad[65];
+  memset( ipad, '\0', sizeof( ipad ) );
+  memset( opad, '\0', sizeof( opad ) );
+  memcpy( ipad, key_.c_str(), key_.length() );
+  memcpy( opad, key_.c_str(), key_.length() );
+  for( int i = 0; i < 64; i++ )
+  {
+    ipad[i] ^= 0x36;
+    opad[i] ^= 0x5c;
+  }
+  sha.feed( ipad, 64 );
+  sha.feed( str );
+  key_ = sha.binary();
+  sha.reset();
+  sha.feed( opad, 64 );
+  sha.feed( key_ );
+  return sha.binary();
+}
+
+static std::string hiString( const std::string& str, const std::string& salt, int iter )
+{
+  unsigned char xored[20];
+  memset( xored, '\0', sizeof( xored ) );
+  std::string tmp = salt;
+  tmp.append( "\0\0\0\1", 4 );
+  for( int i = 0; i < iter; ++i )
+  {
+    tmp = hmacString( str, tmp );
+    for( int j = 0; j < 20; ++j )
+      xored[j] = static_cast<unsigned char>( xored[j] ^ tmp[j] );
+  }
+  return std::string( reinterpret_cast<char*>( xored ), 20 );
+}
+
+static void scram()
+{
+  struct timeval tv1;
+  struct timeval tv2;
+  num = 100;
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    hiString( "pencil", "salt", 4096 );
+  gettimeofday( &tv2, 0 );
+  printTime( "SCRAM Hi(), 4096 iterations, std::string HMAC", tv1, tv2 );
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    SHA::pbkdf2( "pencil", "salt", 4096 );
+  gettimeofday( &tv2, 0 );
+  printTime( "SCRAM Hi(), 4096 iterations, SHA::pbkdf2()", tv1, tv2 );
+
+  if( hiString( "pencil", "salt", 4096 ) != SHA::pbkdf2( "pencil", "salt", 4096 ) )
+    fprintf( stderr, "SHA::pbkdf2() differs from the reference\n" );
+
+  const std::string challenge
+    = Base64::encode64( "r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,s=QSXCR+Q6sek8bf92,i=4096" );
+  ClientBaseTest c;
+  c.setPassword( "pencil" );
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    c.setScramKeys( ClientBase::ScramKeys() );
+    c.scram( challenge );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime( "SCRAM-SHA-1 challenge, deriving the keys", tv1, tv2 );
+
+  num = 10000;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    c.scram( challenge );
+  gettimeofday( &tv2, 0 );
+  printTime( "SCRAM-SHA-1 challenge, cached keys", tv1, tv2 );
+}
+
+// presences and messages from one contact, with @c contacts per-JID handlers and sessions
+static void routing( int contacts )
+{
+  ClientBaseTest c;
+  Counter h;
+  char jid[64];
+  for( int i = 0; i < contacts; ++i )
+  {
+    sprintf( jid, "contact%d@example.net", i );
+    c.registerPresenceHandler( JID( jid ), &h );
+    MessageSession* s = new MessageSession( &c, JID( std::string( jid ) + "/res" ), false, 0, false );
+    s->registerMessageHandler( &h );
+  }
+
+  sprintf( jid, "contact%d@example.net/res", contacts / 2 );
+  Presence p( Presence::Available, JID() );
+  p.setFrom( JID( jid ) );
+  Message m( Message::Chat, JID(), "body" );
+  m.setFrom( JID( jid ) );
+
+  struct timeval tv1;
+  struct timeval tv2;
+  num = 200000;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    c.notifyPresenceHandlers( p );
+  gettimeofday( &tv2, 0 );
+  char name[64];
+  sprintf( name, "presence routing, %d JIDs", contacts );
+  printTime( name, tv1, tv2 );
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    c.notifyMessageHandlers( m );
+  gettimeofday( &tv2, 0 );
+  sprintf( name, "message routing, %d sessions", contacts );
+  printTime( name, tv1, tv2 );
+
+  if( h.count != 3 * num )
+    fprintf( stderr, "%d stanzas handled, expected %d\n", h.count, 3 * num );
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  routing( 10 );
+  routing( 1000 );
+  routing( 10000 );
+
+  requestResponse( 1 );
+  requestResponse( 100 );
+  requestResponse( 10000 );
+
+  // removing the handlers of many pending requests, e.g. when closing windows
+  {
+    const int handlers = 2000;
+    num = 20000;
+    ClientBaseTest c;
+    std::vector<Handler> h( handlers );
+    const JID to( "service.example.net" );
+    for( int i = 0; i < num; ++i )
+    {
+      IQ iq( IQ::Get, to );
+      c.send( iq, &h[i % handlers], 0 );
+    }
+
+    struct timeval tv1;
+    struct timeval tv2;
+    gettimeofday( &tv1, 0 );
+    for( int i = 0; i < handlers; ++i )
+      c.removeIDHandler( &h[i] );
+    gettimeofday( &tv2, 0 );
+    num = handlers;
+    printTime( "removeIDHandler(), 20000 pending", tv1, tv2 );
+  }
+
+  scram();
+
+  return 0;
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
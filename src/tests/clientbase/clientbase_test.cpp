@@ -10,11 +10,21 @@
  *  This software is distributed without any warranty.
  */
 
+#define CLIENTBASE_TEST
 #include "../../clientbase.h"
+#include "../../base64.h"
 #include "../../connectionbase.h"
 // #include "../../logsink.h"
 // #include "../../loghandler.h"
 #include "../../connectionlistener.h"
+#include "../../error.h"
+#include "../../iq.h"
+#include "../../iqhandler.h"
+#include "../../message.h"
+#include "../../messagehandler.h"
+#include "../../messagesession.h"
+#include "../../presence.h"
+#include "../../presencehandler.h"
 #include "../../gloox.h"
 using namespace gloox;
 
@@ -23,6 +33,8 @@ using namespace gloox;
 #include <string>
 #include <cstdio> // [s]print[f]
 
+#include <unistd.h>
+
 class ClientBaseTest : public ClientBase, /*LogHandler,*/ ConnectionListener
 {
   public:
@@ -38,7 +50,7 @@ class ClientBaseTest : public ClientBase, /*LogHandler,*/ ConnectionListener
     }
     virtual ~ClientBaseTest() {}
     virtual void handleStartNode( const Tag* /*tag*/ ) { m_handleStartNodeCalled = true; }
-    virtual bool handleNormalNode(gloox::Tag*) { return true; }
+    virtual bool handleNormalNode(gloox::Tag*) { return false; }
     virtual void rosterFilled() {}
 /*    virtual void handleLog( LogLevel level, LogArea area, const std::string& message )
     {
@@ -53,6 +65,17 @@ class ClientBaseTest : public ClientBase, /*LogHandler,*/ ConnectionListener
     bool sidOK() const { return ( m_sid == "testsid" ); }
     bool versionOK() const { return m_versionOK; }
 
+    // the SCRAM-SHA-1 exchange of RFC 5802, Section 5, after the server-first-message
+    void scram( const std::string& serverFirst )
+    {
+      m_selectedSaslMech = SaslMechScramSha1;
+      m_gs2Header = "n,";
+      m_clientFirstMessageBare = "n=user,r=fyko+d2lbbFgONRv9qkxdawL";
+      processSASLChallenge( Base64::encode64( serverFirst ) );
+    }
+    bool scramSuccess( const std::string& serverFinal )
+      { return processSASLSuccess( Base64::encode64( serverFinal ) ); }
+
   protected:
       virtual bool checkStreamVersion( const std::string& version )
       {
@@ -73,7 +96,7 @@ class ConnectionImpl : public ConnectionBase
     virtual ~ConnectionImpl() {}
     virtual ConnectionError connect() { m_state = StateConnected; return ConnNoError; }
     virtual ConnectionError recv( int /*timeout = -1*/ ) { return ConnNoError; }
-    virtual bool send( const std::string& /*data*/ ) { return true; }
+    virtual bool send( const std::string& data ) { sent += data; return true; }
     virtual ConnectionError receive()
     {
       ConnectionError ce = ConnNoError;
@@ -82,12 +105,93 @@ class ConnectionImpl : public ConnectionBase
       return ConnNotConnected;
     }
     virtual void disconnect() {}
+    virtual void getStatistics( long int &totalIn, long int &totalOut ) { totalIn = totalOut = 0; }
+    virtual ConnectionBase* newInstance() const { return new ConnectionImpl( m_handler ); }
+
+    // the CData of the last SASL response sent
+    const std::string response()
+    {
+      const std::string::size_type start = sent.rfind( "<response" );
+      const std::string::size_type begin = sent.find( '>', start ) + 1;
+      const std::string r = Base64::decode64( sent.substr( begin, sent.find( "</response>", begin ) - begin ) );
+      sent = EmptyString;
+      return r;
+    }
+
+    std::string sent;
 
   private:
     int m_pos;
 
 };
 
+class IqHandlerTest : public IqHandler
+{
+  public:
+    IqHandlerTest() : results( 0 ), timeouts( 0 ), errors( 0 ) {}
+    virtual bool handleIq( const IQ& /*iq*/ ) { return false; }
+    virtual void handleIqID( const IQ& iq, int context )
+    {
+      if( iq.subtype() == IQ::Error )
+        ++errors;
+      if( iq.subtype() == IQ::Result && context == 1 )
+        ++results;
+      else if( iq.subtype() == IQ::Error && context == 2 && iq.error()
+               && iq.error()->error() == StanzaErrorRemoteServerTimeout
+               && iq.from().full() == "x@y/z" )
+        ++timeouts;
+    }
+    int results;
+    int timeouts;
+    int errors;
+};
+
+// records the order handlers are called in
+static std::string calls;
+
+class PresenceHandlerTest : public PresenceHandler
+{
+  public:
+    PresenceHandlerTest( const std::string& id, ClientBase* parent = 0 )
+      : m_id( id ), m_parent( parent ) {}
+    virtual void handlePresence( const Presence& presence )
+    {
+      calls += m_id;
+      // removes itself while the presence is being delivered
+      if( m_parent )
+        m_parent->removePresenceHandler( presence.from(), this );
+    }
+  private:
+    std::string m_id;
+    ClientBase* m_parent;
+};
+
+class MessageHandlerTest : public MessageHandler
+{
+  public:
+    MessageHandlerTest( const std::string& id ) : m_id( id ) {}
+    virtual void handleMessage( const Message& /*msg*/, MessageSession* /*session*/ )
+    {
+      calls += m_id;
+    }
+  private:
+    std::string m_id;
+};
+
+static void presence( ClientBase* c, const std::string& from )
+{
+  Presence p( Presence::Available, JID() );
+  p.setFrom( JID( from ) );
+  c->notifyPresenceHandlers( p );
+}
+
+static void message( ClientBase* c, const std::string& from )
+{
+  Message m( Message::Chat, JID(), "body" );
+  m.setFrom( JID( from ) );
+  c->notifyMessageHandlers( m );
+}
+
 int main( int /*argc*/, char** /*argv*/ )
 {
   int fail = 0;
@@ -192,13 +296,240 @@ int main( int /*argc*/, char** /*argv*/ )
   c = 0;
   t = 0;
 
+  // -------
+  name = "IQ tracking: result and timeout";
+  {
+    IqHandlerTest ih;
+    c = new ClientBaseTest( "a", "b", 1 );
+    c->setIqTimeout( 1 );
+    IQ get( IQ::Get, JID( "x@y/z" ) );
+    c->send( get, &ih, 1 );
+    IQ lost( IQ::Get, JID( "x@y/z" ) );
+    c->send( lost, &ih, 2 );
+    IQ removed( IQ::Get, JID( "x@y/z" ) );
+    IqHandlerTest ih2;
+    c->send( removed, &ih2, 2 );
+    c->removeIDHandler( &ih2 );
+    t = new Tag( "iq" );
+    t->addAttribute( "type", "result" );
+    t->addAttribute( "id", get.id() );
+    t->addAttribute( "from", "x@y/z" );
+    c->handleTag( t );
+    c->handleTag( t );
+    delete t;
+    t = 0;
+    c->checkIqTimeouts();
+    const int early = ih.timeouts;
+    usleep( 1100000 );
+    c->checkIqTimeouts();
+    c->checkIqTimeouts();
+    if( ih.results != 1 || early != 0 || ih.timeouts != 1 || ih2.timeouts != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %d results, %d/%d timeouts\n", name.c_str(), ih.results,
+               ih.timeouts, ih2.timeouts );
+    }
+    delete c;
+    c = 0;
+  }
+
+  // -------
+  name = "IQ tracking: no default timeout, per-request timeout";
+  {
+    IqHandlerTest ih;
+    c = new ClientBaseTest( "a", "b", 1 );
+    IQ kept( IQ::Get, JID( "x@y/z" ) );
+    c->send( kept, &ih, 1 );
+    IQ lost( IQ::Get, JID( "x@y/z" ) );
+    c->send( lost, &ih, 2, false, 1 );
+    c->setIqTimeout( 1 );
+    IQ never( IQ::Get, JID( "x@y/z" ) );
+    c->send( never, &ih, 3, false, 0 );
+    usleep( 1100000 );
+    c->checkIqTimeouts();
+    if( ih.timeouts != 1 || ih.errors != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %d/%d timeouts\n", name.c_str(), ih.timeouts, ih.errors );
+    }
+    delete c;
+    c = 0;
+  }
+
+
+
+  // -------
+  name = "SCRAM-SHA-1: RFC 5802 example";
+  {
+    c = new ClientBaseTest( "a", "b", 1 );
+    ConnectionImpl* conn = new ConnectionImpl( c );
+    c->setConnectionImpl( conn );
+    conn->connect();
+    c->setPassword( "pencil" );
+    c->scram( "r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,s=QSXCR+Q6sek8bf92,i=4096" );
+    const std::string r = conn->response();
+    if( r != "c=biws,r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,p=v0X8v3Bz2T0CJGbJQyF0X+HI4Ts="
+        || !c->scramSuccess( "v=rmF9pqV8S7suAoZWja4dJRkFsKQ=" ) || c->scramKeys().iterations != 4096
+        || c->scramKeys().salt != Base64::decode64( "QSXCR+Q6sek8bf92" ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), r.c_str() );
+    }
+    delete c;
+    c = 0;
+  }
+
+  // -------
+  name = "SCRAM-SHA-1: cached keys";
+  {
+    c = new ClientBaseTest( "a", "b", 1 );
+    ConnectionImpl* conn = new ConnectionImpl( c );
+    c->setConnectionImpl( conn );
+    conn->connect();
+    c->setPassword( "pencil" );
+    c->scram( "r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,s=QSXCR+Q6sek8bf92,i=4096" );
+    conn->response();
+    const ClientBase::ScramKeys keys = c->scramKeys();
+    delete c;
+
+    // the keys are used instead of the (wrong) password for the same salt and iteration count
+    c = new ClientBaseTest( "a", "b", 1 );
+    conn = new ConnectionImpl( c );
+    c->setConnectionImpl( conn );
+    conn->connect();
+    c->setPassword( "wrong" );
+    c->setScramKeys( keys );
+    c->scram( "r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,s=QSXCR+Q6sek8bf92,i=4096" );
+    const std::string cached = conn->response();
+    const bool success = c->scramSuccess( "v=rmF9pqV8S7suAoZWja4dJRkFsKQ=" );
+
+    // but not for a different iteration count
+    c->scram( "r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,s=QSXCR+Q6sek8bf92,i=4095" );
+    const std::string derived = conn->response();
+    const int iterations = c->scramKeys().iterations;
+
+    c->setPassword( "pencil" );
+    if( cached != "c=biws,r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,p=v0X8v3Bz2T0CJGbJQyF0X+HI4Ts="
+        || !success || derived.empty() || derived == cached || iterations != 4095
+        || c->scramKeys().iterations != 0 || !c->scramKeys().clientKey.empty() )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s, %s\n", name.c_str(), cached.c_str(), derived.c_str() );
+    }
+    delete c;
+    c = 0;
+  }
+
+  // -------
+  name = "presence routing by JID";
+  {
+    c = new ClientBaseTest( "a", "b", 1 );
+    PresenceHandlerTest ph1( "1" ), ph2( "2" ), ph3( "3" ), generic( "g" );
+    PresenceHandlerTest self( "s", c );
+    c->registerPresenceHandler( &generic );
+    c->registerPresenceHandler( JID( "a@b/x" ), &ph1 );
+    c->registerPresenceHandler( JID( "a@b" ), &ph2 );
+    c->registerPresenceHandler( JID( "c@d" ), &ph3 );
+    calls = "";
+    presence( c, "a@b/r" );
+    presence( c, "c@d" );
+    presence( c, "e@f/r" );
+    const std::string routed = calls;
+
+    calls = "";
+    c->removePresenceHandler( JID( "a@b" ), &ph1 );
+    presence( c, "a@b/r" );
+    c->removePresenceHandler( JID( "a@b" ), 0 );
+    presence( c, "a@b/r" );
+    const std::string removed = calls;
 
+    calls = "";
+    c->registerPresenceHandler( JID( "e@f" ), &self );
+    c->registerPresenceHandler( JID( "e@f" ), &ph1 );
+    presence( c, "e@f" );
+    presence( c, "e@f" );
+    c->removePresenceHandler( JID( "e@f" ), &ph1 );
+    presence( c, "e@f" );
+    const std::string self_removed = calls;
 
+    if( routed != "123g" || removed != "2g" || self_removed != "s11g"
+        || c->m_presenceJidHandlers.size() != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s, %s, %s, %d\n", name.c_str(), routed.c_str(),
+               removed.c_str(), self_removed.c_str(), (int)c->m_presenceJidHandlers.size() );
+    }
+    delete c;
+    c = 0;
+  }
 
+  // -------
+  name = "message session routing by full and bare JID";
+  {
+    c = new ClientBaseTest( "a", "b", 1 );
+    MessageHandlerTest mh1( "1" ), mh2( "2" ), mh3( "3" );
+    MessageSession* s1 = new MessageSession( c, JID( "a@b/r1" ), true, 0, false );
+    MessageSession* s2 = new MessageSession( c, JID( "a@b" ), true, 0, false );
+    MessageSession* s3 = new MessageSession( c, JID( "c@d/x" ), true, 0, false );
+    s1->registerMessageHandler( &mh1 );
+    s2->registerMessageHandler( &mh2 );
+    s3->registerMessageHandler( &mh3 );
 
+    // s2 follows the sender's resource
+    calls = "";
+    message( c, "a@b/r1" );
+    const std::string first = calls;
+    calls = "";
+    message( c, "a@b/r1" );
+    const std::string second = calls;
 
+    // s2 now sorts before a session registered later for the same full JID
+    calls = "";
+    MessageSession* s4 = new MessageSession( c, JID( "a@b/r2" ), false, 0, false );
+    s4->registerMessageHandler( &mh3 );
+    c->disposeMessageSession( s1 );
+    message( c, "a@b/r2" );
+    message( c, "a@b/r2" );
+    const std::string retargeted = calls;
+    const std::string target = s2->target().full();
 
+    c->disposeMessageSession( s2 );
+    c->disposeMessageSession( s4 );
+    if( first != "112" || second != "1212" || retargeted != "3232323" || target != "a@b/r2"
+        || c->m_messageSessionsFull.size() != 1 || c->m_messageSessionsBare.size() != 1
+        || s3->target().full() != "c@d/x" )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s, %s, %s, %s, %d/%d\n", name.c_str(), first.c_str(),
+               second.c_str(), retargeted.c_str(), target.c_str(),
+               (int)c->m_messageSessionsFull.size(), (int)c->m_messageSessionsBare.size() );
+    }
+    delete c;
+    c = 0;
+  }
 
+  // -------
+  name = "send: reused serialization buffer";
+  {
+    c = new ClientBaseTest( "a", "b", 1 );
+    ConnectionImpl* conn = new ConnectionImpl( c );
+    c->setConnectionImpl( conn );
+    conn->connect();
+    Tag* t = new Tag( "message", "to", "a@b/c" );
+    new Tag( t, "body", "1 < 2 & 'x'" );
+    const std::string xml = t->xml();
+    c->send( t );
+    const std::string::size_type capacity = c->m_sendBuffer.capacity();
+    c->send( new Tag( "presence" ) );
+    if( conn->sent != xml + "<presence/>" || capacity < xml.length()
+        || c->m_sendBuffer.capacity() != capacity )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), conn->sent.c_str() );
+    }
+    delete c;
+    c = 0;
+  }
 
 
 
@@ -0,0 +1,331 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#include "../../connectioneventloop.h"
+#include "../../clientbase.h"
+#include "../../iq.h"
+#include "../../iqhandler.h"
+#include "../../connectiontcpserver.h"
+#include "../../connectiontcpclient.h"
+#include "../../connectiondatahandler.h"
+#include "../../connectionhandler.h"
+#include "../../timerhandler.h"
+#include "../../logsink.h"
+#include "../../gloox.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <vector>
+#include <cstdio> // [s]print[f]
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const int port = 54329;
+static const std::string ping = "<iq type='get' id='p1'><ping xmlns='urn:xmpp:ping'/></iq>";
+
+// the server side: accepts connections into the loop and echoes everything back
+class ServerHandler : public ConnectionHandler, public ConnectionDataHandler
+{
+  public:
+    ServerHandler( ConnectionEventLoop& loop ) : m_loop( loop ), accepted( 0 ), closed( 0 ) {}
+
+    virtual ~ServerHandler()
+    {
+      std::vector<ConnectionBase*>::iterator it = m_connections.begin();
+      for( ; it != m_connections.end(); ++it )
+        delete (*it);
+    }
+
+    virtual void handleIncomingConnection( ConnectionBase* /*server*/, ConnectionBase* connection )
+    {
+      connection->registerConnectionDataHandler( this );
+      m_connections.push_back( connection );
+      if( m_loop.add( connection ) )
+        ++accepted;
+    }
+
+    virtual void handleReceivedData( const ConnectionBase* connection, const std::string& data )
+    {
+      const_cast<ConnectionBase*>( connection )->send( data );
+    }
+
+    virtual void handleConnect( const ConnectionBase* /*connection*/ ) {}
+
+    virtual void handleDisconnect( const ConnectionBase* /*connection*/, ConnectionError /*reason*/ )
+    {
+      ++closed;
+    }
+
+  private:
+    ConnectionEventLoop& m_loop;
+    std::vector<ConnectionBase*> m_connections;
+
+  public:
+    int accepted;
+    int closed;
+};
+
+// the client side: counts echoed bytes
+class ClientHandler : public ConnectionDataHandler
+{
+  public:
+    ClientHandler() : received( 0 ), complete( 0 ) {}
+
+    virtual void handleReceivedData( const ConnectionBase* /*connection*/, const std::string& data )
+    {
+      received += static_cast<long>( data.length() );
+      complete = static_cast<int>( received / static_cast<long>( ping.length() ) );
+    }
+
+    virtual void handleConnect( const ConnectionBase* /*connection*/ ) {}
+
+    virtual void handleDisconnect( const ConnectionBase* /*connection*/, ConnectionError /*reason*/ ) {}
+
+    long received;
+    int complete;
+};
+
+class TimerCounter : public TimerHandler
+{
+  public:
+    TimerCounter( ConnectionEventLoop& loop ) : m_loop( loop ), fired( 0 ), stopAt( -1 ) {}
+
+    virtual void handleTimer( int /*id*/ )
+    {
+      if( ++fired == stopAt )
+        m_loop.stop();
+    }
+
+  private:
+    ConnectionEventLoop& m_loop;
+
+  public:
+    int fired;
+    int stopAt;
+};
+
+class LoopClient : public ClientBase
+{
+  public:
+    LoopClient() : ClientBase( "jabber:client", "example.net" ) {}
+    virtual void handleStartNode( const Tag* /*start*/ ) {}
+    virtual bool handleNormalNode( Tag* /*tag*/ ) { return false; }
+    virtual void rosterFilled() {}
+};
+
+class TimeoutCounter : public IqHandler
+{
+  public:
+    TimeoutCounter() : timeouts( 0 ) {}
+    virtual bool handleIq( const IQ& /*iq*/ ) { return false; }
+    virtual void handleIqID( const IQ& iq, int /*context*/ )
+    {
+      if( iq.subtype() == IQ::Error )
+        ++timeouts;
+    }
+
+    int timeouts;
+};
+
+static double elapsed( struct timeval tv1 )
+{
+  struct timeval tv2;
+  gettimeofday( &tv2, 0 );
+  return static_cast<double>( tv2.tv_sec - tv1.tv_sec )
+         + static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / 1000000;
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  int fail = 0;
+  std::string name;
+  LogSink log;
+
+  // each connection needs two fds in this process
+  int num = 5000;
+  struct rlimit rl;
+  if( getrlimit( RLIMIT_NOFILE, &rl ) == 0 )
+  {
+    if( rl.rlim_cur < rl.rlim_max )
+    {
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit( RLIMIT_NOFILE, &rl );
+      getrlimit( RLIMIT_NOFILE, &rl );
+    }
+    if( rl.rlim_cur != RLIM_INFINITY && static_cast<int>( rl.rlim_cur ) < 2 * num + 64 )
+    {
+      num = ( static_cast<int>( rl.rlim_cur ) - 64 ) / 2;
+      printf( "fd limit too low, using %d connections\n", num );
+    }
+  }
+
+  ConnectionEventLoop loop( log );
+  ServerHandler sh( loop );
+  ClientHandler ch;
+  ConnectionTCPServer server( &sh, log, "127.0.0.1", port );
+
+  // -------
+  name = "listen";
+  if( server.connect() != ConnNoError || !loop.add( &server ) )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    return 1;
+  }
+
+  // -------
+  name = "connect and accept";
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  std::vector<ConnectionTCPClient*> clients;
+  for( int i = 0; i < num; ++i )
+  {
+    ConnectionTCPClient* c = new ConnectionTCPClient( &ch, log, "127.0.0.1", port );
+    clients.push_back( c );
+    if( c->connect() != ConnNoError || !loop.add( c ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed at connection %d\n", name.c_str(), i );
+      break;
+    }
+    // keep the listen backlog short
+    loop.poll( 0 );
+  }
+  while( sh.accepted < num && elapsed( tv ) < 30 )
+    loop.poll( 100000 );
+  if( sh.accepted != num || loop.connections() != 2 * num + 1 )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed: %d accepted, %d in the loop\n", name.c_str(), sh.accepted,
+             loop.connections() );
+  }
+  printf( "%d connections established in %.02f seconds\n", num, elapsed( tv ) );
+
+  // -------
+  name = "echo";
+  gettimeofday( &tv, 0 );
+  std::vector<ConnectionTCPClient*>::iterator it = clients.begin();
+  for( ; it != clients.end(); ++it )
+    (*it)->send( ping );
+  while( ch.complete < num && elapsed( tv ) < 30 )
+    loop.poll( 100000 );
+  if( ch.received != static_cast<long>( num * ping.length() ) )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed: %ld of %ld bytes echoed\n", name.c_str(), ch.received,
+             static_cast<long>( num * ping.length() ) );
+  }
+  printf( "%d round trips in %.02f seconds\n", num, elapsed( tv ) );
+
+  // -------
+  name = "timers";
+  {
+    TimerCounter once( loop );
+    TimerCounter repeated( loop );
+    TimerCounter removed( loop );
+    loop.registerTimer( 10, &once, false );
+    loop.removeTimer( loop.registerTimer( 10, &removed ) );
+    repeated.stopAt = 5;
+    const int id = loop.registerTimer( 20, &repeated );
+    gettimeofday( &tv, 0 );
+    loop.run();
+    const double t = elapsed( tv );
+    loop.removeTimer( id );
+    if( once.fired != 1 || repeated.fired != 5 || removed.fired != 0 || t < 0.09 || t > 5 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %d/%d/%d fired in %.03f seconds\n", name.c_str(), once.fired,
+               repeated.fired, removed.fired, t );
+    }
+  }
+
+  // -------
+  name = "disconnect";
+  gettimeofday( &tv, 0 );
+  for( it = clients.begin(); it != clients.end(); ++it )
+  {
+    loop.remove( *it );
+    delete (*it);
+  }
+  while( loop.connections() > 1 && elapsed( tv ) < 30 )
+    loop.poll( 100000 );
+  if( loop.connections() != 1 || sh.closed != num )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed: %d connections left, %d closed\n", name.c_str(),
+             loop.connections(), sh.closed );
+  }
+
+  loop.remove( &server );
+  server.disconnect();
+
+  // -------
+  name = "IQ timeouts of an idle client";
+  {
+    int sv[2];
+    if( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: socketpair()\n", name.c_str() );
+    }
+    else
+    {
+      ConnectionEventLoop iqLoop( log );
+      LoopClient client;
+      ConnectionTCPClient* conn = new ConnectionTCPClient( &client, log, "127.0.0.1" );
+      conn->setSocket( sv[0] );
+      client.setConnectionImpl( conn );
+      TimeoutCounter tc;
+      IQ lost( IQ::Get, JID( "x@y/z" ) );
+      client.send( lost, &tc, 1, false, 1 );
+      IQ kept( IQ::Get, JID( "x@y/z" ) );
+      client.send( kept, &tc, 2 );
+      iqLoop.add( &client );
+      gettimeofday( &tv, 0 );
+      while( tc.timeouts == 0 && elapsed( tv ) < 5 )
+        iqLoop.poll( 100000 );
+      const double t = elapsed( tv );
+      for( int i = 0; i < 12; ++i )
+        iqLoop.poll( 100000 );
+      iqLoop.remove( &client );
+      close( sv[1] );
+      if( tc.timeouts != 1 || t < 0.5 || t > 3 )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed: %d timeouts after %.02f seconds\n", name.c_str(),
+                 tc.timeouts, t );
+      }
+    }
+  }
+
+  if( fail == 0 )
+  {
+    printf( "ConnectionEventLoop: OK\n" );
+    return 0;
+  }
+  else
+  {
+    fprintf( stderr, "ConnectionEventLoop: %d test(s) failed\n", fail );
+    return 1;
+  }
+
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#include "../../connectiontcpclient.h"
+#include "../../connectiondatahandler.h"
+#include "../../logsink.h"
+#include "../../gloox.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <cstdio> // [s]print[f]
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double divider = 1000000;
+static int num = 500000;
+static double t;
+
+static const std::string presence = "<presence from='room@conference.example.net/nick' "
+                                    "to='user@example.net/resource'><x xmlns='http://jabber.org/"
+                                    "protocol/muc#user'><item affiliation='member' role='participant'/>"
+                                    "</x></presence>";
+
+class Handler : public ConnectionDataHandler
+{
+  public:
+    virtual void handleReceivedData( const ConnectionBase* /*connection*/, const std::string& /*data*/ ) {}
+    virtual void handleConnect( const ConnectionBase* /*connection*/ ) {}
+    virtual void handleDisconnect( const ConnectionBase* /*connection*/, ConnectionError /*reason*/ ) {}
+};
+
+static void printTime ( const char * testName, struct timeval tv1, struct timeval tv2 )
+{
+  t = static_cast<double>( tv2.tv_sec - tv1.tv_sec );
+  t +=  static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / divider;
+  printf( "%s: %.03f seconds (%.00f/s)\n", testName, t, num / t );
+}
+
+static void* reader( void* arg )
+{
+  const int fd = *static_cast<int*>( arg );
+  char buf[65536];
+  while( ::recv( fd, buf, sizeof( buf ), 0 ) > 0 )
+    ;
+  return 0;
+}
+
+// sends @c num stanzas, flushing after every @c batch of them, like an event loop iteration
+// that fans out one incoming stanza. a batch of 0 means asynchronous mode without byte budget
+static void fanOut( bool async, int batch )
+{
+  int sv[2];
+  if( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) != 0 )
+    return;
+
+  pthread_t thread;
+  pthread_create( &thread, 0, reader, &sv[1] );
+
+  LogSink log;
+  Handler h;
+  ConnectionTCPClient* c = new ConnectionTCPClient( &h, log, "localhost" );
+  c->setSocket( sv[0] );
+  if( async )
+    c->setAsyncSend( true, batch ? 16384 : 0 );
+
+  struct timeval tv1;
+  struct timeval tv2;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    c->send( presence );
+    if( async && ( !batch || ( i + 1 ) % batch == 0 ) )
+    {
+      // wait for the reader if the socket is full
+      while( c->flush() == ConnNoError && c->pendingOutput() )
+        c->recv( 1000 );
+    }
+  }
+  while( c->flush() == ConnNoError && c->pendingOutput() )
+    c->recv( 1000 );
+  gettimeofday( &tv2, 0 );
+
+  char name[64];
+  if( async && !batch )
+    sprintf( name, "asynchronous, no byte budget" );
+  else if( async )
+    sprintf( name, "asynchronous, flush every %d stanzas", batch );
+  else
+    sprintf( name, "synchronous" );
+  printTime( name, tv1, tv2 );
+
+  delete c;
+  pthread_join( thread, 0 );
+  close( sv[1] );
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  fanOut( false, 1 );
+  fanOut( true, 0 );
+  fanOut( true, 10 );
+  fanOut( true, 100 );
+  fanOut( true, 1000 );
+
+  return 0;
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
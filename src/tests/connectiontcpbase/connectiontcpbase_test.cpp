@@ -0,0 +1,462 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#include "../../connectiontcpclient.h"
+#include "../../connectioneventloop.h"
+#include "../../connectiondatahandler.h"
+#include "../../sendqueuehandler.h"
+#include "../../logsink.h"
+#include "../../gloox.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <cstdio> // [s]print[f]
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <unistd.h>
+
+static const std::string presence = "<presence from='a@b/c'/>";
+
+class Handler : public ConnectionDataHandler, public SendQueueHandler
+{
+  public:
+    Handler() : pending( 0 ), high( 0 ), low( 0 ), disconnected( 0 ) {}
+
+    virtual void handleReceivedData( const ConnectionBase* /*connection*/, const std::string& /*data*/ ) {}
+    virtual void handleConnect( const ConnectionBase* /*connection*/ ) {}
+    virtual void handleDisconnect( const ConnectionBase* /*connection*/, ConnectionError /*reason*/ )
+    {
+      ++disconnected;
+    }
+
+    virtual void handleSendQueue( const ConnectionBase* /*connection*/, SendQueueEvent event, int /*bytes*/ )
+    {
+      switch( event )
+      {
+        case SendQueuePending: ++pending; break;
+        case SendQueueHigh: ++high; break;
+        case SendQueueLow: ++low; break;
+      }
+    }
+
+    int pending;
+    int high;
+    int low;
+    int disconnected;
+};
+
+// reads what is available on the peer socket, returns the number of read() calls that returned data
+static int drain( int fd, std::string& out )
+{
+  int reads = 0;
+  char buf[65536];
+  for( ;; )
+  {
+    const ssize_t n = ::recv( fd, buf, sizeof( buf ), MSG_DONTWAIT );
+    if( n <= 0 )
+      break;
+    out.append( buf, static_cast<size_t>( n ) );
+    ++reads;
+  }
+  return reads;
+}
+
+static double elapsed( struct timeval tv1 )
+{
+  struct timeval tv2;
+  gettimeofday( &tv2, 0 );
+  return static_cast<double>( tv2.tv_sec - tv1.tv_sec )
+         + static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / 1000000;
+}
+
+// a connection on one end of a socket pair, the other end is returned in @c peer
+static ConnectionTCPClient* pair( Handler& h, const LogSink& log, int& peer, int bufsize = 0 )
+{
+  int sv[2];
+  if( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) != 0 )
+    return 0;
+
+  if( bufsize )
+  {
+    setsockopt( sv[0], SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof( bufsize ) );
+    setsockopt( sv[1], SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof( bufsize ) );
+  }
+
+  ConnectionTCPClient* c = new ConnectionTCPClient( &h, log, "localhost" );
+  c->setSocket( sv[0] );
+  c->registerSendQueueHandler( &h );
+  peer = sv[1];
+  return c;
+}
+
+static std::string chunk( int i )
+{
+  char b[16];
+  sprintf( b, "%08d", i );
+  std::string s( 1000, 'x' );
+  s.replace( 0, 8, b );
+  return s;
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  int fail = 0;
+  std::string name;
+  LogSink log;
+  int peer;
+  std::string out;
+
+  // -------
+  {
+    name = "synchronous send";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    out = "";
+    if( !c->send( presence ) || c->pendingOutput() != 0 || drain( peer, out ) != 1 || out != presence
+        || h.pending != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "queue until flush";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, 1000, 1000 );
+    out = "";
+    c->send( presence );
+    c->send( presence );
+    c->send( presence );
+    const bool queued = c->pendingOutput() == static_cast<int>( 3 * presence.length() )
+                        && c->nextFlush() > 0 && drain( peer, out ) == 0 && h.pending == 1;
+    if( !queued || c->flush() != ConnNoError || c->pendingOutput() != 0 || c->nextFlush() != 0
+        || drain( peer, out ) != 1 || out != presence + presence + presence )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    long int in, o;
+    c->getStatistics( in, o );
+    if( o != static_cast<long int>( 3 * presence.length() ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %ld bytes out\n", name.c_str(), o );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "byte budget";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, static_cast<int>( 2 * presence.length() ), 10000 );
+    out = "";
+    c->send( presence );
+    const bool queued = c->pendingOutput() != 0;
+    c->send( presence );
+    if( !queued || c->pendingOutput() != 0 || drain( peer, out ) != 1 || out != presence + presence )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "no byte budget";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, 0, 0 );
+    out = "";
+    c->send( presence );
+    if( c->pendingOutput() != 0 || drain( peer, out ) != 1 || out != presence || h.pending != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "latency budget";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, 100000, 30 );
+    out = "";
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    c->send( presence );
+    // nothing to read, so recv() returns once the queued data is due
+    const ConnectionError e = c->recv( 2000000 );
+    const double t = elapsed( tv );
+    if( e != ConnNoError || c->pendingOutput() != 0 || drain( peer, out ) != 1 || out != presence
+        || t < 0.02 || t > 1.5 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed after %.03f seconds\n", name.c_str(), t );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "backpressure";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer, 16384 );
+    c->setAsyncSend( true, 0, 0 );
+    c->setSendQueueLimits( 200000, 50000 );
+    out = "";
+    std::string expected;
+    bool ok = true;
+    for( int i = 0; i < 1000; ++i )
+    {
+      expected += chunk( i );
+      ok = ok && c->send( chunk( i ) );
+    }
+    ok = ok && h.high == 1 && h.low == 0 && h.pending == 1 && c->pendingOutput() > 200000;
+
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    while( out.length() < expected.length() && elapsed( tv ) < 10 )
+    {
+      drain( peer, out );
+      c->recv( 1000 );
+    }
+    if( !ok || out != expected || c->pendingOutput() != 0 || h.high != 1 || h.low != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %d/%d/%d events, %d pending\n", name.c_str(), h.pending,
+               h.high, h.low, c->pendingOutput() );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "switch to synchronous";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, 100000, 10000 );
+    out = "";
+    c->send( presence );
+    c->setAsyncSend( false );
+    c->send( presence );
+    if( c->pendingOutput() != 0 || drain( peer, out ) < 1 || out != presence + presence )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "write error";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, 100000, 10000 );
+    close( peer );
+    c->send( presence );
+    if( c->flush() != ConnIoError || h.disconnected != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    delete c;
+  }
+
+  // -------
+  {
+    name = "cleanup";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, 100000, 10000 );
+    c->send( presence );
+    c->cleanup();
+    out = "";
+    drain( peer, out );
+    if( c->pendingOutput() != 0 || c->nextFlush() != 0 || out != presence )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "disconnect flushes";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, 1000000, 10000 );
+    for( int i = 0; i < 100; ++i )
+      c->send( presence );
+    c->disconnect();
+    out = "";
+    drain( peer, out );
+    if( c->pendingOutput() != 0 || out.length() != 100 * presence.length() )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %d octets queued, %d received\n", name.c_str(),
+               c->pendingOutput(), static_cast<int>( out.length() ) );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "cleanup with a stalled peer";
+    Handler h;
+    ConnectionTCPClient* c = pair( h, log, peer, 4096 );
+    c->setAsyncSend( true, 0 );
+    for( int i = 0; i < 1000; ++i )
+      c->send( chunk( i ) );
+    const bool queued = c->pendingOutput() > 0;
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    c->cleanup();
+    const double t = elapsed( tv );
+    if( !queued || c->pendingOutput() != 0 || t < 0.5 || t > 3 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: cleanup took %.02f seconds\n", name.c_str(), t );
+    }
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "event loop: coalescing";
+    Handler h;
+    ConnectionEventLoop loop( log );
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true );
+    loop.add( c );
+    out = "";
+    for( int i = 0; i < 100; ++i )
+      c->send( presence );
+    const bool queued = c->pendingOutput() == static_cast<int>( 100 * presence.length() );
+    loop.poll( 0 );
+    if( !queued || c->pendingOutput() != 0 || drain( peer, out ) != 1
+        || out.length() != 100 * presence.length() )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    loop.remove( c );
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "event loop: latency budget";
+    Handler h;
+    ConnectionEventLoop loop( log );
+    ConnectionTCPClient* c = pair( h, log, peer );
+    c->setAsyncSend( true, 100000, 30 );
+    loop.add( c );
+    out = "";
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    c->send( presence );
+    loop.poll( 0 );
+    const bool held = c->pendingOutput() != 0;
+    loop.poll( 2000000 );
+    const double t = elapsed( tv );
+    if( !held || c->pendingOutput() != 0 || drain( peer, out ) != 1 || t < 0.02 || t > 1.5 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed after %.03f seconds\n", name.c_str(), t );
+    }
+    loop.remove( c );
+    delete c;
+    close( peer );
+  }
+
+  // -------
+  {
+    name = "event loop: full socket";
+    Handler h;
+    ConnectionEventLoop loop( log );
+    ConnectionTCPClient* c = pair( h, log, peer, 16384 );
+    c->setAsyncSend( true, 0, 0 );
+    loop.add( c );
+    out = "";
+    std::string expected;
+    for( int i = 0; i < 1000; ++i )
+    {
+      expected += chunk( i );
+      c->send( chunk( i ) );
+    }
+    loop.poll( 0 );
+    const bool blocked = c->pendingOutput() != 0;
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    while( out.length() < expected.length() && elapsed( tv ) < 10 )
+    {
+      drain( peer, out );
+      loop.poll( 1000 );
+    }
+    // nothing left to wait for, so this must not spin
+    gettimeofday( &tv, 0 );
+    loop.poll( 20000 );
+    const double t = elapsed( tv );
+    if( !blocked || out != expected || c->pendingOutput() != 0 || t < 0.01 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    loop.remove( c );
+    delete c;
+    close( peer );
+  }
+
+
+  if( fail == 0 )
+  {
+    printf( "ConnectionTCPBase: OK\n" );
+    return 0;
+  }
+  else
+  {
+    fprintf( stderr, "ConnectionTCPBase: %d test(s) failed\n", fail );
+    return 1;
+  }
+
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
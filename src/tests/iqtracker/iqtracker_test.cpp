@@ -0,0 +1,225 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#include "../../iqtracker.h"
+#include "../../iqhandler.h"
+#include "../../iq.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <cstdio> // [s]print[f]
+
+class Handler : public IqHandler
+{
+  public:
+    virtual bool handleIq( const IQ& /*iq*/ ) { return false; }
+    virtual void handleIqID( const IQ& /*iq*/, int /*context*/ ) {}
+};
+
+static const std::string prefix = "0123456789abcdef0123456789abcdef01234567";
+
+static void add( IqTracker& it, IqHandler* ih, const std::string& id, long long deadline,
+                 int context = 0 )
+{
+  it.add( id, ih, context, false, "a@b/c", deadline );
+}
+
+static std::string ownID( unsigned n )
+{
+  char r[9];
+  sprintf( r, "%08x", n );
+  return prefix + r;
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  int fail = 0;
+  std::string name;
+  Handler h1, h2, h3;
+  IqTracker::Track t;
+
+  // -------
+  {
+    name = "add/take own id";
+    IqTracker it;
+    it.setIDPrefix( prefix );
+    add( it, &h1, ownID( 0x1a ), 0, 5 );
+    if( it.size() != 1 || !it.take( ownID( 0x1a ), t ) || t.ih != &h1 || t.context != 5
+        || it.size() != 0
+        || it.take( ownID( 0x1a ), t ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  {
+    name = "add/take foreign ids";
+    IqTracker it;
+    it.setIDPrefix( prefix );
+    add( it, &h1, "abc", 0 );
+    add( it, &h1, prefix + "0000001A", 0 );
+    add( it, &h1, prefix + "0000001", 0 );
+    add( it, &h1, ownID( 0x1a ), 0 );
+    if( it.size() != 4 || it.take( "abcd", t )
+        || !it.take( prefix + "0000001A", t ) || !it.take( ownID( 0x1a ), t )
+        || !it.take( "abc", t ) || !it.take( prefix + "0000001", t ) || it.size() != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  {
+    name = "no prefix";
+    IqTracker it;
+    add( it, &h1, "uid1", 0 );
+    add( it, &h1, "uid2", 0 );
+    if( !it.take( "uid2", t ) || !it.take( "uid1", t ) || it.take( "uid1", t ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  {
+    name = "replace existing id";
+    IqTracker it;
+    it.setIDPrefix( prefix );
+    add( it, &h1, ownID( 1 ), 100, 1 );
+    add( it, &h2, ownID( 1 ), 0, 2 );
+    it.remove( &h1 );
+    if( it.size() != 1 || it.expire( 1000, t ) || !it.take( ownID( 1 ), t ) || t.ih != &h2
+        || t.context != 2 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  {
+    name = "remove handler";
+    IqTracker it;
+    it.setIDPrefix( prefix );
+    for( unsigned i = 0; i < 30; ++i )
+    {
+      IqHandler* ih = i % 3 == 0 ? static_cast<IqHandler*>( &h1 )
+                                 : i % 3 == 1 ? static_cast<IqHandler*>( &h2 ) : &h3;
+      add( it, ih, i % 2 ? ownID( i ) : "x" + ownID( i ), i + 1 );
+    }
+    // take some from the middle and the ends of h2's chain
+    it.take( ownID( 1 ), t );
+    it.take( "x" + ownID( 16 ), t );
+    it.take( ownID( 25 ), t );
+    it.remove( &h2 );
+    it.remove( &h2 );
+    bool ok = it.size() == 20;
+    for( unsigned i = 0; i < 30; ++i )
+    {
+      const bool found = it.take( i % 2 ? ownID( i ) : "x" + ownID( i ), t );
+      if( found != ( i % 3 != 1 ) || ( found && t.ih != ( i % 3 == 0 ? static_cast<IqHandler*>( &h1 ) : &h3 ) ) )
+        ok = false;
+    }
+    if( !ok || it.size() != 0 || it.expire( 100, t ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  {
+    name = "many handlers";
+    IqTracker it;
+    it.setIDPrefix( prefix );
+    Handler hs[500];
+    bool ok = true;
+    for( unsigned i = 0; i < 500; ++i )
+    {
+      add( it, &hs[i], ownID( 2 * i ), 0 );
+      add( it, &hs[i], ownID( 2 * i + 1 ), 0 );
+      ok = ok && it.take( ownID( 2 * i ), t ) && t.ih == &hs[i];
+      if( i % 2 )
+        ok = ok && it.take( ownID( 2 * i + 1 ), t ) && t.ih == &hs[i];
+    }
+    for( unsigned i = 0; i < 500; ++i )
+      it.remove( &hs[i] );
+    if( !ok || it.size() != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  {
+    name = "expire";
+    IqTracker it;
+    it.setIDPrefix( prefix );
+    add( it, &h1, ownID( 1 ), 300 );
+    add( it, &h2, ownID( 2 ), 100 );
+    add( it, &h1, ownID( 3 ), 0 );
+    add( it, &h3, "foo", 200 );
+    bool ok = !it.expire( 99, t );
+    ok = ok && it.expire( 250, t ) && t.ih == &h2 && t.id == ownID( 2 ) && t.to == "a@b/c";
+    ok = ok && it.expire( 250, t ) && t.ih == &h3 && t.id == "foo";
+    ok = ok && !it.expire( 250, t ) && it.size() == 2;
+    it.remove( &h1 );
+    ok = ok && !it.expire( 1000000, t ) && it.size() == 0;
+    if( !ok )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  {
+    name = "clear";
+    IqTracker it;
+    it.setIDPrefix( prefix );
+    add( it, &h1, ownID( 1 ), 1 );
+    add( it, &h2, "foo", 1 );
+    it.clear();
+    if( it.size() != 0 || it.expire( 10, t ) || it.take( "foo", t ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    add( it, &h1, "foo", 0 );
+    it.remove( &h1 );
+    if( it.size() != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+
+  if( fail == 0 )
+  {
+    printf( "IqTracker: OK\n" );
+    return 0;
+  }
+  else
+  {
+    fprintf( stderr, "IqTracker: %d test(s) failed\n", fail );
+    return 1;
+  }
+
+}
@@ -13,6 +13,7 @@
 #ifndef _WIN32
 
 #include "../../jid.h"
+#include "../../prep.h"
 using namespace gloox;
 
 #include <stdio.h>
@@ -120,9 +121,79 @@ int main( int /*argc*/, char** /*argv*/ )
   delete jid;
   printTime ("full", tv1, tv2);
 
+  // -----------------------------------------------------------------------
+
+  num = 1000000;
+  JID a( addr );
+  JID b( addr );
+  JID c( "username@server.org/other" );
+  int n = 0;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    JID d = a;
+    n += ( d == b );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("copy + compare", tv1, tv2);
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    n += ( a.bareJID() == c.bareJID() );
+  gettimeofday( &tv2, 0 );
+  printTime ("compare bareJID()", tv1, tv2);
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    n += a.equalBare( c );
+  gettimeofday( &tv2, 0 );
+  printTime ("equalBare()", tv1, tv2);
+
+  // -----------------------------------------------------------------------
+
+  // the 'from' of stanzas from 100 contacts, and of one-off senders
+  num = 200000;
+  char buf[64];
+  JID from;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    sprintf( buf, "contact%d@server.org/resource", i % 100 );
+    from.setJID( buf );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("setJID(), 100 distinct", tv1, tv2);
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    sprintf( buf, "contact%d@server.org/resource", i );
+    from.setJID( buf );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("setJID(), all distinct", tv1, tv2);
+
+  // mixed case JIDs are never canonical, so every setJID() preps all parts
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    sprintf( buf, "Contact%d@Server.org/Resource", i % 100 );
+    from.setJID( buf );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("setJID(), 100 distinct, mixed case", tv1, tv2);
 
+  prep::setCacheSize( 0 );
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    sprintf( buf, "Contact%d@Server.org/Resource", i % 100 );
+    from.setJID( buf );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("setJID(), 100 distinct, mixed case, no prep cache", tv1, tv2);
 
-  return 0;
+  return n == -1;
 }
 #else
 int main( int, char** ) { return 0; }
@@ -17,6 +17,7 @@ using namespace gloox;
 #include <locale.h>
 #include <string>
 #include <cstdio> // [s]print[f]
+#include <unordered_map>
 
 int main( int /*argc*/, char** /*argv*/ )
 {
@@ -166,13 +167,107 @@ int main( int /*argc*/, char** /*argv*/ )
     ++fail;
     fprintf( stderr, "test '%s' failed\n", name.c_str() );
   }
+  // -------
+  name = "interning";
+  {
+    JID a( "abc@server.dom/res" );
+    JID b( "abc@server.dom/res" );
+    JID c = a;
+    JID d;
+    d.setServer( "server.dom" );
+    d.setUsername( "abc" );
+    d.setResource( "res" );
+    if( a != b || a != c || a != d || &a.full() != &b.full() || &a.full() != &d.full()
+        || a.hash() != b.hash() || !d || d.full() != "abc@server.dom/res" )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
 
+  // -------
+  name = "interning: setters";
+  {
+    JID a( "abc@server.dom/res" );
+    JID b = a;
+    b.setResource( "other" );
+    JID c = a;
+    c.setJID( "server2.dom" );
+    if( a.full() != "abc@server.dom/res" || b.full() != "abc@server.dom/other" || a == b
+        || c.full() != "server2.dom" || !c.username().empty() || !c.resource().empty() )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), c.full().c_str() );
+    }
+  }
 
+  // -------
+  name = "interning: bare JIDs";
+  {
+    JID a( "abc@server.dom/res" );
+    JID b( "abc@server.dom/other" );
+    JID c( "abc@server.dom" );
+    JID o( "xyz@server.dom/res" );
+    if( !a.equalBare( b ) || !a.equalBare( c ) || a.equalBare( o ) || a.bareJID() != c
+        || &a.bareJID().full() != &c.full() || a.bareHash() != c.hash() || a.bareHash() != b.bareHash()
+        || a.bare() != "abc@server.dom" || !a.bareJID() )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
 
+  // -------
+  name = "interning: empty JIDs";
+  {
+    JID a;
+    JID b( "" );
+    JID c( "abc@server.dom" );
+    c.setJID( "" );
+    if( a != b || a != c || a.hash() != 0 || a || c || !a.full().empty() || !a.bareJID().bare().empty()
+        || a.equalBare( JID( "abc@server.dom" ) ) || !a.equalBare( c ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
 
+  // -------
+  name = "interning: many JIDs";
+  {
+    bool ok = true;
+    char buf[64];
+    for( int i = 0; i < 20000 && ok; ++i )
+    {
+      sprintf( buf, "user%d@server.dom", i % 7000 );
+      const std::string bare = buf;
+      sprintf( buf, "user%d@server.dom/res%d", i % 7000, i );
+      JID a( buf );
+      ok = a.full() == buf && a.bareJID().full() == bare && a.equalBare( JID( bare ) );
+    }
+    JID again( "user1@server.dom/res1" );
+    if( !ok || again.resource() != "res1" || !again.equalBare( JID( "user1@server.dom" ) ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
 
-
-
+  // -------
+  name = "hash table key";
+  {
+    std::unordered_map<JID, int> m;
+    m[JID( "abc@server.dom/res" )] = 1;
+    m[JID( "abc@server.dom" )] = 2;
+    JID a( "abc@server.dom/res" );
+    std::unordered_map<JID, int>::const_iterator it = m.find( a );
+    std::unordered_map<JID, int>::const_iterator it2 = m.find( a.bareJID() );
+    if( m.size() != 2 || it == m.end() || (*it).second != 1 || it2 == m.end() || (*it2).second != 2 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
 
 
 
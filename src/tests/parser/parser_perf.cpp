@@ -0,0 +1,152 @@
+/*
+ *  Copyright (c) 2004-2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#include "../../parser.h"
+#include "../../taghandler.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <algorithm>
+#include <string>
+#include <cstdio> // [s]print[f]
+
+#include <sys/time.h>
+#include <cstdlib>
+#include <new>
+
+static unsigned long allocs = 0;
+static unsigned long allocBytes = 0;
+
+void* operator new( std::size_t size )
+{
+  ++allocs;
+  allocBytes += size;
+  void* p = malloc( size ? size : 1 );
+  if( !p )
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete( void* p ) noexcept { free( p ); }
+void operator delete( void* p, std::size_t ) noexcept { free( p ); }
+
+static const double divider = 1000000;
+static const int num = 50000;
+static const std::string::size_type chunkSize = 4096;
+static double t;
+
+static void printTime( const char* testName, struct timeval tv1, struct timeval tv2,
+                       std::string::size_type bytes )
+{
+  t = static_cast<double>( tv2.tv_sec - tv1.tv_sec );
+  t +=  static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / divider;
+  printf( "%s: %.03f seconds (%.01f MB/s)\n", testName, t, bytes / t / ( 1024 * 1024 ) );
+}
+
+class PerfHandler : public TagHandler
+{
+  public:
+    PerfHandler() : count( 0 ) {}
+    virtual void handleTag( Tag* /*tag*/ ) { ++count; }
+    int count;
+};
+
+static const std::string header = "<stream:stream xmlns='jabber:client' "
+  "xmlns:stream='http://etherx.jabber.org/streams' version='1.0'>";
+
+static const std::string stanzas[] =
+{
+  "<message from='juliet@example.com/balcony' to='romeo@example.net' type='chat' id='ktx72v49'>"
+  "<body>Art thou not Romeo, and a Montague? &lt;3</body>"
+  "<active xmlns='http://jabber.org/protocol/chatstates'/></message>",
+  "<presence from='romeo@example.net/orchard'><show>away</show><priority>5</priority>"
+  "<c xmlns='http://jabber.org/protocol/caps' hash='sha-1' node='http://gloox.im' "
+  "ver='QgayPKawpkPSDYmwT/WM94uAlu0='/></presence>",
+  "<iq type='result' id='roster_1' to='juliet@example.com/balcony'>"
+  "<query xmlns='jabber:iq:roster' ver='ver11'>"
+  "<item jid='romeo@example.net' name='Romeo' subscription='both'><group>Friends</group></item>"
+  "<item jid='mercutio@example.com' name='Mercutio' subscription='from'/>"
+  "<item jid='benvolio@example.net' name='Benvolio' subscription='both'/>"
+  "</query></iq>",
+};
+
+static void run( const std::string& stream, bool copy, const char* name, int expected = num + 1,
+                 bool arena = false )
+{
+  struct timeval tv1;
+  struct timeval tv2;
+
+  PerfHandler ph;
+  Parser p( &ph );
+  p.setTagArena( arena );
+
+  const unsigned long a = allocs;
+  const unsigned long b = allocBytes;
+
+  gettimeofday( &tv1, 0 );
+  for( std::string::size_type pos = 0; pos < stream.length(); pos += chunkSize )
+  {
+    const std::string::size_type len = std::min( chunkSize, stream.length() - pos );
+    if( copy )
+    {
+      // what the std::string based receive chain did: one string per layer
+      std::string received( stream.data() + pos, len );
+      std::string data = received;
+      p.feed( data );
+    }
+    else
+      p.feed( stream.data() + pos, len );
+  }
+  gettimeofday( &tv2, 0 );
+
+  if( ph.count != expected )
+    printf( "%s: parsed %d of %d stanzas\n", name, ph.count, expected );
+  printTime( name, tv1, tv2, stream.length() );
+  printf( "%s: %.01f allocations (%.00f bytes) per stanza\n", name,
+          static_cast<double>( allocs - a ) / expected, static_cast<double>( allocBytes - b ) / expected );
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  std::string stream = header;
+  for( int i = 0; i < num; ++i )
+    stream += stanzas[i % 3];
+
+  printf( "Parsing %d stanzas (%lu bytes) in %lu byte chunks...\n", num,
+          static_cast<unsigned long>( stream.length() ), static_cast<unsigned long>( chunkSize ) );
+
+  run( stream, true, "feed( std::string& ) with copies" );
+  run( stream, false, "feed( const char*, length )" );
+  run( stream, false, "feed( const char*, length ), TagArena", num + 1, true );
+
+  // avatar/file transfer sized payloads, i.e. long runs of cdata
+  const int numLarge = 50;
+  std::string payload;
+  for( int i = 0; payload.length() < 256 * 1024; ++i )
+    payload += "iVBORw0KGgoAAAANSUhEUgAAAEAAAABACAYAAACqaXHeAAAgAElEQVR4nO2de3gU9b3/3zO7m+"[i % 72];
+  std::string large = header;
+  for( int i = 0; i < numLarge; ++i )
+    large += "<iq type='set' id='ibb" + std::string( 1, char( 'a' + i % 26 ) ) + "' to='romeo@example.net/orchard'>"
+             "<data xmlns='http://jabber.org/protocol/ibb' seq='0' sid='i781b32'>" + payload + "</data></iq>";
+
+  printf( "Parsing %d stanzas with %lu bytes of cdata each...\n", numLarge,
+          static_cast<unsigned long>( payload.length() ) );
+  run( large, false, "feed( const char*, length ), large cdata", numLarge + 1 );
+
+  return 0;
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
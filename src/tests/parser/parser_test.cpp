@@ -1303,23 +1303,86 @@ class ParserTest : private TagHandler
       m_tag = 0;
 #endif
 
+      // -------
+      name = "TagArena";
+      p->setTagArena( true );
+      data = "<message to='me@example.net' type='chat'><body>hi</body>"
+             "<x xmlns='jabber:x:data' type='form'><field var='a'><value>b</value></field></x>"
+             "</message><presence/>";
+      p->feed( data );
+      if( m_tag == 0 || m_tag->name() != "presence" )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s: %s' failed\n", name.c_str(), data.c_str() );
+      }
+      delete m_tag;
+      m_tag = 0;
 
+      // -------
+      name = "TagArena, split input";
+      std::string data1 = "<message to='me@example.net'><body>h";
+      std::string data2 = "i</body><x xmlns='jabber:x:data'/></message>";
+      p->feed( data1 );
+      p->feed( data2 );
+      if( m_tag == 0 || m_tag->name() != "message" || m_tag->findCData( "/message/body" ) != "hi"
+          || !m_tag->findChild( "x", "xmlns", "jabber:x:data" )
+          || m_tag->xml() != "<message to='me@example.net'><body>hi</body>"
+                             "<x xmlns='jabber:x:data'/></message>" )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), m_tag ? m_tag->xml().c_str() : "" );
+      }
+      delete m_tag;
+      m_tag = 0;
+      p->setTagArena( false );
 
+      // -------
+      name = "feed( const char*, length ), split tokens";
+      data = "<message><body>a &amp; b</body><x><![CDATA[<c>]]></x></message>junk";
+      for( std::string::size_type split = 1; split < data.length() - 4; ++split )
+      {
+        delete m_tag;
+        m_tag = 0;
+        p->feed( data.data(), split );
+        p->feed( data.data() + split, data.length() - 4 - split );
+        if( m_tag == 0 || m_tag->findCData( "/message/body" ) != "a & b"
+            || m_tag->findCData( "/message/x" ) != "<c>" )
+        {
+          ++fail;
+          fprintf( stderr, "test '%s' failed at %d\n", name.c_str(), static_cast<int>( split ) );
+          break;
+        }
+      }
+      delete m_tag;
+      m_tag = 0;
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+      // -------
+      name = "long cdata and attribute values";
+      {
+        const std::string run( 1000, 'A' );
+        data = "<message a=\"" + run + "'x&lt;" + run + "\"><body>" + run + "&amp;" + run
+               + "]]&gt;</body><x><![CDATA[" + run + "]]" + run + "]]></x></message>";
+        const std::string value = run + "'x<" + run;
+        const std::string body = run + "&" + run + "]]>";
+        const std::string cdata = run + "]]" + run;
+        for( std::string::size_type split = 1; split < data.length(); split += 97 )
+        {
+          delete m_tag;
+          m_tag = 0;
+          p->feed( data.data(), split );
+          p->feed( data.data() + split, data.length() - split );
+          if( m_tag == 0 || m_tag->findAttribute( "a" ) != value
+              || m_tag->findCData( "/message/body" ) != body
+              || m_tag->findCData( "/message/x" ) != cdata )
+          {
+            ++fail;
+            fprintf( stderr, "test '%s' failed at %d\n", name.c_str(), static_cast<int>( split ) );
+            break;
+          }
+        }
+        delete m_tag;
+        m_tag = 0;
+      }
 
       delete p;
       p = 0;
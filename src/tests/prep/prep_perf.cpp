@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#include "../../prep.h"
+#include "../../jid.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <cstdio> // [s]print[f]
+
+#include <sys/time.h>
+
+static double divider = 1000000;
+static int num = 1000000;
+static double t;
+
+static void printTime ( const char * testName, struct timeval tv1, struct timeval tv2 )
+{
+  t = static_cast<double>( tv2.tv_sec - tv1.tv_sec );
+  t +=  static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / divider;
+  printf( "%s: %.03f seconds (%.00f/s)\n", testName, t, num / t );
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  struct timeval tv1;
+  struct timeval tv2;
+  std::string out;
+  int n = 0;
+
+  printf( "Testing %d...\n", num );
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    n += prep::nodeprep( "username", out );
+  gettimeofday( &tv2, 0 );
+  printTime ("nodeprep(), canonical", tv1, tv2);
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    n += prep::nameprep( "Server.org", out );
+  gettimeofday( &tv2, 0 );
+  printTime ("nameprep(), mixed case", tv1, tv2);
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    n += prep::resourceprep( "Resource", out );
+  gettimeofday( &tv2, 0 );
+  printTime ("resourceprep(), canonical", tv1, tv2);
+
+  prep::CacheStats s = prep::cacheStats( prep::Nameprep );
+  printf( "nameprep cache: %lu hits, %lu misses, %lu fast path\n", s.hits, s.misses, s.fastPath );
+
+  // -----------------------------------------------------------------------
+
+  // the 'from' of stanzas from 1000 contacts; mixed case, so they are prepped every time
+  char buf[64];
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    sprintf( buf, "Contact%d@Server.org/Resource", i % 1000 );
+    JID from( buf );
+    n += from.username().length() > 0;
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("JID(), 1000 distinct, mixed case", tv1, tv2);
+
+  s = prep::cacheStats( prep::Nodeprep );
+  printf( "nodeprep cache: %lu hits, %lu misses, %lu fast path\n", s.hits, s.misses, s.fastPath );
+
+  prep::setCacheSize( 0 );
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    sprintf( buf, "Contact%d@Server.org/Resource", i % 1000 );
+    JID from( buf );
+    n += from.username().length() > 0;
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("JID(), 1000 distinct, mixed case, no cache", tv1, tv2);
+
+  return n == -1;
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
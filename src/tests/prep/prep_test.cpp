@@ -10,7 +10,7 @@
  *  This software is distributed without any warranty.
  */
 
-#include "../../prep.h"
+#include "../../prep.cpp"
 using namespace gloox;
 
 #include <stdio.h>
@@ -18,6 +18,21 @@ using namespace gloox;
 #include <string>
 #include <cstdio> // [s]print[f]
 
+static int calls = 0;
+
+// lowercases, rejects '!'
+static bool lower( const std::string& in, std::string& out )
+{
+  ++calls;
+  if( in.empty() || in.find( '!' ) != std::string::npos )
+    return false;
+  out = in;
+  for( std::string::iterator it = out.begin(); it != out.end(); ++it )
+    if( (*it) >= 'A' && (*it) <= 'Z' )
+      (*it) = static_cast<char>( (*it) - 'A' + 'a' );
+  return true;
+}
+
 int main( int /*argc*/, char** /*argv*/ )
 {
   int fail = 0;
@@ -136,6 +151,171 @@ int main( int /*argc*/, char** /*argv*/ )
   }
   result = "";
 
+  // -------
+  name = "cache: ascii fast path";
+  {
+    prep::Cache c( prep::Nodeprep );
+    calls = 0;
+    if( !c.prep( "user.name_1", result, lower ) || result != "user.name_1"
+        || calls != 0 || c.stats().fastPath != 1 || c.stats().entries != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+  result = "";
+
+  // -------
+  name = "cache: not canonical per profile";
+  {
+    prep::Cache node( prep::Nodeprep );
+    prep::Cache domain( prep::Nameprep );
+    prep::Cache res( prep::Resourceprep );
+    calls = 0;
+    node.prep( "a@b", result, lower );
+    node.prep( "a b", result, lower );
+    node.prep( "Ab", result, lower );
+    node.prep( "d\xc3\xb6m", result, lower );
+    domain.prep( "a b", result, lower );
+    domain.prep( "Ab", result, lower );
+    domain.prep( "a\tb", result, lower );
+    if( calls != 7 || node.stats().fastPath != 0 || domain.stats().fastPath != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    calls = 0;
+    domain.prep( "a@b:c", result, lower );
+    res.prep( "Res Ource@/:", result, lower );
+    res.prep( "a\tb", result, lower );
+    if( calls != 1 || domain.stats().fastPath != 1 || res.stats().fastPath != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed (canonical)\n", name.c_str() );
+    }
+  }
+  result = "";
+
+  // -------
+  name = "cache: hits";
+  {
+    prep::Cache c( prep::Nodeprep );
+    calls = 0;
+    bool ok = c.prep( "UsEr", result, lower ) && result == "user";
+    result = "";
+    ok = ok && c.prep( "UsEr", result, lower ) && result == "user";
+    prep::CacheStats s = c.stats();
+    if( !ok || calls != 1 || s.hits != 1 || s.misses != 1 || s.entries != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+  result = "";
+
+  // -------
+  name = "cache: failures";
+  {
+    prep::Cache c( prep::Nodeprep );
+    calls = 0;
+    result = "untouched";
+    bool ok = !c.prep( "Bad!", result, lower ) && !c.prep( "Bad!", result, lower );
+    if( !ok || result != "untouched" || calls != 1 || c.stats().hits != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+  result = "";
+
+  // -------
+  name = "cache: empty and oversized input";
+  {
+    prep::Cache c( prep::Nodeprep );
+    calls = 0;
+    c.prep( std::string(), result, lower );
+    c.prep( std::string( 1200, 'X' ), result, lower );
+    prep::CacheStats s = c.stats();
+    if( calls != 2 || s.hits || s.misses || s.fastPath || s.entries )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+  result = "";
+
+  // -------
+  name = "cache: size";
+  {
+    prep::Cache c( prep::Nodeprep );
+    c.setSize( 2 );
+    c.prep( "A", result, lower );
+    c.prep( "B", result, lower );
+    c.prep( "A", result, lower );
+    c.prep( "C", result, lower );
+    calls = 0;
+    c.prep( "A", result, lower );
+    c.prep( "C", result, lower );
+    if( c.stats().entries != 2 || calls != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    c.prep( "B", result, lower );
+    if( calls != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed (lru)\n", name.c_str() );
+    }
+    c.setSize( 0 );
+    calls = 0;
+    c.prep( "A", result, lower );
+    c.prep( "A", result, lower );
+    if( c.stats().entries != 0 || calls != 2 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed (disabled)\n", name.c_str() );
+    }
+    c.clear();
+    prep::CacheStats s = c.stats();
+    if( s.hits || s.misses || s.fastPath || s.entries )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed (clear)\n", name.c_str() );
+    }
+  }
+  result = "";
+
+  // -------
+  name = "cache stats";
+  {
+    prep::clearCache();
+    prep::nodeprep( "UsEr", result );
+    prep::nodeprep( "UsEr", result );
+    prep::nameprep( "example.org", result );
+    prep::CacheStats node = prep::cacheStats( prep::Nodeprep );
+    prep::CacheStats domain = prep::cacheStats( prep::Nameprep );
+#ifdef HAVE_LIBIDN
+    if( node.hits != 1 || node.misses != 1 || node.entries != 1 || domain.fastPath != 1 )
+#else
+    if( node.hits || node.misses || node.entries || domain.fastPath )
+#endif
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    prep::setCacheSize( 0 );
+    prep::nodeprep( "UsEr", result );
+    if( prep::cacheStats( prep::Nodeprep ).entries != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed (size)\n", name.c_str() );
+    }
+    prep::setCacheSize( 4096 );
+  }
+  result = "";
+
+
 
 
 
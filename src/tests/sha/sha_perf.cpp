@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#include "../../sha.cpp"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <cstdio> // [s]print[f]
+
+#include <sys/time.h>
+
+static const double divider = 1000000;
+
+static double wallTime()
+{
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return static_cast<double>( tv.tv_sec ) + static_cast<double>( tv.tv_usec ) / divider;
+}
+
+// latency of hashing short strings, e.g. XEP-0115 verification strings or SCRAM messages
+static void small( const char* testName, const std::string& data, int num )
+{
+  std::string hex;
+  const double t = wallTime();
+  for( int i = 0; i < num; ++i )
+    hex = SHA::hex( data );
+  const double d = wallTime() - t;
+  printf( "%s (%d bytes): %.00f ns per hash\n", testName, static_cast<int>( data.length() ),
+          d * 1000000000 / num );
+}
+
+static void bulk( const char* testName, CompressFunc compressBlocks )
+{
+  const unsigned blocks = 16384; // 1 MB
+  unsigned char* data = new unsigned char[blocks * 64];
+  for( unsigned i = 0; i < blocks * 64; ++i )
+    data[i] = static_cast<unsigned char>( i );
+
+  unsigned h[5];
+  memcpy( h, IV, sizeof( IV ) );
+  const int mb = 64;
+  const double t = wallTime();
+  for( int i = 0; i < mb; ++i )
+    compressBlocks( h, data, blocks );
+  const double d = wallTime() - t;
+  printf( "bulk, %s: %.01f MB/s\n", testName, mb / d );
+  delete[] data;
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  small( "SHA::hex()", "abc", 200000 );
+  small( "SHA::hex(), caps verification string",
+         "client/pc//Exodus 0.9.1<http://jabber.org/protocol/caps<http://jabber.org/protocol/disco#info<"
+         "http://jabber.org/protocol/disco#items<http://jabber.org/protocol/muc<", 200000 );
+
+  const int num = 50;
+  const double t = wallTime();
+  for( int i = 0; i < num; ++i )
+    SHA::pbkdf2( "pencil", "salt", 4096 );
+  printf( "SHA::pbkdf2(), 4096 iterations: %.03f ms\n", ( wallTime() - t ) * 1000 / num );
+
+  bulk( "scalar", compressScalar );
+#if defined( GLOOX_SHA_X86 )
+  unsigned eax, ebx, ecx, edx;
+  if( __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) && ( ecx & bit_SSSE3 ) )
+    bulk( "SSSE3 message schedule", compressSSSE3 );
+  if( resolveCompress() == compressSHANI )
+    bulk( "SHA-NI", compressSHANI );
+#endif
+
+  return 0;
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
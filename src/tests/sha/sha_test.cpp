@@ -10,7 +10,7 @@
  *  This software is distributed without any warranty.
  */
 
-#include "../../sha.h"
+#include "../../sha.cpp"
 using namespace gloox;
 
 #include <stdio.h>
@@ -18,6 +18,18 @@ using namespace gloox;
 #include <string>
 #include <cstdio> // [s]print[f]
 
+static const std::string toHex( const std::string& binary )
+{
+  char buf[3];
+  std::string hex;
+  for( std::string::size_type i = 0; i < binary.length(); ++i )
+  {
+    sprintf( buf, "%02x", static_cast<unsigned char>( binary[i] ) );
+    hex += buf;
+  }
+  return hex;
+}
+
 int main( int /*argc*/, char** /*argv*/ )
 {
   int fail = 0;
@@ -130,6 +142,120 @@ int main( int /*argc*/, char** /*argv*/ )
   }
   sha.reset();
 
+  // -------
+  name = "odd-sized steps across blocks";
+  {
+    std::string data;
+    for( int i = 0; i < 5; ++i )
+      for( int j = 0; j < 256; ++j )
+        data.push_back( static_cast<char>( j ) );
+    std::string::size_type pos = 0;
+    for( std::string::size_type step = 1; pos < data.length(); step += 7 )
+    {
+      sha.feed( data.substr( pos, step ) );
+      pos += step;
+    }
+    sha.finalize();
+    if( sha.hex() != "e37a04cb2353309f5cff4ee036cfb91a5e31cefd" )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), sha.hex().c_str() );
+    }
+    sha.reset();
+  }
+
+  // -------
+  name = "HMAC-SHA1 (RFC 2202, test case 1)";
+  if( toHex( SHA::hmac( std::string( 20, '\x0b' ), "Hi There" ) ) != "b617318655057264e28bc0b6fb378c8ef146be00" )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
+
+  // -------
+  name = "HMAC-SHA1 (RFC 2202, test case 2)";
+  if( toHex( SHA::hmac( "Jefe", "what do ya want for nothing?" ) ) != "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79" )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
+
+  // -------
+  name = "HMAC-SHA1 (RFC 2202, test case 6, key longer than a block)";
+  if( toHex( SHA::hmac( std::string( 80, '\xaa' ), "Test Using Larger Than Block-Size Key - Hash Key First" ) )
+      != "aa4ae5e15272d00e95705637ce8a3b55ed402112" )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
+
+  // -------
+  name = "PBKDF2-HMAC-SHA1 (RFC 6070, 1 iteration)";
+  if( toHex( SHA::pbkdf2( "password", "salt", 1 ) ) != "0c60c80f961f0e71f3a9b524af6012062fe037a6" )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
+
+  // -------
+  name = "PBKDF2-HMAC-SHA1 (RFC 6070, 2 iterations)";
+  if( toHex( SHA::pbkdf2( "password", "salt", 2 ) ) != "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957" )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
+
+  // -------
+  name = "PBKDF2-HMAC-SHA1 (RFC 6070, 4096 iterations)";
+  if( toHex( SHA::pbkdf2( "password", "salt", 4096 ) ) != "4b007901b765489abead49d926f721d065a429c1" )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
+
+
+
+  // -------
+  name = "compression functions";
+  {
+    unsigned char data[64 * 37];
+    for( unsigned i = 0; i < sizeof( data ); ++i )
+      data[i] = static_cast<unsigned char>( i * 131 + ( i >> 8 ) );
+
+    unsigned ref[5];
+    memcpy( ref, IV, sizeof( IV ) );
+    compressScalar( ref, data, 37 );
+
+    CompressFunc funcs[2] = { 0, 0 };
+    const char* names[2] = { "SSSE3", "SHA-NI" };
+#if defined( GLOOX_SHA_X86 )
+    unsigned eax, ebx, ecx, edx;
+    if( __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) && ( ecx & bit_SSSE3 ) )
+    {
+      funcs[0] = compressSSSE3;
+      if( resolveCompress() == compressSHANI )
+        funcs[1] = compressSHANI;
+    }
+#endif
+    for( int f = 0; f < 2; ++f )
+    {
+      if( !funcs[f] )
+      {
+        printf( "SHA: %s not available, not tested\n", names[f] );
+        continue;
+      }
+      unsigned h[5];
+      memcpy( h, IV, sizeof( IV ) );
+      funcs[f]( h, data, 1 );
+      funcs[f]( h, data + 64, 36 );
+      if( memcmp( h, ref, sizeof( ref ) ) )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), names[f] );
+      }
+    }
+  }
+
 
 
   if( fail == 0 )
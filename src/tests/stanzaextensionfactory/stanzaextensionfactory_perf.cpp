@@ -10,9 +10,12 @@
  *  This software is distributed without any warranty.
  */
 
+#ifndef _WIN32
+
 #include "../../stanzaextension.h"
 #include "../../stanzaextensionfactory.h"
-#include "../../iq.h"
+#include "../../message.h"
+#include "../../presence.h"
 #include "../../tag.h"
 using namespace gloox;
 
@@ -21,72 +24,188 @@ using namespace gloox;
 #include <string>
 #include <cstdio> // [s]print[f]
 
-class SETest : public StanzaExtension
+#include <sys/time.h>
+
+class SEPerf : public StanzaExtension
 {
   public:
-    SETest( const Tag* tag ) : StanzaExtension( ExtUser + 1 ), m_tag( const_cast<Tag*>( tag ) ) {}
-    ~SETest() {}
+    SEPerf( int type, const std::string& filter ) : StanzaExtension( type ), m_filter( filter ) {}
+    ~SEPerf() {}
 
-    virtual const std::string& filterString() const
-    {
-      static const std::string filter = "/foo/bar";
-      return filter;
-    }
+    virtual const std::string& filterString() const { return m_filter; }
 
-    virtual StanzaExtension* newInstance( const Tag* tag ) const
-    { return new SETest( tag ); }
+    virtual StanzaExtension* newInstance( const Tag* /*tag*/ ) const
+    { return new SEPerf( extensionType(), m_filter ); }
 
-    virtual Tag* tag() const
-    { return m_tag; }
+    virtual Tag* tag() const { return 0; }
 
     virtual StanzaExtension* clone() const
-    { return new SETest( m_tag ? m_tag->clone() : 0 ); }
+    { return new SEPerf( extensionType(), m_filter ); }
 
   private:
-    Tag* m_tag;
+    std::string m_filter;
 
 };
 
+static const double divider = 1000000;
+static const int num = 2500;
+static double t;
+
+static void printTime ( const char * testName, struct timeval tv1, struct timeval tv2 )
+{
+  t = static_cast<double>( tv2.tv_sec - tv1.tv_sec );
+  t +=  static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / divider;
+  printf( "%s: %.03f seconds (%.00f stanzas/s)\n", testName, t, num / t );
+}
+
+static const char* filters[] =
+{
+  "/message/x[@xmlns='jabber:x:data']",
+  "/message/x[@xmlns='jabber:x:event']",
+  "/message/x[@xmlns='jabber:x:encrypted']",
+  "/message/x[@xmlns='jabber:x:conference']",
+  "/message/x[@xmlns='http://jabber.org/protocol/muc#user']",
+  "/message/html[@xmlns='http://jabber.org/protocol/xhtml-im']",
+  "/message/amp[@xmlns='http://jabber.org/protocol/amp']",
+  "/message/attention[@xmlns='urn:xmpp:attention:0']",
+  "/message/event[@xmlns='http://jabber.org/protocol/pubsub#event']",
+  "/message/addresses[@xmlns='http://jabber.org/protocol/address']",
+  "/message/markup[@xmlns='urn:xmpp:markup:0']",
+  "/message/reference[@xmlns='urn:xmpp:reference:0']",
+  "/message/sxe[@xmlns='urn:xmpp:sxe:0']",
+  "/message/*[@xmlns='urn:xmpp:hints']",
+  "/message/*[@xmlns='urn:xmpp:carbons:2']",
+  "/message/active[@xmlns='http://jabber.org/protocol/chatstates']"
+  "|/message/composing[@xmlns='http://jabber.org/protocol/chatstates']"
+  "|/message/paused[@xmlns='http://jabber.org/protocol/chatstates']",
+  "/message/request[@xmlns='urn:xmpp:receipts']|/message/received[@xmlns='urn:xmpp:receipts']",
+  "/message/received[@xmlns='urn:xmpp:chat-markers:0']"
+  "|/message/displayed[@xmlns='urn:xmpp:chat-markers:0']",
+  "/message/forwarded[@xmlns='urn:xmpp:forward:0']|/iq/forwarded[@xmlns='urn:xmpp:forward:0']",
+  "/message/propose[@xmlns='urn:xmpp:jingle-message:0']"
+  "|/message/retract[@xmlns='urn:xmpp:jingle-message:0']"
+  "|/message/accept[@xmlns='urn:xmpp:jingle-message:0']",
+  "/presence/c[@xmlns='http://jabber.org/protocol/caps']",
+  "/presence/x[@xmlns='http://jabber.org/protocol/muc']",
+  "/presence/x[@xmlns='http://jabber.org/protocol/muc#user']",
+  "/presence/x[@xmlns='vcard-temp:x:update']",
+  "/presence/x[@xmlns='jabber:x:signed']|/message/x[@xmlns='jabber:x:signed']",
+  "/presence/x[@xmlns='jabber:x:oob']|/message/x[@xmlns='jabber:x:oob']",
+  "/presence/nick[@xmlns='http://jabber.org/protocol/nick']"
+  "|/message/nick[@xmlns='http://jabber.org/protocol/nick']",
+  "/presence/delay[@xmlns='urn:xmpp:delay']|/message/delay[@xmlns='urn:xmpp:delay']",
+  "/presence/headers[@xmlns='http://jabber.org/protocol/shim']"
+  "|/message/headers[@xmlns='http://jabber.org/protocol/shim']"
+  "|/iq/*/headers[@xmlns='http://jabber.org/protocol/shim']",
+  "/iq/error|/message/error|/presence/error",
+  "/iq/bind[@xmlns='urn:ietf:params:xml:ns:xmpp-bind']",
+  "/iq/command[@xmlns='http://jabber.org/protocol/commands']",
+  "/iq/jingle[@xmlns='urn:xmpp:jingle:1']",
+  "/iq/offline[@xmlns='http://jabber.org/protocol/offline']",
+  "/iq/ping[@xmlns='urn:xmpp:ping']",
+  "/iq/pubsub[@xmlns='http://jabber.org/protocol/pubsub']",
+  "/iq/pubsub[@xmlns='http://jabber.org/protocol/pubsub#owner']",
+  "/iq/pubsub/items[@node='urn:xmpp:avatar:data']",
+  "/iq/query[@xmlns='jabber:iq:auth']",
+  "/iq/query[@xmlns='http://jabber.org/protocol/bytestreams']",
+  "/iq/query[@xmlns='http://jabber.org/protocol/disco#info']",
+  "/iq/query[@xmlns='http://jabber.org/protocol/disco#items']",
+  "/iq/query[@xmlns='jabber:iq:last']|/presence/query[@xmlns='jabber:iq:last']",
+  "/iq/query[@xmlns='http://jabber.org/protocol/muc#admin']",
+  "/iq/query[@xmlns='http://jabber.org/protocol/muc#owner']",
+  "/iq/query[@xmlns='jabber:iq:privacy']",
+  "/iq/query[@xmlns='jabber:iq:private']",
+  "/iq/query[@xmlns='jabber:iq:register']",
+  "/iq/query[@xmlns='jabber:iq:roster']",
+  "/iq/query[@xmlns='jabber:iq:search']",
+  "/iq/query[@xmlns='jabber:iq:version']",
+  "/iq/si[@xmlns='http://jabber.org/protocol/si']",
+  "/iq/unique[@xmlns='http://jabber.org/protocol/muc#unique']",
+  "/iq/vCard[@xmlns='vcard-temp']",
+  "/iq/open[@xmlns='http://jabber.org/protocol/ibb']"
+  "|/iq/data[@xmlns='http://jabber.org/protocol/ibb']"
+  "|/message/data[@xmlns='http://jabber.org/protocol/ibb']",
+  "/iq/data[@xmlns='urn:xmpp:bob']|/presence/data[@xmlns='urn:xmpp:bob']",
+  "/iq/services[@xmlns='urn:xmpp:extdisco:2']",
+  "/iq/x",
+};
+
+static const int numFilters = sizeof( filters ) / sizeof( filters[0] );
+
+static Tag* newMessage()
+{
+  Tag* m = new Tag( "message" );
+  m->addAttribute( "type", "groupchat" );
+  m->addAttribute( "from", "room@conference.example.net/nick" );
+  new Tag( m, "body", "Hello, World!" );
+  new Tag( m, "active", "xmlns", "http://jabber.org/protocol/chatstates" );
+  new Tag( m, "x", "xmlns", "http://jabber.org/protocol/muc#user" );
+  new Tag( m, "delay", "xmlns", "urn:xmpp:delay" );
+  new Tag( m, "store", "xmlns", "urn:xmpp:hints" );
+  return m;
+}
+
+static Tag* newPresence()
+{
+  Tag* p = new Tag( "presence" );
+  p->addAttribute( "from", "user@example.net/resource" );
+  new Tag( p, "show", "away" );
+  new Tag( p, "priority", "5" );
+  Tag* c = new Tag( p, "c", "xmlns", "http://jabber.org/protocol/caps" );
+  c->addAttribute( "ver", "QgayPKawpkPSDYmwT/WM94uAlu0=" );
+  new Tag( p, "x", "xmlns", "vcard-temp:x:update" );
+  return p;
+}
+
 int main( int /*argc*/, char** /*argv*/ )
 {
-  int fail = 0;
-  std::string name;
+  struct timeval tv1;
+  struct timeval tv2;
+
   StanzaExtensionFactory sef;
+  for( int i = 0; i < numFilters; ++i )
+    sef.registerExtension( new SEPerf( ExtUser + i, filters[i] ) );
+
+  printf( "Testing %d stanzas against %d extensions...\n", num, numFilters );
+
+  Tag* m = newMessage();
+  Tag* p = newPresence();
 
   // -------
-  name = "SEFactory test";
-  SETest* set = new SETest( 0 ); // deleted by StanzaExtensionFactory sef;
-  sef.registerExtension( set );
-  Tag* f = new Tag( "foo" );
-  Tag* b = new Tag( f, "bar", "attr", "value" );
-  IQ iq( IQ::Set, JID(), "" );
-  sef.addExtensions( iq, f );
-  const StanzaExtension* se = iq.findExtension( ExtUser + 1 );
-  if( se == 0 || se == set || se->tag() != b )
+  // the pre-indexing dispatch: evaluate every extension's filter string on every stanza
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
   {
-    ++fail;
-    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    Tag* tag = ( i % 2 ) ? p : m;
+    for( int j = 0; j < numFilters; ++j )
+      tag->findTagList( filters[j] );
   }
-  delete f;
+  gettimeofday( &tv2, 0 );
+  printTime( "per-extension findTagList()", tv1, tv2 );
 
   // -------
-  name = "remove ext";
-  if( !sef.removeExtension( ExtUser + 1 ) )
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
   {
-    ++fail;
-    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    if( i % 2 )
+    {
+      Presence pres( Presence::Available, JID() );
+      sef.addExtensions( pres, p );
+    }
+    else
+    {
+      Message msg( Message::Groupchat, JID() );
+      sef.addExtensions( msg, m );
+    }
   }
+  gettimeofday( &tv2, 0 );
+  printTime( "indexed addExtensions()", tv1, tv2 );
 
+  delete m;
+  delete p;
 
-  if( fail == 0 )
-  {
-    printf( "StanzaExtensionFactory: OK\n" );
-    return 0;
-  }
-  else
-  {
-    fprintf( stderr, "StanzaExtensionFactory: %d test(s) failed\n", fail );
-    return 1;
-  }
-
+  return 0;
 }
+#else
+int main( int, char** ) { return 0; }
+#endif
@@ -13,6 +13,7 @@
 #include "../../stanzaextension.h"
 #include "../../stanzaextensionfactory.h"
 #include "../../iq.h"
+#include "../../message.h"
 #include "../../tag.h"
 using namespace gloox;
 
@@ -47,6 +48,42 @@ class SETest : public StanzaExtension
 
 };
 
+class SEFilter : public StanzaExtension
+{
+  public:
+    SEFilter( int type, const std::string& filter, const Tag* tag = 0 )
+      : StanzaExtension( type ), m_filter( filter ), m_tag( tag ) {}
+    ~SEFilter() {}
+
+    virtual const std::string& filterString() const { return m_filter; }
+
+    virtual StanzaExtension* newInstance( const Tag* tag ) const
+    { return new SEFilter( extensionType(), m_filter, tag ); }
+
+    virtual Tag* tag() const
+    { return m_tag ? m_tag->clone() : 0; }
+
+    virtual StanzaExtension* clone() const
+    { return new SEFilter( extensionType(), m_filter, m_tag ); }
+
+    const Tag* matched() const { return m_tag; }
+
+  private:
+    std::string m_filter;
+    const Tag* m_tag;
+
+};
+
+static int countExtensions( const Stanza& stanza, int type )
+{
+  int count = 0;
+  StanzaExtensionList::const_iterator it = stanza.extensions().begin();
+  for( ; it != stanza.extensions().end(); ++it )
+    if( (*it)->extensionType() == type )
+      ++count;
+  return count;
+}
+
 int main( int /*argc*/, char** /*argv*/ )
 {
   int fail = 0;
@@ -78,6 +115,85 @@ int main( int /*argc*/, char** /*argv*/ )
   }
 
 
+  // -------
+  {
+    name = "indexed dispatch";
+    StanzaExtensionFactory sef2;
+    sef2.registerExtension( new SEFilter( ExtUser + 10, "/message/x[@xmlns='foo']" ) );
+    sef2.registerExtension( new SEFilter( ExtUser + 11, "/message/x[@xmlns='bar']|/presence/x[@xmlns='foo']" ) );
+    sef2.registerExtension( new SEFilter( ExtUser + 12, "/message/*[@xmlns='baz']" ) );
+    sef2.registerExtension( new SEFilter( ExtUser + 13, "/message/event/items[@node='n']" ) );
+    sef2.registerExtension( new SEFilter( ExtUser + 14, "/message/error" ) );
+    sef2.registerExtension( new SEFilter( ExtUser + 15, "/iq/x[@xmlns='foo']" ) );
+    sef2.registerExtension( new SEFilter( ExtUser + 16, "/message[@type='chat']" ) );
+    sef2.registerExtension( new SEFilter( ExtUser + 17, "/message/x[@xmlns='foo']|/message/x" ) );
+
+    Tag* m = new Tag( "message" );
+    m->addAttribute( "type", "chat" );
+    Tag* x1 = new Tag( m, "x", "xmlns", "foo" );
+    Tag* x2 = new Tag( m, "x", "xmlns", "bar" );
+    new Tag( m, "y", "xmlns", "baz" );
+    Tag* e = new Tag( m, "event" );
+    new Tag( e, "items", "node", "n" );
+    new Tag( e, "items", "node", "o" );
+    Message msg( Message::Chat, JID() );
+    sef2.addExtensions( msg, m );
+
+    const SEFilter* se10 = msg.findExtension<SEFilter>( ExtUser + 10 );
+    const SEFilter* se11 = msg.findExtension<SEFilter>( ExtUser + 11 );
+    const SEFilter* se13 = msg.findExtension<SEFilter>( ExtUser + 13 );
+    if( !se10 || se10->matched() != x1 || countExtensions( msg, ExtUser + 10 ) != 1
+        || !se11 || se11->matched() != x2 || countExtensions( msg, ExtUser + 11 ) != 1
+        || countExtensions( msg, ExtUser + 12 ) != 1
+        || !se13 || se13->matched()->findAttribute( "node" ) != "n"
+        || countExtensions( msg, ExtUser + 13 ) != 1
+        || countExtensions( msg, ExtUser + 14 ) != 0
+        || countExtensions( msg, ExtUser + 15 ) != 0
+        || countExtensions( msg, ExtUser + 16 ) != 1
+        || countExtensions( msg, ExtUser + 17 ) != 2 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+
+    // extensions are created in registration order
+    name = "indexed dispatch order";
+    int last = 0;
+    StanzaExtensionList::const_iterator it = msg.extensions().begin();
+    for( ; it != msg.extensions().end(); ++it )
+    {
+      if( (*it)->extensionType() < last )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed\n", name.c_str() );
+        break;
+      }
+      last = (*it)->extensionType();
+    }
+
+    // the first match comes first for multi-alternative filters
+    name = "indexed dispatch union order";
+    const SEFilter* se17 = msg.findExtension<SEFilter>( ExtUser + 17 );
+    if( !se17 || se17->matched() != x1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+
+    name = "indexed dispatch after remove";
+    sef2.removeExtension( ExtUser + 10 );
+    Message msg2( Message::Chat, JID() );
+    sef2.addExtensions( msg2, m );
+    if( countExtensions( msg2, ExtUser + 10 ) != 0 || countExtensions( msg2, ExtUser + 11 ) != 1 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+
+    delete m;
+  }
+
+
   if( fail == 0 )
   {
     printf( "StanzaExtensionFactory: OK\n" );
@@ -13,6 +13,10 @@
 #ifndef _WIN32
 
 #include "../../tag.h"
+#include "../../tagarena.h"
+#include "../../parser.h"
+#include "../../taghandler.h"
+#include "../../util.h"
 using namespace gloox;
 
 #include <stdio.h>
@@ -24,6 +28,23 @@ using namespace gloox;
 
 #include <sys/time.h>
 #include <time.h>
+#include <new>
+
+static unsigned long allocs = 0;
+static unsigned long allocBytes = 0;
+
+void* operator new( std::size_t size )
+{
+  ++allocs;
+  allocBytes += size;
+  void* p = malloc( size ? size : 1 );
+  if( !p )
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete( void* p ) noexcept { free( p ); }
+void operator delete( void* p, std::size_t ) noexcept { free( p ); }
 
 static double divider = 1000000;
 static int num = 2500;
@@ -77,6 +98,59 @@ static void randomize( const int size )
   values[size-1] = 0;
 }
 
+class ParseHandler : public TagHandler
+{
+  public:
+    ParseHandler() : count( 0 ) {}
+    virtual void handleTag( Tag* tag ) { if( tag->name() == "message" ) ++count; }
+    int count;
+};
+
+static const std::string stanza = "<message from='juliet@example.com/balcony' "
+  "to='romeo@example.net' type='chat' id='ktx72v49'>"
+  "<body>Art thou not Romeo, and a Montague?</body>"
+  "<thread>e0ffe42b28561960c6b12b944a092794b9683a38</thread>"
+  "<active xmlns='http://jabber.org/protocol/chatstates'/>"
+  "<request xmlns='urn:xmpp:receipts'/>"
+  "<delay xmlns='urn:xmpp:delay' from='capulet.com' stamp='2002-09-10T23:08:25Z'>Offline</delay>"
+  "</message>";
+
+static void parse( bool arena, const char* name )
+{
+  struct timeval tv1;
+  struct timeval tv2;
+
+  ParseHandler ph;
+  Parser p( &ph );
+  p.setTagArena( arena );
+
+  std::string data = "<stream:stream xmlns='jabber:client' "
+                     "xmlns:stream='http://etherx.jabber.org/streams' version='1.0'>";
+  p.feed( data );
+
+  unsigned long a = allocs;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    data = stanza;
+    p.feed( data );
+  }
+  gettimeofday( &tv2, 0 );
+  a = allocs - a;
+
+  if( ph.count != num )
+    printf( "%s: parsed %d of %d stanzas\n", name, ph.count, num );
+  printTime( name, tv1, tv2 );
+  printf( "%s: %.01f allocations/stanza\n", name, static_cast<double>( a ) / num );
+}
+
+// prints the heap allocations made since @c a / @c b were taken
+static void printAllocs( const char* testName, unsigned long a, unsigned long b )
+{
+  printf( "%s: %.01f allocations (%.00f bytes) per iteration\n", testName,
+          static_cast<double>( allocs - a ) / num, static_cast<double>( allocBytes - b ) / num );
+}
+
 int main( int /*argc*/, char** /*argv*/ )
 {
   struct timeval tv1;
@@ -110,6 +184,83 @@ int main( int /*argc*/, char** /*argv*/ )
 
   // ---------------------------------------------------------------------
 
+  std::string buffer;
+  tag = newSimpleTag();
+  unsigned long a = allocs;
+  unsigned long b = allocBytes;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    buffer.clear();
+    tag->appendXml( buffer );
+  }
+  gettimeofday( &tv2, 0 );
+  delete tag;
+  printTime ("non escaping appendXml, reused buffer", tv1, tv2);
+  printAllocs( "non escaping appendXml, reused buffer", a, b );
+
+  tag = newEscapableTag();
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    buffer.clear();
+    tag->appendXml( buffer );
+  }
+  gettimeofday( &tv2, 0 );
+  delete tag;
+  printTime ("escaping appendXml, reused buffer", tv1, tv2);
+
+
+  // ---------------------------------------------------------------------
+
+  // a long message body without, and with a few characters to escape
+  const int saved = num;
+  num = 100000;
+  std::string text;
+  for( int i = 0; i < 40; ++i )
+    text += simpleString;
+  std::string escapable = text;
+  for( std::string::size_type i = 0; i < escapable.length(); i += 97 )
+    escapable[i] = '<';
+
+  std::string escaped;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    escaped = util::escape( text );
+  gettimeofday( &tv2, 0 );
+  printTime ("util::escape, 1160 octets, non escaping", tv1, tv2);
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    buffer.clear();
+    util::appendEscaped( buffer, text );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("util::appendEscaped, 1160 octets, non escaping", tv1, tv2);
+
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    buffer.clear();
+    util::appendEscaped( buffer, escapable );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime ("util::appendEscaped, 1160 octets, 12 escaped", tv1, tv2);
+
+  int valid = 0;
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+    valid += util::checkValidXMLChars( text );
+  gettimeofday( &tv2, 0 );
+  printTime ("util::checkValidXMLChars, 1160 octets", tv1, tv2);
+  num = saved;
+
+
+  // ---------------------------------------------------------------------
+
+  a = allocs;
+  b = allocBytes;
   gettimeofday( &tv1, 0 );
   for( int i = 0; i < num; ++i )
   {
@@ -117,6 +268,7 @@ int main( int /*argc*/, char** /*argv*/ )
   }
   gettimeofday( &tv2, 0 );
   printTime ("non relaxing create/delete", tv1, tv2);
+  printAllocs( "non relaxing create/delete", a, b );
 
 
   // -----------------------------------------------------------------------
@@ -146,6 +298,8 @@ int main( int /*argc*/, char** /*argv*/ )
 
   tag = newSimpleTag();
 
+  a = allocs;
+  b = allocBytes;
   gettimeofday( &tv1, 0 );
   for( int i = 0; i < num; ++i )
   {
@@ -153,13 +307,16 @@ int main( int /*argc*/, char** /*argv*/ )
   }
   gettimeofday( &tv2, 0 );
   printTime ("clone/delete", tv1, tv2);
+  printAllocs( "clone/delete", a, b );
 
+  delete tag;
 
+  // -----------------------------------------------------------------------
 
+  parse( false, "parse (heap)" );
+  parse( true, "parse (TagArena)" );
 
-  delete tag;
-
-  return 0;
+  return valid == -1;
 }
 #else
 int main( int, char** ) { return 0; }
@@ -437,6 +437,55 @@ int main( int /*argc*/, char** /*argv*/ )
     }
   }
 
+  //-------
+  {
+    name = "many children and attributes";
+    Tag p( "p" );
+    for( int i = 0; i < 10; ++i )
+    {
+      p.addAttribute( "a" + util::int2string( i ), i );
+      new Tag( &p, "c" + util::int2string( i ), "cdata" );
+      p.addCData( "x" );
+    }
+    const TagList& l = p.children();
+    p.removeChild( "c3" );
+    p.removeAttribute( "a3" );
+    p.removeAttribute( "a9" );
+    new Tag( &p, "c10" );
+    Tag* c = p.clone();
+    if( l.size() != 10 || p.attributes().size() != 8 || p.cdata() != "xxxxxxxxxx"
+        || p.findChild( "c3" ) || !p.findChild( "c9" ) || l.back()->name() != "c10"
+        || p.findAttribute( "a8" ) != "8" || p.hasAttribute( "a9" )
+        || p.findChildren( "c4" ).size() != 1 || *c != p )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), p.xml().c_str() );
+    }
+    delete c;
+  }
+
+  //-------
+  {
+    name = "appendXml";
+    Tag p( "p", "a", "'&'" );
+    p.setXmlns( "ns", "x" );
+    p.setPrefix( "x" );
+    new Tag( &p, "c", "1 < 2" );
+    new Tag( &p, "e" );
+    std::string target = "head";
+    p.appendXml( target );
+    const bool appended = target == "head" + p.xml();
+    const std::string::size_type capacity = target.capacity();
+    target.clear();
+    p.appendXml( target );
+    if( !appended || target != p.xml() || target.capacity() != capacity
+        || target != "<x:p a='&apos;&amp;&apos;' xmlns:x='ns'><c>1 &lt; 2</c><e/></x:p>" )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), target.c_str() );
+    }
+  }
+
 
 
 
@@ -0,0 +1,217 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#include "../../config.h"
+
+#include <stdio.h>
+#include <cstdio> // [s]print[f]
+
+#ifdef HAVE_OPENSSL
+
+#include "../../tlscontext.h"
+#include "../../tlshandler.h"
+#include "../../tlsopensslclient.h"
+#include "../../tlsopensslserver.h"
+#include "../../gloox.h"
+using namespace gloox;
+
+#include <string>
+
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static const double divider = 1000000;
+static const int num = 200;
+
+static double cpuTime()
+{
+  struct rusage ru;
+  getrusage( RUSAGE_SELF, &ru );
+  return static_cast<double>( ru.ru_utime.tv_sec + ru.ru_stime.tv_sec )
+         + static_cast<double>( ru.ru_utime.tv_usec + ru.ru_stime.tv_usec ) / divider;
+}
+
+static double wallTime()
+{
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return static_cast<double>( tv.tv_sec ) + static_cast<double>( tv.tv_usec ) / divider;
+}
+
+// connects an OpenSSLClient and an OpenSSLServer in memory
+class Handshake : public TLSHandler
+{
+  public:
+    Handshake( TLSContext* clientContext, TLSContext* serverContext, const StringList& cacerts,
+               const std::string& key, const std::string& cert )
+      : m_client( this, "localhost" ), m_server( this ), m_done( 0 ), m_success( true )
+    {
+      m_client.setContext( clientContext );
+      m_client.init( EmptyString, EmptyString, cacerts );
+      m_server.setContext( serverContext );
+      m_server.init( key, cert );
+    }
+
+    bool run()
+    {
+      m_client.handshake();
+      // keep going after the handshake so that TLS 1.3 session tickets get processed
+      while( !m_toServer.empty() || !m_toClient.empty() )
+      {
+        std::string data;
+        data.swap( m_toServer );
+        if( !data.empty() )
+          m_server.decrypt( data );
+        data.clear();
+        data.swap( m_toClient );
+        if( !data.empty() )
+          m_client.decrypt( data );
+      }
+      return m_done == 2 && m_success;
+    }
+
+    virtual void handleEncryptedData( const TLSBase* base, const std::string& data )
+    {
+      if( base == &m_client )
+        m_toServer += data;
+      else
+        m_toClient += data;
+    }
+
+    virtual void handleDecryptedData( const TLSBase* /*base*/, const std::string& /*data*/ ) {}
+
+    virtual void handleHandshakeResult( const TLSBase* /*base*/, bool success, CertInfo& /*certinfo*/ )
+    {
+      ++m_done;
+      m_success = m_success && success;
+    }
+
+  private:
+    OpenSSLClient m_client;
+    OpenSSLServer m_server;
+    std::string m_toServer;
+    std::string m_toClient;
+    int m_done;
+    bool m_success;
+};
+
+// a self-signed certificate for the server
+static bool writeCert( const std::string& key, const std::string& cert )
+{
+  RSA* rsa = RSA_new();
+  BIGNUM* e = BN_new();
+  BN_set_word( e, RSA_F4 );
+  RSA_generate_key_ex( rsa, 2048, e, 0 );
+  BN_free( e );
+
+  EVP_PKEY* pkey = EVP_PKEY_new();
+  EVP_PKEY_set1_RSA( pkey, rsa );
+
+  X509* x = X509_new();
+  ASN1_INTEGER_set( X509_get_serialNumber( x ), 1 );
+  X509_gmtime_adj( X509_get_notBefore( x ), 0 );
+  X509_gmtime_adj( X509_get_notAfter( x ), 86400 );
+  X509_set_pubkey( x, pkey );
+  X509_NAME* name = X509_get_subject_name( x );
+  X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC,
+                              reinterpret_cast<const unsigned char*>( "localhost" ), -1, -1, 0 );
+  X509_set_issuer_name( x, name );
+  X509_sign( x, pkey, EVP_sha256() );
+
+  bool ok = false;
+  FILE* f = fopen( key.c_str(), "w" );
+  if( f )
+  {
+    ok = PEM_write_RSAPrivateKey( f, rsa, 0, 0, 0, 0, 0 ) == 1;
+    fclose( f );
+  }
+  f = fopen( cert.c_str(), "w" );
+  if( f )
+  {
+    ok = ok && PEM_write_X509( f, x ) == 1;
+    fclose( f );
+  }
+
+  X509_free( x );
+  EVP_PKEY_free( pkey );
+  RSA_free( rsa );
+  return ok;
+}
+
+static void handshakes( const char* testName, TLSContext* client, TLSContext* server,
+                        const StringList& cacerts, const std::string& key, const std::string& cert )
+{
+  int failed = 0;
+  const double wall = wallTime();
+  const double cpu = cpuTime();
+  for( int i = 0; i < num; ++i )
+  {
+    Handshake h( client, server, cacerts, key, cert );
+    if( !h.run() )
+      ++failed;
+  }
+  const double w = wallTime() - wall;
+  const double c = cpuTime() - cpu;
+  printf( "%s: %.00f handshakes/s, %.03f ms CPU per handshake%s\n", testName, num / w,
+          c * 1000 / num, failed ? " (some failed)" : "" );
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  char dir[] = "/tmp/glooxtlsXXXXXX";
+  if( !mkdtemp( dir ) )
+    return 1;
+  const std::string key = std::string( dir ) + "/key.pem";
+  const std::string cert = std::string( dir ) + "/cert.pem";
+  if( !writeCert( key, cert ) )
+    return 1;
+
+  // what every connection loads without a shared context
+  StringList cacerts;
+  if( access( "/etc/ssl/certs/ca-certificates.crt", R_OK ) == 0 )
+    cacerts.push_back( "/etc/ssl/certs/ca-certificates.crt" );
+
+  printf( "%d handshakes (client and server side) per run\n", num );
+  handshakes( "no context", 0, 0, cacerts, key, cert );
+
+  TLSContext* client = new TLSContext( EmptyString, EmptyString, cacerts );
+  TLSContext* server = new TLSContext( key, cert );
+  client->setSessionCacheSize( 0 );
+  handshakes( "shared context", client, server, cacerts, key, cert );
+  client->release();
+  server->release();
+
+  client = new TLSContext( EmptyString, EmptyString, cacerts );
+  server = new TLSContext( key, cert );
+  handshakes( "shared context, resumption", client, server, cacerts, key, cert );
+  client->release();
+  server->release();
+
+  unlink( key.c_str() );
+  unlink( cert.c_str() );
+  rmdir( dir );
+  return 0;
+}
+
+#else
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  printf( "TLSContext benchmark skipped: no OpenSSL\n" );
+  return 0;
+}
+
+#endif // HAVE_OPENSSL
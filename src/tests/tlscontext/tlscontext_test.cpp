@@ -0,0 +1,304 @@
+/*
+ *  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#include "../../tlscontext.h"
+#include "../../tlshandler.h"
+#include "../../gloox.h"
+using namespace gloox;
+
+#include "../../config.h"
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <cstdio> // [s]print[f]
+
+#ifdef HAVE_OPENSSL
+# include "../../tlsopensslclient.h"
+# include "../../tlsopensslserver.h"
+# include <openssl/pem.h>
+# include <openssl/rsa.h>
+# include <openssl/x509.h>
+# include <unistd.h>
+#endif
+
+static int backends = 0;
+
+class CountingBackend : public TLSContext::Backend
+{
+  public:
+    CountingBackend() { ++backends; }
+    virtual ~CountingBackend() { --backends; }
+};
+
+#ifdef HAVE_OPENSSL
+
+// exposes whether the session was resumed
+class ResumingClient : public OpenSSLClient
+{
+  public:
+    ResumingClient( TLSHandler* th ) : OpenSSLClient( th, "localhost" ) {}
+    bool resumed() const { return SSL_session_reused( m_ssl ) == 1; }
+};
+
+// connects an OpenSSLClient and an OpenSSLServer in memory
+class Handshake : public TLSHandler
+{
+  public:
+    Handshake( TLSContext* clientContext, TLSContext* serverContext, const std::string& key,
+               const std::string& cert )
+      : m_clientResult( false ), m_serverResult( false ), m_success( true )
+    {
+      m_client = new ResumingClient( this );
+      m_client->setContext( clientContext );
+      m_client->init();
+      m_server = new OpenSSLServer( this );
+      m_server->setContext( serverContext );
+      m_server->init( key, cert );
+    }
+
+    ~Handshake()
+    {
+      delete m_client;
+      delete m_server;
+    }
+
+    bool run()
+    {
+      m_client->handshake();
+      while( !m_toServer.empty() || !m_toClient.empty() )
+      {
+        std::string data;
+        data.swap( m_toServer );
+        if( !data.empty() )
+          m_server->decrypt( data );
+        data.clear();
+        data.swap( m_toClient );
+        if( !data.empty() )
+          m_client->decrypt( data );
+      }
+      return m_clientResult && m_serverResult && m_success;
+    }
+
+    bool resumed() const { return m_client->resumed(); }
+
+    virtual void handleEncryptedData( const TLSBase* base, const std::string& data )
+    {
+      if( base == m_client )
+        m_toServer += data;
+      else
+        m_toClient += data;
+    }
+
+    virtual void handleDecryptedData( const TLSBase* /*base*/, const std::string& /*data*/ ) {}
+
+    virtual void handleHandshakeResult( const TLSBase* base, bool success, CertInfo& /*certinfo*/ )
+    {
+      if( base == m_client )
+        m_clientResult = true;
+      else
+        m_serverResult = true;
+      m_success = m_success && success;
+    }
+
+  private:
+    ResumingClient* m_client;
+    OpenSSLServer* m_server;
+    std::string m_toServer;
+    std::string m_toClient;
+    bool m_clientResult;
+    bool m_serverResult;
+    bool m_success;
+};
+
+// a self-signed certificate for the server
+static bool writeCert( const std::string& key, const std::string& cert )
+{
+  RSA* rsa = RSA_new();
+  BIGNUM* e = BN_new();
+  BN_set_word( e, RSA_F4 );
+  RSA_generate_key_ex( rsa, 2048, e, 0 );
+  BN_free( e );
+
+  EVP_PKEY* pkey = EVP_PKEY_new();
+  EVP_PKEY_set1_RSA( pkey, rsa );
+
+  X509* x = X509_new();
+  ASN1_INTEGER_set( X509_get_serialNumber( x ), 1 );
+  X509_gmtime_adj( X509_get_notBefore( x ), 0 );
+  X509_gmtime_adj( X509_get_notAfter( x ), 86400 );
+  X509_set_pubkey( x, pkey );
+  X509_NAME* name = X509_get_subject_name( x );
+  X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC,
+                              reinterpret_cast<const unsigned char*>( "localhost" ), -1, -1, 0 );
+  X509_set_issuer_name( x, name );
+  X509_sign( x, pkey, EVP_sha256() );
+
+  bool ok = false;
+  FILE* f = fopen( key.c_str(), "w" );
+  if( f )
+  {
+    ok = PEM_write_RSAPrivateKey( f, rsa, 0, 0, 0, 0, 0 ) == 1;
+    fclose( f );
+  }
+  f = fopen( cert.c_str(), "w" );
+  if( f )
+  {
+    ok = ok && PEM_write_X509( f, x ) == 1;
+    fclose( f );
+  }
+
+  X509_free( x );
+  EVP_PKEY_free( pkey );
+  RSA_free( rsa );
+  return ok;
+}
+
+#endif // HAVE_OPENSSL
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  int fail = 0;
+  std::string name;
+
+  // -------
+  name = "session cache";
+  {
+    TLSContext* ctx = new TLSContext();
+    std::string s;
+    ctx->storeSession( "a.example", "session-a" );
+    ctx->storeSession( "b.example", "session-b" );
+    ctx->storeSession( "a.example", "session-a2" );
+    if( ctx->sessions() != 2 || !ctx->findSession( "a.example", s ) || s != "session-a2"
+        || ctx->findSession( "c.example", s ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    ctx->removeSession( "a.example" );
+    if( ctx->sessions() != 1 || ctx->findSession( "a.example", s ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed (remove)\n", name.c_str() );
+    }
+    ctx->release();
+  }
+
+  // -------
+  name = "session cache size";
+  {
+    TLSContext* ctx = new TLSContext();
+    std::string s;
+    ctx->setSessionCacheSize( 2 );
+    ctx->storeSession( "a.example", "session-a" );
+    ctx->storeSession( "b.example", "session-b" );
+    ctx->findSession( "a.example", s );
+    ctx->storeSession( "c.example", "session-c" );
+    if( ctx->sessions() != 2 || !ctx->findSession( "a.example", s )
+        || ctx->findSession( "b.example", s ) || !ctx->findSession( "c.example", s ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    ctx->setSessionCacheSize( 0 );
+    ctx->storeSession( "d.example", "session-d" );
+    if( ctx->sessions() != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed (disabled)\n", name.c_str() );
+    }
+    ctx->release();
+  }
+
+  // -------
+  name = "backends and references";
+  {
+    TLSContext* ctx = new TLSContext( "key.pem", "cert.pem" );
+    TLSContext::Backend* b = new CountingBackend();
+    TLSContext::Backend* first = ctx->addBackend( "test", b );
+    TLSContext::Backend* second = ctx->addBackend( "test", new CountingBackend() );
+    ctx->acquire();
+    ctx->release();
+    if( first != b || second != b || ctx->backend( "test" ) != b || ctx->backend( "other" )
+        || backends != 1 || ctx->clientKey() != "key.pem" || ctx->clientCerts() != "cert.pem" )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    ctx->release();
+    if( backends != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %d backends left\n", name.c_str(), backends );
+    }
+  }
+
+#ifdef HAVE_OPENSSL
+  // -------
+  name = "OpenSSL session resumption";
+  {
+    char dir[] = "/tmp/glooxtlsXXXXXX";
+    if( !mkdtemp( dir ) || !writeCert( std::string( dir ) + "/key.pem", std::string( dir ) + "/cert.pem" ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: no certificate\n", name.c_str() );
+    }
+    else
+    {
+      const std::string key = std::string( dir ) + "/key.pem";
+      const std::string cert = std::string( dir ) + "/cert.pem";
+      TLSContext* client = new TLSContext();
+      TLSContext* server = new TLSContext( key, cert );
+
+      Handshake* h = new Handshake( 0, 0, key, cert );
+      const bool plain = h->run() && !h->resumed();
+      delete h;
+
+      h = new Handshake( client, server, key, cert );
+      const bool full = h->run() && !h->resumed();
+      delete h;
+      const int sessions = client->sessions();
+
+      h = new Handshake( client, server, key, cert );
+      const bool resumed = h->run() && h->resumed();
+      delete h;
+
+      if( !plain || !full || sessions != 1 || !resumed )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed: %d/%d/%d, %d sessions\n", name.c_str(), plain, full,
+                 resumed, sessions );
+      }
+
+      client->release();
+      server->release();
+      unlink( key.c_str() );
+      unlink( cert.c_str() );
+      rmdir( dir );
+    }
+  }
+#endif // HAVE_OPENSSL
+
+
+
+  if( fail == 0 )
+  {
+    printf( "TLSContext: OK\n" );
+    return 0;
+  }
+  else
+  {
+    fprintf( stderr, "TLSContext: %d test(s) failed\n", fail );
+    return 1;
+  }
+
+}
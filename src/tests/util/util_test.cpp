@@ -264,6 +264,118 @@ int main()
     fprintf( stderr, "test '%s' failed, expected: %d, result: '%s'\n", name.c_str(), ex, re.c_str() );
     ++fail;
   }
+  // -------
+  name = "findFirstOf";
+  {
+    // covers the scalar tail as well as the 16 and 32 byte blocks
+    const char* set = "<&'\"";
+    for( std::string::size_type len = 0; len < 100; ++len )
+    {
+      for( std::string::size_type at = 0; at <= len; ++at )
+      {
+        std::string data( len, 'x' );
+        if( at < len )
+          data[at] = set[at % 4];
+        if( at + 1 < len )
+          data[len - 1] = '&';
+        const std::string::size_type start = at % 3 < len ? at % 3 : 0;
+        const std::string::size_type expected = std::min( data.find_first_of( set, start ), len );
+        const std::string::size_type result = util::findFirstOf( data.data(), start, len, set );
+        if( result != expected )
+        {
+          fprintf( stderr, "test '%s' failed, length %lu, expected: %lu, result: %lu\n", name.c_str(),
+                   static_cast<unsigned long>( len ), static_cast<unsigned long>( expected ),
+                   static_cast<unsigned long>( result ) );
+          ++fail;
+          len = 100;
+          break;
+        }
+      }
+    }
+  }
+
+  // -------
+  name = "findFirstOf single char";
+  {
+    std::string data( 1000, 'a' );
+    data[700] = ']';
+    if( util::findFirstOf( data.data(), 0, data.length(), "]" ) != 700
+        || util::findFirstOf( data.data(), 701, data.length(), "]" ) != data.length() )
+    {
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+      ++fail;
+    }
+  }
+
+  // -------
+  name = "escape";
+  {
+    // covers the scalar tail as well as the 16 and 32 byte blocks
+    const char* set = "&<>'\"";
+    const char* seqs[] = { "&amp;", "&lt;", "&gt;", "&apos;", "&quot;" };
+    for( std::string::size_type len = 0; len < 100; ++len )
+    {
+      for( std::string::size_type at = 0; at <= len; ++at )
+      {
+        std::string data( len, 'x' );
+        std::string expected = data;
+        if( at < len )
+        {
+          data[at] = set[at % 5];
+          expected = std::string( at, 'x' ) + seqs[at % 5] + std::string( len - at - 1, 'x' );
+        }
+        std::string appended = "head";
+        util::appendEscaped( appended, data );
+        if( util::escape( data ) != expected || appended != "head" + expected )
+        {
+          fprintf( stderr, "test '%s' failed, length %lu, at: %lu\n", name.c_str(),
+                   static_cast<unsigned long>( len ), static_cast<unsigned long>( at ) );
+          ++fail;
+          len = 100;
+          break;
+        }
+      }
+    }
+    if( util::escape( "a&&b<'>\"c" ) != "a&amp;&amp;b&lt;&apos;&gt;&quot;c" )
+    {
+      fprintf( stderr, "test '%s' failed (all)\n", name.c_str() );
+      ++fail;
+    }
+  }
+
+  // -------
+  name = "checkValidXMLChars";
+  {
+    // valid and invalid octets at every position of the scalar tail and the 16 and 32 byte blocks
+    const unsigned char octets[] = { 0x09, 0x0a, 0x0d, 0x20, 0x7f, 0x80, 0xbf, 0xc2, 0xf4,
+                                     0x00, 0x01, 0x1f, 0xc0, 0xc1, 0xf5, 0xff };
+    const int valid = 9;
+    for( std::string::size_type len = 1; len < 80; ++len )
+    {
+      for( std::string::size_type at = 0; at < len; ++at )
+      {
+        for( int o = 0; o < 16; ++o )
+        {
+          std::string data( len, 'x' );
+          data[at] = static_cast<char>( octets[o] );
+          if( util::checkValidXMLChars( data ) != ( o < valid ) )
+          {
+            fprintf( stderr, "test '%s' failed, length %lu, at: %lu, octet: 0x%02x\n", name.c_str(),
+                     static_cast<unsigned long>( len ), static_cast<unsigned long>( at ), octets[o] );
+            ++fail;
+            len = 80;
+            at = len;
+            break;
+          }
+        }
+      }
+    }
+    if( !util::checkValidXMLChars( EmptyString ) )
+    {
+      fprintf( stderr, "test '%s' failed (empty)\n", name.c_str() );
+      ++fail;
+    }
+  }
 
 
 
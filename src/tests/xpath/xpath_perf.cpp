@@ -0,0 +1,110 @@
+/*
+ *  Copyright (c) 2004-2023 by Jakob Schröter <js@camaya.net>
+ *  This file is part of the gloox library. http://camaya.net/gloox
+ *
+ *  This software is distributed under a license. The full license
+ *  agreement can be found in the file LICENSE in this distribution.
+ *  This software may not be copied, modified, sold or distributed
+ *  other than expressed in the named license agreement.
+ *
+ *  This software is distributed without any warranty.
+ */
+
+#ifndef _WIN32
+
+#include "../../tag.h"
+using namespace gloox;
+
+#include <stdio.h>
+#include <locale.h>
+#include <string>
+#include <cstdio> // [s]print[f]
+
+#include <sys/time.h>
+
+static const double divider = 1000000;
+static const int num = 25000;
+static double t;
+
+static void printTime ( const char * testName, struct timeval tv1, struct timeval tv2 )
+{
+  t = static_cast<double>( tv2.tv_sec - tv1.tv_sec );
+  t +=  static_cast<double>( tv2.tv_usec - tv1.tv_usec ) / divider;
+  printf( "%s: %.03f seconds (%.00f/s)\n", testName, t, num / t );
+}
+
+static const char* expressions[] =
+{
+  "/iq/query[@xmlns='jabber:iq:roster']",
+  "/message/x[@xmlns='http://jabber.org/protocol/muc#user']|/presence/x[@xmlns='http://jabber.org/protocol/muc#user']",
+  "query/item",
+  "//item[@jid='juliet@example.com']/group",
+};
+
+static const int numExpressions = sizeof( expressions ) / sizeof( expressions[0] );
+
+static Tag* newRoster()
+{
+  Tag* iq = new Tag( "iq" );
+  iq->addAttribute( "type", "result" );
+  Tag* q = new Tag( iq, "query", "xmlns", "jabber:iq:roster" );
+  Tag* i = new Tag( q, "item", "jid", "romeo@example.net" );
+  new Tag( i, "group", "Friends" );
+  i = new Tag( q, "item", "jid", "juliet@example.com" );
+  new Tag( i, "group", "Family" );
+  new Tag( i, "group", "Friends" );
+  i = new Tag( q, "item", "jid", "benvolio@example.org" );
+  new Tag( i, "group", "Friends" );
+  return iq;
+}
+
+int main( int /*argc*/, char** /*argv*/ )
+{
+  struct timeval tv1;
+  struct timeval tv2;
+
+  Tag* tag = newRoster();
+  const Tag* query = tag->findChild( "query" );
+
+  printf( "Testing %d evaluations of %d expressions...\n", num, numExpressions );
+
+  // -------
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    for( int j = 0; j < numExpressions; ++j )
+      query->findTagList( Tag::XPath( expressions[j] ) );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime( "parse + evaluate", tv1, tv2 );
+
+  // -------
+  const std::string strings[] = { expressions[0], expressions[1], expressions[2], expressions[3] };
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    for( int j = 0; j < numExpressions; ++j )
+      query->findTagList( strings[j] );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime( "cached string expression", tv1, tv2 );
+
+  // -------
+  const Tag::XPath compiled[] = { Tag::XPath( expressions[0] ), Tag::XPath( expressions[1] ),
+                                  Tag::XPath( expressions[2] ), Tag::XPath( expressions[3] ) };
+  gettimeofday( &tv1, 0 );
+  for( int i = 0; i < num; ++i )
+  {
+    for( int j = 0; j < numExpressions; ++j )
+      query->findTagList( compiled[j] );
+  }
+  gettimeofday( &tv2, 0 );
+  printTime( "compiled Tag::XPath", tv1, tv2 );
+
+  delete tag;
+
+  return 0;
+}
+#else
+int main( int, char** ) { return 0; }
+#endif
@@ -888,9 +888,76 @@ int main( int /*argc*/, char** /*argv*/ )
   }
 //   printf( "--------------------------------------------------------------\n" );
 
+  // -- compiled expressions --
 
+  // -------
+  name = "compiled: //bbb[@name='b1']/hhh|/aaa/ccc/*";
+  {
+    const Tag::XPath xp( "//bbb[@name='b1']/hhh|/aaa/ccc/*" );
+    result = aaa->findTagList( xp );
+    it = result.begin();
+    if( xp.expression() != "//bbb[@name='b1']/hhh|/aaa/ccc/*"
+        || result.size() != 3 || (*it) != hhh || (*++it) != ddd || (*++it) != eee
+        || result != aaa->findTagList( "//bbb[@name='b1']/hhh|/aaa/ccc/*" ) )
+    {
+      ++fail;
+      printResult( name, result );
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
 
+  // -------
+  name = "compiled, reused: /aaa/bbb[1]";
+  {
+    const Tag::XPath xp( "/aaa/bbb[1]" );
+    if( aaa->findTag( xp ) != bbb || hhh->findTag( xp ) != bbb || aaa->findTag( xp ) != bbb )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
 
+  // -------
+  name = "compiled, copied: //ddd";
+  {
+    Tag::XPath xp( "/aaa" );
+    const Tag::XPath xp2( "//ddd" );
+    xp = xp2;
+    const Tag::XPath xp3( xp );
+    if( aaa->findCData( xp ) != "bcd" || aaa->findCData( xp3 ) != "bcd" )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  name = "compiled, empty: /";
+  {
+    const Tag::XPath xp( "/" );
+    if( !aaa->findTagList( xp ).empty() || aaa->findTag( xp ) != 0 )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
+
+  // -------
+  name = "expression cache eviction";
+  {
+    char buf[32];
+    for( int i = 0; i < 1000; ++i )
+    {
+      sprintf( buf, "/aaa/bbb[@name='b%d']", i % 400 );
+      const Tag* t = aaa->findTag( buf );
+      if( ( i % 400 == 1 && t != bbb ) || ( i % 400 != 1 && t != 0 ) )
+      {
+        ++fail;
+        fprintf( stderr, "test '%s' failed\n", name.c_str() );
+        break;
+      }
+    }
+  }
 
 
 
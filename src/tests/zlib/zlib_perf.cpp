@@ -26,6 +26,8 @@ using namespace gloox;
 #include <cstdio> // [s]print[f]
 
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <vector>
 
 #ifdef HAVE_ZLIB
 
@@ -72,13 +74,147 @@ static void randomize( const int size )
   srand( static_cast<unsigned int>( time( 0 ) ) );
   for( int i = 0; i < size; ++i )
   {
-    values[i] = static_cast<char>( rand() ) % 96 + 32;
+    values[i] = static_cast<char>( rand() % 95 + 32 );
   }
   values[size] = 0;
 }
 
+// collects compressed or decompressed data
+class Collector : public CompressionDataHandler
+{
+  public:
+    Collector() : bytes( 0 ) {}
+    void handleCompressedData( const std::string& data )
+      { chunks.push_back( data ); bytes += data.length(); }
+    void handleDecompressedData( const std::string& data )
+      { bytes += data.length(); }
+    void handleDecompressedData( const char* /*data*/, std::string::size_type length )
+      { bytes += length; }
+    std::vector<std::string> chunks;
+    std::string::size_type bytes;
+};
+
+static double cpuTime()
+{
+  struct rusage ru;
+  getrusage( RUSAGE_SELF, &ru );
+  return static_cast<double>( ru.ru_utime.tv_sec + ru.ru_stime.tv_sec )
+         + static_cast<double>( ru.ru_utime.tv_usec + ru.ru_stime.tv_usec ) / divider;
+}
+
+static double wallTime()
+{
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return static_cast<double>( tv.tv_sec ) + static_cast<double>( tv.tv_usec ) / divider;
+}
+
+// a roster and a busy MUC, one stanza per compress() call, as sent by ClientBase
+static std::vector<std::string> traffic()
+{
+  static const char* words[] = { "hello", "the", "meeting", "starts", "at", "noon", "see", "you",
+                                 "there", "thanks", "ok", "build", "is", "green", "again", "lunch?" };
+  std::vector<std::string> stanzas;
+  char buf[512];
+  srand( 42 );
+
+  std::string roster = "<iq type='result' id='roster_1' to='juliet@example.com/balcony'>"
+                       "<query xmlns='jabber:iq:roster' ver='ver14'>";
+  for( int i = 0; i < 500; ++i )
+  {
+    sprintf( buf, "<item jid='contact%d@example%d.org' name='Contact %d' subscription='both'>"
+                  "<group>Group %d</group></item>", i, i % 7, i, i % 12 );
+    roster += buf;
+  }
+  roster += "</query></iq>";
+  stanzas.push_back( roster );
+
+  for( int i = 0; i < 20000; ++i )
+  {
+    const int nick = rand() % 200;
+    switch( rand() % 4 )
+    {
+      case 0:
+        sprintf( buf, "<presence from='room@conference.example.com/nick%d' to='juliet@example.com/balcony'"
+                      " id='%08x'><c xmlns='http://jabber.org/protocol/caps' hash='sha-1'"
+                      " node='http://gajim.org' ver='QgayPKawpkPSDYmwT/WM94uAlu0='/>"
+                      "<x xmlns='http://jabber.org/protocol/muc#user'><item affiliation='member'"
+                      " role='participant' jid='user%d@example.net/res'/></x></presence>",
+                 nick, rand(), nick );
+        stanzas.push_back( buf );
+        break;
+      case 1:
+        sprintf( buf, "<iq type='result' id='%08x' from='contact%d@example%d.org/phone'"
+                      " to='juliet@example.com/balcony'><ping xmlns='urn:xmpp:ping'/></iq>",
+                 rand(), nick, nick % 7 );
+        stanzas.push_back( buf );
+        break;
+      default:
+      {
+        std::string body;
+        const int n = 3 + rand() % 20;
+        for( int w = 0; w < n; ++w )
+          body += std::string( w ? " " : "" ) + words[rand() % 16];
+        sprintf( buf, "<message from='room@conference.example.com/nick%d' to='juliet@example.com/balcony'"
+                      " type='groupchat' id='%08x'><body>%s</body><stanza-id xmlns='urn:xmpp:sid:0'"
+                      " id='%08x%08x' by='room@conference.example.com'/></message>",
+                 nick, rand(), body.c_str(), rand(), rand() );
+        stanzas.push_back( buf );
+        break;
+      }
+    }
+  }
+
+  return stanzas;
+}
+
+static void trafficTest( const std::vector<std::string>& stanzas, int level )
+{
+  std::string::size_type total = 0;
+  for( std::vector<std::string>::const_iterator it = stanzas.begin(); it != stanzas.end(); ++it )
+    total += (*it).length();
+  const double kb = static_cast<double>( total ) / 1024;
+  const double mb = kb / 1024;
+
+  Collector sent;
+  Collector received;
+  CompressionZlib sender( &sent, level );
+  CompressionZlib receiver( &received );
+  sender.init();
+  receiver.init();
+
+  double wall = wallTime();
+  double cpu = cpuTime();
+  for( std::vector<std::string>::const_iterator it = stanzas.begin(); it != stanzas.end(); ++it )
+    sender.compress( *it );
+  const double cwall = wallTime() - wall;
+  const double ccpu = cpuTime() - cpu;
+
+  wall = wallTime();
+  cpu = cpuTime();
+  for( std::vector<std::string>::const_iterator it = sent.chunks.begin(); it != sent.chunks.end(); ++it )
+    receiver.decompress( *it );
+  const double dwall = wallTime() - wall;
+  const double dcpu = cpuTime() - cpu;
+
+  printf( "level %d: ratio %.02f; compress %.01f MB/s, %.02f us CPU/KB;"
+          " decompress %.01f MB/s, %.02f us CPU/KB\n",
+          level, static_cast<double>( sent.bytes ) / static_cast<double>( total ),
+          mb / cwall, ccpu * divider / kb, mb / dwall, dcpu * divider / kb );
+  if( received.bytes != total )
+    printf( "error: %lu of %lu octets decompressed\n", static_cast<unsigned long>( received.bytes ),
+            static_cast<unsigned long>( total ) );
+}
+
 int main( int, char** )
 {
+  printf( "roster/MUC traffic, one stanza per flush:\n" );
+  const std::vector<std::string> stanzas = traffic();
+  trafficTest( stanzas, Z_BEST_SPEED );
+  trafficTest( stanzas, 3 );
+  trafficTest( stanzas, Z_DEFAULT_COMPRESSION );
+  trafficTest( stanzas, Z_BEST_COMPRESSION );
+
 //   int fail = 0;
   std::string name;
   ZlibTest t;
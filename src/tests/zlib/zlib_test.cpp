@@ -19,6 +19,7 @@ using namespace gloox;
 #include <stdio.h>
 #include <locale.h>
 #include <string>
+#include <thread>
 #include <cstdio> // [s]print[f]
 
 #ifdef HAVE_ZLIB
@@ -26,15 +27,19 @@ using namespace gloox;
 class ZlibTest : public CompressionDataHandler
 {
   public:
-    ZlibTest() : m_zlib( this ) { m_zlib.init(); }
+    ZlibTest( int level = Z_DEFAULT_COMPRESSION ) : m_zlib( this, level ), m_split( false )
+      { m_zlib.init(); }
     ~ZlibTest() {}
     virtual void handleCompressedData( const std::string& data );
     virtual void handleDecompressedData( const std::string& data );
     const std::string data() { std::string ret = m_decompressed; m_decompressed = ""; return ret; }
     void compress(  const std::string& data );
+    bool setParameters( int level, int strategy ) { return m_zlib.setParameters( level, strategy ); }
+    void setSplit( bool split ) { m_split = split; }
   private:
     CompressionZlib m_zlib;
     std::string m_decompressed;
+    bool m_split;
 };
 
 void ZlibTest::compress( const std::string& data )
@@ -44,7 +49,12 @@ void ZlibTest::compress( const std::string& data )
 
 void ZlibTest::handleCompressedData( const std::string& data )
 {
-  m_zlib.decompress( data );
+  // optionally feed the compressed data octet by octet
+  if( !m_split )
+    m_zlib.decompress( data );
+  else
+    for( std::string::size_type i = 0; i < data.length(); ++i )
+      m_zlib.decompress( data.data() + i, 1 );
 }
 
 void ZlibTest::handleDecompressedData( const std::string& data )
@@ -52,6 +62,31 @@ void ZlibTest::handleDecompressedData( const std::string& data )
   m_decompressed += data;
 }
 
+// waits for another thread to compress while handling compressed data
+class ZlibNested : public CompressionDataHandler
+{
+  public:
+    ZlibNested() : m_zlib( this ), m_nested( false ) { m_zlib.init(); }
+    virtual void handleCompressedData( const std::string& data )
+    {
+      m_zlib.decompress( data );
+      if( m_nested )
+        return;
+
+      m_nested = true;
+      std::thread t( &ZlibNested::compress, this, std::string( "<presence/>" ) );
+      t.join();
+    }
+    virtual void handleDecompressedData( const std::string& data ) { decompressed += data; }
+    void compress( const std::string& data ) { m_zlib.compress( data ); }
+
+    std::string decompressed;
+
+  private:
+    CompressionZlib m_zlib;
+    bool m_nested;
+};
+
 int main( int /*argc*/, char** /*argv*/ )
 {
   int fail = 0;
@@ -109,13 +144,78 @@ int main( int /*argc*/, char** /*argv*/ )
     ++fail;
     fprintf( stderr, "test '%s' failed\n", name.c_str() );
   }
+  // -------
+  name = "split input";
+  t.setSplit( true );
+  t.compress( b );
+  t.compress( c );
+  t.setSplit( false );
+  if( t.data() != b + c )
+  {
+    ++fail;
+    fprintf( stderr, "test '%s' failed\n", name.c_str() );
+  }
 
+  // -------
+  name = "levels";
+  for( int level = Z_NO_COMPRESSION; level <= Z_BEST_COMPRESSION; ++level )
+  {
+    ZlibTest l( level );
+    l.compress( b );
+    l.compress( a );
+    if( l.data() != b + a )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed for level %d\n", name.c_str(), level );
+    }
+  }
 
+  // -------
+  name = "change parameters";
+  {
+    ZlibTest l( Z_BEST_SPEED );
+    std::string e;
+    for( int i = 0; i < 1000; ++i )
+      e += "<message to='room@conference.example.net' type='groupchat'><body>"
+           + std::string( static_cast<std::string::size_type>( i % 50 ), static_cast<char>( 'a' + i % 26 ) )
+           + "</body></message>";
+    l.compress( e );
+    if( !l.setParameters( Z_BEST_COMPRESSION, Z_FILTERED ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+    l.compress( e );
+    l.setParameters( Z_NO_COMPRESSION, Z_DEFAULT_STRATEGY );
+    l.compress( a );
+    if( l.data() != e + e + a || l.setParameters( 10, Z_DEFAULT_STRATEGY )
+        || l.setParameters( Z_BEST_SPEED, 42 ) )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed\n", name.c_str() );
+    }
+  }
 
+  // -------
+  name = "compress from another thread in the handler";
+  {
+    ZlibNested n;
+    n.compress( "<message/>" );
+    n.compress( "<iq/>" );
+    if( n.decompressed != "<message/><presence/><iq/>" )
+    {
+      ++fail;
+      fprintf( stderr, "test '%s' failed: %s\n", name.c_str(), n.decompressed.c_str() );
+    }
+  }
 
-
-
-
+  // -------
+  name = "garbage input";
+  {
+    ZlibTest l;
+    l.handleCompressedData( std::string( 100, 'x' ) );
+    l.data();
+  }
 
 
 
@@ -0,0 +1,47 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef TIMERHANDLER_H__
+#define TIMERHANDLER_H__
+
+#include "macros.h"
+
+namespace gloox
+{
+
+  /**
+   * @brief A virtual interface which can be reimplemented to receive timer events
+   * from a ConnectionEventLoop.
+   *
+   * @author Jakob Schröter <js@camaya.net>
+   * @since 1.1
+   */
+  class GLOOX_API TimerHandler
+  {
+    public:
+      /**
+       * Virtual Destructor.
+       */
+      virtual ~TimerHandler() {}
+
+      /**
+       * This function is called when a timer expires.
+       * @param id The timer's ID, as returned by ConnectionEventLoop::registerTimer().
+       */
+      virtual void handleTimer( int id ) = 0;
+
+  };
+
+}
+
+#endif // TIMERHANDLER_H__
@@ -17,6 +17,7 @@
 
 #include "gloox.h"
 #include "mutex.h"
+#include "tlscontext.h"
 #include "tlshandler.h"
 
 namespace gloox
@@ -37,13 +38,14 @@ namespace gloox
        * @param server The server to use in certificate verification.
        */
       TLSBase( TLSHandler* th, const std::string server )
-        : m_handler( th ), m_server( server ), m_secure( false ), m_valid( false ), m_initLib( true )
+        : m_handler( th ), m_server( server ), m_context( 0 ), m_secure( false ), m_valid( false ),
+          m_initLib( true )
       {}
 
       /**
        * Virtual destructor.
        */
-      virtual ~TLSBase() {}
+      virtual ~TLSBase() { if( m_context ) m_context->release(); }
 
       /**
        * Initializes the TLS module. This function must be called (and execute successfully)
@@ -84,6 +86,18 @@ namespace gloox
        */
       virtual int decrypt( const std::string& data ) = 0;
 
+      /**
+       * Use this function to feed encrypted data or received handshake data to the
+       * encryption implementation without an intermediate copy. The default implementation
+       * copies the data into a string and calls the function above.
+       * @param data The data to decrypt.
+       * @param length The number of bytes in @c data.
+       * @return The number of bytes used from the input.
+       * @since 1.1
+       */
+      virtual int decrypt( const char* data, std::string::size_type length )
+        { return decrypt( std::string( data, length ) ); }
+
       /**
        * This function performs internal cleanup and will be called after a failed handshake attempt.
        */
@@ -148,6 +162,23 @@ namespace gloox
        */
       virtual void setClientCert( const std::string& clientKey, const std::string& clientCerts ) = 0;
 
+      /**
+       * Makes this TLS implementation use a shared TLSContext for its configuration and for
+       * session resumption. Must be called before init(). Implementations not supporting
+       * TLSContext ignore it.
+       * @param context The context to use. A reference is held until this object is destroyed
+       * or another context is set. May be 0.
+       * @since 1.1
+       */
+      virtual void setContext( TLSContext* context )
+      {
+        if( context )
+          context->acquire();
+        if( m_context )
+          m_context->release();
+        m_context = context;
+      }
+
     protected:
       TLSHandler* m_handler;
       StringList m_cacerts;
@@ -155,6 +186,7 @@ namespace gloox
       std::string m_clientCerts;
       std::string m_server;
       CertInfo m_certInfo;
+      TLSContext* m_context;
       util::Mutex m_mutex;
       bool m_secure;
       bool m_valid;
@@ -0,0 +1,131 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#include "tlscontext.h"
+#include "mutexguard.h"
+
+namespace gloox
+{
+
+  TLSContext::TLSContext( const std::string& clientKey, const std::string& clientCerts,
+                          const StringList& cacerts )
+    : m_clientKey( clientKey ), m_clientCerts( clientCerts ), m_cacerts( cacerts ),
+      m_maxSessions( 1024 )
+  {
+    m_refs.increment();
+  }
+
+  TLSContext::~TLSContext()
+  {
+    BackendMap::const_iterator it = m_backends.begin();
+    for( ; it != m_backends.end(); ++it )
+      delete (*it).second;
+  }
+
+  void TLSContext::acquire()
+  {
+    m_refs.increment();
+  }
+
+  void TLSContext::release()
+  {
+    if( m_refs.decrement() == 0 )
+      delete this;
+  }
+
+  void TLSContext::setSessionCacheSize( int size )
+  {
+    util::MutexGuard m( m_mutex );
+    m_maxSessions = size > 0 ? static_cast<SessionList::size_type>( size ) : 0;
+    while( m_sessions.size() > m_maxSessions )
+    {
+      m_sessionIndex.erase( m_sessions.back().first );
+      m_sessions.pop_back();
+    }
+  }
+
+  void TLSContext::storeSession( const std::string& server, const std::string& session )
+  {
+    util::MutexGuard m( m_mutex );
+    if( !m_maxSessions || session.empty() )
+      return;
+
+    SessionMap::iterator it = m_sessionIndex.find( server );
+    if( it != m_sessionIndex.end() )
+    {
+      (*(*it).second).second = session;
+      m_sessions.splice( m_sessions.begin(), m_sessions, (*it).second );
+      return;
+    }
+
+    if( m_sessions.size() >= m_maxSessions )
+    {
+      m_sessionIndex.erase( m_sessions.back().first );
+      m_sessions.pop_back();
+    }
+
+    m_sessions.push_front( std::make_pair( server, session ) );
+    m_sessionIndex[server] = m_sessions.begin();
+  }
+
+  bool TLSContext::findSession( const std::string& server, std::string& session )
+  {
+    util::MutexGuard m( m_mutex );
+    SessionMap::iterator it = m_sessionIndex.find( server );
+    if( it == m_sessionIndex.end() )
+      return false;
+
+    m_sessions.splice( m_sessions.begin(), m_sessions, (*it).second );
+    session = (*(*it).second).second;
+    return true;
+  }
+
+  void TLSContext::removeSession( const std::string& server )
+  {
+    util::MutexGuard m( m_mutex );
+    SessionMap::iterator it = m_sessionIndex.find( server );
+    if( it == m_sessionIndex.end() )
+      return;
+
+    m_sessions.erase( (*it).second );
+    m_sessionIndex.erase( it );
+  }
+
+  int TLSContext::sessions() const
+  {
+    util::MutexGuard m( m_mutex );
+    return static_cast<int>( m_sessions.size() );
+  }
+
+  TLSContext::Backend* TLSContext::backend( const std::string& name ) const
+  {
+    util::MutexGuard m( m_mutex );
+    BackendMap::const_iterator it = m_backends.find( name );
+    return it != m_backends.end() ? (*it).second : 0;
+  }
+
+  TLSContext::Backend* TLSContext::addBackend( const std::string& name, Backend* backend )
+  {
+    util::MutexGuard m( m_mutex );
+    BackendMap::const_iterator it = m_backends.find( name );
+    if( it == m_backends.end() )
+    {
+      m_backends[name] = backend;
+      return backend;
+    }
+
+    delete backend;
+    return (*it).second;
+  }
+
+}
@@ -0,0 +1,201 @@
+/*
+  Copyright (c) 2023 by Jakob Schröter <js@camaya.net>
+  This file is part of the gloox library. http://camaya.net/gloox
+
+  This software is distributed under a license. The full license
+  agreement can be found in the file LICENSE in this distribution.
+  This software may not be copied, modified, sold or distributed
+  other than expressed in the named license agreement.
+
+  This software is distributed without any warranty.
+*/
+
+
+#ifndef TLSCONTEXT_H__
+#define TLSCONTEXT_H__
+
+#include "gloox.h"
+#include "atomicrefcount.h"
+#include "mutex.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace gloox
+{
+
+  /**
+   * @brief A TLS configuration and session cache that can be shared by many TLS connections.
+   *
+   * Without a TLSContext, every TLS connection sets up its own TLS library context, i.e. it parses
+   * the CA certificates and the client certificate again, and always performs a full handshake.
+   * With thousands of (re-)connecting clients this dominates the CPU time spent on TLS.
+   *
+   * A TLSContext holds the CA certificates, the client certificate and key, and the TLS library
+   * objects derived from them (an SSL_CTX with OpenSSL, certificate credentials with GnuTLS).
+   * These are set up once, by the first connection that uses the context. It also caches the last
+   * TLS session per server name, so that a reconnect to the same server resumes the previous
+   * session with an abbreviated handshake.
+   *
+   * Usage:
+   * @code
+   * TLSContext* ctx = new TLSContext( EmptyString, EmptyString, cacerts );
+   * for( ... )
+   * {
+   *   Client* c = new Client( jid, password );
+   *   c->setTLSContext( ctx );
+   *   ...
+   * }
+   * ctx->release(); // the clients hold their own references
+   * @endcode
+   *
+   * A TLSContext is reference counted. It is created with one reference, owned by the creator.
+   * Every TLS implementation using it (see TLSBase::setContext()) holds another one. It deletes
+   * itself when the last reference is released. All functions are thread-safe.
+   *
+   * Server-side OpenSSL connections sharing a context also share the TLS library's server-side
+   * session cache and session ticket keys, so they can resume sessions, too. Server and client
+   * connections may share the same context.
+   *
+   * @note Settings passed to TLSBase::init(), TLSBase::setCACerts() and TLSBase::setClientCert()
+   * of a TLS implementation using a TLSContext are ignored in favour of the context's.
+   *
+   * @author Jakob Schröter <js@camaya.net>
+   * @since 1.1
+   */
+  class GLOOX_API TLSContext
+  {
+    public:
+      /**
+       * @brief Base class of the state a TLS implementation shares via a TLSContext, e.g. an
+       * OpenSSL SSL_CTX.
+       *
+       * You should not need to use this class directly.
+       */
+      class GLOOX_API Backend
+      {
+        public:
+          /**
+           * Virtual destructor. Frees the TLS library's objects.
+           */
+          virtual ~Backend() {}
+      };
+
+      /**
+       * Creates a new TLSContext, holding one reference.
+       * @param clientKey The absolute path to the user's private key in PEM format.
+       * @param clientCerts A path to a certificate bundle in PEM format.
+       * @param cacerts A list of absolute paths to CA root certificate files in PEM format.
+       * If empty, the system's default CA certificates are used.
+       */
+      TLSContext( const std::string& clientKey = EmptyString,
+                  const std::string& clientCerts = EmptyString,
+                  const StringList& cacerts = StringList() );
+
+      /**
+       * Adds a reference.
+       */
+      void acquire();
+
+      /**
+       * Releases a reference. Deletes the context if this was the last one.
+       */
+      void release();
+
+      /**
+       * Returns the path to the client's private key.
+       * @return The path to the client's private key.
+       */
+      const std::string& clientKey() const { return m_clientKey; }
+
+      /**
+       * Returns the path to the client's certificate bundle.
+       * @return The path to the client's certificate bundle.
+       */
+      const std::string& clientCerts() const { return m_clientCerts; }
+
+      /**
+       * Returns the paths to the trusted CA certificates.
+       * @return The paths to the trusted CA certificates.
+       */
+      const StringList& cacerts() const { return m_cacerts; }
+
+      /**
+       * Sets the maximum number of cached TLS sessions. When the cache is full, the session that
+       * has been used least recently is dropped. The default is 1024. 0 disables session
+       * resumption.
+       * @param size The maximum number of sessions to keep.
+       */
+      void setSessionCacheSize( int size );
+
+      /**
+       * Stores a TLS session for later resumption, replacing any previous session for the same
+       * server. Called by the TLS implementations.
+       * @param server The server name the session was established with.
+       * @param session The serialized session, in the TLS library's format.
+       */
+      void storeSession( const std::string& server, const std::string& session );
+
+      /**
+       * Looks up the cached TLS session for a server. Called by the TLS implementations.
+       * @param server The server name.
+       * @param session Receives the serialized session, if found.
+       * @return @b True if a session was found, @b false otherwise.
+       */
+      bool findSession( const std::string& server, std::string& session );
+
+      /**
+       * Removes the cached TLS session for a server, e.g. because resuming it failed.
+       * @param server The server name.
+       */
+      void removeSession( const std::string& server );
+
+      /**
+       * Returns the number of cached TLS sessions.
+       * @return The number of cached TLS sessions.
+       */
+      int sessions() const;
+
+      /**
+       * Returns the shared state registered by a TLS implementation. Called by the TLS
+       * implementations.
+       * @param name A name identifying the TLS implementation and role, e.g. "openssl-client".
+       * @return The shared state, or 0 if there is none yet.
+       */
+      Backend* backend( const std::string& name ) const;
+
+      /**
+       * Registers the shared state of a TLS implementation, unless another connection was faster.
+       * Called by the TLS implementations.
+       * @param name A name identifying the TLS implementation and role.
+       * @param backend The shared state. The context takes ownership.
+       * @return The registered state. If it is not @c backend, @c backend has been deleted.
+       */
+      Backend* addBackend( const std::string& name, Backend* backend );
+
+    private:
+      TLSContext& operator=( const TLSContext& );
+      TLSContext( const TLSContext& );
+      ~TLSContext();
+
+      typedef std::list< std::pair<std::string, std::string> > SessionList;
+      typedef std::map<std::string, SessionList::iterator> SessionMap;
+      typedef std::map<std::string, Backend*> BackendMap;
+
+      util::AtomicRefCount m_refs;
+      mutable util::Mutex m_mutex;
+      std::string m_clientKey;
+      std::string m_clientCerts;
+      StringList m_cacerts;
+      SessionList m_sessions;       // most recently used first
+      SessionMap m_sessionIndex;
+      BackendMap m_backends;
+      SessionList::size_type m_maxSessions;
+
+  };
+
+}
+
+#endif // TLSCONTEXT_H__
@@ -110,6 +110,11 @@ namespace gloox
     return m_impl ? m_impl->decrypt( data ) : 0;
   }
 
+  int TLSDefault::decrypt( const char* data, std::string::size_type length )
+  {
+    return m_impl ? m_impl->decrypt( data, length ) : 0;
+  }
+
   void TLSDefault::cleanup()
   {
     if( m_impl )
@@ -158,4 +163,10 @@ namespace gloox
       m_impl->setClientCert( clientKey, clientCerts );
   }
 
+  void TLSDefault::setContext( TLSContext* context )
+  {
+    if( m_impl )
+      m_impl->setContext( context );
+  }
+
 }
@@ -72,6 +72,9 @@ namespace gloox
       // reimplemented from TLSBase
       virtual int decrypt( const std::string& data );
 
+      // reimplemented from TLSBase
+      virtual int decrypt( const char* data, std::string::size_type length );
+
       // reimplemented from TLSBase
       virtual void cleanup();
 
@@ -99,6 +102,9 @@ namespace gloox
       // reimplemented from TLSBase
       virtual void setClientCert( const std::string& clientKey, const std::string& clientCerts );
 
+      // reimplemented from TLSBase
+      virtual void setContext( TLSContext* context );
+
       /**
        * Returns an ORed list of supported TLS types.
        * @return ORed TLSDefault::type members.
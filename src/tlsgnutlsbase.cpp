@@ -25,7 +25,8 @@ namespace gloox
 {
 
   GnuTLSBase::GnuTLSBase( TLSHandler* th, const std::string& server )
-    : TLSBase( th, server ), m_session( new gnutls_session_t ), m_buf( 0 ), m_bufsize( 17000 )
+    : TLSBase( th, server ), m_session( new gnutls_session_t ), m_buf( 0 ),
+      m_bufsize( 17000 ), m_decrypting( false )
   {
     m_buf = static_cast<char*>( calloc( m_bufsize + 1, sizeof( char ) ) );
   }
@@ -63,14 +64,25 @@ namespace gloox
 
   int GnuTLSBase::decrypt( const std::string& data )
   {
-    m_recvBuffer += data;
+    return decrypt( data.data(), data.length() );
+  }
+
+  int GnuTLSBase::decrypt( const char* data, std::string::size_type length )
+  {
+    m_recvBuffer.append( data, length );
+
+    // called from within handleDecryptedData(): m_buf is still in use, the outer call
+    // will pick up the data from m_recvBuffer
+    if( m_decrypting )
+      return static_cast<int>( length );
 
     if( !m_secure )
     {
       handshake();
-      return static_cast<int>( data.length() );
+      return static_cast<int>( length );
     }
 
+    m_decrypting = true;
     int sum = 0;
     int ret = 0;
     bool stop = false;
@@ -84,13 +96,14 @@ namespace gloox
       ret = static_cast<int>( gnutls_record_recv( *m_session, m_buf, m_bufsize ) );
       if( ret > 0 && m_handler )
       {
-        m_handler->handleDecryptedData( this, std::string( m_buf, ret ) );
+        m_handler->handleDecryptedData( this, m_buf, ret );
         sum += ret;
       }
       if( stop )
         break;
     }
     while( ret > 0 || ret == GNUTLS_E_AGAIN || ret == GNUTLS_E_INTERRUPTED );
+    m_decrypting = false;
 
     return sum;
   }
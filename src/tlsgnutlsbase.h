@@ -56,6 +56,9 @@ namespace gloox
       // reimplemented from TLSBase
       virtual int decrypt( const std::string& data );
 
+      // reimplemented from TLSBase
+      virtual int decrypt( const char* data, std::string::size_type length );
+
       // reimplemented from TLSBase
       virtual void cleanup();
 
@@ -84,6 +87,7 @@ namespace gloox
       std::string m_recvBuffer;
       char* m_buf;
       const int m_bufsize;
+      bool m_decrypting;
 
       ssize_t pullFunc( void* data, size_t len );
       static ssize_t pullFunc( gnutls_transport_ptr_t ptr, void* data, size_t len );
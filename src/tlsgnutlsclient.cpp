@@ -21,23 +21,94 @@
 namespace gloox
 {
 
+  // certificate credentials shared by all connections using the same TLSContext
+  class SharedCredentials : public TLSContext::Backend
+  {
+    public:
+      SharedCredentials( gnutls_certificate_credentials_t credentials )
+        : m_credentials( credentials ) {}
+      virtual ~SharedCredentials() { gnutls_certificate_free_credentials( m_credentials ); }
+      gnutls_certificate_credentials_t credentials() const { return m_credentials; }
+
+    private:
+      gnutls_certificate_credentials_t m_credentials;
+  };
+
   GnuTLSClient::GnuTLSClient( TLSHandler* th, const std::string& server )
-    : GnuTLSBase( th, server )
+    : GnuTLSBase( th, server ), m_credentials( 0 ), m_sharedCredentials( false )
   {
   }
 
   GnuTLSClient::~GnuTLSClient()
   {
+    storeSession();
   }
 
   void GnuTLSClient::cleanup()
   {
+    storeSession();
     GnuTLSBase::cleanup();
-    if( m_credentials )
+    if( m_credentials && !m_sharedCredentials )
       gnutls_certificate_free_credentials( m_credentials );
+    m_credentials = 0;
     init();
   }
 
+  bool GnuTLSClient::initCredentials()
+  {
+    if( !m_context )
+    {
+      m_sharedCredentials = false;
+      if( gnutls_certificate_allocate_credentials( &m_credentials ) < 0 )
+        return false;
+
+      gnutls_certificate_set_x509_system_trust( m_credentials );
+      return true;
+    }
+
+    // the first connection using the TLSContext loads the certificates, the others share them
+    TLSContext::Backend* shared = m_context->backend( "gnutls-client" );
+    if( !shared )
+    {
+      if( gnutls_certificate_allocate_credentials( &m_credentials ) < 0 )
+        return false;
+
+      m_sharedCredentials = false;
+      gnutls_certificate_set_x509_system_trust( m_credentials );
+      setCACerts( m_context->cacerts() );
+      setClientCert( m_context->clientKey(), m_context->clientCerts() );
+      shared = m_context->addBackend( "gnutls-client", new SharedCredentials( m_credentials ) );
+    }
+
+    m_credentials = static_cast<SharedCredentials*>( shared )->credentials();
+    m_sharedCredentials = true;
+    return true;
+  }
+
+  bool GnuTLSClient::handshake()
+  {
+    const bool secure = m_secure;
+    const bool ret = GnuTLSBase::handshake();
+    if( !secure && m_secure )
+      storeSession();
+
+    return ret;
+  }
+
+  void GnuTLSClient::storeSession()
+  {
+    if( !m_context || !m_secure || !m_session )
+      return;
+
+    gnutls_datum_t data;
+    if( gnutls_session_get_data2( *m_session, &data ) != GNUTLS_E_SUCCESS )
+      return;
+
+    m_context->storeSession( m_server, std::string( reinterpret_cast<const char*>( data.data ),
+                                                    data.size ) );
+    gnutls_free( data.data );
+  }
+
   bool GnuTLSClient::init( const std::string& /*clientKey*/,
                            const std::string& /*clientCerts*/,
                            const StringList& /*cacerts*/ )
@@ -45,12 +116,14 @@ namespace gloox
     if( m_initLib && gnutls_global_init() != 0 )
       return false;
 
-    if( gnutls_certificate_allocate_credentials( &m_credentials ) < 0 )
+    if( !initCredentials() )
       return false;
 
     if( gnutls_init( m_session, GNUTLS_CLIENT ) != 0 )
     {
-      gnutls_certificate_free_credentials( m_credentials );
+      if( !m_sharedCredentials )
+        gnutls_certificate_free_credentials( m_credentials );
+      m_credentials = 0;
       return false;
     }
 
@@ -75,9 +148,20 @@ namespace gloox
     gnutls_mac_set_priority( *m_session, macPriority );
 #endif
 
-    gnutls_certificate_set_x509_system_trust( m_credentials );
     gnutls_credentials_set( *m_session, GNUTLS_CRD_CERTIFICATE, m_credentials );
 
+    if( m_context )
+    {
+      gnutls_server_name_set( *m_session, GNUTLS_NAME_DNS, m_server.c_str(), m_server.length() );
+
+      std::string session;
+      if( m_context->findSession( m_server, session ) )
+      {
+        if( gnutls_session_set_data( *m_session, session.data(), session.length() ) != GNUTLS_E_SUCCESS )
+          m_context->removeSession( m_server );
+      }
+    }
+
     gnutls_transport_set_ptr( *m_session, static_cast<gnutls_transport_ptr_t>( this ) );
     gnutls_transport_set_push_function( *m_session, pushFunc );
     gnutls_transport_set_pull_function( *m_session, pullFunc );
@@ -88,6 +172,10 @@ namespace gloox
 
   void GnuTLSClient::setCACerts( const StringList& cacerts )
   {
+    // shared credentials are set up from the TLSContext
+    if( m_sharedCredentials )
+      return;
+
     m_cacerts = cacerts;
 
     StringList::const_iterator it = m_cacerts.begin();
@@ -97,6 +185,9 @@ namespace gloox
 
   void GnuTLSClient::setClientCert( const std::string& clientKey, const std::string& clientCerts )
   {
+    if( m_sharedCredentials )
+      return;
+
     m_clientKey = clientKey;
     m_clientCerts = clientCerts;
 
@@ -112,7 +203,8 @@ namespace gloox
     unsigned int status;
     bool error = false;
 
-    gnutls_certificate_free_ca_names( m_credentials );
+    if( !m_sharedCredentials )
+      gnutls_certificate_free_ca_names( m_credentials );
 
     if( gnutls_certificate_verify_peers2( *m_session, &status ) < 0 )
       error = true;
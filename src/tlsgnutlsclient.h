@@ -64,13 +64,20 @@ namespace gloox
       // reimplemented from TLSBase
       virtual void cleanup();
 
+      // reimplemented from TLSBase
+      virtual bool handshake();
+
     private:
       virtual void getCertInfo();
 
+      bool initCredentials();
+      void storeSession();
+
       bool verifyAgainst( gnutls_x509_crt_t cert, gnutls_x509_crt_t issuer );
       bool verifyAgainstCAs( gnutls_x509_crt_t cert, gnutls_x509_crt_t *CAList, int CAListSize );
 
       gnutls_certificate_credentials_t m_credentials;
+      bool m_sharedCredentials;
 
   };
 
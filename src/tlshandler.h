@@ -53,6 +53,23 @@ namespace gloox
        */
       virtual void handleDecryptedData( const TLSBase* base, const std::string& data ) = 0;
 
+      /**
+       * Reimplement this function to receive decrypted data without an intermediate copy.
+       * The default implementation copies the data into a string and calls the function above.
+       * @param base The encryption implementation which called this function.
+       * @param data The decrypted data. This points into the TLS implementation's internal read
+       * buffer and is only valid until this function returns; copy whatever you need to keep.
+       * @param length The number of bytes in @c data.
+       * @note The implementation must not call TLSBase::decrypt() on @c base (directly or
+       * indirectly, e.g. by receiving from the underlying connection) from within this
+       * function. The OpenSSL and GnuTLS implementations guard against this: data passed in by
+       * such a nested call is only buffered and decrypted after this function has returned.
+       * @since 1.1
+       */
+      virtual void handleDecryptedData( const TLSBase* base, const char* data,
+                                        std::string::size_type length )
+        { handleDecryptedData( base, std::string( data, length ) ); }
+
       /**
        * Reimplement this function to receive the result of a TLS handshake.
        * @param base The encryption implementation which called this function.
@@ -29,13 +29,33 @@
 #endif
 
 #include <string.h>
-#include <iostream>
 
 namespace gloox
 {
 
+#if defined OPENSSL_VERSION_NUMBER && ( OPENSSL_VERSION_NUMBER < 0x10100000 )
+  static int SSL_CTX_up_ref( SSL_CTX* ctx )
+  {
+    CRYPTO_add( &ctx->references, 1, CRYPTO_LOCK_SSL_CTX );
+    return 1;
+  }
+#endif // OPENSSL_VERSION_NUMBER < 0x10100000
+
+  // an SSL_CTX shared by all connections using the same TLSContext
+  class SharedSSLContext : public TLSContext::Backend
+  {
+    public:
+      SharedSSLContext( SSL_CTX* ctx ) : m_ctx( ctx ) {}
+      virtual ~SharedSSLContext() { SSL_CTX_free( m_ctx ); }
+      SSL_CTX* ctx() const { return m_ctx; }
+
+    private:
+      SSL_CTX* m_ctx;
+  };
+
   OpenSSLBase::OpenSSLBase( TLSHandler* th, const std::string& server )
-    : TLSBase( th, server ), m_ssl( 0 ), m_ctx( 0 ), m_buf( 0 ), m_bufsize( 17000 )
+    : TLSBase( th, server ), m_ssl( 0 ), m_ctx( 0 ), m_buf( 0 ), m_bufsize( 17000 ),
+      m_decrypting( false )
   {
     m_buf = static_cast<char*>( calloc( m_bufsize + 1, sizeof( char ) ) );
   }
@@ -66,12 +86,9 @@ namespace gloox
 
     OpenSSL_add_all_algorithms();
 
-    if( !setType() ) //inits m_ctx
+    if( !initContext( clientKey, clientCerts, cacerts ) ) //inits m_ctx
       return false;
 
-    setClientCert( clientKey, clientCerts );
-    setCACerts( cacerts );
-
 //    if( !SSL_CTX_set_cipher_list( m_ctx, "HIGH:MEDIUM:AES:@STRENGTH" ) )
 //      return false;
 
@@ -95,6 +112,37 @@ namespace gloox
     return true;
   }
 
+  bool OpenSSLBase::initContext( const std::string& clientKey, const std::string& clientCerts,
+                                 const StringList& cacerts )
+  {
+    if( !m_context )
+    {
+      if( !setType() )
+        return false;
+
+      setClientCert( clientKey, clientCerts );
+      setCACerts( cacerts );
+      return true;
+    }
+
+    // the first connection using the TLSContext sets up the SSL_CTX, the others share it
+    const std::string name = contextName();
+    TLSContext::Backend* shared = m_context->backend( name );
+    if( !shared )
+    {
+      if( !setType() )
+        return false;
+
+      setClientCert( m_context->clientKey(), m_context->clientCerts() );
+      setCACerts( m_context->cacerts() );
+      shared = m_context->addBackend( name, new SharedSSLContext( m_ctx ) );
+    }
+
+    m_ctx = static_cast<SharedSSLContext*>( shared )->ctx();
+    SSL_CTX_up_ref( m_ctx );
+    return true;
+  }
+
   bool OpenSSLBase::encrypt( const std::string& data )
   {
     m_sendBuffer += data;
@@ -111,7 +159,17 @@ namespace gloox
 
   int OpenSSLBase::decrypt( const std::string& data )
   {
-    m_recvBuffer += data;
+    return decrypt( data.data(), data.length() );
+  }
+
+  int OpenSSLBase::decrypt( const char* data, std::string::size_type length )
+  {
+    m_recvBuffer.append( data, length );
+
+    // called from within handleDecryptedData(): m_buf is still in use, the outer call
+    // will pick up the data from m_recvBuffer
+    if( m_decrypting )
+      return static_cast<int>( length );
 
     if( !m_secure )
     {
@@ -119,7 +177,9 @@ namespace gloox
       return 0;
     }
 
+    m_decrypting = true;
     doTLSOperation( TLSRead );
+    m_decrypting = false;
     return true;
   }
 
@@ -193,7 +253,6 @@ namespace gloox
       }
 
       int err = SSL_get_error( m_ssl, ret );
-      std::cout<<"SSL_get_error is:"<< ERR_error_string(SSL_ERROR_SSL, NULL)<<std::endl;
       switch( err )
       {
         case SSL_ERROR_WANT_READ:
@@ -206,7 +265,7 @@ namespace gloox
           else if( op == TLSWrite )
             m_sendBuffer.erase( 0, ret );
           else if( op == TLSRead )
-            m_handler->handleDecryptedData( this, std::string( m_buf, ret ) );
+            m_handler->handleDecryptedData( this, m_buf, ret );
           pushFunc();
           break;
         default:
@@ -59,6 +59,9 @@ namespace gloox
       // reimplemented from TLSBase
       virtual int decrypt( const std::string& data );
 
+      // reimplemented from TLSBase
+      virtual int decrypt( const char* data, std::string::size_type length );
+
       // reimplemented from TLSBase
       virtual void cleanup();
 
@@ -75,6 +78,12 @@ namespace gloox
       virtual bool setType() = 0;
       virtual int handshakeFunction() = 0;
 
+      /**
+       * Returns the name under which the SSL_CTX is shared via a TLSContext.
+       * @return The name of the shared SSL_CTX.
+       */
+      virtual const std::string contextName() const = 0;
+
       SSL* m_ssl;
       SSL_CTX* m_ctx;
       BIO* m_ibio;
@@ -91,6 +100,8 @@ namespace gloox
         TLSRead
       };
 
+      bool initContext( const std::string& clientKey, const std::string& clientCerts,
+                        const StringList& cacerts );
       void doTLSOperation( TLSOperation op );
       int ASN1Time2UnixTime( ASN1_TIME* time );
 
@@ -98,6 +109,7 @@ namespace gloox
       std::string m_sendBuffer;
       char* m_buf;
       const int m_bufsize;
+      bool m_decrypting;
 
   };
 
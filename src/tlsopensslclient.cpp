@@ -36,9 +36,60 @@ namespace gloox
 
     SSL_CTX_set_options( m_ctx, SSL_OP_NO_SSLv3 );
 
+    // sessions go to the TLSContext's cache, which is keyed by server name
+    if( m_context )
+    {
+      SSL_CTX_set_session_cache_mode( m_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+      SSL_CTX_sess_set_new_cb( m_ctx, newSession );
+    }
+
+    return true;
+  }
+
+  bool OpenSSLClient::privateInit()
+  {
+    if( !m_context )
+      return true;
+
+    SSL_set_app_data( m_ssl, this );
+    SSL_set_tlsext_host_name( m_ssl, m_server.c_str() );
+
+    std::string data;
+    if( m_context->findSession( m_server, data ) )
+    {
+      const unsigned char* p = reinterpret_cast<const unsigned char*>( data.data() );
+      SSL_SESSION* session = d2i_SSL_SESSION( 0, &p, static_cast<long>( data.length() ) );
+      if( session )
+      {
+        SSL_set_session( m_ssl, session );
+        SSL_SESSION_free( session );
+      }
+      else
+        m_context->removeSession( m_server );
+    }
+
     return true;
   }
 
+  int OpenSSLClient::newSession( SSL* ssl, SSL_SESSION* session )
+  {
+    OpenSSLClient* client = static_cast<OpenSSLClient*>( SSL_get_app_data( ssl ) );
+    if( !client || !client->m_context )
+      return 0;
+
+    const int length = i2d_SSL_SESSION( session, 0 );
+    if( length <= 0 )
+      return 0;
+
+    std::string data( static_cast<std::string::size_type>( length ), '\0' );
+    unsigned char* p = reinterpret_cast<unsigned char*>( &data[0] );
+    i2d_SSL_SESSION( session, &p );
+    client->m_context->storeSession( client->m_server, data );
+
+    // the session has been serialized, OpenSSL keeps ownership
+    return 0;
+  }
+
   bool OpenSSLClient::hasChannelBinding() const
   {
     return true;
@@ -63,6 +63,14 @@ namespace gloox
       // reimplemented from OpenSSLBase
       virtual int handshakeFunction();
 
+      // reimplemented from OpenSSLBase
+      virtual const std::string contextName() const { return "openssl-client"; }
+
+      // reimplemented from OpenSSLBase
+      virtual bool privateInit();
+
+      static int newSession( SSL* ssl, SSL_SESSION* session );
+
   };
 
 }
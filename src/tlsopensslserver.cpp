@@ -25,6 +25,9 @@
 namespace gloox
 {
 
+  DH* tmp_dh_callback( SSL* s, int is_export, int keylength );
+  RSA* tmp_rsa_callback( SSL* s, int is_export, int keylength );
+
   OpenSSLServer::OpenSSLServer( TLSHandler* th )
     : OpenSSLBase( th )
   {
@@ -40,8 +43,14 @@ namespace gloox
     if( !m_ctx )
       return false;
 
-    SSL_CTX_set_options( m_ctx, SSL_OP_NO_SSLv3 );
-    
+    SSL_CTX_set_options( m_ctx, SSL_OP_NO_SSLv3 | SSL_OP_CIPHER_SERVER_PREFERENCE );
+    SSL_CTX_set_tmp_rsa_callback( m_ctx, tmp_rsa_callback );
+    SSL_CTX_set_tmp_dh_callback( m_ctx, tmp_dh_callback );
+
+    // lets connections sharing the SSL_CTX via a TLSContext resume each other's sessions
+    static const unsigned char sessionIdContext[] = "gloox";
+    SSL_CTX_set_session_id_context( m_ctx, sessionIdContext, sizeof( sessionIdContext ) - 1 );
+
     return true;
   }
 
@@ -288,14 +297,6 @@ namespace gloox
     return RSA_generate_key( keylength, RSA_F4, 0, 0 );
   }
 
-  bool OpenSSLServer::privateInit()
-  {
-    SSL_CTX_set_tmp_rsa_callback( m_ctx, tmp_rsa_callback );
-    SSL_CTX_set_tmp_dh_callback( m_ctx, tmp_dh_callback );
-    SSL_CTX_set_options( m_ctx, SSL_OP_CIPHER_SERVER_PREFERENCE );
-    return true;
-  }
-
 }
 
 #endif // __SYMBIAN32__
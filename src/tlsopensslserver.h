@@ -47,11 +47,12 @@ namespace gloox
       virtual ~OpenSSLServer();
 
     private:
-      // reimplemented from OpenSSLBase
-      virtual bool privateInit();
       // reimplemented from OpenSSLBase
       virtual bool setType();
 
+      // reimplemented from OpenSSLBase
+      virtual const std::string contextName() const { return "openssl-server"; }
+
       // reimplemented from OpenSSLBase
       virtual int handshakeFunction();
 
@@ -14,6 +14,27 @@
 #include "gloox.h"
 
 #include <cstdio>
+#include <cstring>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+# define GLOOX_FIND_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#if defined( GLOOX_FIND_SSE2 ) && defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+# define GLOOX_FIND_AVX2 1
+# include <immintrin.h>
+#endif
+
+#if defined( _MSC_VER )
+# include <intrin.h>
+#endif
+
+#if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
+# include <windows.h>
+#else
+# include <time.h>
+#endif
 
 namespace gloox
 {
@@ -32,6 +53,17 @@ namespace gloox
       return ( (n == 0) ? (-1) : pos );
     }
 
+    long long monotonicTime()
+    {
+#if defined( _WIN32 ) && !defined( __SYMBIAN32__ )
+      return static_cast<long long>( GetTickCount64() );
+#else
+      struct timespec ts;
+      clock_gettime( CLOCK_MONOTONIC, &ts );
+      return static_cast<long long>( ts.tv_sec ) * 1000 + ts.tv_nsec / 1000000;
+#endif
+    }
+
     unsigned _lookup( const std::string& str, const char* values[], unsigned size, int def )
     {
       unsigned i = 0;
@@ -66,112 +98,346 @@ namespace gloox
       return std::string( buf, 40 );
     }
 
-    static const char escape_chars[] = { '&', '<', '>', '\'', '"' };
+    // the characters to escape, in the order of escape_seqs
+    static const char escape_chars[] = "&<>'\"";
 
-    static const std::string escape_seqs[] = { "amp;", "lt;", "gt;", "apos;", "quot;" };
+    static const std::string escape_seqs[] = { "&amp;", "&lt;", "&gt;", "&apos;", "&quot;" };
 
-    static const std::string escape_seqs_full[] = { "&amp;", "&lt;", "&gt;", "&apos;", "&quot;" };
+    const std::string escape( const std::string& what )
+    {
+      std::string escaped;
+      appendEscaped( escaped, what );
+      return escaped;
+    }
 
-    static const unsigned escape_size = 5;
+    static inline bool needsEscaping( char c )
+    {
+      return c == '&' || c == '<' || c == '>' || c == '\'' || c == '"';
+    }
 
-    const std::string escape( std::string what )
+    static std::string::size_type findEscape( const char* data, std::string::size_type pos,
+                                              std::string::size_type length )
     {
-      for( size_t val, i = 0; i < what.length(); ++i )
+      // characters to escape tend to come in clusters, so look at the next few octets before
+      // setting up a vector search
+      const std::string::size_type stop = std::min( pos + 8, length );
+      for( ; pos < stop; ++pos )
       {
-        for( val = 0; val < escape_size; ++val )
-        {
-          if( what[i] == escape_chars[val] )
-          {
-            what[i] = '&';
-            what.insert( i+1, escape_seqs[val] );
-            i += escape_seqs[val].length();
-            break;
-          }
-        }
+        if( needsEscaping( data[pos] ) )
+          return pos;
       }
-      return what;
+      return findFirstOf( data, pos, length, escape_chars );
     }
 
     void appendEscaped( std::string& target, const std::string& data )
     {
-      size_t rangeStart = 0, rangeCount = 0;
-      size_t length = data.length();
+      // runs that don't need escaping are appended in one go, so input without any
+      // characters to escape is a single copy
       const char* dataPtr = data.data();
-      for( size_t val, i = 0; i < length; ++i )
+      const std::string::size_type length = data.length();
+      std::string::size_type start = 0;
+      std::string::size_type pos = findEscape( dataPtr, 0, length );
+      while( pos < length )
       {
-        const char current = dataPtr[i];
-        for( val = 0; val < escape_size; ++val )
-        {
-          if( current == escape_chars[val] )
-          {
-            // We have a character that needs to be escaped.
-            if( rangeCount > 0 )
-            {
-              // We have a range of the data that needs to be appended
-              // before we escape the current character.
-              // NOTE: Use "data" (std::string) here not dataPtr (const char*).
-              //  Both have the same content, but there isn't
-              //  an append override that takes const char*, pos, n
-              //  (so a temporary std::string would be created)
-              target.append( data, rangeStart, rangeCount );
-            }
-            target.append( escape_seqs_full[val] );
-            rangeStart = i + 1;
-            rangeCount = 0;
-            break;
-          }
-        }
+        target.append( dataPtr + start, pos - start );
+        target.append( escape_seqs[strchr( escape_chars, dataPtr[pos] ) - escape_chars] );
+        start = pos + 1;
+        pos = findEscape( dataPtr, start, length );
+      }
+      target.append( dataPtr + start, length - start );
+    }
 
-        if( rangeStart <= i )
-        {
-          // current did not need to be escaped
-          ++rangeCount;
-        }
+    typedef std::string::size_type ( *FindFirstOfFunc )( const char*, std::string::size_type,
+                                                         std::string::size_type, const char*, int );
+
+    static std::string::size_type findFirstOfScalar( const char* data, std::string::size_type pos,
+                                                     std::string::size_type length,
+                                                     const char* set, int n )
+    {
+      unsigned int bits[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+      for( int j = 0; j < n; ++j )
+      {
+        const unsigned char c = static_cast<unsigned char>( set[j] );
+        bits[c >> 5] |= 1u << ( c & 31 );
       }
 
-      if( rangeCount > 0 )
+      for( ; pos < length; ++pos )
       {
-        // Append the remaining pending range of data that does
-        // not need to be escaped.
-        // NOTE: See previous comment on using data not dataPtr for append.
-        target.append( data, rangeStart, rangeCount );
+        const unsigned char c = static_cast<unsigned char>( data[pos] );
+        if( bits[c >> 5] & ( 1u << ( c & 31 ) ) )
+          return pos;
       }
+      return length;
     }
 
-    bool checkValidXMLChars( const std::string& data )
+#if defined( GLOOX_FIND_SSE2 )
+    static inline unsigned firstBit( unsigned mask )
+    {
+#if defined( __GNUC__ )
+      return static_cast<unsigned>( __builtin_ctz( mask ) );
+#elif defined( _MSC_VER )
+      unsigned long idx;
+      _BitScanForward( &idx, mask );
+      return static_cast<unsigned>( idx );
+#else
+      unsigned idx = 0;
+      for( ; !( mask & 1 ); mask >>= 1 )
+        ++idx;
+      return idx;
+#endif
+    }
+
+    static inline unsigned matchSSE2( const char* data, const __m128i* needles, int n )
+    {
+      const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) );
+      __m128i match = _mm_cmpeq_epi8( block, needles[0] );
+      for( int j = 1; j < n; ++j )
+        match = _mm_or_si128( match, _mm_cmpeq_epi8( block, needles[j] ) );
+      return static_cast<unsigned>( _mm_movemask_epi8( match ) );
+    }
+
+    // requires length - pos >= 16
+    static std::string::size_type findFirstOfSSE2( const char* data, std::string::size_type pos,
+                                                   std::string::size_type length,
+                                                   const char* set, int n )
+    {
+      __m128i needles[8];
+      for( int j = 0; j < n; ++j )
+        needles[j] = _mm_set1_epi8( set[j] );
+
+      for( ; pos + 16 <= length; pos += 16 )
+      {
+        const unsigned mask = matchSSE2( data + pos, needles, n );
+        if( mask )
+          return pos + firstBit( mask );
+      }
+
+      // the octets before pos have been checked already, so the last block may overlap them
+      if( pos < length )
+      {
+        const unsigned mask = matchSSE2( data + length - 16, needles, n );
+        if( mask )
+          return length - 16 + firstBit( mask );
+      }
+      return length;
+    }
+#endif
+
+#if defined( GLOOX_FIND_AVX2 )
+    __attribute__(( target( "avx2" ) ))
+    static inline unsigned matchAVX2( const char* data, const __m256i* needles, int n )
+    {
+      const __m256i block = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+      __m256i match = _mm256_cmpeq_epi8( block, needles[0] );
+      for( int j = 1; j < n; ++j )
+        match = _mm256_or_si256( match, _mm256_cmpeq_epi8( block, needles[j] ) );
+      return static_cast<unsigned>( _mm256_movemask_epi8( match ) );
+    }
+
+    // requires length - pos >= 32. Doesn't call out to SSE2 code, as mixing both is expensive on
+    // some CPUs.
+    __attribute__(( target( "avx2" ) ))
+    static std::string::size_type findFirstOfAVX2( const char* data, std::string::size_type pos,
+                                                   std::string::size_type length,
+                                                   const char* set, int n )
+    {
+      __m256i needles[8];
+      for( int j = 0; j < n; ++j )
+        needles[j] = _mm256_set1_epi8( set[j] );
+
+      for( ; pos + 32 <= length; pos += 32 )
+      {
+        const unsigned mask = matchAVX2( data + pos, needles, n );
+        if( mask )
+          return pos + firstBit( mask );
+      }
+
+      if( pos < length )
+      {
+        const unsigned mask = matchAVX2( data + length - 32, needles, n );
+        if( mask )
+          return length - 32 + firstBit( mask );
+      }
+      return length;
+    }
+#endif
+
+#if defined( GLOOX_FIND_AVX2 )
+    static bool hasAVX2()
+    {
+      __builtin_cpu_init();
+      return __builtin_cpu_supports( "avx2" );
+    }
+#endif
+
+    static FindFirstOfFunc resolveFindFirstOf()
     {
-      if( data.empty() )
-        return true;
+#if defined( GLOOX_FIND_AVX2 )
+      if( hasAVX2() )
+        return findFirstOfAVX2;
+#endif
+#if defined( GLOOX_FIND_SSE2 )
+      return findFirstOfSSE2;
+#else
+      return findFirstOfScalar;
+#endif
+    }
+
+    std::string::size_type findFirstOf( const char* data, std::string::size_type pos,
+                                        std::string::size_type length, const char* set )
+    {
+      static const FindFirstOfFunc find = resolveFindFirstOf();
+
+      if( pos >= length )
+        return length;
+
+      const int n = std::min( static_cast<int>( strlen( set ) ), 8 );
+      if( n == 1 )
+      {
+        const void* match = memchr( data + pos, set[0], length - pos );
+        return match ? static_cast<const char*>( match ) - data : length;
+      }
 
+      // not worth setting up the vector registers for a couple of octets
+      if( length - pos < 16 )
+        return findFirstOfScalar( data, pos, length, set, n );
+
+#if defined( GLOOX_FIND_SSE2 )
+      if( length - pos < 32 )
+        return findFirstOfSSE2( data, pos, length, set, n );
+#endif
+
+      return find( data, pos, length, set, n );
+    }
+
+    typedef const char* ( *FindNonTextFunc )( const char*, const char* );
+
+    // Octets in [0x20, 0xbf] are always valid: printable ASCII and UTF-8 continuation octets.
+    // Only the others need a closer look in checkValidXMLChars().
+    static const char* findNonTextScalar( const char* data, const char* end )
+    {
+      for( ; data != end; ++data )
+      {
+        const unsigned char current = static_cast<unsigned char>( *data );
+        if( current < 0x20 || current >= 0xc0 )
+          break;
+      }
+      return data;
+    }
+
+#if defined( GLOOX_FIND_SSE2 )
+    static inline unsigned nonTextSSE2( const char* data )
+    {
+      // there is no unsigned comparison, so flip the sign bit and compare signed
+      const __m128i block = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) ),
+                                           _mm_set1_epi8( static_cast<char>( 0x80 ) ) );
+      const __m128i match = _mm_or_si128(
+          _mm_cmplt_epi8( block, _mm_set1_epi8( static_cast<char>( 0x20 ^ 0x80 ) ) ),
+          _mm_cmpgt_epi8( block, _mm_set1_epi8( static_cast<char>( 0xbf ^ 0x80 ) ) ) );
+      return static_cast<unsigned>( _mm_movemask_epi8( match ) );
+    }
+
+    // requires end - data >= 16
+    static const char* findNonTextSSE2( const char* data, const char* end )
+    {
+      for( ; end - data >= 16; data += 16 )
+      {
+        const unsigned mask = nonTextSSE2( data );
+        if( mask )
+          return data + firstBit( mask );
+      }
+
+      if( data != end )
+      {
+        const unsigned mask = nonTextSSE2( end - 16 );
+        if( mask )
+          return end - 16 + firstBit( mask );
+      }
+      return end;
+    }
+#endif
+
+#if defined( GLOOX_FIND_AVX2 )
+    __attribute__(( target( "avx2" ) ))
+    static inline unsigned nonTextAVX2( const char* data )
+    {
+      const __m256i block = _mm256_xor_si256(
+          _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) ),
+          _mm256_set1_epi8( static_cast<char>( 0x80 ) ) );
+      const __m256i match = _mm256_or_si256(
+          _mm256_cmpgt_epi8( _mm256_set1_epi8( static_cast<char>( 0x20 ^ 0x80 ) ), block ),
+          _mm256_cmpgt_epi8( block, _mm256_set1_epi8( static_cast<char>( 0xbf ^ 0x80 ) ) ) );
+      return static_cast<unsigned>( _mm256_movemask_epi8( match ) );
+    }
+
+    // requires end - data >= 32
+    __attribute__(( target( "avx2" ) ))
+    static const char* findNonTextAVX2( const char* data, const char* end )
+    {
+      for( ; end - data >= 32; data += 32 )
+      {
+        const unsigned mask = nonTextAVX2( data );
+        if( mask )
+          return data + firstBit( mask );
+      }
+
+      if( data != end )
+      {
+        const unsigned mask = nonTextAVX2( end - 32 );
+        if( mask )
+          return end - 32 + firstBit( mask );
+      }
+      return end;
+    }
+#endif
+
+    static FindNonTextFunc resolveFindNonText()
+    {
+#if defined( GLOOX_FIND_AVX2 )
+      if( hasAVX2() )
+        return findNonTextAVX2;
+#endif
+#if defined( GLOOX_FIND_SSE2 )
+      return findNonTextSSE2;
+#else
+      return findNonTextScalar;
+#endif
+    }
+
+    static inline const char* findNonText( const char* data, const char* end )
+    {
+      static const FindNonTextFunc find = resolveFindNonText();
+
+      if( end - data < 16 )
+        return findNonTextScalar( data, end );
+#if defined( GLOOX_FIND_SSE2 )
+      if( end - data < 32 )
+        return findNonTextSSE2( data, end );
+#endif
+      return find( data, end );
+    }
+
+    bool checkValidXMLChars( const std::string& data )
+    {
       const char* dataPtr = data.data();
       const char* end = dataPtr + data.length();
-      for( ; dataPtr != end; ++dataPtr )
+      while( ( dataPtr = findNonText( dataPtr, end ) ) != end )
       {
-        unsigned char current = static_cast<unsigned char>( *dataPtr );
+        const unsigned char current = static_cast<unsigned char>( *dataPtr );
         if( current < 0x20 )
         {
-          if( current == 0x09
-              || current == 0x0a
-              || current == 0x0d )
-            // Valid character
-            continue;
-          else
+          if( current != 0x09 && current != 0x0a && current != 0x0d )
             // Invalid character
-            break;
+            return false;
         }
-        else if( current >= 0xf5 )
-          // Invalid character
-          break;
-        else if( current == 0xc0
-                 || current == 0xc1 )
+        else if( current >= 0xf5 || current == 0xc0 || current == 0xc1 )
           // Invalid character
-          break;
-        else
-          // Valid character
-          continue;
+          return false;
+
+        ++dataPtr;
       }
 
-      return ( dataPtr == end );
+      return true;
     }
 
     void replaceAll( std::string& target, const std::string& find, const std::string& replace )
@@ -14,6 +14,7 @@
 #define UTIL_H__
 
 #include "gloox.h"
+#include "smallvector.h"
 
 #include <cmath>
 #include <algorithm>
@@ -161,6 +162,19 @@ namespace gloox
       }
     }
 
+    /**
+     * Delete all elements from a SmallVector of pointers.
+     * @param L SmallVector of pointers to delete.
+     */
+    template< typename T, unsigned N >
+    inline void clearList( SmallVector< T*, N >& L )
+    {
+      typename SmallVector< T*, N >::iterator it = L.begin();
+      for( ; it != L.end(); ++it )
+        delete (*it);
+      L.clear();
+    }
+
     /**
      * Delete all associated values from a map (not the key elements).
      * @param M Map of pointer values to delete.
@@ -205,14 +219,14 @@ namespace gloox
      * @param what A string to escape.
      * @return The escaped string.
      */
-    GLOOX_API const std::string escape( std::string what );
+    GLOOX_API const std::string escape( const std::string& what );
 
     /**
      * Append the data to the target, doing any necessary escaping
      * along the way (& --> &amp;amp;, etc).
      * This method is faster than calling "escape" and appending the
      * return value, especially for source strings that don't need
-     * any escaping.
+     * any escaping. Characters to escape are searched for using findFirstOf().
      * @param target The string to append the data to.
      * @param data The string to append that might need escaping.
      */
@@ -220,11 +234,33 @@ namespace gloox
 
     /**
      * Checks whether the given input is valid UTF-8.
+     * Long inputs are scanned in 16 or 32 byte blocks using SSE2 or AVX2, if available.
      * @param data The data to check for validity.
      * @return @b True if the input is valid UTF-8, @b false otherwise.
      */
     GLOOX_API bool checkValidXMLChars( const std::string& data );
 
+    /**
+     * Finds the first octet in @c data[pos, length) that is one of the characters in @c set.
+     * Long inputs are scanned in 16 or 32 byte blocks using SSE2 or AVX2, if available.
+     * AVX2 support is detected at runtime.
+     * @param data The data to search.
+     * @param pos The position to start searching at.
+     * @param length The length of @c data.
+     * @param set A 0-terminated list of at most 8 characters to search for.
+     * @return The position of the first match, or @c length if there is none.
+     * @since 1.1
+     */
+    GLOOX_API std::string::size_type findFirstOf( const char* data, std::string::size_type pos,
+                                                  std::string::size_type length, const char* set );
+
+    /**
+     * Returns the value of a monotonic clock, e.g. to compute timeouts.
+     * @return The current time in milliseconds, relative to an unspecified starting point.
+     * @since 1.1
+     */
+    GLOOX_API long long monotonicTime();
+
     /**
      * Custom log2() implementation.
      * @param n Figure to take the logarithm from.